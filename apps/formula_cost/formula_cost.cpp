@@ -0,0 +1,217 @@
+#include <cura-formulae-engine/cura-formulae-engine.h>
+#include <cura-formulae-engine/opt/cost_model.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+
+struct Entry
+{
+    std::string formula;
+    double cost;
+    std::string dominant;
+};
+
+void usage()
+{
+    spdlog::info("Usage: formula_cost [--top N] [--size name=n]... [corpus]");
+    spdlog::info("       formula_cost --calibrate");
+    spdlog::info("Reads one formula per line from the corpus file, or from stdin, and reports the most expensive ones.");
+    spdlog::info("--calibrate times small formulas and compares them with their estimated cost.");
+}
+
+/**
+ * @brief Formulas of one or two nodes over a few variables, to time the node kinds and builtins one by one.
+ */
+constexpr std::string_view probes[] = {
+    "a",
+    "1.5",
+    "-a",
+    "not t",
+    "a + b",
+    "a - b",
+    "a * b",
+    "a / b",
+    "n % 3",
+    "a ** b",
+    "t and u",
+    "a < b",
+    "a if t else b",
+    "xs[1]",
+    "xs[1:3]",
+    "[a, b]",
+    "[x for x in xs]",
+    "abs(a)",
+    "round(a)",
+    "math.sqrt(a)",
+    "int(a)",
+    "float(n)",
+    "str(a)",
+    "len(xs)",
+    "max(xs)",
+    "sum(xs)",
+    "min(a, b)",
+};
+
+/**
+ * @brief Prints the time each probe takes, in units of the time of looking up a variable, next to its estimated cost,
+ * which is in the same unit. The default weights of `CostModel` were set from this output.
+ */
+int calibrate(const CuraFormulaeEngine::opt::CostModel& model)
+{
+    using namespace CuraFormulaeEngine;
+
+    env::LocalEnvironment environment{ &env::std_env };
+    environment.set("a", 1.5);
+    environment.set("b", 2.25);
+    environment.set("n", std::int64_t{ 7 });
+    environment.set("t", true);
+    environment.set("u", false);
+    environment.set("xs", std::vector<eval::Value>{ 1.0, 2.0, 3.0, 4.0 });
+
+    constexpr int evaluations = 200000;
+    constexpr int runs = 7;
+    double lookup_time = 0.0;
+    for (const auto probe : probes)
+    {
+        const auto expr = parser::parse(probe);
+        if (! expr.has_value())
+        {
+            spdlog::error("Failed to parse {}", probe);
+            return 1;
+        }
+
+        // the fastest run is the one least disturbed by the rest of the machine
+        auto time = std::numeric_limits<double>::max();
+        for (int run = 0; run < runs; ++run)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < evaluations; ++i)
+            {
+                if (! expr.value().evaluate(&environment).has_value())
+                {
+                    spdlog::error("{} fails", probe);
+                    return 1;
+                }
+            }
+            const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+            time = std::min(time, elapsed.count() / evaluations);
+        }
+        if (lookup_time == 0.0)
+        {
+            lookup_time = time;
+        }
+        spdlog::info("{:<18} {:>8.1f} ns {:>6.2f} measured {:>6.2f} estimated", probe, time, time / lookup_time, opt::estimateCost(expr.value(), model).total);
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, const char** argv)
+{
+    spdlog::set_level(spdlog::level::info);
+
+    auto model = CuraFormulaeEngine::opt::CostModel::defaults();
+    std::size_t top = 20;
+    std::string corpus_path;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg{ argv[i] };
+        try
+        {
+            if (arg == "--top" && i + 1 < argc)
+            {
+                top = std::stoul(argv[++i]);
+            }
+            else if (arg == "--size" && i + 1 < argc)
+            {
+                const std::string_view size{ argv[++i] };
+                const auto separator = size.find('=');
+                if (separator == std::string_view::npos)
+                {
+                    usage();
+                    return 1;
+                }
+                model.list_sizes[std::string{ size.substr(0, separator) }] = std::stod(std::string{ size.substr(separator + 1) });
+            }
+            else if (arg == "--calibrate")
+            {
+                return calibrate(model);
+            }
+            else if (arg == "--help" || arg.starts_with("--"))
+            {
+                usage();
+                return arg == "--help" ? 0 : 1;
+            }
+            else
+            {
+                corpus_path = arg;
+            }
+        }
+        catch (const std::logic_error&)
+        {
+            // std::invalid_argument or std::out_of_range from a number that does not parse
+            spdlog::error("Invalid number {}", argv[i]);
+            usage();
+            return 1;
+        }
+    }
+
+    std::ifstream corpus_file;
+    if (! corpus_path.empty())
+    {
+        corpus_file.open(corpus_path);
+        if (! corpus_file)
+        {
+            spdlog::error("Cannot open {}", corpus_path);
+            return 1;
+        }
+    }
+    auto& corpus = corpus_path.empty() ? std::cin : corpus_file;
+
+    std::vector<Entry> entries;
+    double corpus_total = 0.0;
+    std::size_t failed = 0;
+    std::string line;
+    while (std::getline(corpus, line))
+    {
+        if (line.empty() || line.starts_with('#'))
+        {
+            continue;
+        }
+        const auto expr = CuraFormulaeEngine::parser::parse(line);
+        if (! expr.has_value())
+        {
+            spdlog::warn("Failed to parse {}", line);
+            ++failed;
+            continue;
+        }
+        const auto estimate = CuraFormulaeEngine::opt::estimateCost(expr.value(), model);
+        corpus_total += estimate.total;
+        entries.push_back({ line, estimate.total, CuraFormulaeEngine::opt::dominantSubtree(expr.value(), estimate).toString() });
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs) { return lhs.cost > rhs.cost; });
+    spdlog::info("{} formulas, {} failed to parse, total cost {:.1f}", entries.size(), failed, corpus_total);
+    for (std::size_t rank = 0; rank < std::min(top, entries.size()); ++rank)
+    {
+        const auto& entry = entries[rank];
+        const auto share = corpus_total > 0.0 ? 100.0 * entry.cost / corpus_total : 0.0;
+        spdlog::info("{:>4} {:>10.1f} {:>5.1f}%  {}  (mostly {})", rank + 1, entry.cost, share, entry.formula, entry.dominant);
+    }
+
+    return 0;
+}
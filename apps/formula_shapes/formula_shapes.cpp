@@ -0,0 +1,93 @@
+#include <cura-formulae-engine/cura-formulae-engine.h>
+#include <cura-formulae-engine/ast/fused_expr.h>
+#include <cura-formulae-engine/opt/fusion.h>
+#include <spdlog/spdlog.h>
+
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+namespace
+{
+
+void usage()
+{
+    spdlog::info("Usage: formula_shapes [corpus]");
+    spdlog::info("Reads one formula per line from the corpus file, or from stdin, and reports how often the shapes evaluated by fused nodes occur.");
+}
+
+double percentage(std::size_t part, std::size_t whole)
+{
+    return whole > 0 ? 100.0 * static_cast<double>(part) / static_cast<double>(whole) : 0.0;
+}
+
+} // namespace
+
+int main(int argc, const char** argv)
+{
+    spdlog::set_level(spdlog::level::info);
+
+    std::string corpus_path;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg{ argv[i] };
+        if (arg == "--help" || arg.starts_with("--"))
+        {
+            usage();
+            return arg == "--help" ? 0 : 1;
+        }
+        corpus_path = arg;
+    }
+
+    std::ifstream corpus_file;
+    if (! corpus_path.empty())
+    {
+        corpus_file.open(corpus_path);
+        if (! corpus_file)
+        {
+            spdlog::error("Cannot open {}", corpus_path);
+            return 1;
+        }
+    }
+    auto& corpus = corpus_path.empty() ? std::cin : corpus_file;
+
+    CuraFormulaeEngine::opt::ShapeStatistics statistics;
+    std::size_t failed = 0;
+    std::string line;
+    while (std::getline(corpus, line))
+    {
+        if (line.empty() || line.starts_with('#'))
+        {
+            continue;
+        }
+        const auto expr = CuraFormulaeEngine::parser::parse(line);
+        if (! expr.has_value())
+        {
+            spdlog::warn("Failed to parse {}", line);
+            ++failed;
+            continue;
+        }
+        statistics.add(expr.value());
+    }
+
+    spdlog::info("{} formulas with {} nodes, {} failed to parse", statistics.formulas, statistics.nodes, failed);
+    spdlog::info("{:<38} {:>11} {:>10} {:>8}", "shape", "occurrences", "formulas", "nodes");
+    std::size_t fused_nodes = 0;
+    for (std::size_t index = 0; index < CuraFormulaeEngine::ast::fused_shape_count; ++index)
+    {
+        const auto shape = static_cast<CuraFormulaeEngine::ast::FusedShape>(index);
+        spdlog::info(
+            "{:<38} {:>11} {:>9.1f}% {:>7.1f}%",
+            CuraFormulaeEngine::ast::fusedShapeName(shape),
+            statistics.occurrences[index],
+            percentage(statistics.formulas_with[index], statistics.formulas),
+            percentage(statistics.fused_nodes[index], statistics.nodes));
+        fused_nodes += statistics.fused_nodes[index];
+    }
+    // the condition of a selection is not part of its shape, a comparison in it is only counted as a comparison
+    spdlog::info("{:.1f}% of the nodes are evaluated by fused nodes", percentage(fused_nodes, statistics.nodes));
+
+    return 0;
+}
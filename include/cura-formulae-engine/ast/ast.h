@@ -1,12 +1,17 @@
 #pragma once
 
+#include "cura-formulae-engine/ast/expr_kind.h"
+#include "cura-formulae-engine/ast/symbol.h"
 #include "cura-formulae-engine/eval.h"
 
 #include <zeus/expected.hpp>
 
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <string>
 #include <unordered_set>
+#include <utility>
 
 namespace CuraFormulaeEngine::eval
 {
@@ -22,6 +27,8 @@ using Result = zeus::expected<Value, Error>;
 namespace CuraFormulaeEngine::env
 {
 
+class EnvironmentBatch;
+
 class Environment
 {
 public:
@@ -32,10 +39,69 @@ public:
     [[nodiscard]] virtual std::unordered_map<std::string, eval::Value> getAll() const = 0;
 };
 
-class EnvironmentMap : public Environment
+/**
+ * @brief Implemented next to `Environment` by environments that store their values, so lookups in them can be cached.
+ *
+ * Kept out of `Environment`, so environments defined outside the library keep its vtable; lookup caches find this
+ * interface with a `dynamic_cast`, and do not cache lookups in environments without it.
+ */
+class GenerationalEnvironment
+{
+public:
+    virtual ~GenerationalEnvironment() = default;
+
+    /**
+     * @brief Identifies the current contents of the environment.
+     *
+     * No two environments share a generation, an environment gets a new one whenever it changes, and 0 is never a
+     * generation.
+     */
+    [[nodiscard]] virtual std::uint64_t generation() const noexcept = 0;
+
+    /**
+     * @brief The stored value of `key`, or nullptr if there is none.
+     *
+     * The value stays at this address, unchanged, for as long as the generation does.
+     */
+    [[nodiscard]] virtual const eval::Value* find(const std::string& key) const noexcept = 0;
+};
+
+class EnvironmentMap : public Environment, public GenerationalEnvironment
 {
 private:
+    /**
+     * @brief A generation that is not passed on: a copy, or the map that was moved from, gets a new one.
+     */
+    struct Generation
+    {
+        std::uint64_t value{ next() };
+
+        Generation() = default;
+        Generation(const Generation&) noexcept
+        {
+        }
+        Generation(Generation&& other) noexcept
+        {
+            other.value = next();
+        }
+        Generation& operator=(const Generation&) noexcept
+        {
+            value = next();
+            return *this;
+        }
+        Generation& operator=(Generation&& other) noexcept
+        {
+            value = next();
+            other.value = next();
+            return *this;
+        }
+        ~Generation() = default;
+
+        [[nodiscard]] static std::uint64_t next() noexcept;
+    };
+
     std::unordered_map<std::string, eval::Value> environment_ = {};
+    Generation generation_;
 public:
 
     EnvironmentMap() = default;
@@ -48,10 +114,24 @@ public:
 
     [[nodiscard]] std::unordered_map<std::string, eval::Value> getAll() const noexcept override;
 
+    [[nodiscard]] std::uint64_t generation() const noexcept override;
+
+    [[nodiscard]] const eval::Value* find(const std::string& key) const noexcept override;
+
     bool erase(const std::string& key) noexcept;
 
     void set(const std::string& key, const eval::Value& value) noexcept;
 
+    void reserve(std::size_t count);
+
+    /**
+     * @brief Applies all operations of a batch at once.
+     *
+     * @return The keys whose value changed; setting a key to an identical value or erasing an absent key is no change.
+     * Values are identical if they have the same type and the same bits, functions are never identical.
+     */
+    std::unordered_set<std::string> apply(const EnvironmentBatch& batch);
+
     [[nodiscard]] EnvironmentMap clone() const noexcept;
 
 };
@@ -86,7 +166,10 @@ namespace CuraFormulaeEngine::ast
 
 struct Expr
 {
-    Expr() = default;
+    explicit Expr(ExprKind kind) noexcept
+        : kind_(kind)
+    {
+    }
     Expr(const Expr&) = default;
     Expr(Expr&&) = default;
     Expr& operator=(const Expr&) = default;
@@ -106,7 +189,28 @@ struct Expr
      *
      * @return std::unordered_set<std::string> The set of free variables.
      */
-    [[nodiscard]] virtual std::unordered_set<std::string> freeVariables() const = 0;
+    [[nodiscard]] std::unordered_set<std::string> freeVariables() const;
+
+    /**
+     * @brief Returns the free variables of the expression as interned symbols.
+     *
+     * The set is computed once, when the node is constructed, from the sets of its children.
+     */
+    [[nodiscard]] const SymbolSet& freeSymbols() const noexcept;
+
+    /**
+     * @brief Returns a hash of the structure of the expression; expressions that are `deepEq` hash the same.
+     *
+     * Computed once, when the node is constructed, from the hashes of its children.
+     */
+    [[nodiscard]] std::size_t structuralHash() const noexcept;
+
+    /**
+     * @brief Recomputes the free variables and the structural hash of this node from its children.
+     *
+     * Only needed after replacing children of an existing node in place; the nodes above it must be refreshed too.
+     */
+    void refreshAttributes();
 
     /**
      * @brief Returns a string representation of the expression.
@@ -125,9 +229,32 @@ struct Expr
     /**
      * @brief Traverses the expression tree and applies the visitor function to each node.
      *
+     * `ExprPtr` wrappers are not visited, only the nodes they point to. See `visitor.h` for traversals that can
+     * skip subtrees, stop early or rewrite the tree.
+     *
      * @param visitor The visitor function to apply to each node.
      */
-    virtual void visitAll(std::function<void(const Expr&)> visitor) const = 0;
+    void visitAll(const std::function<void(const Expr&)>& visitor) const;
+
+    /**
+     * @brief Returns the concrete type of the expression, see `dispatch.h` for switching on it.
+     */
+    [[nodiscard]] ExprKind kind() const noexcept
+    {
+        return kind_;
+    }
+
+protected:
+    void setAttributes(SymbolSet free_symbols, std::size_t structural_hash) noexcept
+    {
+        free_symbols_ = std::move(free_symbols);
+        structural_hash_ = structural_hash;
+    }
+
+private:
+    ExprKind kind_;
+    SymbolSet free_symbols_;
+    std::size_t structural_hash_{ 0 };
 };
 
 } // namespace CuraFormulaeEngine::ast
@@ -11,7 +11,10 @@ namespace CuraFormulaeEngine::ast
 
 struct AddExpr final : BinaryExpr
 {
-    using BinaryExpr::BinaryExpr;
+    AddExpr(ExprPtr lhs, ExprPtr rhs)
+        : BinaryExpr(ExprKind::Add, std::move(lhs), std::move(rhs))
+    {
+    }
 
     [[nodiscard]] std::string getOpIdentifier() const noexcept final;
 
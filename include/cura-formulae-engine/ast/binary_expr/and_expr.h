@@ -11,7 +11,10 @@ namespace CuraFormulaeEngine::ast
 
 struct AndExpr final : BinaryExpr
 {
-    using BinaryExpr::BinaryExpr;
+    AndExpr(ExprPtr lhs, ExprPtr rhs)
+        : BinaryExpr(ExprKind::And, std::move(lhs), std::move(rhs))
+    {
+    }
 
     [[nodiscard]] std::string getOpIdentifier() const noexcept final;
 
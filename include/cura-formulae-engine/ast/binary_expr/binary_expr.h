@@ -12,10 +12,12 @@ struct BinaryExpr : Expr
     ExprPtr lhs;
     ExprPtr rhs;
 
-    BinaryExpr(ExprPtr lhs, ExprPtr rhs)
-        : lhs(std::move(lhs))
+    BinaryExpr(ExprKind kind, ExprPtr lhs, ExprPtr rhs)
+        : Expr(kind)
+        , lhs(std::move(lhs))
         , rhs(std::move(rhs))
     {
+        refreshAttributes();
     }
 
     [[nodiscard]] virtual std::string getOpIdentifier() const = 0;
@@ -26,11 +28,8 @@ struct BinaryExpr : Expr
 
     [[nodiscard]] eval::Result evaluate(const env::Environment* environment) const noexcept final;
 
-    [[nodiscard]] std::unordered_set<std::string> freeVariables() const noexcept final;
 
     [[nodiscard]] bool deepEq(const Expr& other) const noexcept final;
-
-    void visitAll(std::function<void(const Expr&)> visitor) const noexcept final;
 };
 
 } // namespace CuraFormulaeEngine::ast
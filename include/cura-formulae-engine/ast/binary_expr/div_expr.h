@@ -11,7 +11,10 @@ namespace CuraFormulaeEngine::ast
 
 struct DivExpr final : BinaryExpr
 {
-    using BinaryExpr::BinaryExpr;
+    DivExpr(ExprPtr lhs, ExprPtr rhs)
+        : BinaryExpr(ExprKind::Div, std::move(lhs), std::move(rhs))
+    {
+    }
 
     [[nodiscard]] std::string getOpIdentifier() const noexcept final;
 
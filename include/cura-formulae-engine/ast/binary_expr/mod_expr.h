@@ -11,7 +11,10 @@ namespace CuraFormulaeEngine::ast
 
 struct ModExpr final : BinaryExpr
 {
-    using BinaryExpr::BinaryExpr;
+    ModExpr(ExprPtr lhs, ExprPtr rhs)
+        : BinaryExpr(ExprKind::Mod, std::move(lhs), std::move(rhs))
+    {
+    }
 
     [[nodiscard]] std::string getOpIdentifier() const noexcept final;
 
@@ -11,7 +11,10 @@ namespace CuraFormulaeEngine::ast
 
 struct MulExpr final : BinaryExpr
 {
-    using BinaryExpr::BinaryExpr;
+    MulExpr(ExprPtr lhs, ExprPtr rhs)
+        : BinaryExpr(ExprKind::Mul, std::move(lhs), std::move(rhs))
+    {
+    }
 
     [[nodiscard]] std::string getOpIdentifier() const noexcept final;
 
@@ -12,7 +12,10 @@ namespace CuraFormulaeEngine::ast
 
 struct OrExpr final : BinaryExpr
 {
-    using BinaryExpr::BinaryExpr;
+    OrExpr(ExprPtr lhs, ExprPtr rhs)
+        : BinaryExpr(ExprKind::Or, std::move(lhs), std::move(rhs))
+    {
+    }
 
     [[nodiscard]] std::string getOpIdentifier() const noexcept final;
 
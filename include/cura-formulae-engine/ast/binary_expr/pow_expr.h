@@ -10,7 +10,10 @@ namespace CuraFormulaeEngine::ast
 
 struct PowExpr final : BinaryExpr
 {
-    using BinaryExpr::BinaryExpr;
+    PowExpr(ExprPtr lhs, ExprPtr rhs)
+        : BinaryExpr(ExprKind::Pow, std::move(lhs), std::move(rhs))
+    {
+    }
 
     [[nodiscard]] std::string getOpIdentifier() const noexcept final;
 
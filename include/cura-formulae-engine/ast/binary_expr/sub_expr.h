@@ -11,7 +11,10 @@ namespace CuraFormulaeEngine::ast
 
 struct SubExpr final : BinaryExpr
 {
-    using BinaryExpr::BinaryExpr;
+    SubExpr(ExprPtr lhs, ExprPtr rhs)
+        : BinaryExpr(ExprKind::Sub, std::move(lhs), std::move(rhs))
+    {
+    }
 
     [[nodiscard]] std::string getOpIdentifier() const noexcept final;
 
@@ -1,8 +1,12 @@
 #pragma once
 
 #include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/ast/constant_set.h"
 #include "expr_ptr.h"
 
+#include <memory>
+#include <vector>
+
 namespace CuraFormulaeEngine::ast
 {
 
@@ -18,29 +22,47 @@ enum ComparisonOperators
     Member,
 };
 
+/**
+ * @brief Applies a single comparison operator of a chain to two operands.
+ */
+[[nodiscard]] eval::Result compare(ComparisonOperators comparison_operator, const eval::Value& lhs, const eval::Value& rhs) noexcept;
+
 struct ComparisonChainExpr final : Expr
 {
 
     std::vector<ExprPtr> expressions;
     std::vector<ComparisonOperators> operators;
 
-    ComparisonChainExpr() = default;
+    /**
+     * @brief For each operator, the hashed elements of its right operand if the operator is `in` or `not in` and the
+     * operand a list of literals, which is then not evaluated; refreshed with the attributes of the node.
+     */
+    std::vector<std::shared_ptr<const ConstantSet>> constant_sets;
+
+    ComparisonChainExpr()
+        : Expr(ExprKind::ComparisonChain)
+    {
+    }
 
     ComparisonChainExpr(std::vector<ExprPtr> &&expressions, std::vector<ComparisonOperators> &&operators)
-        : expressions(std::move(expressions))
+        : Expr(ExprKind::ComparisonChain)
+        , expressions(std::move(expressions))
         , operators(std::move(operators))
     {
+        refreshAttributes();
     }
 
     [[nodiscard]] std::string toString() const noexcept final;
 
+    /**
+     * @brief Rebuilds `constant_sets` from the operators and expressions.
+     */
+    void refreshConstantSets();
+
     [[nodiscard]] eval::Result evaluate(const env::Environment* environment) const noexcept final;
 
-    [[nodiscard]] std::unordered_set<std::string> freeVariables() const noexcept final;
 
     [[nodiscard]] bool deepEq(const Expr& other) const noexcept final;
-
-    void visitAll(std::function<void(const Expr&)> visitor) const noexcept final;
 };
 
 } // namespace CuraFormulaeEngine::ast
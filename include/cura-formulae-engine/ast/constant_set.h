@@ -0,0 +1,50 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/eval.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_set>
+
+namespace CuraFormulaeEngine::ast
+{
+
+/**
+ * @brief The elements of a list of literals, hashed so `in` and `not in` need not scan the list.
+ *
+ * Elements match like `==` does: numbers by value across bool, int and float (`1 in [True]` and `1.0 in [1]` hold),
+ * strings by their characters, and None and lists never.
+ */
+class ConstantSet
+{
+public:
+    /**
+     * @brief The set of a list or tuple whose elements are literals or negated number literals; nullptr for other
+     * expressions.
+     */
+    [[nodiscard]] static std::shared_ptr<const ConstantSet> of(const Expr& expr);
+
+    [[nodiscard]] bool contains(const eval::Value& value) const noexcept;
+
+    /**
+     * @brief The value of the list the set was built from.
+     */
+    [[nodiscard]] const eval::Value& list() const noexcept;
+
+private:
+    explicit ConstantSet(eval::Value list);
+
+    eval::Value list_;
+    std::unordered_set<std::string> strings_;
+
+    /**
+     * @brief The int and bool elements; an int only equals a float if it converts to it.
+     */
+    std::unordered_set<std::int64_t> integers_;
+    std::unordered_set<double> integers_as_floats_;
+    std::unordered_set<double> floats_;
+};
+
+} // namespace CuraFormulaeEngine::ast
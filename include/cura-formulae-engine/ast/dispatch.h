@@ -0,0 +1,232 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/ast/binary_expr/add_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/and_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/div_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/mod_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/mul_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/or_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/pow_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/sub_expr.h"
+#include "cura-formulae-engine/ast/comp_chain_expr.h"
+#include "cura-formulae-engine/ast/condition_expr.h"
+#include "cura-formulae-engine/ast/expr_kind.h"
+#include "cura-formulae-engine/ast/expr_ptr.h"
+#include "cura-formulae-engine/ast/flat_expr.h"
+#include "cura-formulae-engine/ast/fn_application_expr.h"
+#include "cura-formulae-engine/ast/fused_expr.h"
+#include "cura-formulae-engine/ast/index_expr.h"
+#include "cura-formulae-engine/ast/let_expr.h"
+#include "cura-formulae-engine/ast/list_comprehension_expr.h"
+#include "cura-formulae-engine/ast/list_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/bool_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/float_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/int_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/none_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/string_expr.h"
+#include "cura-formulae-engine/ast/slice_expr.h"
+#include "cura-formulae-engine/ast/tuple_expr.h"
+#include "cura-formulae-engine/ast/unary_expr/neg_expr.h"
+#include "cura-formulae-engine/ast/unary_expr/not_expr.h"
+#include "cura-formulae-engine/ast/variable_expr.h"
+#include "cura-formulae-engine/eval.h"
+
+#include <concepts>
+#include <type_traits>
+#include <utility>
+
+namespace CuraFormulaeEngine::ast
+{
+
+/**
+ * @brief Calls `fn` with `expr` cast to its concrete type, by switching on `expr.kind()`.
+ *
+ * `ExprPtr`s are unwrapped, `fn` is never called with one. Since all concrete expression types are final, calls
+ * through the concrete reference are resolved statically. Works on both const and mutable expressions; `fn` must
+ * return the same type for every expression type.
+ *
+ * Example:
+ * @code
+ * const auto is_leaf = dispatch(expr, []<typename T>(const T&) { return std::is_same_v<T, VariableExpr>; });
+ * @endcode
+ */
+template<typename ExprT, typename Fn>
+    requires std::derived_from<std::remove_const_t<ExprT>, Expr>
+decltype(auto) dispatch(ExprT& expr, Fn&& fn)
+{
+    const auto as = [&expr]<typename T>() -> std::conditional_t<std::is_const_v<ExprT>, const T&, T&>
+    {
+        using Base = std::conditional_t<std::is_const_v<ExprT>, const Expr&, Expr&>;
+        return static_cast<std::conditional_t<std::is_const_v<ExprT>, const T&, T&>>(static_cast<Base>(expr));
+    };
+
+    switch (expr.kind())
+    {
+    case ExprKind::Bool:
+        return fn(as.template operator()<BoolExpr>());
+    case ExprKind::Float:
+        return fn(as.template operator()<FloatExpr>());
+    case ExprKind::Int:
+        return fn(as.template operator()<IntExpr>());
+    case ExprKind::None:
+        return fn(as.template operator()<NoneExpr>());
+    case ExprKind::String:
+        return fn(as.template operator()<StringExpr>());
+    case ExprKind::Variable:
+        return fn(as.template operator()<VariableExpr>());
+    case ExprKind::Neg:
+        return fn(as.template operator()<NegExpr>());
+    case ExprKind::Not:
+        return fn(as.template operator()<NotExpr>());
+    case ExprKind::Add:
+        return fn(as.template operator()<AddExpr>());
+    case ExprKind::Sub:
+        return fn(as.template operator()<SubExpr>());
+    case ExprKind::Mul:
+        return fn(as.template operator()<MulExpr>());
+    case ExprKind::Div:
+        return fn(as.template operator()<DivExpr>());
+    case ExprKind::Mod:
+        return fn(as.template operator()<ModExpr>());
+    case ExprKind::Pow:
+        return fn(as.template operator()<PowExpr>());
+    case ExprKind::And:
+        return fn(as.template operator()<AndExpr>());
+    case ExprKind::Or:
+        return fn(as.template operator()<OrExpr>());
+    case ExprKind::ComparisonChain:
+        return fn(as.template operator()<ComparisonChainExpr>());
+    case ExprKind::Condition:
+        return fn(as.template operator()<ConditionExpr>());
+    case ExprKind::FnApplication:
+        return fn(as.template operator()<FnApplicationExpr>());
+    case ExprKind::Index:
+        return fn(as.template operator()<IndexExpr>());
+    case ExprKind::Slice:
+        return fn(as.template operator()<SliceExpr>());
+    case ExprKind::List:
+        return fn(as.template operator()<ListExpr>());
+    case ExprKind::Tuple:
+        return fn(as.template operator()<TupleExpr>());
+    case ExprKind::ListComprehension:
+        return fn(as.template operator()<ListComprehensionExpr>());
+    case ExprKind::Let:
+        return fn(as.template operator()<LetExpr>());
+    case ExprKind::Fused:
+        return fn(as.template operator()<FusedExpr>());
+    case ExprKind::Ptr:
+        return dispatch(*as.template operator()<ExprPtr>().ptr, std::forward<Fn>(fn));
+    case ExprKind::Flat:
+        break;
+    }
+    return fn(as.template operator()<FlatExpr>());
+}
+
+/**
+ * @brief Calls `fn` with every direct child of `expr`, in the order `visit` visits them.
+ *
+ * The children are passed as (const) `ExprPtr&`, so a mutable traversal can replace them. A `FlatExpr` has no
+ * children in this sense, its nodes are not `Expr`s.
+ */
+template<typename ExprT, typename Fn>
+    requires std::derived_from<std::remove_const_t<ExprT>, Expr>
+void forEachChild(ExprT& expr, Fn&& fn)
+{
+    dispatch(
+        expr,
+        [&fn]<typename T>(T& node)
+        {
+            using Node = std::remove_const_t<T>;
+            if constexpr (std::is_base_of_v<UnaryExpr, Node>)
+            {
+                fn(node.operand);
+            }
+            else if constexpr (std::is_base_of_v<BinaryExpr, Node>)
+            {
+                fn(node.lhs);
+                fn(node.rhs);
+            }
+            else if constexpr (std::is_same_v<Node, ComparisonChainExpr>)
+            {
+                for (auto& expression : node.expressions)
+                {
+                    fn(expression);
+                }
+            }
+            else if constexpr (std::is_same_v<Node, ListExpr> || std::is_same_v<Node, TupleExpr>)
+            {
+                for (auto& element : node.elements)
+                {
+                    fn(element);
+                }
+            }
+            else if constexpr (std::is_same_v<Node, ConditionExpr>)
+            {
+                fn(node.then_expr);
+                fn(node.condition);
+                fn(node.else_expr);
+            }
+            else if constexpr (std::is_same_v<Node, FnApplicationExpr>)
+            {
+                fn(node.fn);
+                for (auto& arg : node.args)
+                {
+                    fn(arg);
+                }
+            }
+            else if constexpr (std::is_same_v<Node, IndexExpr>)
+            {
+                fn(node.array);
+                fn(node.index);
+            }
+            else if constexpr (std::is_same_v<Node, SliceExpr>)
+            {
+                fn(node.array);
+                for (auto* part : { &node.start_index, &node.end_index, &node.step_size })
+                {
+                    if (part->has_value())
+                    {
+                        fn(part->value());
+                    }
+                }
+            }
+            else if constexpr (std::is_same_v<Node, ListComprehensionExpr>)
+            {
+                fn(node.iterator);
+                for (auto& loop : node.loops)
+                {
+                    fn(loop.iterator_key);
+                    fn(loop.iterable);
+                    for (auto& condition : loop.conditions)
+                    {
+                        fn(condition);
+                    }
+                }
+            }
+            else if constexpr (std::is_same_v<Node, LetExpr>)
+            {
+                fn(node.value);
+                fn(node.body);
+            }
+            else if constexpr (std::is_same_v<Node, FusedExpr>)
+            {
+                fn(node.original);
+            }
+        });
+}
+
+/**
+ * @brief Evaluates an expression, dispatching on its kind instead of through the vtable.
+ */
+[[nodiscard]] eval::Result evaluate(const Expr& expr, const env::Environment* environment) noexcept;
+
+/**
+ * @brief Structural equality of two expressions, dispatching on their kind instead of through the vtable.
+ *
+ * `ExprPtr`s are unwrapped on both sides, a `FlatExpr` compares equal to the tree it was flattened from. Shared nodes
+ * compare equal without descending, nodes with different structural hashes without looking at their children.
+ */
+[[nodiscard]] bool equal(const Expr& lhs, const Expr& rhs) noexcept;
+
+} // namespace CuraFormulaeEngine::ast
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/ast/expr_ptr.h"
+
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+
+namespace CuraFormulaeEngine::ast
+{
+
+/**
+ * @brief Shares identical subexpressions between all formulas added to it (hash-consing).
+ *
+ * Every node of an added formula that is structurally equal to a node already in the corpus is replaced by that node,
+ * so each distinct subexpression is stored once, however many formulas contain it. Nodes are looked up by their
+ * structural hash and compared with `equal`, which stops at shared children.
+ *
+ * Formulas returned by `add` share nodes with each other; `rewrite`, and the passes in `opt` built on it, copy the
+ * shared nodes they visit, so rewriting one formula leaves the others and the corpus as they are. The corpus keeps
+ * its nodes alive until it is cleared or destroyed. Not thread safe.
+ *
+ * Example:
+ * @code
+ * ExprCorpus corpus;
+ * for (auto& [key, formula] : formulas)
+ * {
+ *     formula = corpus.add(std::move(formula));
+ * }
+ * @endcode
+ */
+class ExprCorpus
+{
+public:
+    /**
+     * @brief Adds a formula to the corpus, returning it with its subexpressions shared.
+     */
+    [[nodiscard]] ExprPtr add(ExprPtr formula);
+
+    /**
+     * @brief The number of distinct nodes in the corpus.
+     */
+    [[nodiscard]] std::size_t size() const noexcept;
+
+    /**
+     * @brief The number of nodes of added formulas that were replaced by a node already in the corpus.
+     */
+    [[nodiscard]] std::size_t sharedCount() const noexcept;
+
+    void clear() noexcept;
+
+private:
+    void intern(ExprPtr& node);
+
+    std::unordered_multimap<std::size_t, std::shared_ptr<Expr>> nodes_;
+    std::size_t shared_count_{ 0 };
+};
+
+} // namespace CuraFormulaeEngine::ast
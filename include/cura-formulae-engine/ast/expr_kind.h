@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+namespace CuraFormulaeEngine::ast
+{
+
+/**
+ * @brief Identifies the concrete type of an expression node.
+ */
+enum class ExprKind : std::uint8_t
+{
+    Bool,
+    Float,
+    Int,
+    None,
+    String,
+    Variable,
+    Neg,
+    Not,
+    Add,
+    Sub,
+    Mul,
+    Div,
+    Mod,
+    Pow,
+    And,
+    Or,
+    ComparisonChain,
+    Condition,
+    FnApplication,
+    Index,
+    Slice,
+    List,
+    Tuple,
+    ListComprehension,
+
+    /**
+     * @brief A `LetExpr`, which has no syntax and is only introduced by optimizations.
+     */
+    Let,
+
+    /**
+     * @brief A `FusedExpr`, a common shape of subexpression evaluated in one step, only introduced by optimizations.
+     */
+    Fused,
+
+    /**
+     * @brief An `ExprPtr`, which only wraps another expression.
+     */
+    Ptr,
+
+    /**
+     * @brief A `FlatExpr`, a whole formula in flattened form.
+     */
+    Flat,
+};
+
+} // namespace CuraFormulaeEngine::ast
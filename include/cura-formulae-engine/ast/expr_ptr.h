@@ -2,35 +2,63 @@
 
 #include "cura-formulae-engine/ast/ast.h"
 
+#include <concepts>
+#include <memory>
+#include <utility>
+
 namespace CuraFormulaeEngine::ast
 {
 
 struct ExprPtr final : Expr
 {
-    ExprPtr() = default;
+    ExprPtr()
+        : Expr(ExprKind::Ptr)
+    {
+    }
+
     ExprPtr(const ExprPtr&) = delete;
     ExprPtr(ExprPtr&&) = default;
     ExprPtr& operator=(const ExprPtr&) = delete;
     ExprPtr& operator=(ExprPtr&&) = default;
     ~ExprPtr() override = default;
 
-    std::unique_ptr<Expr> ptr;
+    /**
+     * @brief The owned expression; shared between formulas when they were added to an `ExprCorpus`.
+     */
+    std::shared_ptr<Expr> ptr;
 
-    ExprPtr(std::unique_ptr<Expr> ptr)
-        : ptr(std::move(ptr))
+    template<std::derived_from<Expr> T>
+    ExprPtr(std::unique_ptr<T> ptr)
+        : Expr(ExprKind::Ptr)
+        , ptr(std::move(ptr))
     {
     }
 
-    [[nodiscard]] eval::Result evaluate(const env::Environment* environment) const noexcept final;
+    ExprPtr(std::shared_ptr<Expr> ptr)
+        : Expr(ExprKind::Ptr)
+        , ptr(std::move(ptr))
+    {
+    }
 
-    [[nodiscard]] std::unordered_set<std::string> freeVariables() const noexcept final;
+    /**
+     * @brief Returns a second owner of the same expression, without copying it.
+     */
+    [[nodiscard]] ExprPtr share() const noexcept
+    {
+        return ExprPtr(ptr);
+    }
+
+    /**
+     * @brief Returns an owner of a copy of the expression, which shares the children of the original.
+     */
+    [[nodiscard]] ExprPtr copy() const;
+
+    [[nodiscard]] eval::Result evaluate(const env::Environment* environment) const noexcept final;
 
     [[nodiscard]] std::string toString() const noexcept final;
 
     [[nodiscard]] bool deepEq(const Expr& other) const noexcept final;
 
-    void visitAll(std::function<void(const Expr&)> visitor) const noexcept final;
-
     ExprPtr operator[](ExprPtr other);
 
     template<typename... Ts>
@@ -40,7 +68,7 @@ struct ExprPtr final : Expr
 template<typename T, typename... Ts>
 ExprPtr make_expr_ptr(Ts... args)
 {
-    return ExprPtr(std::move(std::make_unique<T>(std::forward<Ts>(args)...)));
+    return ExprPtr(std::shared_ptr<Expr>(std::make_shared<T>(std::forward<Ts>(args)...)));
 }
 
 } // namespace CuraFormulaeEngine::ast
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/ast/comp_chain_expr.h"
+#include "cura-formulae-engine/ast/expr_kind.h"
+#include "cura-formulae-engine/ast/expr_ptr.h"
+#include "cura-formulae-engine/eval.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace CuraFormulaeEngine::ast
+{
+
+/**
+ * @brief A formula stored as a flat array of nodes instead of a tree of heap allocated nodes.
+ *
+ * All nodes of the formula live in one contiguous array in post-order: the nodes of every subtree directly precede
+ * their parent and the root is the last node. Children are referred to by 32-bit indices into that array, literals,
+ * variable names and comparison operators live in per-formula pools next to it. Evaluation walks the arrays
+ * directly, without virtual calls or pointer chasing.
+ *
+ * `FlatExpr` is itself an `Expr`, so it can be used wherever a tree is expected (e.g. wrapped in an `ExprPtr`).
+ * `toString`, `deepEq` against a tree and `visitAll` go through `toExpr()`, which rebuilds the equivalent tree.
+ *
+ * Example:
+ * @code
+ * const auto flat = FlatExpr::flatten(expr);
+ * const auto result = flat.evaluate(&environment);
+ * @endcode
+ */
+struct FlatExpr final : Expr
+{
+    using index_t = std::uint32_t;
+
+    struct Node
+    {
+        ExprKind kind;
+
+        /**
+         * @brief Kind specific; index into the constant, name or operator pool, the slice parts present or the loop table.
+         */
+        index_t payload{ 0 };
+
+        index_t first_child{ 0 };
+        index_t child_count{ 0 };
+    };
+
+    /**
+     * @brief Bits of the payload of a `Slice` node; the children are the array followed by the parts present.
+     */
+    enum SliceParts : index_t
+    {
+        SliceStart = 1,
+        SliceEnd = 2,
+        SliceStep = 4,
+    };
+
+    FlatExpr(const FlatExpr&) = default;
+    FlatExpr(FlatExpr&&) = default;
+    FlatExpr& operator=(const FlatExpr&) = default;
+    FlatExpr& operator=(FlatExpr&&) = default;
+    ~FlatExpr() override = default;
+
+    /**
+     * @brief Flattens an expression tree.
+     */
+    [[nodiscard]] static FlatExpr flatten(const Expr& expr);
+
+    /**
+     * @brief Rebuilds the equivalent expression tree.
+     */
+    [[nodiscard]] ExprPtr toExpr() const;
+
+    /**
+     * @brief Appends the binary encoding of the formula to `buffer`: its arrays and pools as they are in memory, so
+     * decoding is mostly copying. See `FormulaCache`.
+     *
+     * @note Numbers are stored in the byte order of the writing machine, like snapshots.
+     */
+    void encode(std::string& buffer) const;
+
+    /**
+     * @brief Decodes a formula written by `encode`.
+     *
+     * Every index is checked, and the nodes must form a tree in post-order, so a corrupt encoding gives `std::nullopt`
+     * rather than a formula that reads out of bounds.
+     */
+    [[nodiscard]] static std::optional<FlatExpr> decode(std::span<const std::byte> bytes);
+
+    [[nodiscard]] index_t root() const noexcept;
+
+    [[nodiscard]] const std::vector<Node>& nodes() const noexcept;
+
+    [[nodiscard]] std::span<const index_t> children(index_t node) const noexcept;
+
+    [[nodiscard]] eval::Result evaluate(const env::Environment* environment) const noexcept final;
+
+
+    [[nodiscard]] std::string toString() const noexcept final;
+
+    [[nodiscard]] bool deepEq(const Expr& other) const noexcept final;
+
+
+private:
+    FlatExpr()
+        : Expr(ExprKind::Flat)
+    {
+    }
+
+    index_t append(const Expr& expr);
+
+    index_t appendNode(ExprKind kind, index_t payload, const std::vector<index_t>& children);
+
+    [[nodiscard]] eval::Result evaluateNode(index_t node, const env::Environment* environment) const noexcept;
+
+    std::optional<eval::Error> evaluateLoop(
+        index_t node,
+        std::size_t loop,
+        std::size_t loop_child,
+        env::LocalEnvironment& local_environment,
+        std::vector<std::optional<std::vector<eval::Value>>>& iterables,
+        std::vector<eval::Value>& results) const;
+
+    void assignKey(index_t key, const eval::Value& element, env::LocalEnvironment& local_environment) const;
+
+    [[nodiscard]] ExprPtr toExprNode(index_t node) const;
+
+    [[nodiscard]] bool nodeEq(index_t node, const FlatExpr& other, index_t other_node) const noexcept;
+
+    /**
+     * @brief Whether the decoded arrays describe a formula `evaluate` and `toExpr` can walk safely.
+     */
+    [[nodiscard]] bool wellFormed() const noexcept;
+
+    std::vector<Node> nodes_;
+    std::vector<index_t> children_;
+    std::vector<eval::Value> constants_;
+    std::vector<std::string> names_;
+    std::vector<ComparisonOperators> operators_;
+
+    /**
+     * @brief The `ComparisonChainExpr::constant_sets` of the comparison chains, indexed like `operators_`.
+     */
+    std::vector<std::shared_ptr<const ConstantSet>> constant_sets_;
+
+    /**
+     * @brief For every list comprehension the number of loops, followed for each loop by the number of its conditions
+     * and one more than the loop its iterable depends on (see `ListComprehensionExpr::iterableDependencies`), or 0.
+     */
+    std::vector<index_t> loop_table_;
+};
+
+} // namespace CuraFormulaeEngine::ast
@@ -12,20 +12,19 @@ struct FnApplicationExpr final : Expr
     std::vector<ExprPtr> args;
 
     FnApplicationExpr(ExprPtr fn, std::vector<ExprPtr> args)
-        : fn(std::move(fn))
+        : Expr(ExprKind::FnApplication)
+        , fn(std::move(fn))
         , args(std::move(args))
     {
+        refreshAttributes();
     }
 
     [[nodiscard]] std::string toString() const noexcept final;
 
     [[nodiscard]] eval::Result evaluate(const env::Environment* environment) const noexcept final;
 
-    [[nodiscard]] std::unordered_set<std::string> freeVariables() const noexcept final;
 
     [[nodiscard]] bool deepEq(const Expr& other) const noexcept final;
-
-    void visitAll(std::function<void(const Expr&)> visitor) const noexcept final;
 };
 
 } // namespace CuraFormulaeEngine::ast
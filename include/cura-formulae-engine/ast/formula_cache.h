@@ -0,0 +1,124 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/ast/flat_expr.h"
+
+#include <zeus/expected.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace CuraFormulaeEngine::ast
+{
+
+enum class FormulaCacheError
+{
+    IoError,
+    InvalidFormat,
+
+    /**
+     * @brief The cache was written by another version of the format, or by a build hashing formulas differently;
+     * it has to be built again.
+     */
+    IncompatibleVersion,
+
+    /**
+     * @brief A text or an encoded formula does not fit the 32 bit lengths of the index.
+     */
+    TooLarge
+};
+
+/**
+ * @brief A hash of the text of a formula (64-bit FNV-1a), the same in every build and process, which keys the formulas
+ * of a `FormulaCache`.
+ */
+[[nodiscard]] std::uint64_t formulaTextHash(std::string_view text) noexcept;
+
+/**
+ * @brief Collects parsed formulas, keyed by their text, and encodes them into the format read by `FormulaCache`.
+ *
+ * The encoding is a header, an index of (text hash, text, formula) entries sorted by hash, followed by the texts and
+ * the formulas encoded with `FlatExpr::encode`. Adding a text twice keeps the last formula.
+ *
+ * @note Numbers are stored in the byte order of the writing machine, caches are not portable across endianness.
+ */
+class FormulaCacheBuilder
+{
+public:
+    void add(std::string_view text, const Expr& formula);
+
+    [[nodiscard]] std::size_t size() const noexcept;
+
+    [[nodiscard]] zeus::expected<std::string, FormulaCacheError> encode() const;
+
+    /**
+     * @brief Writes the encoding to a temporary file next to `path` and renames it over `path`, so readers of the old
+     * cache never see a partly written file.
+     */
+    [[nodiscard]] zeus::expected<void, FormulaCacheError> write(const std::filesystem::path& path) const;
+
+private:
+    /**
+     * @brief The encoded formulas, by text hash and text.
+     */
+    std::map<std::pair<std::uint64_t, std::string>, std::string> entries_;
+};
+
+/**
+ * @brief Precompiled formulas, loaded instead of parsing their text again.
+ *
+ * Loading a cache only validates its header and index; a formula is decoded when it is looked up, straight into the
+ * arrays of a `FlatExpr`, which is mostly copying. Formulas are found by the hash of their text and the text is
+ * compared too, so an entry whose formula text changed since the cache was built is not found, and the caller parses
+ * the new text instead.
+ *
+ * The format version must be bumped whenever the encoding or the trees the parser builds change.
+ *
+ * Example:
+ * @code
+ * // when building the cache
+ * FormulaCacheBuilder builder;
+ * builder.add(text, parser::parse(text).value());
+ * builder.write("formulas.cfec");
+ *
+ * // at start up
+ * const auto cache = FormulaCache::open("formulas.cfec");
+ * auto formula = cache.has_value() ? cache.value().find(text) : std::nullopt;
+ * const auto expr = formula.has_value() ? make_expr_ptr<FlatExpr>(std::move(formula.value())) : parser::parse(text).value();
+ * @endcode
+ */
+class FormulaCache
+{
+public:
+    [[nodiscard]] static zeus::expected<FormulaCache, FormulaCacheError> open(const std::filesystem::path& path);
+
+    /**
+     * @brief Loads a cache from the bytes written by `FormulaCacheBuilder::encode`.
+     */
+    [[nodiscard]] static zeus::expected<FormulaCache, FormulaCacheError> decode(std::string data);
+
+    /**
+     * @brief The formula cached for `text`; `std::nullopt` if there is none, or if its encoding is corrupt.
+     */
+    [[nodiscard]] std::optional<FlatExpr> find(std::string_view text) const;
+
+    [[nodiscard]] std::size_t size() const noexcept;
+
+private:
+    FormulaCache() = default;
+
+    [[nodiscard]] std::uint64_t hashAt(std::size_t index) const noexcept;
+
+    [[nodiscard]] std::string_view textAt(std::size_t index) const noexcept;
+
+    std::string data_;
+    std::size_t entry_count_{ 0 };
+};
+
+} // namespace CuraFormulaeEngine::ast
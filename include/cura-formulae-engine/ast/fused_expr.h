@@ -0,0 +1,145 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/ast/comp_chain_expr.h"
+#include "cura-formulae-engine/ast/constant_set.h"
+#include "cura-formulae-engine/ast/expr_ptr.h"
+#include "cura-formulae-engine/ast/lookup_cache.h"
+#include "cura-formulae-engine/eval.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace CuraFormulaeEngine::ast
+{
+
+/**
+ * @brief The shapes of subexpressions common enough in formulas to be evaluated by a single `FusedExpr`.
+ */
+enum class FusedShape : std::uint8_t
+{
+    /**
+     * @brief `variable == 'literal'`, or another comparison of a variable with a literal.
+     */
+    VariableComparison,
+
+    /**
+     * @brief `variable in [literals]` or `variable not in [literals]`.
+     */
+    VariableMembership,
+
+    /**
+     * @brief `variable * number` or `number * variable`.
+     */
+    VariableScale,
+
+    /**
+     * @brief `a if condition else b`, with variables `a` and `b` and any condition.
+     */
+    VariableSelection,
+
+    /**
+     * @brief `min(a, b)` of two variables.
+     */
+    VariableMin,
+
+    /**
+     * @brief `max(a, b)` of two variables.
+     */
+    VariableMax,
+};
+
+inline constexpr std::size_t fused_shape_count = static_cast<std::size_t>(FusedShape::VariableMax) + 1;
+
+/**
+ * @brief A short description of a shape, like `variable == literal`.
+ */
+[[nodiscard]] std::string_view fusedShapeName(FusedShape shape) noexcept;
+
+/**
+ * @brief The shape of an expression, if it is one a `FusedExpr` can evaluate.
+ */
+[[nodiscard]] std::optional<FusedShape> matchFusedShape(const Expr& expr) noexcept;
+
+/**
+ * @brief Evaluates a subexpression of one of the `FusedShape`s in a single step.
+ *
+ * The fused node looks its variables up and combines them directly, without evaluating the nodes of the shape one by
+ * one: no virtual calls and intermediate results for the variables and literals, and no argument list for `min` and
+ * `max`. The results and errors are those of evaluating `original`. `min` and `max` are only fused while they are the
+ * builtins of `env::std_env` in the environment, other functions of those names are called like any function.
+ *
+ * Formulas have no syntax for this node, it is introduced by `opt::fuseShapes`. The subexpression it replaces is kept
+ * as its only child, `original`, so visitors, printing, flattening and free variables see through it. The shape is
+ * matched again whenever the attributes are refreshed; if `original` no longer has a fused shape after a rewrite, it
+ * is evaluated as it is.
+ */
+struct FusedExpr final : Expr
+{
+    ExprPtr original;
+
+    /**
+     * @brief The shape of `original`, refreshed with the attributes of the node, together with the fields below.
+     */
+    std::optional<FusedShape> shape;
+
+    /**
+     * @brief The variable of the shape; the first operand of `min` and `max` and the `then` branch of a selection.
+     */
+    std::string variable;
+
+    /**
+     * @brief The second operand of `min` and `max` and the `else` branch of a selection.
+     */
+    std::string other_variable;
+
+    /**
+     * @brief The literal of a comparison, or the number a variable is scaled by.
+     */
+    eval::Value constant;
+
+    ComparisonOperators comparison_operator{ Equals };
+
+    std::shared_ptr<const ConstantSet> constant_set;
+
+    /**
+     * @brief Whether the variable is the left operand of a scale, which matters for strings and lists.
+     */
+    bool variable_first{ true };
+
+    /**
+     * @brief The condition of a selection, which is evaluated as usual.
+     */
+    std::optional<ExprPtr> condition;
+
+    /**
+     * @brief The inline caches of the lookups of `variable` and `other_variable`, like those of `VariableExpr`.
+     */
+    LookupCache variable_cache;
+    LookupCache other_variable_cache;
+
+    explicit FusedExpr(ExprPtr original)
+        : Expr(ExprKind::Fused)
+        , original(std::move(original))
+    {
+        refreshAttributes();
+    }
+
+    /**
+     * @brief Matches the shape of `original` again and rebuilds the fields it is evaluated with.
+     */
+    void refreshShape();
+
+    [[nodiscard]] std::string toString() const noexcept final;
+
+    [[nodiscard]] eval::Result evaluate(const env::Environment* environment) const noexcept final;
+
+
+    [[nodiscard]] bool deepEq(const Expr& other) const noexcept final;
+};
+
+} // namespace CuraFormulaeEngine::ast
@@ -20,20 +20,19 @@ struct IndexExpr final : Expr
     ExprPtr index;
 
     IndexExpr(ExprPtr array, ExprPtr index)
-        : array(std::move(array))
+        : Expr(ExprKind::Index)
+        , array(std::move(array))
         , index(std::move(index))
     {
+        refreshAttributes();
     }
 
     [[nodiscard]] std::string toString() const noexcept final;
 
     [[nodiscard]] eval::Result evaluate(const env::Environment* environment) const noexcept final;
 
-    [[nodiscard]] std::unordered_set<std::string> freeVariables() const noexcept final;
 
     [[nodiscard]] bool deepEq(const Expr& other) const noexcept final;
-
-    void visitAll(std::function<void(const Expr&)> visitor) const noexcept final;
 };
 
 } // namespace CuraFormulaeEngine::ast
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/ast.h"
+#include "expr_ptr.h"
+
+#include <string>
+
+namespace CuraFormulaeEngine::ast
+{
+
+/**
+ * @brief Evaluates `value` once and binds the result to `name` while evaluating `body`.
+ *
+ * Formulas have no syntax for this node, it is introduced by optimizations (see `opt::eliminateCommonSubexpressions`)
+ * to share a value between several places in a formula. `toString` gives `(let name = value in body)`, which the
+ * parser does not accept.
+ */
+struct LetExpr final : Expr
+{
+    std::string name;
+    ExprPtr value;
+    ExprPtr body;
+
+    LetExpr(std::string name, ExprPtr value, ExprPtr body)
+        : Expr(ExprKind::Let)
+        , name(std::move(name))
+        , value(std::move(value))
+        , body(std::move(body))
+    {
+        refreshAttributes();
+    }
+
+    [[nodiscard]] std::string toString() const noexcept final;
+
+    [[nodiscard]] eval::Result evaluate(const env::Environment* environment) const noexcept final;
+
+
+    [[nodiscard]] bool deepEq(const Expr& other) const noexcept final;
+};
+
+} // namespace CuraFormulaeEngine::ast
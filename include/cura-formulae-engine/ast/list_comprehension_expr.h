@@ -33,23 +33,42 @@ struct ListComprehensionExpr final : Expr
     std::vector<loop> loops;
 
     ListComprehensionExpr(ExprPtr iterator, std::vector<loop> loops)
-        : iterator(std::move(iterator))
+        : Expr(ExprKind::ListComprehension)
+        , iterator(std::move(iterator))
         , loops(std::move(loops))
     {
+        refreshAttributes();
     }
 
+    /**
+     * @brief The state of the loops while the list comprehension is evaluated.
+     *
+     * The iterable of a loop is only evaluated again once a loop whose variables it reads has advanced, so an iterable
+     * that reads no loop variables is evaluated at most once, however many elements the outer loops have.
+     */
+    struct loop_state
+    {
+        /**
+         * @brief See `iterableDependencies()`; the iterables depending on a loop are reset whenever it advances.
+         */
+        std::vector<std::optional<std::size_t>> dependencies;
+        std::vector<std::optional<std::vector<eval::Value>>> iterables;
+    };
+
     [[nodiscard]] std::string toString() const noexcept final;
 
-    std::optional<eval::Error> handle_loop(const size_t loop_index, env::LocalEnvironment& local_environment, std::vector<eval::Value>& results) const;
+    /**
+     * @brief For each loop the innermost earlier loop binding a variable its iterable reads, if any.
+     */
+    [[nodiscard]] std::vector<std::optional<std::size_t>> iterableDependencies() const;
+
+    std::optional<eval::Error> handle_loop(const size_t loop_index, env::LocalEnvironment& local_environment, loop_state& state, std::vector<eval::Value>& results) const;
 
     [[nodiscard]] eval::Result evaluate(const env::Environment* environment) const noexcept final;
 
-    [[nodiscard]] std::unordered_set<std::string> freeVariables() const noexcept final;
 
     [[nodiscard]] bool deepEq(const Expr& other) const noexcept final;
 
-    void visitAll(std::function<void(const Expr&)> visitor) const noexcept final;
-
 };
 
 } // namespace CuraFormulaeEngine::ast
@@ -14,19 +14,19 @@ struct ListExpr final : Expr
     std::vector<ExprPtr> elements;
 
     ListExpr(std::vector<ExprPtr> elements)
-        : elements(std::move(elements))
+        : Expr(ExprKind::List)
+        , elements(std::move(elements))
     {
+        refreshAttributes();
     }
 
     [[nodiscard]] std::string toString() const noexcept final;
 
     [[nodiscard]] eval::Result evaluate(const env::Environment* environment) const noexcept final;
 
-    [[nodiscard]] std::unordered_set<std::string> freeVariables() const noexcept final;
 
     [[nodiscard]] bool deepEq(const Expr& other) const noexcept final;
 
-    void visitAll(std::function<void(const Expr&)> visitor) const noexcept final;
 };
 
 template<typename... Ts>
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/eval.h"
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace CuraFormulaeEngine::ast
+{
+
+/**
+ * @brief An inline cache for the lookups of one name by one node.
+ *
+ * Remembers where the value was found the last time: the environment, its generation and the address of the value. As
+ * long as the node is evaluated against the same environment, and the environment did not change, the value is read
+ * from there without hashing the name. Environments that are not an `env::GenerationalEnvironment` are always asked
+ * with `get`.
+ *
+ * The cache is a seqlock, so nodes can be evaluated by several threads at once; a lookup that sees a concurrent update
+ * of the cache takes the slow path.
+ */
+class LookupCache
+{
+public:
+    LookupCache() = default;
+
+    /**
+     * @brief A copy of a node does not take over the cache, a copy of the cache starts empty.
+     */
+    LookupCache(const LookupCache&) noexcept
+    {
+    }
+    LookupCache& operator=(const LookupCache&) noexcept
+    {
+        clear();
+        return *this;
+    }
+    ~LookupCache() = default;
+
+    /**
+     * @brief Looks up `key` in `environment` like `environment->get(key)` does.
+     *
+     * The key must be the same for every lookup through the cache, or the cache must be cleared in between.
+     */
+    [[nodiscard]] std::optional<eval::Value> get(const env::Environment* environment, const std::string& key) const noexcept;
+
+    void clear() noexcept;
+
+private:
+    [[nodiscard]] const eval::Value* cached(const env::Environment* environment, std::uint64_t generation) const noexcept;
+    void store(const env::Environment* environment, std::uint64_t generation, const eval::Value* value) const noexcept;
+
+    // odd while an update is in progress
+    mutable std::atomic<std::uint64_t> sequence_{ 0 };
+    mutable std::atomic<const env::Environment*> environment_{ nullptr };
+    mutable std::atomic<std::uint64_t> generation_{ 0 };
+    mutable std::atomic<const eval::Value*> value_{ nullptr };
+};
+
+/**
+ * @brief How the lookups through `LookupCache`s went since the statistics were last reset.
+ */
+struct LookupStatistics
+{
+    std::uint64_t hits{ 0 };
+    std::uint64_t misses{ 0 };
+
+    /**
+     * @brief Lookups in environments without generations, which are never cached.
+     */
+    std::uint64_t uncached{ 0 };
+
+    [[nodiscard]] double hitRate() const noexcept
+    {
+        const auto lookups = hits + misses + uncached;
+        return lookups > 0 ? static_cast<double>(hits) / static_cast<double>(lookups) : 0.0;
+    }
+};
+
+/**
+ * @brief Starts or stops counting the lookups through `LookupCache`s.
+ *
+ * Counting is off by default, the counters are shared by all threads and would make every lookup write to them.
+ */
+void setLookupStatisticsEnabled(bool enabled) noexcept;
+
+[[nodiscard]] LookupStatistics lookupStatistics() noexcept;
+
+void resetLookupStatistics() noexcept;
+
+} // namespace CuraFormulaeEngine::ast
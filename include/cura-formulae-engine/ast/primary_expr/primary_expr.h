@@ -5,21 +5,53 @@
 
 #include <fmt/format.h>
 
+#include <bit>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <string>
+#include <type_traits>
 #include <unordered_set>
 
 namespace CuraFormulaeEngine::ast
 {
 
+template<typename T>
+consteval ExprKind primaryExprKind()
+{
+    if constexpr (std::is_same_v<T, bool>)
+    {
+        return ExprKind::Bool;
+    }
+    else if constexpr (std::is_same_v<T, double>)
+    {
+        return ExprKind::Float;
+    }
+    else if constexpr (std::is_same_v<T, std::int64_t>)
+    {
+        return ExprKind::Int;
+    }
+    else if constexpr (std::is_same_v<T, std::nullptr_t>)
+    {
+        return ExprKind::None;
+    }
+    else
+    {
+        static_assert(std::is_same_v<T, std::string>, "unsupported primary expression type");
+        return ExprKind::String;
+    }
+}
+
 template<typename T>
 struct PrimaryExpr : public Expr
 {
     T value;
 
     explicit PrimaryExpr(T value)
-        : value(value)
+        : Expr(primaryExprKind<T>())
+        , value(value)
     {
+        refreshAttributes();
     }
 
     [[nodiscard]] eval::Result evaluate(const env::Environment*) const noexcept final
@@ -27,11 +59,6 @@ struct PrimaryExpr : public Expr
         return value;
     }
 
-    [[nodiscard]] std::unordered_set<std::string> freeVariables() const noexcept final
-    {
-        return {};
-    };
-
     [[nodiscard]] std::string toString() const noexcept override
     {
         return fmt::format("{}", value);
@@ -39,16 +66,19 @@ struct PrimaryExpr : public Expr
 
     [[nodiscard]] bool deepEq(const Expr& other) const noexcept final
     {
-        if (auto other_number = dynamic_cast<const PrimaryExpr<T>*>(&other))
+        if (other.kind() != kind())
         {
-            return value == other_number->value;
+            return false;
+        }
+        if constexpr (std::is_same_v<T, double>)
+        {
+            // by their bits, so 0.0 and -0.0, which print and convert to strings differently, are not merged
+            return std::bit_cast<std::uint64_t>(value) == std::bit_cast<std::uint64_t>(static_cast<const PrimaryExpr<T>&>(other).value);
+        }
+        else
+        {
+            return value == static_cast<const PrimaryExpr<T>&>(other).value;
         }
-        return false;
-    }
-
-    void visitAll(std::function<void(const Expr&)> visitor) const noexcept final
-    {
-        visitor(*this);
     }
 };
 
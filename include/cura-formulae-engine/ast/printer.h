@@ -0,0 +1,57 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/ast.h"
+
+#include <string>
+
+namespace CuraFormulaeEngine::ast
+{
+
+enum class PrintStyle
+{
+    /**
+     * @brief Only the parentheses the precedence of the operators requires, like the formula would be written.
+     */
+    Minimal,
+
+    /**
+     * @brief Every operator expression in parentheses, so the structure can be read without knowing precedences.
+     */
+    Full
+};
+
+/**
+ * @brief Appends the source text of a formula to `buffer`, writing every node straight into it.
+ *
+ * Unlike `toString`, which builds a string per node and copies it into its parent, printing does not allocate apart
+ * from growing `buffer`, so a buffer reused between formulas stops allocating altogether. Literals are written as they
+ * are parsed (`True`, `None`, `1.0`), floats in fixed notation with digits that read back as the same
+ * value (`0.00001`, never `1e-05`), list comprehensions in brackets, and a `LetExpr`, which has no syntax, as
+ * `(let name = value in body)`. Formulas printed in either style parse back to trees that evaluate the same, and
+ * to equal trees except where the grammar has no syntax for a node:
+ * - a negative literal prints in parentheses, `(-1)`, and parses back as the negation of a positive literal;
+ * - an infinite or NaN float prints as `math.inf` or `math.nan`, and parses back as that variable, which evaluates the
+ *   same where the standard environment defines it;
+ * - a subnormal float (smaller than about `2.2e-308`) prints in full, but `std::stod` in the parser throws on it;
+ * - a tuple of one element, which the parser never builds, prints as `(x,)` and parses back as `x`;
+ * - only variables can be called or indexed, anything else is put in parentheses.
+ *
+ * Example:
+ * @code
+ * std::string key;
+ * for (const auto& formula : formulas)
+ * {
+ *     key.clear();
+ *     printTo(key, formula);
+ *     cache.find(key);
+ * }
+ * @endcode
+ */
+void printTo(std::string& buffer, const Expr& expr, PrintStyle style = PrintStyle::Minimal);
+
+/**
+ * @brief Prints a formula into a new string, see `printTo`.
+ */
+[[nodiscard]] std::string print(const Expr& expr, PrintStyle style = PrintStyle::Minimal);
+
+} // namespace CuraFormulaeEngine::ast
@@ -24,22 +24,30 @@ struct SliceExpr final : Expr
     std::optional<ExprPtr> step_size;
 
     SliceExpr(ExprPtr array, std::optional<ExprPtr> start_index, std::optional<ExprPtr> end_index, std::optional<ExprPtr> step_size)
-        : array(std::move(array))
+        : Expr(ExprKind::Slice)
+        , array(std::move(array))
         , start_index(std::move(start_index))
         , end_index(std::move(end_index))
         , step_size(std::move(step_size))
     {
+        refreshAttributes();
     }
 
     [[nodiscard]] std::string toString() const noexcept final;
 
     [[nodiscard]] eval::Result evaluate(const env::Environment* environment) const noexcept final;
 
-    [[nodiscard]] std::unordered_set<std::string> freeVariables() const noexcept final;
+    /**
+     * @brief Slices an already evaluated array, `step_size` must not be 0.
+     */
+    [[nodiscard]] static eval::Value slice(
+        const std::vector<eval::Value>& array_value,
+        std::optional<std::int64_t> start_index_value,
+        std::optional<std::int64_t> end_index_value,
+        std::int64_t step_size_value) noexcept;
 
-    [[nodiscard]] bool deepEq(const Expr& other) const noexcept final;
 
-    void visitAll(std::function<void(const Expr&)> visitor) const noexcept final;
+    [[nodiscard]] bool deepEq(const Expr& other) const noexcept final;
 
 };
 
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/ast/dispatch.h"
+#include "cura-formulae-engine/env/lookup.h"
+#include "cura-formulae-engine/eval.h"
+
+#include <zeus/expected.hpp>
+
+#include <concepts>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace CuraFormulaeEngine::ast
+{
+
+/**
+ * @brief Evaluates an expression against an environment of a type known at compile time.
+ *
+ * Gives the same results and errors as `evaluate(expr, &environment)`, but variables are looked up with `env::lookup`
+ * for `Env`, which inlines the lookups of `EnvironmentMap`, `LocalEnvironment` and `LayeredEnvironment` instead of
+ * calling `get` through the vtable. Literals, variables, operators, comparisons and conditions are evaluated here,
+ * dispatching on their kind; the other nodes, which call functions, bind names or build lists, evaluate their
+ * subtree through the vtable, with the environment passed as an `env::Environment`.
+ *
+ * Example:
+ * @code
+ * const env::LayeredEnvironment environment{ settings, env::std_env };
+ * const auto result = ast::evaluate(expr, environment);
+ * @endcode
+ */
+template<typename Env>
+    requires std::derived_from<Env, env::Environment>
+[[nodiscard]] eval::Result evaluate(const Expr& expr, const Env& environment) noexcept
+{
+    return dispatch(
+        expr,
+        [&environment]<typename T>(const T& node) -> eval::Result
+        {
+            if constexpr (std::is_same_v<T, VariableExpr>)
+            {
+                if (auto value = lookup(environment, node.name); value.has_value())
+                {
+                    return std::move(value.value());
+                }
+                return zeus::unexpected(eval::Error::UndefinedVariable);
+            }
+            else if constexpr (std::is_base_of_v<UnaryExpr, T>)
+            {
+                const auto operand_result = evaluate(node.operand, environment);
+                if (! operand_result.has_value())
+                {
+                    return zeus::unexpected(operand_result.error());
+                }
+                return node.evaluate(operand_result.value());
+            }
+            else if constexpr (std::is_base_of_v<BinaryExpr, T>)
+            {
+                auto lhs_result = evaluate(node.lhs, environment);
+                if (! lhs_result.has_value())
+                {
+                    return lhs_result;
+                }
+                // `and` and `or` only evaluate the right operand if the left one does not decide the result
+                if constexpr (std::is_same_v<T, AndExpr> || std::is_same_v<T, OrExpr>)
+                {
+                    if (lhs_result.value().isTruthy() == std::is_same_v<T, OrExpr>)
+                    {
+                        return lhs_result;
+                    }
+                }
+                auto rhs_result = evaluate(node.rhs, environment);
+                if (! rhs_result.has_value())
+                {
+                    return rhs_result;
+                }
+                return node.evaluate(lhs_result.value(), rhs_result.value());
+            }
+            else if constexpr (std::is_same_v<T, ComparisonChainExpr>)
+            {
+                auto left_result = evaluate(node.expressions[0], environment);
+                if (! left_result.has_value())
+                {
+                    return left_result;
+                }
+                auto left_value = std::move(left_result.value());
+                for (std::size_t i = 0; i < node.operators.size(); ++i)
+                {
+                    if (i < node.constant_sets.size() && node.constant_sets[i] != nullptr)
+                    {
+                        if (node.constant_sets[i]->contains(left_value) != (node.operators[i] == Member))
+                        {
+                            return false;
+                        }
+                        if (i + 1 < node.operators.size())
+                        {
+                            left_value = node.constant_sets[i]->list();
+                        }
+                        continue;
+                    }
+
+                    auto right_result = evaluate(node.expressions[i + 1], environment);
+                    if (! right_result.has_value())
+                    {
+                        return right_result;
+                    }
+                    const auto comparison_result = compare(node.operators[i], left_value, right_result.value());
+                    if (! comparison_result.has_value())
+                    {
+                        return zeus::unexpected(comparison_result.error());
+                    }
+                    if (! comparison_result.value().isTruthy())
+                    {
+                        return false;
+                    }
+                    left_value = std::move(right_result.value());
+                }
+                return true;
+            }
+            else if constexpr (std::is_same_v<T, ConditionExpr>)
+            {
+                const auto condition_result = evaluate(node.condition, environment);
+                if (! condition_result.has_value())
+                {
+                    return zeus::unexpected(condition_result.error());
+                }
+                return evaluate(condition_result.value().isTruthy() ? node.then_expr : node.else_expr, environment);
+            }
+            else
+            {
+                // T is final, so this call is resolved statically; only the subtree goes through the vtable
+                return node.evaluate(static_cast<const env::Environment*>(&environment));
+            }
+        });
+}
+
+} // namespace CuraFormulaeEngine::ast
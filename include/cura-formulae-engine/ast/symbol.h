@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace CuraFormulaeEngine::ast
+{
+
+/**
+ * @brief Identifies an interned variable name.
+ */
+using symbol_t = std::uint32_t;
+
+/**
+ * @brief Returns the symbol for a variable name, interning the name on first use.
+ *
+ * Symbols are process wide and never released, the same name always maps to the same symbol. Thread safe.
+ */
+[[nodiscard]] symbol_t intern(std::string_view name);
+
+/**
+ * @brief Returns the name a symbol was interned from; the reference stays valid for the lifetime of the process.
+ */
+[[nodiscard]] const std::string& symbolName(symbol_t symbol) noexcept;
+
+/**
+ * @brief A set of symbols, stored as a sorted vector.
+ */
+class SymbolSet
+{
+public:
+    SymbolSet() = default;
+
+    explicit SymbolSet(symbol_t symbol)
+        : symbols_{ symbol }
+    {
+    }
+
+    [[nodiscard]] bool contains(symbol_t symbol) const noexcept;
+
+    [[nodiscard]] bool contains(std::string_view name) const noexcept;
+
+    /**
+     * @brief Adds all symbols of `other` to this set.
+     */
+    void merge(const SymbolSet& other);
+
+    /**
+     * @brief Removes all symbols of `other` from this set.
+     */
+    void erase(const SymbolSet& other);
+
+    [[nodiscard]] std::span<const symbol_t> symbols() const noexcept
+    {
+        return symbols_;
+    }
+
+    [[nodiscard]] auto begin() const noexcept
+    {
+        return symbols_.begin();
+    }
+
+    [[nodiscard]] auto end() const noexcept
+    {
+        return symbols_.end();
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept
+    {
+        return symbols_.size();
+    }
+
+    [[nodiscard]] bool empty() const noexcept
+    {
+        return symbols_.empty();
+    }
+
+    /**
+     * @brief Returns the names of the symbols in the set.
+     */
+    [[nodiscard]] std::unordered_set<std::string> names() const;
+
+    bool operator==(const SymbolSet&) const noexcept = default;
+
+private:
+    std::vector<symbol_t> symbols_;
+};
+
+} // namespace CuraFormulaeEngine::ast
@@ -16,19 +16,19 @@ struct TupleExpr final : Expr
     std::vector<ExprPtr> elements;
 
     TupleExpr(std::vector<ExprPtr> elements)
-        : elements(std::move(elements))
+        : Expr(ExprKind::Tuple)
+        , elements(std::move(elements))
     {
+        refreshAttributes();
     }
 
     [[nodiscard]] std::string toString() const noexcept final;
 
     [[nodiscard]] eval::Result evaluate(const env::Environment* environment) const noexcept final;
 
-    [[nodiscard]] std::unordered_set<std::string> freeVariables() const noexcept final;
 
     [[nodiscard]] bool deepEq(const Expr& other) const noexcept final;
 
-    void visitAll(std::function<void(const Expr&)> visitor) const noexcept final;
 };
 
 template<typename... Ts>
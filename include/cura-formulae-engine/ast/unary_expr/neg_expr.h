@@ -11,7 +11,10 @@ namespace CuraFormulaeEngine::ast
 
 struct NegExpr final : UnaryExpr
 {
-    using UnaryExpr::UnaryExpr;
+    explicit NegExpr(ExprPtr operand)
+        : UnaryExpr(ExprKind::Neg, std::move(operand))
+    {
+    }
 
     [[nodiscard]] std::string getOpIdentifier() const noexcept final;
 
@@ -11,7 +11,10 @@ namespace CuraFormulaeEngine::ast
 
 struct NotExpr final : UnaryExpr
 {
-    using UnaryExpr::UnaryExpr;
+    explicit NotExpr(ExprPtr operand)
+        : UnaryExpr(ExprKind::Not, std::move(operand))
+    {
+    }
 
     [[nodiscard]] std::string getOpIdentifier() const noexcept final;
 
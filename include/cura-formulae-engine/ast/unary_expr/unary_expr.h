@@ -19,9 +19,11 @@ struct UnaryExpr : Expr
 {
     ExprPtr operand;
 
-    explicit UnaryExpr(ExprPtr operand)
-        : operand(std::move(operand))
+    UnaryExpr(ExprKind kind, ExprPtr operand)
+        : Expr(kind)
+        , operand(std::move(operand))
     {
+        refreshAttributes();
     }
 
     [[nodiscard]] virtual std::string getOpIdentifier() const = 0;
@@ -32,11 +34,8 @@ struct UnaryExpr : Expr
 
     [[nodiscard]] eval::Result evaluate(const env::Environment* environment) const noexcept final;
 
-    [[nodiscard]] std::unordered_set<std::string> freeVariables() const noexcept final;
 
     [[nodiscard]] bool deepEq(const Expr& other) const noexcept final;
-
-    void visitAll(std::function<void(const Expr&)> visitor) const noexcept final;
 };
 
 } // namespace CuraFormulaeEngine::ast
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/ast/lookup_cache.h"
 #include "cura-formulae-engine/env/env.h"
 #include "cura-formulae-engine/eval.h"
 
@@ -13,20 +14,25 @@ struct VariableExpr final : Expr
 {
     std::string name;
 
+    /**
+     * @brief Where the name was found the last time the variable was evaluated; cleared when the attributes are
+     * refreshed, so a renamed variable does not read the value of its old name.
+     */
+    LookupCache lookup_cache;
+
     VariableExpr(std::string name)
-        : name(std::move(name))
+        : Expr(ExprKind::Variable)
+        , name(std::move(name))
     {
+        refreshAttributes();
     }
 
     std::string toString() const noexcept final;
 
     eval::Result evaluate(const env::Environment* environment) const noexcept final;
 
-    std::unordered_set<std::string> freeVariables() const noexcept final;
 
     bool deepEq(const Expr& other) const noexcept final;
-
-    void visitAll(std::function<void(const Expr&)> visitor) const noexcept final;
 };
 
 } // namespace CuraFormulaeEngine::ast
@@ -0,0 +1,236 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/ast/dispatch.h"
+#include "cura-formulae-engine/ast/expr_kind.h"
+#include "cura-formulae-engine/ast/expr_ptr.h"
+
+#include <concepts>
+#include <cstdint>
+#include <type_traits>
+
+namespace CuraFormulaeEngine::ast
+{
+
+/**
+ * @brief Returned by visitor callbacks to steer the traversal.
+ */
+enum class VisitAction : std::uint8_t
+{
+    Continue,
+
+    /**
+     * @brief Do not visit the children of this node; only meaningful when entering a node.
+     */
+    SkipChildren,
+
+    /**
+     * @brief End the whole traversal.
+     */
+    Stop,
+};
+
+namespace detail
+{
+
+template<typename Callback, typename Node>
+VisitAction callVisitor(Callback&& callback, Node& node)
+{
+    if constexpr (std::is_void_v<std::invoke_result_t<Callback&, Node&>>)
+    {
+        callback(node);
+        return VisitAction::Continue;
+    }
+    else
+    {
+        return callback(node);
+    }
+}
+
+template<typename Visitor, typename Node>
+VisitAction enter(Visitor& visitor, Node& node)
+{
+    if constexpr (std::invocable<Visitor&, Node&>)
+    {
+        return callVisitor(visitor, node);
+    }
+    else if constexpr (requires { visitor.enter(node); })
+    {
+        return callVisitor([&visitor](Node& entered) { return visitor.enter(entered); }, node);
+    }
+    else
+    {
+        return VisitAction::Continue;
+    }
+}
+
+template<typename Visitor, typename Node>
+VisitAction leave(Visitor& visitor, Node& node)
+{
+    if constexpr (requires { visitor.leave(node); })
+    {
+        return callVisitor([&visitor](Node& left) { return visitor.leave(left); }, node);
+    }
+    else
+    {
+        return VisitAction::Continue;
+    }
+}
+
+struct RewriteResult
+{
+    bool stopped{ false };
+    bool changed{ false };
+};
+
+template<typename Visitor>
+RewriteResult rewriteNode(ExprPtr& expr, Visitor& visitor)
+{
+    // a node shared with other formulas (see `ExprCorpus`) is copied before the visitor can change it, which shares
+    // its children in turn, so rewriting one formula leaves the others as they are
+    if (expr.ptr.use_count() > 1)
+    {
+        expr = expr.copy();
+    }
+
+    RewriteResult result;
+    const auto* original = expr.ptr.get();
+    const auto entered = enter(visitor, expr);
+    result.changed = expr.ptr.get() != original;
+    if (entered == VisitAction::Stop)
+    {
+        result.stopped = true;
+        return result;
+    }
+
+    if (entered != VisitAction::SkipChildren)
+    {
+        auto children_changed = false;
+        forEachChild(
+            *expr.ptr,
+            [&visitor, &result, &children_changed](ExprPtr& child)
+            {
+                if (result.stopped)
+                {
+                    return;
+                }
+                const auto child_result = rewriteNode(child, visitor);
+                result.stopped = child_result.stopped;
+                children_changed |= child_result.changed;
+            });
+        if (children_changed)
+        {
+            expr.ptr->refreshAttributes();
+            result.changed = true;
+        }
+        if (result.stopped)
+        {
+            return result;
+        }
+    }
+
+    const auto* visited = expr.ptr.get();
+    result.stopped = leave(visitor, expr) == VisitAction::Stop;
+    result.changed |= expr.ptr.get() != visited;
+    return result;
+}
+
+} // namespace detail
+
+/**
+ * @brief Walks an expression tree depth first, without type erasure or copies of the visitor.
+ *
+ * The visitor is either a callable, called when entering each node, or an object with `enter` and/or `leave`
+ * members, called before and after the children of a node. Callbacks take a `const Expr&` and return `void` or a
+ * `VisitAction`. `ExprPtr` wrappers are transparent: callbacks only see the nodes they point to. A `FlatExpr` is
+ * visited as a single node.
+ *
+ * @return false if a callback stopped the traversal, true otherwise.
+ *
+ * Example:
+ * @code
+ * std::size_t variables = 0;
+ * visit(expr, [&variables](const Expr& node) { variables += node.kind() == ExprKind::Variable; });
+ * @endcode
+ */
+template<typename Visitor>
+bool visit(const Expr& expr, Visitor&& visitor)
+{
+    const auto* node = &expr;
+    while (node->kind() == ExprKind::Ptr)
+    {
+        node = static_cast<const ExprPtr*>(node)->ptr.get();
+    }
+
+    const auto entered = detail::enter(visitor, *node);
+    if (entered == VisitAction::Stop)
+    {
+        return false;
+    }
+    if (entered != VisitAction::SkipChildren)
+    {
+        auto stopped = false;
+        forEachChild(
+            *node,
+            [&visitor, &stopped](const ExprPtr& child)
+            {
+                if (! stopped)
+                {
+                    stopped = ! visit(child, visitor);
+                }
+            });
+        if (stopped)
+        {
+            return false;
+        }
+    }
+    return detail::leave(visitor, *node) != VisitAction::Stop;
+}
+
+/**
+ * @brief Walks an expression tree depth first, allowing the visitor to replace nodes.
+ *
+ * Like `visit`, but callbacks take the `ExprPtr&` owning each node and may assign a new expression to it. A node
+ * replaced when entering has the children of its replacement visited. The cached free variables of every node above
+ * a replaced node are refreshed. Nodes shared with other formulas (see `ExprCorpus`) are copied before they are
+ * visited, so callbacks may also change the node they are given; the other formulas keep the original.
+ *
+ * @return false if a callback stopped the traversal, true otherwise.
+ *
+ * Example:
+ * @code
+ * struct ReplaceVariable
+ * {
+ *     void leave(ExprPtr& node)
+ *     {
+ *         if (node.ptr->kind() == ExprKind::Variable)
+ *         {
+ *             node = make_expr_ptr<IntExpr>(0);
+ *         }
+ *     }
+ * };
+ * rewrite(expr, ReplaceVariable{});
+ * @endcode
+ */
+template<typename Visitor>
+bool rewrite(ExprPtr& expr, Visitor&& visitor)
+{
+    return ! detail::rewriteNode(expr, visitor).stopped;
+}
+
+/**
+ * @brief Copies every node of a formula that is shared with other formulas, like `rewrite` does for the nodes it
+ * visits.
+ *
+ * Needed before changing a formula other than through `rewrite`, or before keying anything by its nodes (e.g.
+ * `opt::inferTypes`) that should still hold while it is rewritten.
+ */
+inline void unshare(ExprPtr& expr)
+{
+    struct Unsharer
+    {
+    };
+    rewrite(expr, Unsharer{});
+}
+
+} // namespace CuraFormulaeEngine::ast
@@ -1,6 +1,12 @@
 #pragma once
 
 #include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/env/concurrent_environment.h"
 #include "cura-formulae-engine/env/env.h"
+#include "cura-formulae-engine/env/environment_batch.h"
+#include "cura-formulae-engine/env/extruder_environment_family.h"
+#include "cura-formulae-engine/env/formula_environment.h"
+#include "cura-formulae-engine/env/layered_environment.h"
+#include "cura-formulae-engine/env/snapshot_environment.h"
 #include "cura-formulae-engine/parser/parser.h"
 #include "eval.h"
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/env/environment_batch.h"
+#include "cura-formulae-engine/eval.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+namespace CuraFormulaeEngine::env
+{
+
+/**
+ * @brief A thread-safe, read-mostly environment based on read-copy-update.
+ *
+ * The current state of the environment is an immutable `EnvironmentMap` that is published through an atomic shared
+ * pointer. Readers take a snapshot (a single atomic load plus reference count increment) and evaluate against it
+ * without any further synchronization; the snapshot stays valid, and unchanged, for as long as the reader holds it.
+ *
+ * A writer copies the current state, applies its edits to the copy and publishes the copy atomically. Writers are
+ * serialized with each other, readers never wait for writers. Old versions are released once the last reader
+ * drops its snapshot.
+ *
+ * Example:
+ * @code
+ * const auto snapshot = environment.snapshot();
+ * const auto result = expr.evaluate(snapshot.get());
+ * @endcode
+ */
+class ConcurrentEnvironment : public Environment
+{
+public:
+    using snapshot_t = std::shared_ptr<const EnvironmentMap>;
+
+    ConcurrentEnvironment();
+    explicit ConcurrentEnvironment(EnvironmentMap environment);
+    ~ConcurrentEnvironment() override = default;
+
+    ConcurrentEnvironment(const ConcurrentEnvironment&) = delete;
+    ConcurrentEnvironment(ConcurrentEnvironment&&) = delete;
+    ConcurrentEnvironment& operator=(const ConcurrentEnvironment&) = delete;
+    ConcurrentEnvironment& operator=(ConcurrentEnvironment&&) = delete;
+
+    /**
+     * @brief Returns an immutable snapshot of the current version of the environment.
+     *
+     * Evaluating a formula against the snapshot requires no locking, and is not affected by concurrent writers.
+     */
+    [[nodiscard]] snapshot_t snapshot() const noexcept;
+
+    /**
+     * @brief A snapshot together with the number of versions published up to and including it.
+     */
+    struct VersionedSnapshot
+    {
+        snapshot_t environment;
+        std::uint64_t version{ 0 };
+    };
+
+    /**
+     * @brief Returns a snapshot and its version, which are published together and so always belong to each other.
+     */
+    [[nodiscard]] VersionedSnapshot versionedSnapshot() const noexcept;
+
+    /**
+     * @brief Returns the number of versions published so far.
+     */
+    [[nodiscard]] std::uint64_t version() const noexcept;
+
+    /**
+     * @note Each call takes its own snapshot; use `snapshot()` when several lookups must observe the same version.
+     */
+    [[nodiscard]] std::optional<eval::Value> get(const std::string& key) const noexcept override;
+
+    [[nodiscard]] bool has(const std::string& key) const noexcept override;
+
+    [[nodiscard]] std::unordered_map<std::string, eval::Value> getAll() const noexcept override;
+
+    /**
+     * @brief Publishes a new version in which `key` is set to `value`.
+     */
+    void set(const std::string& key, const eval::Value& value);
+
+    /**
+     * @brief Publishes a new version without `key`.
+     *
+     * @return true if the key was present, false otherwise (in which case no new version is published).
+     */
+    bool erase(const std::string& key);
+
+    /**
+     * @brief Publishes all operations of a batch as a single new version.
+     *
+     * @return The keys whose value changed; when nothing changed no new version is published.
+     */
+    std::unordered_set<std::string> apply(const EnvironmentBatch& batch);
+
+    /**
+     * @brief Applies an arbitrary number of edits and publishes them as a single new version.
+     *
+     * @param edit Callable invoked as `edit(EnvironmentMap&)` on a private copy of the current version.
+     */
+    template<typename Fn>
+    void update(Fn&& edit)
+    {
+        const std::lock_guard<std::mutex> lock(writer_mutex_);
+        auto next = snapshot()->clone();
+        std::forward<Fn>(edit)(next);
+        publish(std::move(next));
+    }
+
+private:
+    /**
+     * @brief A published version; the version number lives next to the environment so both are published at once.
+     */
+    struct State
+    {
+        EnvironmentMap environment;
+        std::uint64_t version{ 0 };
+    };
+    using state_t = std::shared_ptr<const State>;
+
+    [[nodiscard]] state_t state() const noexcept;
+
+    /**
+     * @brief Publishes the next version; only called with `writer_mutex_` held.
+     */
+    void publish(EnvironmentMap next);
+
+    std::mutex writer_mutex_;
+#if defined(__cpp_lib_atomic_shared_ptr)
+    std::atomic<state_t> current_;
+#else
+    state_t current_; // only accessed through std::atomic_load / std::atomic_store
+#endif
+};
+
+} // namespace CuraFormulaeEngine::env
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "cura-formulae-engine/eval.h"
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace CuraFormulaeEngine::env
+{
+
+/**
+ * @brief A set of staged `set`/`erase` operations that is applied to an environment at once.
+ *
+ * Staging the same key more than once keeps only the last operation. Applying a batch (e.g. through
+ * `EnvironmentMap::apply`) reserves the room it needs once and returns the set of keys whose value actually
+ * changed, so that dependents can be recomputed once per batch instead of once per key.
+ *
+ * Example:
+ * @code
+ * EnvironmentBatch batch;
+ * batch.set("layer_height", 0.1);
+ * batch.erase("support_angle");
+ * formula_environment.invalidate(environment.apply(batch));
+ * @endcode
+ */
+class EnvironmentBatch
+{
+public:
+    /**
+     * @brief An operation is either the new value of a key, or nullopt if the key is erased.
+     */
+    using operations_t = std::unordered_map<std::string, std::optional<eval::Value>>;
+
+    void reserve(std::size_t count);
+
+    void set(const std::string& key, const eval::Value& value);
+
+    void erase(const std::string& key);
+
+    void clear() noexcept;
+
+    [[nodiscard]] std::size_t size() const noexcept;
+
+    [[nodiscard]] bool empty() const noexcept;
+
+    [[nodiscard]] const operations_t& operations() const noexcept;
+
+private:
+    operations_t operations_;
+};
+
+} // namespace CuraFormulaeEngine::env
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/eval.h"
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace CuraFormulaeEngine::env
+{
+
+/**
+ * @brief The environments of a printer: a global layer shared by N extruder overlays.
+ *
+ * Values are stored key-major; every key owns one contiguous row of `1 + extruder_count` cells, the global value
+ * followed by the per-extruder overrides. Gathering a key across all extruders (`extruderValues`) is therefore a
+ * single hash lookup followed by a strided read of one row.
+ *
+ * A lookup in an extruder resolves the extruder override, then the global value, then the base environment. Keys
+ * can be resolved to a slot once with `slot` to skip the string lookup altogether.
+ *
+ * The per-extruder `Environment`s returned by `extruder()` and `global()` additionally resolve `extruderValue` and
+ * `extruderValues` to functions bound to this family, unless these names are set explicitly.
+ *
+ * @note The family hands out pointers to itself, it can neither be copied nor moved.
+ */
+class ExtruderEnvironmentFamily
+{
+public:
+    using slot_t = std::size_t;
+
+    explicit ExtruderEnvironmentFamily(std::size_t extruder_count, const Environment* base_environment = nullptr);
+
+    ExtruderEnvironmentFamily(const ExtruderEnvironmentFamily&) = delete;
+    ExtruderEnvironmentFamily(ExtruderEnvironmentFamily&&) = delete;
+    ExtruderEnvironmentFamily& operator=(const ExtruderEnvironmentFamily&) = delete;
+    ExtruderEnvironmentFamily& operator=(ExtruderEnvironmentFamily&&) = delete;
+    ~ExtruderEnvironmentFamily() = default;
+
+    [[nodiscard]] std::size_t extruderCount() const noexcept;
+
+    /**
+     * @brief Returns the slot of a key, or nullopt if the key was never set in this family.
+     */
+    [[nodiscard]] std::optional<slot_t> slot(const std::string& key) const noexcept;
+
+    void setGlobal(const std::string& key, const eval::Value& value);
+
+    void setExtruder(std::size_t extruder, const std::string& key, const eval::Value& value);
+
+    /**
+     * @brief Removes the override of a key in one extruder, the extruder falls back to the global value.
+     *
+     * @return true if the extruder had an override for the key, false otherwise.
+     */
+    bool eraseExtruder(std::size_t extruder, const std::string& key) noexcept;
+
+    [[nodiscard]] std::optional<eval::Value> globalValue(const std::string& key) const noexcept;
+
+    [[nodiscard]] std::optional<eval::Value> extruderValue(std::size_t extruder, const std::string& key) const noexcept;
+
+    [[nodiscard]] const eval::Value* extruderValue(std::size_t extruder, slot_t slot) const noexcept;
+
+    /**
+     * @brief Returns the value of a key in every extruder, in extruder order.
+     *
+     * @return nullopt if an extruder has no value for the key, neither in this family nor in the base environment.
+     */
+    [[nodiscard]] std::optional<std::vector<eval::Value>> extruderValues(const std::string& key) const;
+
+    /**
+     * @brief Returns the value of a slot in every extruder, in extruder order.
+     *
+     * @return nullopt if the slot was not handed out by this family, or if an extruder has neither an override nor a
+     * global value for it; `extruderValue` has no value for that extruder either.
+     */
+    [[nodiscard]] std::optional<std::vector<eval::Value>> extruderValues(slot_t slot) const;
+
+    [[nodiscard]] const Environment& global() const noexcept;
+
+    [[nodiscard]] const Environment& extruder(std::size_t extruder) const;
+
+    /**
+     * @brief `extruderValue(extruder_nr, key)`; resolves a key in a single extruder, or in the global layer for -1.
+     */
+    [[nodiscard]] const eval::Value::fn_t& extruderValueFunction() const noexcept;
+
+    /**
+     * @brief `extruderValues(key)`; resolves a key in every extruder.
+     */
+    [[nodiscard]] const eval::Value::fn_t& extruderValuesFunction() const noexcept;
+
+private:
+    class View final : public Environment
+    {
+    public:
+        View(const ExtruderEnvironmentFamily* family, std::optional<std::size_t> extruder);
+
+        [[nodiscard]] std::optional<eval::Value> get(const std::string& key) const noexcept final;
+
+        [[nodiscard]] bool has(const std::string& key) const noexcept final;
+
+        [[nodiscard]] std::unordered_map<std::string, eval::Value> getAll() const noexcept final;
+
+    private:
+        const ExtruderEnvironmentFamily* family_;
+        std::optional<std::size_t> extruder_;
+    };
+
+    [[nodiscard]] std::size_t stride() const noexcept;
+
+    [[nodiscard]] slot_t internSlot(const std::string& key);
+
+    [[nodiscard]] const eval::Value* resolve(std::optional<std::size_t> extruder, slot_t slot) const noexcept;
+
+    [[nodiscard]] std::optional<eval::Value> lookup(std::optional<std::size_t> extruder, const std::string& key) const noexcept;
+
+    std::size_t extruder_count_;
+    const Environment* base_environment_;
+    std::unordered_map<std::string, slot_t> slots_;
+    std::vector<std::string> keys_;
+    std::vector<std::optional<eval::Value>> cells_;
+    std::vector<View> views_;
+    eval::Value::fn_t extruder_value_fn_;
+    eval::Value::fn_t extruder_values_fn_;
+};
+
+} // namespace CuraFormulaeEngine::env
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/ast/expr_ptr.h"
+#include "cura-formulae-engine/eval.h"
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace CuraFormulaeEngine::env
+{
+
+/**
+ * @brief An environment in which (some) keys are backed by a formula instead of a value.
+ *
+ * The formula of a key is only evaluated when the key is first looked up, against this same environment, so that
+ * formulas can refer to each other. The result is memoized until the key, or one of the keys its formula depends
+ * on, is invalidated. Keys without a formula are resolved in the base environment.
+ *
+ * Cyclic formulas are detected; every key on the cycle evaluates to `eval::Error::CyclicDependency`. When a formula
+ * fails because a formula it depends on failed, `evaluate` reports the error of the innermost failing formula
+ * rather than `UndefinedVariable`.
+ *
+ * @note The memoization state is not synchronized, an instance must not be evaluated from multiple threads
+ * concurrently.
+ */
+class FormulaEnvironment : public Environment
+{
+public:
+    explicit FormulaEnvironment(const Environment* base_environment);
+    ~FormulaEnvironment() override = default;
+
+    FormulaEnvironment(const FormulaEnvironment&) = delete;
+    FormulaEnvironment(FormulaEnvironment&&) = default;
+    FormulaEnvironment& operator=(const FormulaEnvironment&) = delete;
+    FormulaEnvironment& operator=(FormulaEnvironment&&) = default;
+
+    [[nodiscard]] std::optional<eval::Value> get(const std::string& key) const noexcept override;
+
+    [[nodiscard]] bool has(const std::string& key) const noexcept override;
+
+    /**
+     * @note Evaluates every formula that has not been evaluated yet; formulas that fail to evaluate are omitted.
+     */
+    [[nodiscard]] std::unordered_map<std::string, eval::Value> getAll() const noexcept override;
+
+    /**
+     * @brief Evaluates (or returns the memoized value of) a single key.
+     *
+     * @return The value of the key, or the evaluation error of the (innermost) formula that failed.
+     */
+    [[nodiscard]] eval::Result evaluate(const std::string& key) const noexcept;
+
+    /**
+     * @brief Sets the formula of a key, replacing any previous formula, and invalidates its dependents.
+     */
+    void setFormula(const std::string& key, ast::ExprPtr formula);
+
+    /**
+     * @brief Removes the formula of a key, the key is resolved in the base environment afterwards.
+     *
+     * @return true if the key had a formula, false otherwise.
+     */
+    bool eraseFormula(const std::string& key);
+
+    [[nodiscard]] bool hasFormula(const std::string& key) const noexcept;
+
+    /**
+     * @brief Drops the memoized value of a key and of every formula that (transitively) depends on it.
+     *
+     * Must be called for keys whose value changed in the base environment.
+     */
+    void invalidate(const std::string& key);
+
+    /**
+     * @brief Drops the memoized values of a set of keys and their dependents in a single pass.
+     *
+     * Intended for the changed-key set returned by applying an `EnvironmentBatch` to the base environment.
+     */
+    void invalidate(const std::unordered_set<std::string>& keys);
+
+    /**
+     * @brief Drops all memoized values.
+     */
+    void invalidateAll() noexcept;
+
+    /**
+     * @brief Returns true if the value of the key is currently memoized.
+     */
+    [[nodiscard]] bool isEvaluated(const std::string& key) const noexcept;
+
+private:
+    const Environment* base_environment_;
+    std::unordered_map<std::string, ast::ExprPtr> formulas_;
+    std::unordered_map<std::string, std::unordered_set<std::string>> dependents_;
+
+    mutable std::unordered_map<std::string, eval::Result> evaluated_;
+    mutable std::unordered_set<std::string> in_progress_;
+    mutable std::optional<eval::Error> nested_error_;
+};
+
+} // namespace CuraFormulaeEngine::env
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/env/lookup.h"
+#include "cura-formulae-engine/eval.h"
+
+#include <concepts>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace CuraFormulaeEngine::env
+{
+
+/**
+ * @brief An environment in which the keys of `Upper` shadow those of `Lower`, with both types known at compile time.
+ *
+ * Like a `LocalEnvironment`, but the lower layer is not reached through a virtual call: a stack of layers, such as the
+ * settings of an extruder over those of the global stack over `std_env`, resolves a name with one inlined lookup per
+ * layer when evaluated with `ast::evaluate<Env>`. Layers are referenced, not copied, and must outlive the stack.
+ *
+ * Example:
+ * @code
+ * const LayeredEnvironment<EnvironmentMap, EnvironmentMap> global{ global_settings, std_env };
+ * const LayeredEnvironment extruder{ extruder_settings, global };
+ * const auto result = ast::evaluate(expr, extruder);
+ * @endcode
+ */
+template<typename Upper, typename Lower>
+    requires std::derived_from<Upper, Environment> && std::derived_from<Lower, Environment>
+class LayeredEnvironment final : public Environment
+{
+public:
+    LayeredEnvironment(const Upper& upper, const Lower& lower) noexcept
+        : upper_(&upper)
+        , lower_(&lower)
+    {
+    }
+    ~LayeredEnvironment() override = default;
+
+    [[nodiscard]] std::optional<eval::Value> get(const std::string& key) const noexcept final
+    {
+        if (auto value = lookup(*upper_, key); value.has_value())
+        {
+            return value;
+        }
+        return lookup(*lower_, key);
+    }
+
+    [[nodiscard]] bool has(const std::string& key) const noexcept final
+    {
+        return upper_->has(key) || lower_->has(key);
+    }
+
+    [[nodiscard]] std::unordered_map<std::string, eval::Value> getAll() const noexcept final
+    {
+        auto all = lower_->getAll();
+        for (auto& [key, value] : upper_->getAll())
+        {
+            all.insert_or_assign(key, std::move(value));
+        }
+        return all;
+    }
+
+    [[nodiscard]] const Upper& upper() const noexcept
+    {
+        return *upper_;
+    }
+
+    [[nodiscard]] const Lower& lower() const noexcept
+    {
+        return *lower_;
+    }
+
+private:
+    const Upper* upper_;
+    const Lower* lower_;
+};
+
+} // namespace CuraFormulaeEngine::env
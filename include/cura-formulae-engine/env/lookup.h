@@ -0,0 +1,54 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/eval.h"
+
+#include <concepts>
+#include <optional>
+#include <string>
+
+namespace CuraFormulaeEngine::env
+{
+
+/**
+ * @brief Looks `key` up in an environment whose type is known at compile time, like `environment.get(key)` does.
+ *
+ * Found by argument dependent lookup, so environments can add overloads next to their definition. This one calls
+ * `get`, which needs no virtual call when `Env`, or its `get`, is final.
+ */
+template<typename Env>
+    requires std::derived_from<Env, Environment>
+[[nodiscard]] std::optional<eval::Value> lookup(const Env& environment, const std::string& key) noexcept
+{
+    return environment.get(key);
+}
+
+/**
+ * @brief Hashes the key once and calls no virtual functions, where `get` hashes it twice.
+ */
+[[nodiscard]] inline std::optional<eval::Value> lookup(const EnvironmentMap& environment, const std::string& key) noexcept
+{
+    if (const auto* value = environment.EnvironmentMap::find(key); value != nullptr)
+    {
+        return *value;
+    }
+    return std::nullopt;
+}
+
+/**
+ * @brief Looks the local names up without a virtual call, and asks the shadow environment once instead of twice.
+ */
+[[nodiscard]] inline std::optional<eval::Value> lookup(const LocalEnvironment& environment, const std::string& key) noexcept
+{
+    if (auto value = lookup(environment.local_environment_, key); value.has_value())
+    {
+        return value;
+    }
+    if (environment.shadow_environment_ == nullptr)
+    {
+        return std::nullopt;
+    }
+    return environment.shadow_environment_->get(key);
+}
+
+} // namespace CuraFormulaeEngine::env
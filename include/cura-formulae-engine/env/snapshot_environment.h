@@ -0,0 +1,108 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/eval.h"
+
+#include <zeus/expected.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace CuraFormulaeEngine::env
+{
+
+/**
+ * @brief The deepest nesting of lists a snapshot can hold; reading a deeper value fails instead of exhausting the stack.
+ */
+constexpr std::size_t max_snapshot_nesting = 64;
+
+enum class SnapshotError
+{
+    IoError,
+    InvalidFormat,
+    UnsupportedValue,
+
+    /**
+     * @brief A key or an encoded value does not fit the 32 bit lengths of the index.
+     */
+    TooLarge
+};
+
+/**
+ * @brief Encodes an environment into the snapshot format read by `SnapshotEnvironment`.
+ *
+ * The encoding is position independent: a header, an index of (key, value) offsets sorted by key, followed by the
+ * key bytes and the encoded values. Functions cannot be encoded, and neither can lists nested deeper than
+ * `max_snapshot_nesting`; an environment containing either yields `SnapshotError::UnsupportedValue`.
+ *
+ * @note Numbers are stored in the byte order of the writing machine, snapshots are not portable across endianness.
+ */
+[[nodiscard]] zeus::expected<std::string, SnapshotError> encodeSnapshot(const Environment& environment);
+
+/**
+ * @brief Encodes an environment and writes it to a snapshot file.
+ *
+ * The snapshot is written next to the file and then renamed over it, so readers that still have the previous version
+ * mapped keep reading that version, instead of the file changing under them.
+ */
+[[nodiscard]] zeus::expected<void, SnapshotError> writeSnapshot(const Environment& environment, const std::filesystem::path& path);
+
+/**
+ * @brief A read-only environment served directly from a memory mapped snapshot file.
+ *
+ * Opening a snapshot maps the file and validates its header, nothing is parsed up front. A lookup is a binary
+ * search over the sorted key index in the mapping followed by decoding the single value found. Because the mapping
+ * is read-only and shared, processes opening the same file share one physical copy of it.
+ *
+ * Example:
+ * @code
+ * writeSnapshot(defaults, "defaults.cfes");
+ * // in every worker
+ * const auto snapshot = SnapshotEnvironment::open("defaults.cfes");
+ * const auto result = expr.evaluate(&snapshot.value());
+ * @endcode
+ */
+class SnapshotEnvironment : public Environment
+{
+public:
+    [[nodiscard]] static zeus::expected<SnapshotEnvironment, SnapshotError> open(const std::filesystem::path& path);
+
+    SnapshotEnvironment(const SnapshotEnvironment&) = delete;
+    SnapshotEnvironment(SnapshotEnvironment&& other) noexcept;
+    SnapshotEnvironment& operator=(const SnapshotEnvironment&) = delete;
+    SnapshotEnvironment& operator=(SnapshotEnvironment&& other) noexcept;
+    ~SnapshotEnvironment() override;
+
+    [[nodiscard]] std::optional<eval::Value> get(const std::string& key) const noexcept override;
+
+    [[nodiscard]] bool has(const std::string& key) const noexcept override;
+
+    [[nodiscard]] std::unordered_map<std::string, eval::Value> getAll() const noexcept override;
+
+    [[nodiscard]] std::size_t size() const noexcept;
+
+private:
+    SnapshotEnvironment() = default;
+
+    [[nodiscard]] std::string_view keyAt(std::size_t index) const noexcept;
+
+    [[nodiscard]] std::optional<std::size_t> find(std::string_view key) const noexcept;
+
+    [[nodiscard]] std::optional<eval::Value> valueAt(std::size_t index) const noexcept;
+
+    void unmap() noexcept;
+
+    const std::byte* data_{ nullptr };
+    std::size_t size_{ 0 };
+    std::size_t key_count_{ 0 };
+#ifdef _WIN32
+    void* mapping_handle_{ nullptr };
+#endif
+};
+
+} // namespace CuraFormulaeEngine::env
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <filesystem>
+#include <span>
+
+namespace CuraFormulaeEngine
+{
+
+/**
+ * @brief Replaces the file at `path` by one holding `contents`, so readers open either the old file or the new one,
+ * never a part of it.
+ *
+ * The contents are written to a temporary file next to `path`, named after the process and a random number so
+ * concurrent writers, in this process or others, do not collide, which is then renamed over `path`.
+ *
+ * @return false if writing or renaming failed; the temporary file is removed and `path` is left as it was.
+ */
+[[nodiscard]] bool replaceFile(const std::filesystem::path& path, std::span<const char> contents);
+
+} // namespace CuraFormulaeEngine
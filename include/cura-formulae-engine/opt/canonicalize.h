@@ -0,0 +1,50 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/ast/expr_ptr.h"
+#include "cura-formulae-engine/opt/value_types.h"
+
+#include <cstddef>
+#include <string>
+
+namespace CuraFormulaeEngine::opt
+{
+
+/**
+ * @brief Rewrites a formula into a canonical form, so formulas written differently but meaning the same become equal.
+ *
+ * Operands are ordered by their `toString`, with literals after everything else:
+ * - the operands of `+` and `*` are swapped when both are numbers (strings and lists do not commute);
+ * - chains of `+` or `*` of integers are flattened and sorted, `(c + a) + b` becomes `(a + b) + c`;
+ * - chains of `and` or `or` are nested to the left, `a and (b and c)` becomes `(a and b) and c`, keeping the order
+ *   of the operands;
+ * - comparisons of two operands are swapped, flipping `<`, `>`, `<=` and `>=`, so `0 < x` becomes `x > 0`. `<=` and
+ *   `>=` are only swapped when the operands are not both strings, which only `>=` compares.
+ *
+ * Float additions and multiplications are not reassociated, since that changes their rounding. The types of the
+ * operands are inferred with `schema` (see `inferTypes`). Parentheses are not part of the tree, so `(a)` and `a`
+ * already parse the same.
+ *
+ * Operands are only reordered when the error a formula reports stays the same: at most one of them may fail, which
+ * is judged by their types and, for variables, by whether they are in `schema` or `env::std_env`. A chain with more
+ * operands that may fail is nested to the left in its original order.
+ *
+ * @param canonicalized If set, incremented by the number of operators rewritten.
+ */
+[[nodiscard]] ast::ExprPtr canonicalize(ast::ExprPtr expr, const TypeSchema& schema = {}, std::size_t* canonicalized = nullptr);
+
+/**
+ * @brief The canonical form of a formula, printed fully parenthesized (`ast::PrintStyle::Full`), which is the same for
+ * formulas `canonicalize` makes equal and so can key a parse cache, a result cache or an `ast::ExprCorpus`. The formula
+ * itself is not modified.
+ *
+ * Example:
+ * @code
+ * const auto schema = opt::TypeSchema::fromEnvironment(global_stack);
+ * // with numbers a and b, "0 < b + a" and "a + b > 0" give the same key
+ * const auto key = opt::canonicalString(formula, schema);
+ * @endcode
+ */
+[[nodiscard]] std::string canonicalString(const ast::Expr& expr, const TypeSchema& schema = {});
+
+} // namespace CuraFormulaeEngine::opt
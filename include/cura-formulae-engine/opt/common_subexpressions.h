@@ -0,0 +1,43 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/ast/expr_ptr.h"
+
+#include <cstddef>
+
+namespace CuraFormulaeEngine::opt
+{
+
+/**
+ * @brief Evaluates subexpressions that occur more than once in a formula only once.
+ *
+ * Structurally identical subexpressions that call a function, contain a list comprehension or have at least four
+ * nodes are replaced by a temporary, bound by an `ast::LetExpr` placed around all of them. The temporaries are named
+ * `$0`, `$1`, ..., which cannot clash with the names in a parsed formula. Functions are assumed to be pure, which
+ * they are in formulas.
+ *
+ * A subexpression is only shared where the result does not change:
+ * - all occurrences must refer to the same variables, so occurrences that read a loop variable are only shared with
+ *   occurrences in the same list comprehension;
+ * - it must be evaluated whenever the temporary is bound, so it is not hoisted out of a branch of a conditional
+ *   expression, out of the right operand of `and` or `or`, out of the later comparisons of a chain, or into a list
+ *   comprehension loop that may not run;
+ * - it must not fail, or nothing evaluated before it where the temporary is bound may fail, so the error reported
+ *   stays the same: `g(x) + f(x) * f(x)` is left alone, but `f(x) + g(x) * f(x)` is shared. Names of `env::std_env`
+ *   are assumed to be defined, as they are when formulas are evaluated over it.
+ *
+ * Occurrences in the conditions and the iterator of a list comprehension that read its loop variables are bound by an
+ * extra loop over a single element list, `[f(x) for x in xs if f(x) > 0]` becomes
+ * `[$0 for x in xs for $0 in [f(x)] if $0 > 0]`.
+ *
+ * Example:
+ * @code
+ * auto shared = opt::eliminateCommonSubexpressions(parser::parse("extruderValues('a')[0] + extruderValues('a')[1]").value());
+ * // shared is (let $0 = extruderValues('a') in $0[0] + $0[1])
+ * @endcode
+ *
+ * @param eliminated If set, incremented by the number of temporaries introduced.
+ */
+[[nodiscard]] ast::ExprPtr eliminateCommonSubexpressions(ast::ExprPtr expr, std::size_t* eliminated = nullptr);
+
+} // namespace CuraFormulaeEngine::opt
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/ast/expr_ptr.h"
+#include "cura-formulae-engine/env/env.h"
+#include "cura-formulae-engine/eval.h"
+
+#include <cstddef>
+#include <optional>
+
+namespace CuraFormulaeEngine::opt
+{
+
+/**
+ * @brief Returns the literal expression for a value, if it has one.
+ *
+ * Booleans, integers, strings, None and finite floats have literals; lists, functions, infinities and NaN do not.
+ */
+[[nodiscard]] std::optional<ast::ExprPtr> makeLiteral(const eval::Value& value);
+
+/**
+ * @brief Folds constant subexpressions into literals.
+ *
+ * A subexpression is constant if every free variable in it is defined in `constants`, which by default are the
+ * builtins of the standard environment. Constant subexpressions are evaluated against `constants` once, bottom up,
+ * and replaced by the literal of their result. Subexpressions that fail to evaluate (e.g. `1 / 0`) are kept, so
+ * evaluating the folded formula gives the same error; so are results without a literal. Conditional expressions with a
+ * constant condition are replaced by the branch that is taken, `and` and `or` with a constant left operand by the
+ * operand that gives the result. Calls of `float`, `int` and `str` are never folded, as these builtins throw for some
+ * arguments (e.g. `float('abc')`) where the formula might never call them.
+ *
+ * The names in `constants` are assumed to keep their meaning in the environments the formula is evaluated in, except
+ * where a list comprehension binds them as loop variables.
+ *
+ * Example:
+ * @code
+ * auto folded = opt::foldConstants(parser::parse("math.pi / 180 * angle").value());
+ * // folded is 0.017453292519943295 * angle
+ * @endcode
+ *
+ * @param folded If set, incremented by the number of subexpressions that were folded.
+ */
+[[nodiscard]] ast::ExprPtr foldConstants(ast::ExprPtr expr, const env::Environment& constants = env::std_env, std::size_t* folded = nullptr);
+
+} // namespace CuraFormulaeEngine::opt
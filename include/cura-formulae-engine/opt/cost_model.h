@@ -0,0 +1,135 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/ast/expr_kind.h"
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+
+namespace CuraFormulaeEngine::opt
+{
+
+/**
+ * @brief The cost of a call to a function, apart from evaluating its arguments.
+ */
+struct FnCost
+{
+    double base{ 0.0 };
+
+    /**
+     * @brief Added for each element of a list argument, for functions that go over their list (`sum`, `max`, ...).
+     */
+    double per_element{ 0.0 };
+};
+
+/**
+ * @brief The weights `estimateCost` uses, in units of one variable lookup.
+ *
+ * The defaults are weights measured for the tree evaluator with `formula_cost --calibrate`, relative to the time of a
+ * variable lookup: they rank formulas, but do not predict times on other machines. Adjust `list_sizes` to the machine
+ * (e.g. the number of extruders) and `fn_costs` to the functions an application defines.
+ */
+struct CostModel
+{
+    /**
+     * @brief The cost of evaluating a node of each kind, apart from its children, indexed by `ast::ExprKind`.
+     */
+    std::array<double, static_cast<std::size_t>(ast::ExprKind::Flat) + 1> kind_costs{};
+
+    /**
+     * @brief Added for each element of a list or tuple, and for each element a list comprehension loop binds.
+     */
+    double per_element{ 0.0 };
+
+    /**
+     * @brief The cost of calls, by the name of the function; calls of other functions cost `unknown_fn`.
+     */
+    std::unordered_map<std::string, FnCost> fn_costs;
+    FnCost unknown_fn;
+
+    /**
+     * @brief The number of elements of list variables, and of the lists returned by calls of functions, by name;
+     * other lists are assumed to have `default_list_size` elements.
+     */
+    std::unordered_map<std::string, double> list_sizes;
+    double default_list_size{ 0.0 };
+
+    /**
+     * @brief The chance the right operand of `and` and `or`, a branch of a conditional expression, or a later
+     * comparison of a chain is evaluated.
+     */
+    double branch_probability{ 0.0 };
+
+    /**
+     * @brief The default weights, with the builtins of `env::std_env` and Cura's `extruderValue(s)`.
+     */
+    [[nodiscard]] static const CostModel& defaults();
+};
+
+/**
+ * @brief The estimated cost of a node of a formula.
+ */
+struct NodeCost
+{
+    /**
+     * @brief The cost of evaluating the node once, including its children.
+     */
+    double cost{ 0.0 };
+
+    /**
+     * @brief How often the node is expected to be evaluated when the formula is evaluated once.
+     */
+    double evaluations{ 0.0 };
+
+    /**
+     * @brief The part of the cost of the formula spent in this subtree.
+     */
+    [[nodiscard]] double total() const noexcept
+    {
+        return cost * evaluations;
+    }
+};
+
+struct CostEstimate
+{
+    /**
+     * @brief The estimated cost of evaluating the formula once.
+     */
+    double total{ 0.0 };
+
+    /**
+     * @brief The cost of each node, keyed by the node (not the `ExprPtr` wrapping it).
+     */
+    std::unordered_map<const ast::Expr*, NodeCost> nodes;
+};
+
+/**
+ * @brief Estimates how expensive evaluating a formula is, to decide what is worth caching or optimizing.
+ *
+ * The cost of a node is its weight in `model` plus the costs of its children, weighted by how often they are
+ * evaluated. A list comprehension loop runs once for every element of its iterable, whose size is taken from the
+ * literal or from `model.list_sizes`; conditions are assumed to hold. Like the evaluator, an iterable is only
+ * evaluated again when a loop whose variables it reads advances.
+ *
+ * The estimate is only valid while the formula is not modified. A `FlatExpr` is estimated like its tree, but is a
+ * single entry of `nodes`.
+ *
+ * Example:
+ * @code
+ * auto model = opt::CostModel::defaults();
+ * model.list_sizes["extruderValues"] = 2;
+ * const auto estimate = opt::estimateCost(formula, model);
+ * spdlog::info("{} costs {}, mostly {}", formula.toString(), estimate.total, opt::dominantSubtree(formula, estimate).toString());
+ * @endcode
+ */
+[[nodiscard]] CostEstimate estimateCost(const ast::Expr& expr, const CostModel& model = CostModel::defaults());
+
+/**
+ * @brief The smallest subtree accounting for at least `share` of the cost of a formula: starting from the root, the
+ * child with the largest part of the cost, as long as that part is large enough.
+ */
+[[nodiscard]] const ast::Expr& dominantSubtree(const ast::Expr& expr, const CostEstimate& estimate, double share = 0.5);
+
+} // namespace CuraFormulaeEngine::opt
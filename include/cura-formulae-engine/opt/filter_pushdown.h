@@ -0,0 +1,32 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/expr_ptr.h"
+#include "cura-formulae-engine/opt/value_types.h"
+
+#include <cstddef>
+
+namespace CuraFormulaeEngine::opt
+{
+
+/**
+ * @brief Moves the conditions of list comprehensions to the outermost loop where they can be checked.
+ *
+ * A condition that reads no variables of the loop it belongs to only depends on the outer loops, yet it is checked
+ * for every element of the inner ones. It is moved to the innermost loop binding a variable it reads, or to the first
+ * loop if it reads none, so inner loops are skipped as a whole when it does not hold:
+ * `[(x, y) for x in xs for y in ys if x != 0]` becomes `[(x, y) for x in xs if x != 0 for y in ys]`.
+ *
+ * A moved condition is checked before the iterables and conditions it moves ahead of, and also when the inner loops
+ * have no elements. So a condition is only moved when it and everything it moves ahead of cannot fail, which is
+ * decided from the types inferred with `schema` (see `inferTypes`): literals, defined variables, `and`, `or`, `not`,
+ * conditional expressions, lists, tuples, `==`, `!=`, `in` on lists, and ordering comparisons and `+`, `-` and `*`
+ * of numbers. Variables in the schema are assumed to be defined.
+ *
+ * Iterables that read no variables of the loops between them and the loop they depend on are not re-evaluated as
+ * those loops advance (see `ast::ListComprehensionExpr::iterableDependencies`), so they need no rewrite.
+ *
+ * @param moved If set, incremented by the number of conditions moved.
+ */
+[[nodiscard]] ast::ExprPtr pushDownFilters(ast::ExprPtr expr, const TypeSchema& schema = {}, std::size_t* moved = nullptr);
+
+} // namespace CuraFormulaeEngine::opt
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/ast/expr_ptr.h"
+#include "cura-formulae-engine/ast/fused_expr.h"
+
+#include <array>
+#include <cstddef>
+
+namespace CuraFormulaeEngine::opt
+{
+
+/**
+ * @brief Replaces the subexpressions with one of the `ast::FusedShape`s by `ast::FusedExpr` nodes, which evaluate them
+ * in one step.
+ *
+ * The shapes are matched bottom up, so a fused comparison can be the condition of a fused selection. Fusing should be
+ * the last pass: the other passes see through fused nodes, but leave a fused node their rewrites have changed the shape
+ * of to evaluate its subexpression as usual. Results and errors do not change.
+ *
+ * Example:
+ * @code
+ * const auto formula = opt::fuseShapes(parser::parse("line_width * 2 if adhesion_type == 'brim' else skirt_width").value());
+ * // the comparison and the scale are fused, the selection is not since its then branch is not a variable
+ * @endcode
+ *
+ * @param fused If set, incremented by the number of fused nodes introduced.
+ */
+[[nodiscard]] ast::ExprPtr fuseShapes(ast::ExprPtr expr, std::size_t* fused = nullptr);
+
+/**
+ * @brief How often the shapes `fuseShapes` fuses occur in a corpus of formulas.
+ */
+struct ShapeStatistics
+{
+    std::size_t formulas{ 0 };
+
+    /**
+     * @brief The nodes of the formulas, not counting `ExprPtr`s and fused nodes, which wrap other nodes.
+     */
+    std::size_t nodes{ 0 };
+
+    /**
+     * @brief The number of subexpressions of each shape, indexed by `ast::FusedShape`.
+     */
+    std::array<std::size_t, ast::fused_shape_count> occurrences{};
+
+    /**
+     * @brief The number of formulas with at least one subexpression of each shape.
+     */
+    std::array<std::size_t, ast::fused_shape_count> formulas_with{};
+
+    /**
+     * @brief The nodes evaluated by the fused nodes of each shape; the condition of a selection is not, so it is not
+     * counted.
+     */
+    std::array<std::size_t, ast::fused_shape_count> fused_nodes{};
+
+    /**
+     * @brief Adds the shapes of one more formula.
+     */
+    void add(const ast::Expr& formula);
+};
+
+} // namespace CuraFormulaeEngine::opt
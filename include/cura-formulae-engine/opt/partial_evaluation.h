@@ -0,0 +1,47 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/ast/expr_ptr.h"
+
+#include <string>
+#include <unordered_set>
+
+namespace CuraFormulaeEngine::opt
+{
+
+/**
+ * @brief A formula specialized for a set of frozen values.
+ */
+struct PartialEvaluation
+{
+    /**
+     * @brief What is left of the formula, evaluating to the same result as the original in any environment that
+     * holds the frozen values.
+     */
+    ast::ExprPtr residual;
+
+    /**
+     * @brief The free variables of the residual, which still have to be read when it is evaluated.
+     */
+    std::unordered_set<std::string> free_variables;
+};
+
+/**
+ * @brief Specializes a formula for values that are fixed for a while, e.g. the machine settings of a printer.
+ *
+ * Reads of frozen variables are replaced by their values, conditional expressions on frozen values are reduced to the
+ * branch that is taken, and everything else that only depends on frozen values is folded (see `foldConstants`).
+ * Frozen lists and functions have no literal, so reading them directly stays in the residual, but expressions using
+ * them (`len(extruders)`, `max(machine_width, 10)`) are folded. To fold calls to builtins, layer the frozen values
+ * over `env::std_env`.
+ *
+ * Example:
+ * @code
+ * env::LocalEnvironment machine{ &env::std_env };
+ * machine.set("machine_extruder_count", std::int64_t{ 1 });
+ * auto specialized = opt::partiallyEvaluate(std::move(formula), machine);
+ * @endcode
+ */
+[[nodiscard]] PartialEvaluation partiallyEvaluate(ast::ExprPtr expr, const env::Environment& frozen);
+
+} // namespace CuraFormulaeEngine::opt
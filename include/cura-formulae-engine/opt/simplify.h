@@ -0,0 +1,37 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/expr_ptr.h"
+#include "cura-formulae-engine/opt/value_types.h"
+
+#include <cstddef>
+
+namespace CuraFormulaeEngine::opt
+{
+
+/**
+ * @brief Applies algebraic simplifications and strength reductions.
+ *
+ * Rewrites are only applied where they give exactly the same value, of the same type, and fail in the same cases as
+ * the original. Most of them depend on the type of an operand (`x * 1` is `x` for a float, but an error for a bool),
+ * which is inferred from the formula and the types of the variables in `schema` (see `expressionTypes`):
+ * - `x + 0`, `x - 0`, `x * 1`, `x / 1`, `- -x` and `not not x` become `x`, `x ** 1` becomes `x` for a float `x`, and
+ *   `0 - x` becomes `-x`;
+ * - `x / c` becomes `x * (1 / c)` if `c` is a power of two, so the reciprocal is exact;
+ * - `v ** 2` becomes `v * v` for a float variable `v`;
+ * - `True and x` and `False or x` become `x`, `False and x` and `True or x` the literal, and `x and True` and
+ *   `x or False` become `x` for a boolean `x`;
+ * - `a if True else b` becomes `a`, and `a if not c else b` becomes `b if c else a`;
+ * - `min(min(a, b), c)` becomes `min(a, b, c)`, likewise for `max`; a nested call in another position is kept, since
+ *   `min(1, min(nan, 0))` is 1 but `min(1, nan, 0)` is 0.
+ *
+ * Integer powers are left alone: `**` computes them through `double`, which `*` and the operand itself do not round.
+ * When several subexpressions of a flattened `min` or `max` fail, the error reported may be another one. `min` and
+ * `max` are assumed to be the builtins.
+ *
+ * Run after `foldConstants`, so constant operands are literals.
+ *
+ * @param simplified If set, incremented by the number of rewrites applied.
+ */
+[[nodiscard]] ast::ExprPtr simplify(ast::ExprPtr expr, const TypeSchema& schema = {}, std::size_t* simplified = nullptr);
+
+} // namespace CuraFormulaeEngine::opt
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/ast/expr_kind.h"
+#include "cura-formulae-engine/opt/value_types.h"
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace CuraFormulaeEngine::opt
+{
+
+/**
+ * @brief Gives the types a function returns for arguments of the given types; empty if every such call fails.
+ */
+using FnSignature = std::function<ValueTypes(const std::vector<ValueTypes>& args)>;
+
+using FnSignatures = std::unordered_map<std::string, FnSignature>;
+
+/**
+ * @brief The signatures of the functions in `env::std_env`.
+ */
+[[nodiscard]] const FnSignatures& builtinSignatures();
+
+/**
+ * @brief The types a binary arithmetic operator (`+`, `-`, `*`, `/`, `%` or `**`) gives for operands of the given
+ * types; empty if it fails for all of them.
+ */
+[[nodiscard]] ValueTypes arithmeticTypes(ast::ExprKind op, ValueTypes lhs, ValueTypes rhs) noexcept;
+
+/**
+ * @brief The types inferred for the nodes of a formula.
+ */
+struct TypeAnnotations
+{
+    /**
+     * @brief The types each node may evaluate to, keyed by the node (not the `ExprPtr` wrapping it). A node that
+     * always fails has no types.
+     */
+    std::unordered_map<const ast::Expr*, ValueTypes> types;
+
+    /**
+     * @brief The nodes that fail with a type mismatch whenever they are evaluated, although their operands do not
+     * always fail; calls with a number of arguments a builtin does not accept are included.
+     */
+    std::vector<const ast::Expr*> mismatches;
+
+    /**
+     * @brief The types annotated for a node, or any type for nodes that were not annotated.
+     */
+    [[nodiscard]] ValueTypes typesOf(const ast::Expr& expr) const;
+
+    /**
+     * @brief Whether evaluating a node never fails, judging by the types annotated for it and its operands; false when
+     * that is not known.
+     *
+     * @param is_defined Whether a variable is defined where the node is evaluated.
+     */
+    [[nodiscard]] bool cannotFail(const ast::Expr& expr, const std::function<bool(const std::string&)>& is_defined) const;
+};
+
+/**
+ * @brief Infers the types every node of a formula may evaluate to.
+ *
+ * Variables have the types in `schema`; names not in it have the type of their value in `env::std_env` if they are
+ * defined there, and may have any type otherwise. Calls to functions in `signatures` have the types of their
+ * signature. Results of indexing and elements of lists may have any type.
+ *
+ * The annotations are only valid while the formula is not modified.
+ *
+ * Example:
+ * @code
+ * const auto annotations = opt::inferTypes(formula, opt::TypeSchema::fromEnvironment(global_stack));
+ * if (! annotations.mismatches.empty())
+ * {
+ *     spdlog::warn("{} always fails", annotations.mismatches.front()->toString());
+ * }
+ * @endcode
+ */
+[[nodiscard]] TypeAnnotations inferTypes(const ast::Expr& expr, const TypeSchema& schema = {}, const FnSignatures& signatures = builtinSignatures());
+
+/**
+ * @brief The types a formula may evaluate to, like `inferTypes` without annotating the nodes.
+ */
+[[nodiscard]] ValueTypes expressionTypes(const ast::Expr& expr, const TypeSchema& schema = {}, const FnSignatures& signatures = builtinSignatures());
+
+} // namespace CuraFormulaeEngine::opt
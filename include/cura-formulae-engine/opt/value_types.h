@@ -0,0 +1,148 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/eval.h"
+
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <unordered_map>
+
+namespace CuraFormulaeEngine::opt
+{
+
+/**
+ * @brief The types an `eval::Value` can hold, in the order of its variant.
+ */
+enum class ValueType : std::uint8_t
+{
+    Bool,
+    Float,
+    Int,
+    String,
+    List,
+    Fn,
+    None,
+};
+
+/**
+ * @brief A set of value types, e.g. the types an expression may evaluate to.
+ */
+class ValueTypes
+{
+public:
+    constexpr ValueTypes() noexcept = default;
+
+    constexpr ValueTypes(std::initializer_list<ValueType> types) noexcept
+    {
+        for (const auto type : types)
+        {
+            bits_ |= bit(type);
+        }
+    }
+
+    /**
+     * @brief All types, for values nothing is known about.
+     */
+    [[nodiscard]] static constexpr ValueTypes any() noexcept
+    {
+        ValueTypes types;
+        types.bits_ = (1U << (static_cast<unsigned>(ValueType::None) + 1U)) - 1U;
+        return types;
+    }
+
+    [[nodiscard]] static ValueTypes of(const eval::Value& value) noexcept;
+
+    [[nodiscard]] constexpr bool empty() const noexcept
+    {
+        return bits_ == 0;
+    }
+
+    [[nodiscard]] constexpr bool contains(ValueType type) const noexcept
+    {
+        return (bits_ & bit(type)) != 0;
+    }
+
+    /**
+     * @brief Whether every type in this set is also in `other`; the empty set is a subset of every set.
+     */
+    [[nodiscard]] constexpr bool isSubsetOf(ValueTypes other) const noexcept
+    {
+        return (bits_ & ~other.bits_) == 0;
+    }
+
+    /**
+     * @brief Calls `fn` with each type in the set.
+     */
+    template<typename Fn>
+    void forEach(Fn&& fn) const
+    {
+        for (auto type = static_cast<unsigned>(ValueType::Bool); type <= static_cast<unsigned>(ValueType::None); ++type)
+        {
+            if (contains(static_cast<ValueType>(type)))
+            {
+                fn(static_cast<ValueType>(type));
+            }
+        }
+    }
+
+    /**
+     * @brief The types joined by " | ", e.g. "int | float".
+     */
+    [[nodiscard]] std::string toString() const;
+
+    constexpr ValueTypes& operator|=(ValueTypes other) noexcept
+    {
+        bits_ |= other.bits_;
+        return *this;
+    }
+
+    [[nodiscard]] friend constexpr ValueTypes operator|(ValueTypes lhs, ValueTypes rhs) noexcept
+    {
+        return lhs |= rhs;
+    }
+
+    [[nodiscard]] friend constexpr ValueTypes operator&(ValueTypes lhs, ValueTypes rhs) noexcept
+    {
+        lhs.bits_ &= rhs.bits_;
+        return lhs;
+    }
+
+    [[nodiscard]] friend constexpr bool operator==(ValueTypes lhs, ValueTypes rhs) noexcept = default;
+
+private:
+    static constexpr std::uint8_t bit(ValueType type) noexcept
+    {
+        return static_cast<std::uint8_t>(1U << static_cast<unsigned>(type));
+    }
+
+    std::uint8_t bits_{ 0 };
+};
+
+/**
+ * @brief The types variables are known to have when a formula is evaluated.
+ *
+ * In Cura every setting keeps the type of its definition, so the types of the settings can be taken from any
+ * environment holding them. Variables not in the schema may have any type.
+ */
+class TypeSchema
+{
+public:
+    TypeSchema() = default;
+
+    /**
+     * @brief A schema with the types of the current values in an environment.
+     */
+    [[nodiscard]] static TypeSchema fromEnvironment(const env::Environment& environment);
+
+    void set(const std::string& name, ValueTypes types);
+
+    [[nodiscard]] bool has(const std::string& name) const;
+
+    [[nodiscard]] ValueTypes get(const std::string& name) const;
+
+private:
+    std::unordered_map<std::string, ValueTypes> types_;
+};
+
+} // namespace CuraFormulaeEngine::opt
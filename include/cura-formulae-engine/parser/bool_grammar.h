@@ -15,13 +15,13 @@ struct BoolGrammar : lexy::token_production
     struct TrueGrammar
     {
         static constexpr auto rule = LEXY_LIT("True");
-        static constexpr auto value = lexy::callback<ast::ExprPtr>([]() { return ast::ExprPtr(std::make_unique<ast::BoolExpr>(true)); });
+        static constexpr auto value = lexy::callback<ast::ExprPtr>([]() { return ast::make_expr_ptr<ast::BoolExpr>(true); });
     };
 
     struct FalseGrammar
     {
         static constexpr auto rule = LEXY_LIT("False");
-        static constexpr auto value = lexy::callback<ast::ExprPtr>([]() { return ast::ExprPtr(std::make_unique<ast::BoolExpr>(false)); });
+        static constexpr auto value = lexy::callback<ast::ExprPtr>([]() { return ast::make_expr_ptr<ast::BoolExpr>(false); });
     };
 
     static constexpr auto rule = lexy::dsl::p<TrueGrammar> | lexy::dsl::p<FalseGrammar>;
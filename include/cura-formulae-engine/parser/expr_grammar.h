@@ -29,7 +29,7 @@ struct ExprGrammar : lexy::expression_production
     static constexpr auto value = lexy::callback<ast::ExprPtr>(
         lexy::forward<ast::ExprPtr>,
         [](ast::ExprPtr&& lhs, lexy::op<op_condition>, ast::ExprPtr&& condition, ast::ExprPtr&& rhs)
-        { return ast::ExprPtr(std::make_unique<ast::ConditionExpr>(std::move(lhs), std::move(condition), std::move(rhs))); });
+        { return ast::make_expr_ptr<ast::ConditionExpr>(std::move(lhs), std::move(condition), std::move(rhs)); });
 };
 
 } // namespace CuraFormulaeEngine::parser
@@ -43,7 +43,7 @@ struct ListComprehensionGrammar : lexy::token_production
     static constexpr auto rule = lexy::dsl::p<MathExprGrammar> + lexy::dsl::opt(lexy::dsl::p<loop>);
     static constexpr auto value = lexy::callback<ast::ExprPtr>(
         [](auto&& expr, lexy::nullopt) { return std::move(expr); },
-        [](auto&& expr, auto&& loops) { return ast::ExprPtr(std::make_unique<ast::ListComprehensionExpr>(std::move(expr), std::move(loops))); });
+        [](auto&& expr, auto&& loops) { return ast::make_expr_ptr<ast::ListComprehensionExpr>(std::move(expr), std::move(loops)); });
 };
 
 } // namespace CuraFormulaeEngine::parser
@@ -21,13 +21,13 @@ struct ListGrammar : lexy::token_production
                                           [](std::vector<ast::ExprPtr> exprs)
                                           {
                                               // special case if the list contains a single list comprehension, we evaluate it and return the result
-                                              if (exprs.size() == 1 && dynamic_cast<const ast::ListComprehensionExpr*>(exprs[0].ptr.get()) != nullptr)
+                                              if (exprs.size() == 1 && exprs[0].ptr->kind() == ast::ExprKind::ListComprehension)
                                               {
                                                   return std::move(exprs[0]);
                                               }
-                                              return ast::ExprPtr(std::make_unique<ast::ListExpr>(std::move(exprs)));
+                                              return ast::make_expr_ptr<ast::ListExpr>(std::move(exprs));
                                           },
-                                          [](lexy::nullopt = {}) { return ast::ExprPtr(std::make_unique<ast::ListExpr>(std::vector<ast::ExprPtr>{})); });
+                                          [](lexy::nullopt = {}) { return ast::make_expr_ptr<ast::ListExpr>(std::vector<ast::ExprPtr>{}); });
     };
 
     static constexpr auto rule = lexy::dsl::peek(lexy::dsl::lit_c<'['>) >> lexy::dsl::p<ListGrammarInner>;
@@ -125,12 +125,16 @@ struct MathExprGrammar : lexy::expression_production
         [](auto&& node, lexy::op<op_geq>) { node->operators.emplace_back(CuraFormulaeEngine::ast::ComparisonOperators::GreaterThenEqual); },
         [](auto&& node, lexy::op<op_not_member>) { node->operators.emplace_back(CuraFormulaeEngine::ast::ComparisonOperators::NotMember); },
         [](auto&& node, lexy::op<op_member>) { node->operators.emplace_back(CuraFormulaeEngine::ast::ComparisonOperators::Member); },
-        [](auto&& node, ast::ExprPtr&& expr) { node->expressions.emplace_back(std::move(expr)); }
+        [](auto&& node, ast::ExprPtr&& expr)
+        {
+            node->expressions.emplace_back(std::move(expr));
+            node->refreshAttributes();
+        }
     ) >> lexy::callback<ast::ExprPtr>(
         lexy::forward<ast::ExprPtr>,
         [](lexy::op<op_neg>, ast::ExprPtr&& operand) { return - std::move(operand); },
         [](lexy::op<op_not>, ast::ExprPtr&& operand) { return ! std::move(operand); },
-        [](ast::ExprPtr&& lhs, lexy::op<op_pow>, ast::ExprPtr&& rhs) { return ast::ExprPtr(std::make_unique<ast::PowExpr>(std::move(lhs), std::move(rhs))); },
+        [](ast::ExprPtr&& lhs, lexy::op<op_pow>, ast::ExprPtr&& rhs) { return ast::make_expr_ptr<ast::PowExpr>(std::move(lhs), std::move(rhs)); },
         [](ast::ExprPtr&& lhs, lexy::op<op_mul>, ast::ExprPtr&& rhs) { return std::move(lhs) * std::move(rhs); },
         [](ast::ExprPtr&& lhs, lexy::op<op_div>, ast::ExprPtr&& rhs) { return std::move(lhs) / std::move(rhs); },
         [](ast::ExprPtr&& lhs, lexy::op<op_mod>, ast::ExprPtr&& rhs) { return std::move(lhs) % std::move(rhs); },
@@ -12,7 +12,7 @@ namespace CuraFormulaeEngine::parser
 struct NoneGrammar
 {
     static constexpr auto rule = LEXY_LIT("None");
-    static constexpr auto value = lexy::callback<ast::ExprPtr>([]() { return ast::ExprPtr(std::make_unique<ast::NoneExpr>()); });
+    static constexpr auto value = lexy::callback<ast::ExprPtr>([]() { return ast::make_expr_ptr<ast::NoneExpr>(); });
 };
 
 } // namespace CuraFormulaeEngine::parser
@@ -21,9 +21,9 @@ struct NumberGrammar : lexy::token_production
             const auto number_str = std::string(number.begin(), number.end());
             if (number_str.find('.') != std::string::npos)
             {
-                return static_cast<ast::ExprPtr>(std::make_unique<ast::FloatExpr>(std::stod(number_str)));
+                return ast::make_expr_ptr<ast::FloatExpr>(std::stod(number_str));
             }
-            return static_cast<ast::ExprPtr>(std::make_unique<ast::IntExpr>(std::stod(number_str)));
+            return ast::make_expr_ptr<ast::IntExpr>(std::stod(number_str));
         });
 };
 
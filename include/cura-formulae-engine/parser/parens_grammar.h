@@ -23,9 +23,9 @@ struct ParensGrammar : lexy::token_production
                                           {
                                               return std::move(exprs[0]);
                                           }
-                                          return ast::ExprPtr(std::make_unique<ast::TupleExpr>(std::move(exprs)));
+                                          return ast::make_expr_ptr<ast::TupleExpr>(std::move(exprs));
                                       },
-                                      [](lexy::nullopt = {}) { return ast::ExprPtr(std::make_unique<ast::TupleExpr>(std::vector<ast::ExprPtr>{})); });
+                                      [](lexy::nullopt = {}) { return ast::make_expr_ptr<ast::TupleExpr>(std::vector<ast::ExprPtr>{}); });
 };
 
 } // namespace CuraFormulaeEngine::parser
@@ -14,7 +14,7 @@ struct VariableGrammar : lexy::token_production
     static constexpr auto rule = lexy::dsl::identifier(lexy::dsl::ascii::alpha_digit_underscore / lexy::dsl::lit_c<'.'>);
     static constexpr auto value = lexy::callback<ast::ExprPtr>([](const auto&& variable)
     {
-        return ast::ExprPtr(std::make_unique<ast::VariableExpr>(std::string(variable.begin(), variable.end())));
+        return ast::make_expr_ptr<ast::VariableExpr>(std::string(variable.begin(), variable.end()));
     });
 };
 
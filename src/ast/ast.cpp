@@ -1,8 +1,65 @@
 #include "cura-formulae-engine/ast/ast.h"
 
+#include "cura-formulae-engine/env/environment_batch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
 namespace CuraFormulaeEngine::env
 {
 
+namespace
+{
+
+/**
+ * Whether storing `next` over `current` changes nothing. Stricter than `deepEq`: values of different types differ, a
+ * function always differs since functions cannot be compared, and floats are compared bitwise so `0.0` to `-0.0` is a
+ * change.
+ */
+bool unchanged(const eval::Value& current, const eval::Value& next) noexcept
+{
+    if (current.value.index() != next.value.index())
+    {
+        return false;
+    }
+    return std::visit(
+        [&next]<typename T>(const T& current_alternative) -> bool
+        {
+            const auto& next_alternative = std::get<T>(next.value);
+            if constexpr (std::is_same_v<T, eval::Value::fn_t>)
+            {
+                return false;
+            }
+            else if constexpr (std::is_same_v<T, double>)
+            {
+                return std::bit_cast<std::uint64_t>(current_alternative) == std::bit_cast<std::uint64_t>(next_alternative);
+            }
+            else if constexpr (std::is_same_v<T, std::vector<eval::Value>>)
+            {
+                return std::ranges::equal(current_alternative, next_alternative, unchanged);
+            }
+            else
+            {
+                return current_alternative == next_alternative;
+            }
+        },
+        current.value);
+}
+
+} // namespace
+
+std::uint64_t EnvironmentMap::Generation::next() noexcept
+{
+    // 0 is never a generation, it marks an empty lookup cache
+    static std::atomic<std::uint64_t> last{ 0 };
+    return last.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
 std::optional<eval::Value> EnvironmentMap::get(const std::string& key) const noexcept
 {
     if (!has(key))
@@ -22,14 +79,71 @@ std::unordered_map<std::string, eval::Value> EnvironmentMap::getAll() const noex
     return environment_;
 }
 
+std::uint64_t EnvironmentMap::generation() const noexcept
+{
+    return generation_.value;
+}
+
+const eval::Value* EnvironmentMap::find(const std::string& key) const noexcept
+{
+    // the nodes of an unordered_map stay put when it rehashes, only erasing a key moves its value away
+    const auto value = environment_.find(key);
+    return value != environment_.end() ? &value->second : nullptr;
+}
+
 bool EnvironmentMap::erase(const std::string& key) noexcept
 {
-    return environment_.erase(key) > 0;
+    if (environment_.erase(key) == 0)
+    {
+        return false;
+    }
+    generation_.value = Generation::next();
+    return true;
 }
 
 void EnvironmentMap::set(const std::string& key, const eval::Value& value) noexcept
 {
     environment_.insert_or_assign(key, value);
+    generation_.value = Generation::next();
+}
+
+void EnvironmentMap::reserve(std::size_t count)
+{
+    environment_.reserve(count);
+}
+
+std::unordered_set<std::string> EnvironmentMap::apply(const EnvironmentBatch& batch)
+{
+    reserve(environment_.size() + batch.size());
+
+    std::unordered_set<std::string> changed;
+    for (const auto& [key, operation] : batch.operations())
+    {
+        if (! operation.has_value())
+        {
+            if (environment_.erase(key) > 0)
+            {
+                changed.insert(key);
+            }
+            continue;
+        }
+
+        const auto [current, inserted] = environment_.try_emplace(key, operation.value());
+        if (! inserted)
+        {
+            if (unchanged(current->second, operation.value()))
+            {
+                continue;
+            }
+            current->second = operation.value();
+        }
+        changed.insert(key);
+    }
+    if (! changed.empty())
+    {
+        generation_.value = Generation::next();
+    }
+    return changed;
 }
 
 EnvironmentMap EnvironmentMap::clone() const noexcept
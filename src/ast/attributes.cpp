@@ -0,0 +1,217 @@
+#include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/ast/dispatch.h"
+#include "cura-formulae-engine/ast/symbol.h"
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_set>
+#include <utility>
+
+namespace CuraFormulaeEngine::ast
+{
+
+namespace
+{
+
+constexpr std::size_t hashCombine(std::size_t seed, std::size_t value) noexcept
+{
+    return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6U) + (seed >> 2U));
+}
+
+std::size_t hashValue(bool value) noexcept
+{
+    return std::hash<bool>{}(value);
+}
+
+std::size_t hashValue(double value) noexcept
+{
+    // float literals are equal by their bits, see `PrimaryExpr::deepEq`
+    return std::hash<std::uint64_t>{}(std::bit_cast<std::uint64_t>(value));
+}
+
+std::size_t hashValue(std::int64_t value) noexcept
+{
+    return std::hash<std::int64_t>{}(value);
+}
+
+std::size_t hashValue(std::nullptr_t) noexcept
+{
+    return 0;
+}
+
+std::size_t hashValue(const std::string& value) noexcept
+{
+    return std::hash<std::string>{}(value);
+}
+
+SymbolSet collectFreeSymbols(const ListComprehensionExpr& list_comprehension_expr)
+{
+    // iterables only see the loop variables of the loops before them, conditions and the iterator see all
+    SymbolSet free_symbols;
+    SymbolSet local_symbols;
+    for (const auto& loop : list_comprehension_expr.loops)
+    {
+        auto iterable_symbols = loop.iterable.freeSymbols();
+        iterable_symbols.erase(local_symbols);
+        free_symbols.merge(iterable_symbols);
+
+        local_symbols.merge(loop.iterator_key.freeSymbols());
+        for (const auto& condition : loop.conditions)
+        {
+            auto condition_symbols = condition.freeSymbols();
+            condition_symbols.erase(local_symbols);
+            free_symbols.merge(condition_symbols);
+        }
+    }
+    auto iterator_symbols = list_comprehension_expr.iterator.freeSymbols();
+    iterator_symbols.erase(local_symbols);
+    free_symbols.merge(iterator_symbols);
+    return free_symbols;
+}
+
+/**
+ * Hashes what distinguishes two nodes of the same kind apart from their children.
+ */
+std::size_t hashPayload(const Expr& expr) noexcept
+{
+    switch (expr.kind())
+    {
+    case ExprKind::Bool:
+        return hashValue(static_cast<const PrimaryExpr<bool>&>(expr).value);
+    case ExprKind::Float:
+        return hashValue(static_cast<const PrimaryExpr<double>&>(expr).value);
+    case ExprKind::Int:
+        return hashValue(static_cast<const PrimaryExpr<std::int64_t>&>(expr).value);
+    case ExprKind::None:
+        return hashValue(nullptr);
+    case ExprKind::String:
+        return hashValue(static_cast<const PrimaryExpr<std::string>&>(expr).value);
+    case ExprKind::Variable:
+        return hashValue(static_cast<const VariableExpr&>(expr).name);
+    case ExprKind::ComparisonChain:
+    {
+        std::size_t hash = 0;
+        for (const auto op : static_cast<const ComparisonChainExpr&>(expr).operators)
+        {
+            hash = hashCombine(hash, static_cast<std::size_t>(op));
+        }
+        return hash;
+    }
+    case ExprKind::Slice:
+    {
+        const auto& slice_expr = static_cast<const SliceExpr&>(expr);
+        return static_cast<std::size_t>(slice_expr.start_index.has_value()) | static_cast<std::size_t>(slice_expr.end_index.has_value()) << 1U
+             | static_cast<std::size_t>(slice_expr.step_size.has_value()) << 2U;
+    }
+    case ExprKind::Let:
+        return hashValue(static_cast<const LetExpr&>(expr).name);
+    case ExprKind::ListComprehension:
+    {
+        std::size_t hash = 0;
+        for (const auto& loop : static_cast<const ListComprehensionExpr&>(expr).loops)
+        {
+            hash = hashCombine(hash, loop.conditions.size());
+        }
+        return hash;
+    }
+    default:
+        return 0;
+    }
+}
+
+} // namespace
+
+std::unordered_set<std::string> Expr::freeVariables() const
+{
+    return freeSymbols().names();
+}
+
+const SymbolSet& Expr::freeSymbols() const noexcept
+{
+    if (kind_ == ExprKind::Ptr)
+    {
+        if (const auto& expr_ptr = static_cast<const ExprPtr&>(*this); expr_ptr.ptr != nullptr)
+        {
+            return expr_ptr.ptr->freeSymbols();
+        }
+    }
+    return free_symbols_;
+}
+
+std::size_t Expr::structuralHash() const noexcept
+{
+    if (kind_ == ExprKind::Ptr)
+    {
+        if (const auto& expr_ptr = static_cast<const ExprPtr&>(*this); expr_ptr.ptr != nullptr)
+        {
+            return expr_ptr.ptr->structuralHash();
+        }
+    }
+    return structural_hash_;
+}
+
+void Expr::refreshAttributes()
+{
+    if (kind_ == ExprKind::Ptr || kind_ == ExprKind::Flat)
+    {
+        // an ExprPtr has no attributes of its own and a FlatExpr cannot change
+        return;
+    }
+
+    auto hash = hashCombine(static_cast<std::size_t>(kind_), hashPayload(*this));
+    SymbolSet free_symbols;
+    const auto add_child = [&hash, &free_symbols](const ExprPtr& child)
+    {
+        hash = hashCombine(hash, child.structuralHash());
+        free_symbols.merge(child.freeSymbols());
+    };
+
+    // literals and operators refresh from the constructor of their base, before the concrete node exists
+    if (kind_ == ExprKind::Neg || kind_ == ExprKind::Not)
+    {
+        add_child(static_cast<const UnaryExpr&>(*this).operand);
+    }
+    else if (kind_ >= ExprKind::Add && kind_ <= ExprKind::Or)
+    {
+        const auto& binary_expr = static_cast<const BinaryExpr&>(*this);
+        add_child(binary_expr.lhs);
+        add_child(binary_expr.rhs);
+    }
+    else if (kind_ == ExprKind::Variable)
+    {
+        auto& variable_expr = static_cast<VariableExpr&>(*this);
+        free_symbols = SymbolSet{ intern(variable_expr.name) };
+        variable_expr.lookup_cache.clear();
+    }
+    else if (kind_ > ExprKind::Variable)
+    {
+        forEachChild(*this, add_child);
+        if (kind_ == ExprKind::ListComprehension)
+        {
+            free_symbols = collectFreeSymbols(static_cast<const ListComprehensionExpr&>(*this));
+        }
+        else if (kind_ == ExprKind::ComparisonChain)
+        {
+            static_cast<ComparisonChainExpr&>(*this).refreshConstantSets();
+        }
+        else if (kind_ == ExprKind::Fused)
+        {
+            static_cast<FusedExpr&>(*this).refreshShape();
+        }
+        else if (kind_ == ExprKind::Let)
+        {
+            // the name is only bound in the body
+            const auto& let_expr = static_cast<const LetExpr&>(*this);
+            free_symbols = let_expr.value.freeSymbols();
+            auto body_symbols = let_expr.body.freeSymbols();
+            body_symbols.erase(SymbolSet{ intern(let_expr.name) });
+            free_symbols.merge(body_symbols);
+        }
+    }
+    setAttributes(std::move(free_symbols), hash);
+}
+
+} // namespace CuraFormulaeEngine::ast
@@ -24,6 +24,12 @@ namespace CuraFormulaeEngine::ast
     }
     auto lhs_eval = lhs_result.value();
 
+    // `and` and `or` only evaluate the right operand if the left one does not decide the result
+    if ((kind() == ExprKind::And && ! lhs_eval.isTruthy()) || (kind() == ExprKind::Or && lhs_eval.isTruthy()))
+    {
+        return lhs_eval;
+    }
+
     const auto rhs_result = rhs.evaluate(environment);
     if (! rhs_result.has_value())
     {
@@ -34,17 +40,9 @@ namespace CuraFormulaeEngine::ast
     return evaluate(lhs_eval, rhs_eval);
 }
 
-[[nodiscard]] std::unordered_set<std::string> BinaryExpr::freeVariables() const noexcept
-{
-    auto lhs_free_variables = lhs.freeVariables();
-    auto rhs_free_variables = rhs.freeVariables();
-    lhs_free_variables.insert(rhs_free_variables.begin(), rhs_free_variables.end());
-    return lhs_free_variables;
-}
-
 [[nodiscard]] bool BinaryExpr::deepEq(const Expr& other) const noexcept
 {
-    if (typeid(*this) != typeid(other))
+    if (kind() != other.kind())
     {
         return false;
     }
@@ -52,12 +50,4 @@ namespace CuraFormulaeEngine::ast
     return lhs.deepEq(other_binary_expr.lhs) && rhs.deepEq(other_binary_expr.rhs);
 }
 
-void BinaryExpr::visitAll(std::function<void(const Expr&)> visitor) const noexcept
-{
-    visitor(*this);
-
-    lhs.visitAll(visitor);
-    rhs.visitAll(visitor);
-}
-
 } // namespace CuraFormulaeEngine::ast
@@ -47,6 +47,53 @@ namespace CuraFormulaeEngine::ast
     return result;
 }
 
+eval::Result compare(ComparisonOperators comparison_operator, const eval::Value& lhs, const eval::Value& rhs) noexcept
+{
+    switch (comparison_operator)
+    {
+    case Equals:
+        return lhs == rhs;
+    case NotEquals:
+        return !(lhs == rhs);
+    case LessThan:
+        return lhs < rhs;
+    case GreaterThan:
+        return lhs > rhs;
+    case LessThenEqual:
+        return lhs <= rhs;
+    case GreaterThenEqual:
+        return lhs >= rhs;
+    case Member:
+    case NotMember:
+        if (!std::holds_alternative<std::vector<eval::Value>>(rhs.value))
+        {
+            return zeus::unexpected(eval::Error::TypeMismatch);
+        }
+
+        for (const auto& item : std::get<std::vector<eval::Value>>(rhs.value))
+        {
+            if (lhs == item)
+            {
+                return comparison_operator == Member;
+            }
+        }
+        return comparison_operator == NotMember;
+    }
+    return zeus::unexpected(eval::Error::TypeMismatch);
+}
+
+void ComparisonChainExpr::refreshConstantSets()
+{
+    constant_sets.assign(operators.size(), nullptr);
+    for (std::size_t i = 0; i < operators.size() && i + 1 < expressions.size(); ++i)
+    {
+        if (operators[i] == Member || operators[i] == NotMember)
+        {
+            constant_sets[i] = ConstantSet::of(expressions[i + 1]);
+        }
+    }
+}
+
 [[nodiscard]] eval::Result ComparisonChainExpr::evaluate(const env::Environment* environment) const noexcept
 {
     assert(expressions.size() == operators.size() + 1);
@@ -60,61 +107,27 @@ namespace CuraFormulaeEngine::ast
 
     for (size_t i = 0; i < operators.size(); i ++)
     {
-        const auto right_value_result = expressions[i + 1].evaluate(environment);
-        if (!right_value_result.has_value())
-        {
-            return zeus::unexpected(right_value_result.error());
-        }
-       const auto& right_value = right_value_result.value();
-
-        eval::Result comparison_result;
-        switch (operators[i])
+        if (i < constant_sets.size() && constant_sets[i] != nullptr)
         {
-        case Equals:
-            comparison_result = left_value == right_value;
-            break;
-        case NotEquals:
-            comparison_result = !(left_value == right_value);
-            break;
-        case LessThan:
-            comparison_result = left_value < right_value;
-            break;
-        case GreaterThan:
-            comparison_result = left_value > right_value;
-            break;
-        case LessThenEqual:
-            comparison_result = left_value_result.value() <= right_value_result.value();
-            break;
-        case GreaterThenEqual:
-            comparison_result = left_value_result.value() >= right_value_result.value();
-            break;
-        case Member:
-        case NotMember:
-            if (!right_value_result.has_value())
+            if (constant_sets[i]->contains(left_value) != (operators[i] == Member))
             {
-                return zeus::unexpected(right_value_result.error());
+                return false;
             }
-
-            const auto& rhs_value = right_value_result.value();
-            if (!std::holds_alternative<std::vector<eval::Value>>(rhs_value.value))
+            if (i + 1 < operators.size())
             {
-                return zeus::unexpected(eval::Error::TypeMismatch);
+                left_value = constant_sets[i]->list();
             }
+            continue;
+        }
 
-            comparison_result = operators[i] == NotMember;
-
-            const auto& list = std::get<std::vector<eval::Value>>(rhs_value.value);
-            for (const auto& item : list)
-            {
-                if (left_value == item)
-                {
-                    comparison_result = operators[i] == Member;
-                    break;
-                }
-            }
-            break;
+        const auto right_value_result = expressions[i + 1].evaluate(environment);
+        if (!right_value_result.has_value())
+        {
+            return zeus::unexpected(right_value_result.error());
         }
+       const auto& right_value = right_value_result.value();
 
+        const auto comparison_result = compare(operators[i], left_value, right_value);
         if (!comparison_result.has_value())
         {
             return zeus::unexpected(comparison_result.error());
@@ -131,20 +144,9 @@ namespace CuraFormulaeEngine::ast
     return true;
 }
 
-[[nodiscard]] std::unordered_set<std::string> ComparisonChainExpr::freeVariables() const noexcept
-{
-    std::unordered_set<std::string> free_vars;
-    for (const auto& expr : expressions)
-    {
-        const auto expr_free_vars = expr.freeVariables();
-        free_vars.insert(expr_free_vars.begin(), expr_free_vars.end());
-    }
-    return free_vars;
-}
-
 [[nodiscard]] bool ComparisonChainExpr::deepEq(const Expr& other) const noexcept
 {
-    if (const auto other_comp_chain_expr = dynamic_cast<const ComparisonChainExpr*>(&other))
+    if (const auto other_comp_chain_expr = other.kind() == ExprKind::ComparisonChain ? static_cast<const ComparisonChainExpr*>(&other) : nullptr)
     {
         if (operators.size() != other_comp_chain_expr->operators.size() || expressions.size() != other_comp_chain_expr->expressions.size())
         {
@@ -169,16 +171,6 @@ namespace CuraFormulaeEngine::ast
     return false;
 }
 
-void ComparisonChainExpr::visitAll(std::function<void(const Expr&)> visitor) const noexcept
-{
-    visitor(*this);
-
-    for (const auto& expr : expressions)
-    {
-        expr.visitAll(visitor);
-    }
-}
-
 } // namespace CuraFormulaeEngine::ast
 
 CuraFormulaeEngine::ast::ExprPtr operator==(CuraFormulaeEngine::ast::ExprPtr lhs, CuraFormulaeEngine::ast::ExprPtr rhs)
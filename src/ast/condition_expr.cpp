@@ -31,19 +31,9 @@ namespace CuraFormulaeEngine::ast
     return else_expr.evaluate(environment);
 }
 
-[[nodiscard]] std::unordered_set<std::string> ConditionExpr::freeVariables() const noexcept
-{
-    auto condition_vars = condition.freeVariables();
-    auto then_vars = then_expr.freeVariables();
-    auto else_vars = else_expr.freeVariables();
-    condition_vars.insert(then_vars.begin(), then_vars.end());
-    condition_vars.insert(else_vars.begin(), else_vars.end());
-    return condition_vars;
-}
-
 [[nodiscard]] bool ConditionExpr::deepEq(const Expr& other) const noexcept
 {
-    if (const auto other_condition_expr = dynamic_cast<const ConditionExpr*>(&other))
+    if (const auto other_condition_expr = other.kind() == ExprKind::Condition ? static_cast<const ConditionExpr*>(&other) : nullptr)
     {
         // clang-format off
         return then_expr.deepEq(other_condition_expr->then_expr)
@@ -54,13 +44,4 @@ namespace CuraFormulaeEngine::ast
     return false;
 }
 
-void ConditionExpr::visitAll(std::function<void(const Expr&)> visitor) const noexcept
-{
-    visitor(*this);
-
-    then_expr.visitAll(visitor);
-    condition.visitAll(visitor);
-    else_expr.visitAll(visitor);
-}
-
 } // namespace CuraFormulaeEngine::ast
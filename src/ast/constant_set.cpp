@@ -0,0 +1,114 @@
+#include "cura-formulae-engine/ast/constant_set.h"
+
+#include "cura-formulae-engine/ast/expr_ptr.h"
+#include "cura-formulae-engine/ast/list_expr.h"
+#include "cura-formulae-engine/ast/tuple_expr.h"
+#include "cura-formulae-engine/ast/unary_expr/unary_expr.h"
+
+#include <algorithm>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace CuraFormulaeEngine::ast
+{
+
+namespace
+{
+
+const Expr& unwrap(const Expr& expr) noexcept
+{
+    const auto* node = &expr;
+    while (node->kind() == ExprKind::Ptr)
+    {
+        node = static_cast<const ExprPtr*>(node)->ptr.get();
+    }
+    return *node;
+}
+
+bool isConstant(const Expr& expr) noexcept
+{
+    const auto& node = unwrap(expr);
+    if (node.kind() == ExprKind::Neg)
+    {
+        const auto& operand = unwrap(static_cast<const UnaryExpr&>(node).operand);
+        return operand.kind() == ExprKind::Int || operand.kind() == ExprKind::Float;
+    }
+    return node.kind() <= ExprKind::String;
+}
+
+} // namespace
+
+std::shared_ptr<const ConstantSet> ConstantSet::of(const Expr& expr)
+{
+    const auto& node = unwrap(expr);
+    const std::vector<ExprPtr>* elements = nullptr;
+    if (node.kind() == ExprKind::List)
+    {
+        elements = &static_cast<const ListExpr&>(node).elements;
+    }
+    else if (node.kind() == ExprKind::Tuple)
+    {
+        elements = &static_cast<const TupleExpr&>(node).elements;
+    }
+    if (elements == nullptr || ! std::all_of(elements->begin(), elements->end(), [](const ExprPtr& element) { return isConstant(element); }))
+    {
+        return nullptr;
+    }
+
+    // literals read no variables and cannot fail
+    auto list = node.evaluate(nullptr);
+    if (! list.has_value())
+    {
+        return nullptr;
+    }
+    return std::shared_ptr<const ConstantSet>(new ConstantSet(std::move(list.value())));
+}
+
+ConstantSet::ConstantSet(eval::Value list)
+    : list_(std::move(list))
+{
+    for (const auto& element : std::get<std::vector<eval::Value>>(list_.value))
+    {
+        if (std::holds_alternative<std::string>(element.value))
+        {
+            strings_.insert(std::get<std::string>(element.value));
+        }
+        else if (std::holds_alternative<std::int64_t>(element.value) || std::holds_alternative<bool>(element.value))
+        {
+            const auto integer = std::holds_alternative<std::int64_t>(element.value) ? std::get<std::int64_t>(element.value) : std::int64_t{ std::get<bool>(element.value) };
+            integers_.insert(integer);
+            integers_as_floats_.insert(static_cast<double>(integer));
+        }
+        else if (std::holds_alternative<double>(element.value))
+        {
+            floats_.insert(std::get<double>(element.value));
+        }
+    }
+}
+
+bool ConstantSet::contains(const eval::Value& value) const noexcept
+{
+    if (std::holds_alternative<std::string>(value.value))
+    {
+        return strings_.contains(std::get<std::string>(value.value));
+    }
+    if (std::holds_alternative<std::int64_t>(value.value) || std::holds_alternative<bool>(value.value))
+    {
+        const auto integer = std::holds_alternative<std::int64_t>(value.value) ? std::get<std::int64_t>(value.value) : std::int64_t{ std::get<bool>(value.value) };
+        return integers_.contains(integer) || floats_.contains(static_cast<double>(integer));
+    }
+    if (std::holds_alternative<double>(value.value))
+    {
+        const auto number = std::get<double>(value.value);
+        return floats_.contains(number) || integers_as_floats_.contains(number);
+    }
+    return false;
+}
+
+const eval::Value& ConstantSet::list() const noexcept
+{
+    return list_;
+}
+
+} // namespace CuraFormulaeEngine::ast
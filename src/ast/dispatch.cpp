@@ -0,0 +1,64 @@
+#include "cura-formulae-engine/ast/dispatch.h"
+
+#include <type_traits>
+
+namespace CuraFormulaeEngine::ast
+{
+
+eval::Result evaluate(const Expr& expr, const env::Environment* environment) noexcept
+{
+    return dispatch(
+        expr,
+        [environment]<typename T>(const T& node)
+        {
+            // the operator nodes overload evaluate for their operands, which hides the environment overload
+            if constexpr (std::is_base_of_v<UnaryExpr, T>)
+            {
+                return static_cast<const UnaryExpr&>(node).evaluate(environment);
+            }
+            else if constexpr (std::is_base_of_v<BinaryExpr, T>)
+            {
+                return static_cast<const BinaryExpr&>(node).evaluate(environment);
+            }
+            else
+            {
+                return node.evaluate(environment);
+            }
+        });
+}
+
+bool equal(const Expr& lhs, const Expr& rhs) noexcept
+{
+    if (lhs.kind() == ExprKind::Ptr)
+    {
+        return equal(*static_cast<const ExprPtr&>(lhs).ptr, rhs);
+    }
+    if (rhs.kind() == ExprKind::Ptr)
+    {
+        return equal(lhs, *static_cast<const ExprPtr&>(rhs).ptr);
+    }
+    if (&lhs == &rhs)
+    {
+        return true;
+    }
+    if (lhs.structuralHash() != rhs.structuralHash())
+    {
+        return false;
+    }
+    // trees do not know about flattened expressions, let the flattened side compare
+    if (lhs.kind() == ExprKind::Flat)
+    {
+        return lhs.deepEq(rhs);
+    }
+    if (rhs.kind() == ExprKind::Flat)
+    {
+        return rhs.deepEq(lhs);
+    }
+    if (lhs.kind() != rhs.kind())
+    {
+        return false;
+    }
+    return dispatch(lhs, [&rhs](const auto& node) { return node.deepEq(rhs); });
+}
+
+} // namespace CuraFormulaeEngine::ast
@@ -0,0 +1,61 @@
+#include "cura-formulae-engine/ast/expr_corpus.h"
+
+#include "cura-formulae-engine/ast/dispatch.h"
+#include "cura-formulae-engine/ast/visitor.h"
+
+namespace CuraFormulaeEngine::ast
+{
+
+ExprPtr ExprCorpus::add(ExprPtr formula)
+{
+    // bottom up, so the children of a node are already shared when the node is looked up
+    struct Interner
+    {
+        ExprCorpus& corpus;
+
+        void leave(ExprPtr& node)
+        {
+            corpus.intern(node);
+        }
+    };
+
+    rewrite(formula, Interner{ *this });
+    return formula;
+}
+
+void ExprCorpus::intern(ExprPtr& node)
+{
+    const auto hash = node.structuralHash();
+    const auto [first, last] = nodes_.equal_range(hash);
+    for (auto candidate = first; candidate != last; ++candidate)
+    {
+        if (equal(*candidate->second, *node.ptr))
+        {
+            if (candidate->second != node.ptr)
+            {
+                node.ptr = candidate->second;
+                ++shared_count_;
+            }
+            return;
+        }
+    }
+    nodes_.emplace(hash, node.ptr);
+}
+
+std::size_t ExprCorpus::size() const noexcept
+{
+    return nodes_.size();
+}
+
+std::size_t ExprCorpus::sharedCount() const noexcept
+{
+    return shared_count_;
+}
+
+void ExprCorpus::clear() noexcept
+{
+    nodes_.clear();
+    shared_count_ = 0;
+}
+
+} // namespace CuraFormulaeEngine::ast
@@ -1,20 +1,117 @@
 #include "cura-formulae-engine/ast/expr_ptr.h"
+#include "cura-formulae-engine/ast/dispatch.h"
 #include "cura-formulae-engine/ast/index_expr.h"
 
+#include <memory>
+#include <optional>
 #include <string>
+#include <type_traits>
 #include <unordered_set>
+#include <vector>
 
 namespace CuraFormulaeEngine::ast
 {
 
-eval::Result ExprPtr::evaluate(const env::Environment* environment) const noexcept
+namespace
+{
+
+std::vector<ExprPtr> shareAll(const std::vector<ExprPtr>& exprs)
+{
+    std::vector<ExprPtr> shared;
+    shared.reserve(exprs.size());
+    for (const auto& expr : exprs)
+    {
+        shared.push_back(expr.share());
+    }
+    return shared;
+}
+
+std::optional<ExprPtr> shareOptional(const std::optional<ExprPtr>& expr)
 {
-    return ptr->evaluate(environment);
+    return expr.has_value() ? std::optional<ExprPtr>(expr->share()) : std::nullopt;
 }
 
-std::unordered_set<std::string> ExprPtr::freeVariables() const noexcept
+} // namespace
+
+ExprPtr ExprPtr::copy() const
+{
+    return dispatch(
+        *ptr,
+        []<typename T>(const T& node) -> ExprPtr
+        {
+            if constexpr (std::is_base_of_v<UnaryExpr, T>)
+            {
+                return make_expr_ptr<T>(node.operand.share());
+            }
+            else if constexpr (std::is_base_of_v<BinaryExpr, T>)
+            {
+                return make_expr_ptr<T>(node.lhs.share(), node.rhs.share());
+            }
+            else if constexpr (std::is_same_v<T, NoneExpr>)
+            {
+                return make_expr_ptr<NoneExpr>();
+            }
+            else if constexpr (std::is_same_v<T, BoolExpr> || std::is_same_v<T, FloatExpr> || std::is_same_v<T, IntExpr> || std::is_same_v<T, StringExpr>)
+            {
+                return make_expr_ptr<T>(node.value);
+            }
+            else if constexpr (std::is_same_v<T, VariableExpr>)
+            {
+                return make_expr_ptr<VariableExpr>(node.name);
+            }
+            else if constexpr (std::is_same_v<T, ComparisonChainExpr>)
+            {
+                return make_expr_ptr<ComparisonChainExpr>(shareAll(node.expressions), std::vector<ComparisonOperators>(node.operators));
+            }
+            else if constexpr (std::is_same_v<T, ConditionExpr>)
+            {
+                return make_expr_ptr<ConditionExpr>(node.then_expr.share(), node.condition.share(), node.else_expr.share());
+            }
+            else if constexpr (std::is_same_v<T, FnApplicationExpr>)
+            {
+                return make_expr_ptr<FnApplicationExpr>(node.fn.share(), shareAll(node.args));
+            }
+            else if constexpr (std::is_same_v<T, IndexExpr>)
+            {
+                return make_expr_ptr<IndexExpr>(node.array.share(), node.index.share());
+            }
+            else if constexpr (std::is_same_v<T, SliceExpr>)
+            {
+                return make_expr_ptr<SliceExpr>(node.array.share(), shareOptional(node.start_index), shareOptional(node.end_index), shareOptional(node.step_size));
+            }
+            else if constexpr (std::is_same_v<T, ListExpr> || std::is_same_v<T, TupleExpr>)
+            {
+                return make_expr_ptr<T>(shareAll(node.elements));
+            }
+            else if constexpr (std::is_same_v<T, ListComprehensionExpr>)
+            {
+                std::vector<ListComprehensionExpr::loop> loops;
+                loops.reserve(node.loops.size());
+                for (const auto& loop : node.loops)
+                {
+                    loops.emplace_back(loop.iterator_key.share(), loop.iterable.share(), shareAll(loop.conditions));
+                }
+                return make_expr_ptr<ListComprehensionExpr>(node.iterator.share(), std::move(loops));
+            }
+            else if constexpr (std::is_same_v<T, LetExpr>)
+            {
+                return make_expr_ptr<LetExpr>(node.name, node.value.share(), node.body.share());
+            }
+            else if constexpr (std::is_same_v<T, FusedExpr>)
+            {
+                return make_expr_ptr<FusedExpr>(node.original.share());
+            }
+            else
+            {
+                static_assert(std::is_same_v<T, FlatExpr>);
+                return make_expr_ptr<FlatExpr>(node);
+            }
+        });
+}
+
+eval::Result ExprPtr::evaluate(const env::Environment* environment) const noexcept
 {
-    return ptr->freeVariables();
+    return ast::evaluate(*ptr, environment);
 }
 
 std::string ExprPtr::toString() const noexcept
@@ -24,17 +121,11 @@ std::string ExprPtr::toString() const noexcept
 
 bool ExprPtr::deepEq(const Expr& other) const noexcept
 {
-    if (const auto& other_ptr = dynamic_cast<const ExprPtr*>(&other))
+    if (other.kind() != ExprKind::Ptr)
     {
-        return ptr->deepEq(*other_ptr->ptr);
+        return false;
     }
-    return false;
-}
-
-void ExprPtr::visitAll(std::function<void(const Expr&)> visitor) const noexcept
-{
-    visitor(*this);
-    ptr->visitAll(visitor);
+    return equal(*ptr, *static_cast<const ExprPtr&>(other).ptr);
 }
 
 } // namespace CuraFormulaeEngine::ast
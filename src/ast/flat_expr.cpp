@@ -0,0 +1,1271 @@
+#include "cura-formulae-engine/ast/flat_expr.h"
+
+#include "cura-formulae-engine/ast/binary_expr/add_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/and_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/div_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/mod_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/mul_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/or_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/pow_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/sub_expr.h"
+#include "cura-formulae-engine/ast/condition_expr.h"
+#include "cura-formulae-engine/ast/fn_application_expr.h"
+#include "cura-formulae-engine/ast/fused_expr.h"
+#include "cura-formulae-engine/ast/index_expr.h"
+#include "cura-formulae-engine/ast/let_expr.h"
+#include "cura-formulae-engine/ast/list_comprehension_expr.h"
+#include "cura-formulae-engine/ast/list_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/bool_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/float_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/int_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/none_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/string_expr.h"
+#include "cura-formulae-engine/ast/slice_expr.h"
+#include "cura-formulae-engine/ast/tuple_expr.h"
+#include "cura-formulae-engine/ast/unary_expr/neg_expr.h"
+#include "cura-formulae-engine/ast/unary_expr/not_expr.h"
+#include "cura-formulae-engine/ast/variable_expr.h"
+
+#include <zeus/expected.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_set>
+#include <variant>
+#include <vector>
+
+namespace CuraFormulaeEngine::ast
+{
+
+namespace
+{
+
+/*
+ * u64 structural hash, u32 counts of the nodes, children, constants, names, operators, loop table and free symbols,
+ * followed by the arrays in that order. A node is u8 kind, 3 zero bytes, u32 payload, first child and child count. A
+ * constant is its u8 kind and value, a string or name a u32 length and its bytes, an operator a u8 operator and a u8
+ * telling whether its comparison had a constant set. Free symbols are indices into the names.
+ */
+template<typename T>
+void put(std::string& buffer, const T& value)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void putString(std::string& buffer, const std::string& value)
+{
+    put(buffer, static_cast<std::uint32_t>(value.size()));
+    buffer.append(value);
+}
+
+/**
+ * @brief Bounds checked reading of an encoded formula.
+ */
+class Reader
+{
+public:
+    explicit Reader(std::span<const std::byte> bytes) noexcept
+        : bytes_(bytes)
+    {
+    }
+
+    [[nodiscard]] bool done() const noexcept
+    {
+        return bytes_.empty();
+    }
+
+    [[nodiscard]] bool skip(std::size_t count) noexcept
+    {
+        if (bytes_.size() < count)
+        {
+            return false;
+        }
+        bytes_ = bytes_.subspan(count);
+        return true;
+    }
+
+    template<typename T>
+    [[nodiscard]] std::optional<T> take() noexcept
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (bytes_.size() < sizeof(T))
+        {
+            return std::nullopt;
+        }
+        T value;
+        std::memcpy(&value, bytes_.data(), sizeof(T));
+        bytes_ = bytes_.subspan(sizeof(T));
+        return value;
+    }
+
+    [[nodiscard]] std::optional<std::string> takeString() noexcept
+    {
+        const auto length = take<std::uint32_t>();
+        if (! length.has_value() || length.value() > bytes_.size())
+        {
+            return std::nullopt;
+        }
+        std::string value(reinterpret_cast<const char*>(bytes_.data()), length.value());
+        bytes_ = bytes_.subspan(length.value());
+        return value;
+    }
+
+    /**
+     * @brief Reads `count` values of `T` into `values` at once.
+     */
+    template<typename T>
+    [[nodiscard]] bool takeArray(std::vector<T>& values, std::size_t count) noexcept
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (count > bytes_.size() / sizeof(T))
+        {
+            return false;
+        }
+        values.resize(count);
+        std::memcpy(values.data(), bytes_.data(), count * sizeof(T));
+        bytes_ = bytes_.subspan(count * sizeof(T));
+        return true;
+    }
+
+private:
+    std::span<const std::byte> bytes_;
+};
+
+} // namespace
+
+FlatExpr FlatExpr::flatten(const Expr& expr)
+{
+    FlatExpr flat;
+    flat.append(expr);
+
+    flat.setAttributes(expr.freeSymbols(), expr.structuralHash());
+    return flat;
+}
+
+FlatExpr::index_t FlatExpr::root() const noexcept
+{
+    return static_cast<index_t>(nodes_.size() - 1);
+}
+
+const std::vector<FlatExpr::Node>& FlatExpr::nodes() const noexcept
+{
+    return nodes_;
+}
+
+std::span<const FlatExpr::index_t> FlatExpr::children(index_t node) const noexcept
+{
+    const auto& flat_node = nodes_[node];
+    return std::span<const index_t>(children_).subspan(flat_node.first_child, flat_node.child_count);
+}
+
+FlatExpr::index_t FlatExpr::appendNode(ExprKind kind, index_t payload, const std::vector<index_t>& children)
+{
+    if (nodes_.size() >= std::numeric_limits<index_t>::max() || children_.size() + children.size() >= std::numeric_limits<index_t>::max())
+    {
+        throw std::length_error("expression too large to flatten");
+    }
+
+    nodes_.push_back(Node{ .kind = kind, .payload = payload, .first_child = static_cast<index_t>(children_.size()), .child_count = static_cast<index_t>(children.size()) });
+    children_.insert(children_.end(), children.begin(), children.end());
+    return static_cast<index_t>(nodes_.size() - 1);
+}
+
+FlatExpr::index_t FlatExpr::append(const Expr& expr)
+{
+    const auto constant = [this](ExprKind kind, eval::Value value)
+    {
+        constants_.push_back(std::move(value));
+        return appendNode(kind, static_cast<index_t>(constants_.size() - 1), {});
+    };
+    const auto binary = [this](ExprKind kind, const BinaryExpr& binary_expr)
+    {
+        const auto lhs = append(binary_expr.lhs);
+        const auto rhs = append(binary_expr.rhs);
+        return appendNode(kind, 0, { lhs, rhs });
+    };
+    const auto name_index = [this](const std::string& name)
+    {
+        auto pooled = std::ranges::find(names_, name);
+        if (pooled == names_.end())
+        {
+            pooled = names_.insert(names_.end(), name);
+        }
+        return static_cast<index_t>(pooled - names_.begin());
+    };
+    const auto sequence = [this](ExprKind kind, const std::vector<ExprPtr>& elements)
+    {
+        std::vector<index_t> children;
+        children.reserve(elements.size());
+        for (const auto& element : elements)
+        {
+            children.push_back(append(element));
+        }
+        return appendNode(kind, 0, children);
+    };
+
+    switch (expr.kind())
+    {
+    case ExprKind::Ptr:
+        return append(*static_cast<const ExprPtr&>(expr).ptr);
+    case ExprKind::Flat:
+        return append(static_cast<const FlatExpr&>(expr).toExpr());
+    case ExprKind::Fused:
+        // flat formulas evaluate the nodes of the shape one by one
+        return append(static_cast<const FusedExpr&>(expr).original);
+    case ExprKind::Bool:
+        return constant(ExprKind::Bool, static_cast<const BoolExpr&>(expr).value);
+    case ExprKind::Float:
+        return constant(ExprKind::Float, static_cast<const FloatExpr&>(expr).value);
+    case ExprKind::Int:
+        return constant(ExprKind::Int, static_cast<const IntExpr&>(expr).value);
+    case ExprKind::None:
+        return constant(ExprKind::None, nullptr);
+    case ExprKind::String:
+        return constant(ExprKind::String, static_cast<const StringExpr&>(expr).value);
+    case ExprKind::Variable:
+        return appendNode(ExprKind::Variable, name_index(static_cast<const VariableExpr&>(expr).name), {});
+    case ExprKind::Neg:
+    case ExprKind::Not:
+        return appendNode(expr.kind(), 0, { append(static_cast<const UnaryExpr&>(expr).operand) });
+    case ExprKind::Add:
+    case ExprKind::Sub:
+    case ExprKind::Mul:
+    case ExprKind::Div:
+    case ExprKind::Mod:
+    case ExprKind::Pow:
+    case ExprKind::And:
+    case ExprKind::Or:
+        return binary(expr.kind(), static_cast<const BinaryExpr&>(expr));
+    case ExprKind::ComparisonChain:
+    {
+        const auto& comparison_chain_expr = static_cast<const ComparisonChainExpr&>(expr);
+        const auto operators = static_cast<index_t>(operators_.size());
+        operators_.insert(operators_.end(), comparison_chain_expr.operators.begin(), comparison_chain_expr.operators.end());
+        constant_sets_.insert(constant_sets_.end(), comparison_chain_expr.constant_sets.begin(), comparison_chain_expr.constant_sets.end());
+        constant_sets_.resize(operators_.size());
+        auto node = sequence(ExprKind::ComparisonChain, comparison_chain_expr.expressions);
+        nodes_[node].payload = operators;
+        return node;
+    }
+    case ExprKind::Condition:
+    {
+        const auto& condition_expr = static_cast<const ConditionExpr&>(expr);
+        const auto then_expr = append(condition_expr.then_expr);
+        const auto condition = append(condition_expr.condition);
+        const auto else_expr = append(condition_expr.else_expr);
+        return appendNode(ExprKind::Condition, 0, { then_expr, condition, else_expr });
+    }
+    case ExprKind::FnApplication:
+    {
+        const auto& fn_application_expr = static_cast<const FnApplicationExpr&>(expr);
+        std::vector<index_t> children{ append(fn_application_expr.fn) };
+        for (const auto& arg : fn_application_expr.args)
+        {
+            children.push_back(append(arg));
+        }
+        return appendNode(ExprKind::FnApplication, 0, children);
+    }
+    case ExprKind::Index:
+    {
+        const auto& index_expr = static_cast<const IndexExpr&>(expr);
+        const auto array = append(index_expr.array);
+        const auto index = append(index_expr.index);
+        return appendNode(ExprKind::Index, 0, { array, index });
+    }
+    case ExprKind::Slice:
+    {
+        const auto& slice_expr = static_cast<const SliceExpr&>(expr);
+        index_t parts = 0;
+        std::vector<index_t> children{ append(slice_expr.array) };
+        if (slice_expr.start_index.has_value())
+        {
+            parts |= SliceStart;
+            children.push_back(append(slice_expr.start_index.value()));
+        }
+        if (slice_expr.end_index.has_value())
+        {
+            parts |= SliceEnd;
+            children.push_back(append(slice_expr.end_index.value()));
+        }
+        if (slice_expr.step_size.has_value())
+        {
+            parts |= SliceStep;
+            children.push_back(append(slice_expr.step_size.value()));
+        }
+        return appendNode(ExprKind::Slice, parts, children);
+    }
+    case ExprKind::List:
+        return sequence(ExprKind::List, static_cast<const ListExpr&>(expr).elements);
+    case ExprKind::Tuple:
+        return sequence(ExprKind::Tuple, static_cast<const TupleExpr&>(expr).elements);
+    case ExprKind::ListComprehension:
+    {
+        const auto& list_comprehension_expr = static_cast<const ListComprehensionExpr&>(expr);
+        const auto loop_table = static_cast<index_t>(loop_table_.size());
+        loop_table_.push_back(static_cast<index_t>(list_comprehension_expr.loops.size()));
+        const auto dependencies = list_comprehension_expr.iterableDependencies();
+        for (std::size_t loop = 0; loop < list_comprehension_expr.loops.size(); ++loop)
+        {
+            loop_table_.push_back(static_cast<index_t>(list_comprehension_expr.loops[loop].conditions.size()));
+            loop_table_.push_back(dependencies[loop].has_value() ? static_cast<index_t>(dependencies[loop].value() + 1) : 0);
+        }
+
+        std::vector<index_t> children{ append(list_comprehension_expr.iterator) };
+        for (const auto& loop : list_comprehension_expr.loops)
+        {
+            children.push_back(append(loop.iterator_key));
+            children.push_back(append(loop.iterable));
+            for (const auto& condition : loop.conditions)
+            {
+                children.push_back(append(condition));
+            }
+        }
+        return appendNode(ExprKind::ListComprehension, loop_table, children);
+    }
+    case ExprKind::Let:
+    {
+        const auto& let_expr = static_cast<const LetExpr&>(expr);
+        const auto value = append(let_expr.value);
+        const auto body = append(let_expr.body);
+        return appendNode(ExprKind::Let, name_index(let_expr.name), { value, body });
+    }
+    }
+
+    throw std::invalid_argument("cannot flatten expression of unknown type");
+}
+
+eval::Result FlatExpr::evaluate(const env::Environment* environment) const noexcept
+{
+    return evaluateNode(root(), environment);
+}
+
+eval::Result FlatExpr::evaluateNode(index_t node, const env::Environment* environment) const noexcept
+{
+    const auto& flat_node = nodes_[node];
+    const auto* children = children_.data() + flat_node.first_child;
+
+    switch (flat_node.kind)
+    {
+    case ExprKind::Bool:
+    case ExprKind::Float:
+    case ExprKind::Int:
+    case ExprKind::None:
+    case ExprKind::String:
+        return constants_[flat_node.payload];
+    case ExprKind::Variable:
+        if (auto value = environment->get(names_[flat_node.payload]); value.has_value())
+        {
+            return std::move(value.value());
+        }
+        return zeus::unexpected(eval::Error::UndefinedVariable);
+    case ExprKind::Neg:
+    case ExprKind::Not:
+    {
+        const auto operand = evaluateNode(children[0], environment);
+        if (! operand.has_value())
+        {
+            return zeus::unexpected(operand.error());
+        }
+        return flat_node.kind == ExprKind::Neg ? -operand.value() : ! operand.value();
+    }
+    case ExprKind::Add:
+    case ExprKind::Sub:
+    case ExprKind::Mul:
+    case ExprKind::Div:
+    case ExprKind::Mod:
+    case ExprKind::Pow:
+    case ExprKind::And:
+    case ExprKind::Or:
+    {
+        const auto lhs = evaluateNode(children[0], environment);
+        if (! lhs.has_value())
+        {
+            return zeus::unexpected(lhs.error());
+        }
+        if (flat_node.kind == ExprKind::And || flat_node.kind == ExprKind::Or)
+        {
+            // the right operand is only evaluated if the left one does not decide the result
+            if (lhs.value().isTruthy() == (flat_node.kind == ExprKind::Or))
+            {
+                return lhs;
+            }
+            return evaluateNode(children[1], environment);
+        }
+        const auto rhs = evaluateNode(children[1], environment);
+        if (! rhs.has_value())
+        {
+            return zeus::unexpected(rhs.error());
+        }
+
+        switch (flat_node.kind)
+        {
+        case ExprKind::Add:
+            return lhs.value() + rhs.value();
+        case ExprKind::Sub:
+            return lhs.value() - rhs.value();
+        case ExprKind::Mul:
+            return lhs.value() * rhs.value();
+        case ExprKind::Div:
+            return lhs.value() / rhs.value();
+        case ExprKind::Mod:
+            return lhs.value() % rhs.value();
+        default:
+            return eval::pow(lhs.value(), rhs.value());
+        }
+    }
+    case ExprKind::ComparisonChain:
+    {
+        auto left_result = evaluateNode(children[0], environment);
+        if (! left_result.has_value())
+        {
+            return zeus::unexpected(left_result.error());
+        }
+        auto left_value = std::move(left_result.value());
+
+        for (index_t i = 0; i + 1 < flat_node.child_count; ++i)
+        {
+            const auto comparison_operator = operators_[flat_node.payload + i];
+            if (const auto& constant_set = constant_sets_[flat_node.payload + i]; constant_set != nullptr)
+            {
+                if (constant_set->contains(left_value) != (comparison_operator == Member))
+                {
+                    return false;
+                }
+                if (i + 2 < flat_node.child_count)
+                {
+                    left_value = constant_set->list();
+                }
+                continue;
+            }
+
+            auto right_result = evaluateNode(children[i + 1], environment);
+            if (! right_result.has_value())
+            {
+                return zeus::unexpected(right_result.error());
+            }
+
+            const auto comparison_result = compare(comparison_operator, left_value, right_result.value());
+            if (! comparison_result.has_value())
+            {
+                return zeus::unexpected(comparison_result.error());
+            }
+            if (! comparison_result.value().isTruthy())
+            {
+                return false;
+            }
+            left_value = std::move(right_result.value());
+        }
+        return true;
+    }
+    case ExprKind::Condition:
+    {
+        const auto condition = evaluateNode(children[1], environment);
+        if (! condition.has_value())
+        {
+            return zeus::unexpected(condition.error());
+        }
+        return evaluateNode(condition.value().isTruthy() ? children[0] : children[2], environment);
+    }
+    case ExprKind::FnApplication:
+    {
+        const auto fn_result = try_get<eval::Value::fn_t>(evaluateNode(children[0], environment));
+        if (! fn_result.has_value())
+        {
+            return zeus::unexpected(fn_result.error());
+        }
+
+        std::vector<eval::Value> args;
+        args.reserve(flat_node.child_count - 1);
+        for (index_t i = 1; i < flat_node.child_count; ++i)
+        {
+            auto arg = evaluateNode(children[i], environment);
+            if (! arg.has_value())
+            {
+                return zeus::unexpected(arg.error());
+            }
+            args.push_back(std::move(arg.value()));
+        }
+        return fn_result.value()(args);
+    }
+    case ExprKind::Index:
+    {
+        const auto array = evaluateNode(children[0], environment);
+        if (! array.has_value())
+        {
+            return zeus::unexpected(array.error());
+        }
+        const auto index = evaluateNode(children[1], environment);
+        if (! index.has_value())
+        {
+            return zeus::unexpected(index.error());
+        }
+        return array.value()[index.value()];
+    }
+    case ExprKind::Slice:
+    {
+        // same evaluation order as SliceExpr: step size, array, start index, end index
+        const auto parts = flat_node.payload;
+        auto part = index_t(1);
+        const auto next_part = [&](index_t present) -> std::optional<index_t>
+        {
+            if ((parts & present) == 0)
+            {
+                return std::nullopt;
+            }
+            return children[part++];
+        };
+        const auto start_index = next_part(SliceStart);
+        const auto end_index = next_part(SliceEnd);
+        const auto step_size = next_part(SliceStep);
+
+        const auto evaluate_int = [&](std::optional<index_t> child) -> zeus::expected<std::optional<std::int64_t>, eval::Error>
+        {
+            if (! child.has_value())
+            {
+                return std::nullopt;
+            }
+            const auto result = try_get<std::int64_t>(evaluateNode(child.value(), environment));
+            if (! result.has_value())
+            {
+                return zeus::unexpected(result.error());
+            }
+            return result.value();
+        };
+
+        const auto step_size_value = evaluate_int(step_size);
+        if (! step_size_value.has_value())
+        {
+            return zeus::unexpected(step_size_value.error());
+        }
+        if (step_size_value.value() == std::int64_t(0))
+        {
+            return zeus::unexpected(eval::Error::ValueError);
+        }
+
+        const auto array = try_get<std::vector<eval::Value>>(evaluateNode(children[0], environment));
+        if (! array.has_value())
+        {
+            return zeus::unexpected(array.error());
+        }
+        const auto start_index_value = evaluate_int(start_index);
+        if (! start_index_value.has_value())
+        {
+            return zeus::unexpected(start_index_value.error());
+        }
+        const auto end_index_value = evaluate_int(end_index);
+        if (! end_index_value.has_value())
+        {
+            return zeus::unexpected(end_index_value.error());
+        }
+        return SliceExpr::slice(array.value(), start_index_value.value(), end_index_value.value(), step_size_value.value().value_or(1));
+    }
+    case ExprKind::List:
+    case ExprKind::Tuple:
+    {
+        std::vector<eval::Value> elements;
+        elements.reserve(flat_node.child_count);
+        for (index_t i = 0; i < flat_node.child_count; ++i)
+        {
+            auto element = evaluateNode(children[i], environment);
+            if (! element.has_value())
+            {
+                return zeus::unexpected(element.error());
+            }
+            elements.push_back(std::move(element.value()));
+        }
+        return elements;
+    }
+    case ExprKind::ListComprehension:
+    {
+        env::LocalEnvironment local_environment{ environment };
+        std::vector<std::optional<std::vector<eval::Value>>> iterables(loop_table_[flat_node.payload]);
+        std::vector<eval::Value> results;
+        if (const auto loop_error = evaluateLoop(node, 0, 1, local_environment, iterables, results); loop_error.has_value())
+        {
+            return zeus::unexpected(loop_error.value());
+        }
+        return results;
+    }
+    case ExprKind::Let:
+    {
+        const auto value = evaluateNode(children[0], environment);
+        if (! value.has_value())
+        {
+            return zeus::unexpected(value.error());
+        }
+        env::LocalEnvironment local_environment{ environment };
+        local_environment.set(names_[flat_node.payload], value.value());
+        return evaluateNode(children[1], &local_environment);
+    }
+    case ExprKind::Fused:
+    case ExprKind::Ptr:
+    case ExprKind::Flat:
+        // never stored as nodes, appending unwraps them
+        break;
+    }
+    return zeus::unexpected(eval::Error::TypeMismatch);
+}
+
+std::optional<eval::Error> FlatExpr::evaluateLoop(
+    index_t node,
+    std::size_t loop,
+    std::size_t loop_child,
+    env::LocalEnvironment& local_environment,
+    std::vector<std::optional<std::vector<eval::Value>>>& iterables,
+    std::vector<eval::Value>& results) const
+{
+    const auto& flat_node = nodes_[node];
+    const auto children = this->children(node);
+    const auto loop_count = loop_table_[flat_node.payload];
+    if (loop >= loop_count)
+    {
+        throw std::runtime_error("loops in list comprehension cannot be empty");
+    }
+    const auto condition_count = loop_table_[flat_node.payload + 1 + 2 * loop];
+
+    // like ListComprehensionExpr, only evaluates an iterable again once a loop whose variables it reads has advanced
+    auto& iterable = iterables[loop];
+    if (! iterable.has_value())
+    {
+        auto iterable_result = try_get<std::vector<eval::Value>>(evaluateNode(children[loop_child + 1], &local_environment));
+        if (! iterable_result.has_value())
+        {
+            return iterable_result.error();
+        }
+        iterable = std::move(iterable_result.value());
+    }
+
+    for (const auto& element : iterable.value())
+    {
+        assignKey(children[loop_child], element, local_environment);
+        for (auto inner = loop + 1; inner < loop_count; ++inner)
+        {
+            if (loop_table_[flat_node.payload + 2 + 2 * inner] == loop + 1)
+            {
+                iterables[inner].reset();
+            }
+        }
+
+        auto exit_loop = false;
+        for (index_t condition = 0; condition < condition_count; ++condition)
+        {
+            const auto condition_result = evaluateNode(children[loop_child + 2 + condition], &local_environment);
+            if (! condition_result.has_value())
+            {
+                return condition_result.error();
+            }
+            if (! condition_result.value().isTruthy())
+            {
+                exit_loop = true;
+                break;
+            }
+        }
+        if (exit_loop)
+        {
+            continue;
+        }
+
+        if (loop + 1 == loop_count)
+        {
+            auto iterator_result = evaluateNode(children[0], &local_environment);
+            if (! iterator_result.has_value())
+            {
+                return iterator_result.error();
+            }
+            results.push_back(std::move(iterator_result.value()));
+        }
+        else if (const auto loop_error = evaluateLoop(node, loop + 1, loop_child + 2 + condition_count, local_environment, iterables, results); loop_error.has_value())
+        {
+            return loop_error;
+        }
+    }
+    return std::nullopt;
+}
+
+void FlatExpr::assignKey(index_t key, const eval::Value& element, env::LocalEnvironment& local_environment) const
+{
+    // binds every variable of the iterator key, like ListComprehensionExpr does with its free variables
+    const auto& key_node = nodes_[key];
+    if (key_node.kind == ExprKind::Variable)
+    {
+        local_environment.set(names_[key_node.payload], element);
+        return;
+    }
+    for (const auto child : children(key))
+    {
+        assignKey(child, element, local_environment);
+    }
+}
+
+std::string FlatExpr::toString() const noexcept
+{
+    return toExpr().toString();
+}
+
+bool FlatExpr::deepEq(const Expr& other) const noexcept
+{
+    switch (other.kind())
+    {
+    case ExprKind::Ptr:
+        return deepEq(*static_cast<const ExprPtr&>(other).ptr);
+    case ExprKind::Flat:
+    {
+        const auto& other_flat = static_cast<const FlatExpr&>(other);
+        return nodeEq(root(), other_flat, other_flat.root());
+    }
+    default:
+        return toExpr().ptr->deepEq(other);
+    }
+}
+
+bool FlatExpr::nodeEq(index_t node, const FlatExpr& other, index_t other_node) const noexcept
+{
+    const auto& flat_node = nodes_[node];
+    const auto& other_flat_node = other.nodes_[other_node];
+    if (flat_node.kind != other_flat_node.kind || flat_node.child_count != other_flat_node.child_count)
+    {
+        return false;
+    }
+
+    switch (flat_node.kind)
+    {
+    case ExprKind::Bool:
+        return std::get<bool>(constants_[flat_node.payload].value) == std::get<bool>(other.constants_[other_flat_node.payload].value);
+    case ExprKind::Float:
+        return std::bit_cast<std::uint64_t>(std::get<double>(constants_[flat_node.payload].value)) == std::bit_cast<std::uint64_t>(std::get<double>(other.constants_[other_flat_node.payload].value));
+    case ExprKind::Int:
+        return std::get<std::int64_t>(constants_[flat_node.payload].value) == std::get<std::int64_t>(other.constants_[other_flat_node.payload].value);
+    case ExprKind::None:
+        return true;
+    case ExprKind::String:
+        return std::get<std::string>(constants_[flat_node.payload].value) == std::get<std::string>(other.constants_[other_flat_node.payload].value);
+    case ExprKind::Variable:
+        return names_[flat_node.payload] == other.names_[other_flat_node.payload];
+    case ExprKind::Let:
+        if (names_[flat_node.payload] != other.names_[other_flat_node.payload])
+        {
+            return false;
+        }
+        break;
+    case ExprKind::ComparisonChain:
+        if (! std::equal(
+                operators_.begin() + flat_node.payload,
+                operators_.begin() + flat_node.payload + flat_node.child_count - 1,
+                other.operators_.begin() + other_flat_node.payload))
+        {
+            return false;
+        }
+        break;
+    case ExprKind::Slice:
+        if (flat_node.payload != other_flat_node.payload)
+        {
+            return false;
+        }
+        break;
+    case ExprKind::ListComprehension:
+    {
+        const auto loop_count = loop_table_[flat_node.payload];
+        if (! std::equal(
+                loop_table_.begin() + flat_node.payload,
+                loop_table_.begin() + flat_node.payload + 1 + 2 * loop_count,
+                other.loop_table_.begin() + other_flat_node.payload,
+                other.loop_table_.begin() + other_flat_node.payload + 1 + 2 * other.loop_table_[other_flat_node.payload]))
+        {
+            return false;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+
+    const auto children = this->children(node);
+    const auto other_children = other.children(other_node);
+    for (std::size_t i = 0; i < children.size(); ++i)
+    {
+        if (! nodeEq(children[i], other, other_children[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+ExprPtr FlatExpr::toExpr() const
+{
+    return toExprNode(root());
+}
+
+ExprPtr FlatExpr::toExprNode(index_t node) const
+{
+    const auto& flat_node = nodes_[node];
+    const auto children = this->children(node);
+    const auto constant = [this, &flat_node]<typename T>() { return std::get<T>(constants_[flat_node.payload].value); };
+    const auto child = [this, &children](std::size_t index) { return toExprNode(children[index]); };
+    const auto elements = [this, &children](std::size_t first)
+    {
+        std::vector<ExprPtr> expressions;
+        for (auto index = first; index < children.size(); ++index)
+        {
+            expressions.push_back(toExprNode(children[index]));
+        }
+        return expressions;
+    };
+
+    switch (flat_node.kind)
+    {
+    case ExprKind::Bool:
+        return make_expr_ptr<BoolExpr>(constant.template operator()<bool>());
+    case ExprKind::Float:
+        return make_expr_ptr<FloatExpr>(constant.template operator()<double>());
+    case ExprKind::Int:
+        return make_expr_ptr<IntExpr>(constant.template operator()<std::int64_t>());
+    case ExprKind::None:
+        return make_expr_ptr<NoneExpr>();
+    case ExprKind::String:
+        return make_expr_ptr<StringExpr>(constant.template operator()<std::string>());
+    case ExprKind::Variable:
+        return make_expr_ptr<VariableExpr>(names_[flat_node.payload]);
+    case ExprKind::Neg:
+        return make_expr_ptr<NegExpr>(child(0));
+    case ExprKind::Not:
+        return make_expr_ptr<NotExpr>(child(0));
+    case ExprKind::Add:
+        return make_expr_ptr<AddExpr>(child(0), child(1));
+    case ExprKind::Sub:
+        return make_expr_ptr<SubExpr>(child(0), child(1));
+    case ExprKind::Mul:
+        return make_expr_ptr<MulExpr>(child(0), child(1));
+    case ExprKind::Div:
+        return make_expr_ptr<DivExpr>(child(0), child(1));
+    case ExprKind::Mod:
+        return make_expr_ptr<ModExpr>(child(0), child(1));
+    case ExprKind::Pow:
+        return make_expr_ptr<PowExpr>(child(0), child(1));
+    case ExprKind::And:
+        return make_expr_ptr<AndExpr>(child(0), child(1));
+    case ExprKind::Or:
+        return make_expr_ptr<OrExpr>(child(0), child(1));
+    case ExprKind::ComparisonChain:
+        return make_expr_ptr<ComparisonChainExpr>(
+            elements(0),
+            std::vector<ComparisonOperators>(operators_.begin() + flat_node.payload, operators_.begin() + flat_node.payload + flat_node.child_count - 1));
+    case ExprKind::Condition:
+        return make_expr_ptr<ConditionExpr>(child(0), child(1), child(2));
+    case ExprKind::FnApplication:
+        return make_expr_ptr<FnApplicationExpr>(child(0), elements(1));
+    case ExprKind::Index:
+        return make_expr_ptr<IndexExpr>(child(0), child(1));
+    case ExprKind::Slice:
+    {
+        std::size_t part = 1;
+        const auto next_part = [&](index_t present) -> std::optional<ExprPtr>
+        {
+            if ((flat_node.payload & present) == 0)
+            {
+                return std::nullopt;
+            }
+            return child(part++);
+        };
+        auto start_index = next_part(SliceStart);
+        auto end_index = next_part(SliceEnd);
+        auto step_size = next_part(SliceStep);
+        return make_expr_ptr<SliceExpr>(child(0), std::move(start_index), std::move(end_index), std::move(step_size));
+    }
+    case ExprKind::List:
+        return make_expr_ptr<ListExpr>(elements(0));
+    case ExprKind::Tuple:
+        return make_expr_ptr<TupleExpr>(elements(0));
+    case ExprKind::ListComprehension:
+    {
+        std::vector<ListComprehensionExpr::loop> loops;
+        std::size_t loop_child = 1;
+        for (index_t loop = 0; loop < loop_table_[flat_node.payload]; ++loop)
+        {
+            const auto condition_count = loop_table_[flat_node.payload + 1 + 2 * loop];
+            std::vector<ExprPtr> conditions;
+            for (index_t condition = 0; condition < condition_count; ++condition)
+            {
+                conditions.push_back(child(loop_child + 2 + condition));
+            }
+            loops.emplace_back(child(loop_child), child(loop_child + 1), std::move(conditions));
+            loop_child += 2 + condition_count;
+        }
+        return make_expr_ptr<ListComprehensionExpr>(child(0), std::move(loops));
+    }
+    case ExprKind::Let:
+        return make_expr_ptr<LetExpr>(names_[flat_node.payload], child(0), child(1));
+    case ExprKind::Fused:
+    case ExprKind::Ptr:
+    case ExprKind::Flat:
+        break;
+    }
+    throw std::invalid_argument("unknown flat expression node");
+}
+
+void FlatExpr::encode(std::string& buffer) const
+{
+    put(buffer, static_cast<std::uint64_t>(structuralHash()));
+    const auto& free_symbols = freeSymbols();
+    for (const auto count : { nodes_.size(), children_.size(), constants_.size(), names_.size(), operators_.size(), loop_table_.size(), free_symbols.size() })
+    {
+        put(buffer, static_cast<std::uint32_t>(count));
+    }
+
+    for (const auto& node : nodes_)
+    {
+        put(buffer, node.kind);
+        buffer.append(3, '\0');
+        put(buffer, node.payload);
+        put(buffer, node.first_child);
+        put(buffer, node.child_count);
+    }
+    buffer.append(reinterpret_cast<const char*>(children_.data()), children_.size() * sizeof(index_t));
+
+    // constants are the payloads of literal nodes, so their kind tells the alternative
+    for (const auto& node : nodes_)
+    {
+        if (node.kind > ExprKind::String)
+        {
+            continue;
+        }
+        const auto& constant = constants_[node.payload].value;
+        put(buffer, node.kind);
+        switch (node.kind)
+        {
+        case ExprKind::Bool:
+            put(buffer, static_cast<std::uint8_t>(std::get<bool>(constant)));
+            break;
+        case ExprKind::Float:
+            put(buffer, std::get<double>(constant));
+            break;
+        case ExprKind::Int:
+            put(buffer, std::get<std::int64_t>(constant));
+            break;
+        case ExprKind::String:
+            putString(buffer, std::get<std::string>(constant));
+            break;
+        default:
+            break;
+        }
+    }
+    for (const auto& name : names_)
+    {
+        putString(buffer, name);
+    }
+    for (std::size_t i = 0; i < operators_.size(); ++i)
+    {
+        put(buffer, static_cast<std::uint8_t>(operators_[i]));
+        put(buffer, static_cast<std::uint8_t>(constant_sets_[i] != nullptr));
+    }
+    buffer.append(reinterpret_cast<const char*>(loop_table_.data()), loop_table_.size() * sizeof(index_t));
+    for (const auto symbol : free_symbols)
+    {
+        // free symbols are the names of variables, which are all pooled
+        put(buffer, static_cast<index_t>(std::ranges::find(names_, symbolName(symbol)) - names_.begin()));
+    }
+}
+
+std::optional<FlatExpr> FlatExpr::decode(std::span<const std::byte> bytes)
+{
+    Reader reader{ bytes };
+    const auto structural_hash = reader.take<std::uint64_t>();
+    std::array<std::uint32_t, 7> counts{};
+    for (auto& count : counts)
+    {
+        const auto value = reader.take<std::uint32_t>();
+        if (! value.has_value())
+        {
+            return std::nullopt;
+        }
+        count = value.value();
+    }
+    const auto [node_count, child_count, constant_count, name_count, operator_count, loop_table_size, free_symbol_count] = counts;
+    // the smallest encoding of the counts, checked before anything is allocated for them
+    const auto minimum_size = std::uint64_t{ node_count } * 16 + std::uint64_t{ child_count } * sizeof(index_t) + constant_count + std::uint64_t{ name_count } * 4
+                            + std::uint64_t{ operator_count } * 2 + std::uint64_t{ loop_table_size } * sizeof(index_t) + std::uint64_t{ free_symbol_count } * 4;
+    if (! structural_hash.has_value() || node_count == 0 || constant_count > node_count || minimum_size > bytes.size())
+    {
+        return std::nullopt;
+    }
+
+    FlatExpr flat;
+    flat.nodes_.reserve(node_count);
+    for (std::uint32_t i = 0; i < node_count; ++i)
+    {
+        const auto kind = reader.take<ExprKind>();
+        const auto padded = reader.skip(3);
+        const auto payload = reader.take<index_t>();
+        const auto first_child = reader.take<index_t>();
+        const auto children = reader.take<index_t>();
+        if (! kind.has_value() || ! padded || ! children.has_value())
+        {
+            return std::nullopt;
+        }
+        flat.nodes_.push_back(Node{ .kind = kind.value(), .payload = payload.value(), .first_child = first_child.value(), .child_count = children.value() });
+    }
+    if (! reader.takeArray(flat.children_, child_count))
+    {
+        return std::nullopt;
+    }
+
+    flat.constants_.reserve(constant_count);
+    for (std::uint32_t i = 0; i < constant_count; ++i)
+    {
+        const auto kind = reader.take<ExprKind>();
+        if (! kind.has_value())
+        {
+            return std::nullopt;
+        }
+        std::optional<eval::Value> constant;
+        switch (kind.value())
+        {
+        case ExprKind::Bool:
+            if (const auto value = reader.take<std::uint8_t>(); value.has_value())
+            {
+                constant = eval::Value(value.value() != 0);
+            }
+            break;
+        case ExprKind::Float:
+            if (const auto value = reader.take<double>(); value.has_value())
+            {
+                constant = eval::Value(value.value());
+            }
+            break;
+        case ExprKind::Int:
+            if (const auto value = reader.take<std::int64_t>(); value.has_value())
+            {
+                constant = eval::Value(value.value());
+            }
+            break;
+        case ExprKind::None:
+            constant = eval::Value(nullptr);
+            break;
+        case ExprKind::String:
+            if (auto value = reader.takeString(); value.has_value())
+            {
+                constant = eval::Value(std::move(value.value()));
+            }
+            break;
+        default:
+            break;
+        }
+        if (! constant.has_value())
+        {
+            return std::nullopt;
+        }
+        flat.constants_.push_back(std::move(constant.value()));
+    }
+
+    flat.names_.reserve(name_count);
+    for (std::uint32_t i = 0; i < name_count; ++i)
+    {
+        auto name = reader.takeString();
+        if (! name.has_value())
+        {
+            return std::nullopt;
+        }
+        flat.names_.push_back(std::move(name.value()));
+    }
+
+    std::vector<bool> had_constant_set;
+    flat.operators_.reserve(operator_count);
+    for (std::uint32_t i = 0; i < operator_count; ++i)
+    {
+        const auto comparison_operator = reader.take<std::uint8_t>();
+        const auto constant_set = reader.take<std::uint8_t>();
+        if (! comparison_operator.has_value() || ! constant_set.has_value() || comparison_operator.value() > Member)
+        {
+            return std::nullopt;
+        }
+        flat.operators_.push_back(static_cast<ComparisonOperators>(comparison_operator.value()));
+        had_constant_set.push_back(constant_set.value() != 0);
+    }
+    if (! reader.takeArray(flat.loop_table_, loop_table_size))
+    {
+        return std::nullopt;
+    }
+
+    SymbolSet free_symbols;
+    for (std::uint32_t i = 0; i < free_symbol_count; ++i)
+    {
+        const auto name = reader.take<index_t>();
+        if (! name.has_value() || name.value() >= flat.names_.size())
+        {
+            return std::nullopt;
+        }
+        free_symbols.merge(SymbolSet{ intern(flat.names_[name.value()]) });
+    }
+    if (! reader.done() || ! flat.wellFormed())
+    {
+        return std::nullopt;
+    }
+
+    // the sets are rebuilt from the literal lists they were built from
+    flat.constant_sets_.resize(operator_count);
+    for (index_t node = 0; node < node_count; ++node)
+    {
+        const auto& flat_node = flat.nodes_[node];
+        if (flat_node.kind != ExprKind::ComparisonChain)
+        {
+            continue;
+        }
+        for (index_t i = 0; i + 1 < flat_node.child_count; ++i)
+        {
+            if (had_constant_set[flat_node.payload + i])
+            {
+                flat.constant_sets_[flat_node.payload + i] = ConstantSet::of(flat.toExprNode(flat.children(node)[i + 1]));
+            }
+        }
+    }
+
+    flat.setAttributes(std::move(free_symbols), static_cast<std::size_t>(structural_hash.value()));
+    return flat;
+}
+
+bool FlatExpr::wellFormed() const noexcept
+{
+    // every node but the root is the child of exactly one later node, so the nodes form a tree in post-order
+    std::vector<std::uint8_t> parents(nodes_.size(), 0);
+    for (index_t node = 0; node < nodes_.size(); ++node)
+    {
+        const auto& flat_node = nodes_[node];
+        if (flat_node.first_child > children_.size() || flat_node.child_count > children_.size() - flat_node.first_child)
+        {
+            return false;
+        }
+        for (const auto child : children(node))
+        {
+            if (child >= node || parents[child]++ != 0)
+            {
+                return false;
+            }
+        }
+
+        const auto children_are = [&flat_node](index_t count) { return flat_node.child_count == count; };
+        switch (flat_node.kind)
+        {
+        case ExprKind::Bool:
+        case ExprKind::Float:
+        case ExprKind::Int:
+        case ExprKind::None:
+        case ExprKind::String:
+        {
+            if (! children_are(0) || flat_node.payload >= constants_.size())
+            {
+                return false;
+            }
+            // the alternatives of eval::Value in the order of the literal kinds
+            constexpr std::array<std::size_t, 5> alternatives{ 0, 1, 2, 6, 3 };
+            if (constants_[flat_node.payload].value.index() != alternatives[static_cast<std::size_t>(flat_node.kind)])
+            {
+                return false;
+            }
+            break;
+        }
+        case ExprKind::Variable:
+            if (! children_are(0) || flat_node.payload >= names_.size())
+            {
+                return false;
+            }
+            break;
+        case ExprKind::Neg:
+        case ExprKind::Not:
+            if (! children_are(1))
+            {
+                return false;
+            }
+            break;
+        case ExprKind::Add:
+        case ExprKind::Sub:
+        case ExprKind::Mul:
+        case ExprKind::Div:
+        case ExprKind::Mod:
+        case ExprKind::Pow:
+        case ExprKind::And:
+        case ExprKind::Or:
+        case ExprKind::Index:
+            if (! children_are(2))
+            {
+                return false;
+            }
+            break;
+        case ExprKind::Condition:
+            if (! children_are(3))
+            {
+                return false;
+            }
+            break;
+        case ExprKind::FnApplication:
+            if (flat_node.child_count == 0)
+            {
+                return false;
+            }
+            break;
+        case ExprKind::Slice:
+            if (flat_node.payload > (SliceStart | SliceEnd | SliceStep) || ! children_are(1 + static_cast<index_t>(std::popcount(flat_node.payload))))
+            {
+                return false;
+            }
+            break;
+        case ExprKind::List:
+        case ExprKind::Tuple:
+            break;
+        case ExprKind::ComparisonChain:
+            if (flat_node.child_count < 2 || flat_node.payload > operators_.size() || flat_node.child_count - 1 > operators_.size() - flat_node.payload)
+            {
+                return false;
+            }
+            break;
+        case ExprKind::ListComprehension:
+        {
+            if (flat_node.payload >= loop_table_.size())
+            {
+                return false;
+            }
+            const std::uint64_t loop_count = loop_table_[flat_node.payload];
+            if (loop_count == 0 || 2 * loop_count > loop_table_.size() - flat_node.payload - 1)
+            {
+                return false;
+            }
+            // the iterator, then the key, the iterable and the conditions of every loop
+            std::uint64_t expected_children = 1;
+            for (std::uint64_t loop = 0; loop < loop_count; ++loop)
+            {
+                expected_children += 2 + std::uint64_t{ loop_table_[flat_node.payload + 1 + 2 * loop] };
+                if (loop_table_[flat_node.payload + 2 + 2 * loop] > loop)
+                {
+                    return false;
+                }
+            }
+            if (expected_children != flat_node.child_count)
+            {
+                return false;
+            }
+            break;
+        }
+        case ExprKind::Let:
+            if (! children_are(2) || flat_node.payload >= names_.size())
+            {
+                return false;
+            }
+            break;
+        default:
+            return false;
+        }
+    }
+    return std::all_of(parents.begin(), parents.end() - 1, [](std::uint8_t parent_count) { return parent_count == 1; });
+}
+
+} // namespace CuraFormulaeEngine::ast
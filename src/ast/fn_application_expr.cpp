@@ -21,7 +21,7 @@ namespace CuraFormulaeEngine::ast
     auto args_str
             = args | ranges::views::transform([](const auto& arg) { return arg.toString(); }) | ranges::views::join(ranges::views::c_str(", ")) | ranges::to<std::string>();
 
-    if (const auto& variable = dynamic_cast<const VariableExpr*>(fn.ptr.get()))
+    if (const auto& variable = fn.ptr->kind() == ExprKind::Variable ? static_cast<const VariableExpr*>(fn.ptr.get()) : nullptr)
     {
         return fmt::format("({}({}))", variable->name, args_str);
     }
@@ -51,22 +51,9 @@ namespace CuraFormulaeEngine::ast
     return fn_value(arg_results);
 }
 
-[[nodiscard]] std::unordered_set<std::string> FnApplicationExpr::freeVariables() const noexcept
-{
-    std::unordered_set<std::string> result;
-    const auto fn_vars = fn.freeVariables();
-    result.insert(fn_vars.begin(), fn_vars.end());
-    for (const auto& arg : args)
-    {
-        const auto arg_vars = arg.freeVariables();
-        result.insert(arg_vars.begin(), arg_vars.end());
-    }
-    return result;
-}
-
 [[nodiscard]] bool FnApplicationExpr::deepEq(const Expr& other) const noexcept
 {
-    if (const auto& other_fn_application = dynamic_cast<const FnApplicationExpr*>(&other))
+    if (const auto& other_fn_application = other.kind() == ExprKind::FnApplication ? static_cast<const FnApplicationExpr*>(&other) : nullptr)
     {
         if (! fn.deepEq(other_fn_application->fn))
         {
@@ -88,15 +75,4 @@ namespace CuraFormulaeEngine::ast
     return false;
 }
 
-void FnApplicationExpr::visitAll(std::function<void(const Expr&)> visitor) const noexcept
-{
-    visitor(*this);
-
-    fn.visitAll(visitor);
-    for (const auto& arg : args)
-    {
-        arg.visitAll(visitor);
-    }
-}
-
 } // namespace CuraFormulaeEngine::ast
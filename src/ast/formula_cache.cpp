@@ -0,0 +1,285 @@
+#include "cura-formulae-engine/ast/formula_cache.h"
+
+#include "cura-formulae-engine/ast/binary_expr/and_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/mul_expr.h"
+#include "cura-formulae-engine/ast/comp_chain_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/bool_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/float_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/int_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/string_expr.h"
+#include "cura-formulae-engine/ast/variable_expr.h"
+#include "cura-formulae-engine/file.h"
+
+#include <zeus/expected.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace CuraFormulaeEngine::ast
+{
+
+namespace
+{
+
+constexpr std::array<char, 8> cache_magic{ 'C', 'F', 'E', 'F', 'O', 'R', 'M', '\0' };
+constexpr std::uint32_t cache_format_version = 1;
+
+/*
+ * header: magic[8], u32 format version, u32 reserved, u64 entry count, u64 file size, u64 hash fingerprint
+ * index:  entry count entries of u64 text hash, u64 text offset, u32 text length, u32 formula length, u64 formula
+ *         offset; sorted by text hash
+ * data:   texts and encoded formulas, all offsets are relative to the start of the file
+ */
+constexpr std::size_t header_size = 40;
+constexpr std::size_t index_entry_size = 32;
+
+template<typename T>
+void append(std::string& buffer, const T& value)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+void store(std::string& buffer, std::size_t offset, const T& value)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    std::memcpy(buffer.data() + offset, &value, sizeof(T));
+}
+
+template<typename T>
+T load(const char* data) noexcept
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+/**
+ * @brief The structural hash of a formula with a literal of every kind.
+ *
+ * Structural hashes are stored with the formulas but go through `std::hash`, which differs between standard libraries,
+ * so a cache is only loaded by builds hashing this formula the same.
+ */
+std::uint64_t hashFingerprint()
+{
+    static const auto fingerprint = []()
+    {
+        std::vector<ExprPtr> expressions;
+        expressions.push_back(make_expr_ptr<MulExpr>(make_expr_ptr<VariableExpr>(std::string("x")), make_expr_ptr<FloatExpr>(1.5)));
+        expressions.push_back(make_expr_ptr<IntExpr>(std::int64_t{ 2 }));
+        auto comparison = make_expr_ptr<ComparisonChainExpr>(std::move(expressions), std::vector<ComparisonOperators>{ LessThan });
+        const auto probe = make_expr_ptr<AndExpr>(
+            make_expr_ptr<AndExpr>(std::move(comparison), make_expr_ptr<StringExpr>(std::string("fingerprint"))),
+            make_expr_ptr<BoolExpr>(true));
+        return static_cast<std::uint64_t>(probe.structuralHash());
+    }();
+    return fingerprint;
+}
+
+} // namespace
+
+std::uint64_t formulaTextHash(std::string_view text) noexcept
+{
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const auto character : text)
+    {
+        hash ^= static_cast<std::uint8_t>(character);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+void FormulaCacheBuilder::add(std::string_view text, const Expr& formula)
+{
+    std::string encoded;
+    if (formula.kind() == ExprKind::Flat)
+    {
+        static_cast<const FlatExpr&>(formula).encode(encoded);
+    }
+    else
+    {
+        FlatExpr::flatten(formula).encode(encoded);
+    }
+    entries_.insert_or_assign({ formulaTextHash(text), std::string(text) }, std::move(encoded));
+}
+
+std::size_t FormulaCacheBuilder::size() const noexcept
+{
+    return entries_.size();
+}
+
+zeus::expected<std::string, FormulaCacheError> FormulaCacheBuilder::encode() const
+{
+    for (const auto& [key, formula] : entries_)
+    {
+        if (key.second.size() > std::numeric_limits<std::uint32_t>::max() || formula.size() > std::numeric_limits<std::uint32_t>::max())
+        {
+            return zeus::unexpected(FormulaCacheError::TooLarge);
+        }
+    }
+
+    std::string buffer;
+    buffer.append(cache_magic.data(), cache_magic.size());
+    append(buffer, cache_format_version);
+    append(buffer, std::uint32_t{ 0 });
+    append(buffer, static_cast<std::uint64_t>(entries_.size()));
+    append(buffer, std::uint64_t{ 0 });
+    append(buffer, hashFingerprint());
+    buffer.resize(header_size + entries_.size() * index_entry_size);
+
+    std::size_t entry = header_size;
+    for (const auto& [key, formula] : entries_)
+    {
+        const auto& [hash, text] = key;
+        const auto text_offset = buffer.size();
+        buffer.append(text);
+        const auto formula_offset = buffer.size();
+        buffer.append(formula);
+
+        store(buffer, entry, hash);
+        store(buffer, entry + 8, static_cast<std::uint64_t>(text_offset));
+        store(buffer, entry + 16, static_cast<std::uint32_t>(text.size()));
+        store(buffer, entry + 20, static_cast<std::uint32_t>(formula.size()));
+        store(buffer, entry + 24, static_cast<std::uint64_t>(formula_offset));
+        entry += index_entry_size;
+    }
+
+    store(buffer, 24, static_cast<std::uint64_t>(buffer.size()));
+    return buffer;
+}
+
+zeus::expected<void, FormulaCacheError> FormulaCacheBuilder::write(const std::filesystem::path& path) const
+{
+    const auto encoded = encode();
+    if (! encoded.has_value())
+    {
+        return zeus::unexpected(encoded.error());
+    }
+
+    // the file may be loaded by readers, it is replaced rather than rewritten
+    if (! replaceFile(path, encoded.value()))
+    {
+        return zeus::unexpected(FormulaCacheError::IoError);
+    }
+    return {};
+}
+
+zeus::expected<FormulaCache, FormulaCacheError> FormulaCache::open(const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (! file)
+    {
+        return zeus::unexpected(FormulaCacheError::IoError);
+    }
+    std::string data{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+    if (file.bad())
+    {
+        return zeus::unexpected(FormulaCacheError::IoError);
+    }
+    return decode(std::move(data));
+}
+
+zeus::expected<FormulaCache, FormulaCacheError> FormulaCache::decode(std::string data)
+{
+    if (data.size() < header_size || std::memcmp(data.data(), cache_magic.data(), cache_magic.size()) != 0 || load<std::uint64_t>(data.data() + 24) != data.size())
+    {
+        return zeus::unexpected(FormulaCacheError::InvalidFormat);
+    }
+    if (load<std::uint32_t>(data.data() + 8) != cache_format_version || load<std::uint64_t>(data.data() + 32) != hashFingerprint())
+    {
+        return zeus::unexpected(FormulaCacheError::IncompatibleVersion);
+    }
+
+    const auto entry_count = load<std::uint64_t>(data.data() + 16);
+    if (entry_count > (data.size() - header_size) / index_entry_size)
+    {
+        return zeus::unexpected(FormulaCacheError::InvalidFormat);
+    }
+    for (std::size_t index = 0; index < entry_count; ++index)
+    {
+        const auto* entry = data.data() + header_size + index * index_entry_size;
+        const auto text_offset = load<std::uint64_t>(entry + 8);
+        const auto text_length = load<std::uint32_t>(entry + 16);
+        const auto formula_length = load<std::uint32_t>(entry + 20);
+        const auto formula_offset = load<std::uint64_t>(entry + 24);
+        if (text_offset > data.size() || text_length > data.size() - text_offset || formula_offset > data.size() || formula_length > data.size() - formula_offset)
+        {
+            return zeus::unexpected(FormulaCacheError::InvalidFormat);
+        }
+        if (index > 0 && load<std::uint64_t>(entry - index_entry_size) > load<std::uint64_t>(entry))
+        {
+            return zeus::unexpected(FormulaCacheError::InvalidFormat);
+        }
+    }
+
+    FormulaCache cache;
+    cache.data_ = std::move(data);
+    cache.entry_count_ = static_cast<std::size_t>(entry_count);
+    return cache;
+}
+
+std::optional<FlatExpr> FormulaCache::find(std::string_view text) const
+{
+    const auto hash = formulaTextHash(text);
+    std::size_t low = 0;
+    std::size_t high = entry_count_;
+    while (low < high)
+    {
+        const auto middle = low + (high - low) / 2;
+        if (hashAt(middle) < hash)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    // the text tells apart formulas whose texts hash the same
+    for (auto index = low; index < entry_count_ && hashAt(index) == hash; ++index)
+    {
+        if (textAt(index) == text)
+        {
+            const auto* entry = data_.data() + header_size + index * index_entry_size;
+            const auto* formula = reinterpret_cast<const std::byte*>(data_.data() + load<std::uint64_t>(entry + 24));
+            return FlatExpr::decode(std::span<const std::byte>(formula, load<std::uint32_t>(entry + 20)));
+        }
+    }
+    return std::nullopt;
+}
+
+std::size_t FormulaCache::size() const noexcept
+{
+    return entry_count_;
+}
+
+std::uint64_t FormulaCache::hashAt(std::size_t index) const noexcept
+{
+    return load<std::uint64_t>(data_.data() + header_size + index * index_entry_size);
+}
+
+std::string_view FormulaCache::textAt(std::size_t index) const noexcept
+{
+    const auto* entry = data_.data() + header_size + index * index_entry_size;
+    return { data_.data() + load<std::uint64_t>(entry + 8), load<std::uint32_t>(entry + 16) };
+}
+
+} // namespace CuraFormulaeEngine::ast
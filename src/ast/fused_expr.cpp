@@ -0,0 +1,323 @@
+#include "cura-formulae-engine/ast/fused_expr.h"
+
+#include "cura-formulae-engine/ast/binary_expr/binary_expr.h"
+#include "cura-formulae-engine/ast/condition_expr.h"
+#include "cura-formulae-engine/ast/fn_application_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/bool_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/float_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/int_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/string_expr.h"
+#include "cura-formulae-engine/ast/variable_expr.h"
+#include "cura-formulae-engine/env/max.h"
+#include "cura-formulae-engine/env/min.h"
+
+#include <zeus/expected.hpp>
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+
+namespace CuraFormulaeEngine::ast
+{
+
+namespace
+{
+
+const std::string min_name{ "min" };
+const std::string max_name{ "max" };
+
+const Expr& unwrap(const Expr& expr) noexcept
+{
+    const auto* node = &expr;
+    while (node->kind() == ExprKind::Ptr)
+    {
+        node = static_cast<const ExprPtr*>(node)->ptr.get();
+    }
+    return *node;
+}
+
+const VariableExpr* asVariable(const Expr& expr) noexcept
+{
+    const auto& node = unwrap(expr);
+    return node.kind() == ExprKind::Variable ? static_cast<const VariableExpr*>(&node) : nullptr;
+}
+
+std::optional<eval::Value> literalValue(const Expr& expr)
+{
+    const auto& node = unwrap(expr);
+    switch (node.kind())
+    {
+    case ExprKind::Bool:
+        return eval::Value{ static_cast<const BoolExpr&>(node).value };
+    case ExprKind::Float:
+        return eval::Value{ static_cast<const FloatExpr&>(node).value };
+    case ExprKind::Int:
+        return eval::Value{ static_cast<const IntExpr&>(node).value };
+    case ExprKind::None:
+        return eval::Value{};
+    case ExprKind::String:
+        return eval::Value{ static_cast<const StringExpr&>(node).value };
+    default:
+        return std::nullopt;
+    }
+}
+
+bool isNumberLiteral(const Expr& expr) noexcept
+{
+    const auto kind = unwrap(expr).kind();
+    return kind == ExprKind::Int || kind == ExprKind::Float;
+}
+
+} // namespace
+
+std::string_view fusedShapeName(FusedShape shape) noexcept
+{
+    switch (shape)
+    {
+    case FusedShape::VariableComparison:
+        return "variable == literal";
+    case FusedShape::VariableMembership:
+        return "variable in [literals]";
+    case FusedShape::VariableScale:
+        return "variable * number";
+    case FusedShape::VariableSelection:
+        return "variable if condition else variable";
+    case FusedShape::VariableMin:
+        return "min(variable, variable)";
+    case FusedShape::VariableMax:
+        return "max(variable, variable)";
+    }
+    return "unknown";
+}
+
+std::optional<FusedShape> matchFusedShape(const Expr& expr) noexcept
+{
+    const auto& node = unwrap(expr);
+    switch (node.kind())
+    {
+    case ExprKind::ComparisonChain:
+    {
+        const auto& comparison_chain_expr = static_cast<const ComparisonChainExpr&>(node);
+        if (comparison_chain_expr.operators.size() != 1 || comparison_chain_expr.expressions.size() != 2 || asVariable(comparison_chain_expr.expressions[0]) == nullptr)
+        {
+            return std::nullopt;
+        }
+        if (comparison_chain_expr.operators[0] == Member || comparison_chain_expr.operators[0] == NotMember)
+        {
+            const auto has_constant_set = ! comparison_chain_expr.constant_sets.empty() && comparison_chain_expr.constant_sets[0] != nullptr;
+            return has_constant_set ? std::optional{ FusedShape::VariableMembership } : std::nullopt;
+        }
+        const auto kind = unwrap(comparison_chain_expr.expressions[1]).kind();
+        return kind <= ExprKind::String ? std::optional{ FusedShape::VariableComparison } : std::nullopt;
+    }
+    case ExprKind::Mul:
+    {
+        const auto& mul_expr = static_cast<const BinaryExpr&>(node);
+        const auto scales = (asVariable(mul_expr.lhs) != nullptr && isNumberLiteral(mul_expr.rhs)) || (isNumberLiteral(mul_expr.lhs) && asVariable(mul_expr.rhs) != nullptr);
+        return scales ? std::optional{ FusedShape::VariableScale } : std::nullopt;
+    }
+    case ExprKind::Condition:
+    {
+        const auto& condition_expr = static_cast<const ConditionExpr&>(node);
+        const auto selects = asVariable(condition_expr.then_expr) != nullptr && asVariable(condition_expr.else_expr) != nullptr;
+        return selects ? std::optional{ FusedShape::VariableSelection } : std::nullopt;
+    }
+    case ExprKind::FnApplication:
+    {
+        const auto& fn_application_expr = static_cast<const FnApplicationExpr&>(node);
+        const auto* fn = asVariable(fn_application_expr.fn);
+        if (fn == nullptr || fn_application_expr.args.size() != 2 || asVariable(fn_application_expr.args[0]) == nullptr || asVariable(fn_application_expr.args[1]) == nullptr)
+        {
+            return std::nullopt;
+        }
+        if (fn->name == min_name)
+        {
+            return FusedShape::VariableMin;
+        }
+        if (fn->name == max_name)
+        {
+            return FusedShape::VariableMax;
+        }
+        return std::nullopt;
+    }
+    default:
+        return std::nullopt;
+    }
+}
+
+void FusedExpr::refreshShape()
+{
+    shape = matchFusedShape(original);
+    variable.clear();
+    other_variable.clear();
+    constant = eval::Value{};
+    comparison_operator = Equals;
+    constant_set = nullptr;
+    variable_first = true;
+    condition.reset();
+    variable_cache.clear();
+    other_variable_cache.clear();
+    if (! shape.has_value())
+    {
+        return;
+    }
+
+    const auto& node = unwrap(original);
+    switch (shape.value())
+    {
+    case FusedShape::VariableComparison:
+    case FusedShape::VariableMembership:
+    {
+        const auto& comparison_chain_expr = static_cast<const ComparisonChainExpr&>(node);
+        variable = asVariable(comparison_chain_expr.expressions[0])->name;
+        comparison_operator = comparison_chain_expr.operators[0];
+        if (shape == FusedShape::VariableMembership)
+        {
+            constant_set = comparison_chain_expr.constant_sets[0];
+        }
+        else
+        {
+            constant = literalValue(comparison_chain_expr.expressions[1]).value();
+        }
+        return;
+    }
+    case FusedShape::VariableScale:
+    {
+        const auto& mul_expr = static_cast<const BinaryExpr&>(node);
+        variable_first = asVariable(mul_expr.lhs) != nullptr;
+        variable = asVariable(variable_first ? mul_expr.lhs : mul_expr.rhs)->name;
+        constant = literalValue(variable_first ? mul_expr.rhs : mul_expr.lhs).value();
+        return;
+    }
+    case FusedShape::VariableSelection:
+    {
+        const auto& condition_expr = static_cast<const ConditionExpr&>(node);
+        variable = asVariable(condition_expr.then_expr)->name;
+        other_variable = asVariable(condition_expr.else_expr)->name;
+        condition = condition_expr.condition.share();
+        return;
+    }
+    case FusedShape::VariableMin:
+    case FusedShape::VariableMax:
+    {
+        const auto& fn_application_expr = static_cast<const FnApplicationExpr&>(node);
+        variable = asVariable(fn_application_expr.args[0])->name;
+        other_variable = asVariable(fn_application_expr.args[1])->name;
+        return;
+    }
+    }
+}
+
+[[nodiscard]] std::string FusedExpr::toString() const noexcept
+{
+    return original.toString();
+}
+
+[[nodiscard]] eval::Result FusedExpr::evaluate(const env::Environment* environment) const noexcept
+{
+    if (! shape.has_value())
+    {
+        return original.evaluate(environment);
+    }
+
+    switch (shape.value())
+    {
+    case FusedShape::VariableComparison:
+    {
+        const auto value = variable_cache.get(environment, variable);
+        if (! value.has_value())
+        {
+            return zeus::unexpected(eval::Error::UndefinedVariable);
+        }
+        const auto comparison_result = compare(comparison_operator, value.value(), constant);
+        if (! comparison_result.has_value())
+        {
+            return zeus::unexpected(comparison_result.error());
+        }
+        return comparison_result.value().isTruthy();
+    }
+    case FusedShape::VariableMembership:
+    {
+        const auto value = variable_cache.get(environment, variable);
+        if (! value.has_value())
+        {
+            return zeus::unexpected(eval::Error::UndefinedVariable);
+        }
+        return constant_set->contains(value.value()) == (comparison_operator == Member);
+    }
+    case FusedShape::VariableScale:
+    {
+        const auto value = variable_cache.get(environment, variable);
+        if (! value.has_value())
+        {
+            return zeus::unexpected(eval::Error::UndefinedVariable);
+        }
+        return variable_first ? value.value() * constant : constant * value.value();
+    }
+    case FusedShape::VariableSelection:
+    {
+        const auto condition_result = condition->evaluate(environment);
+        if (! condition_result.has_value())
+        {
+            return zeus::unexpected(condition_result.error());
+        }
+        auto value = condition_result.value().isTruthy() ? variable_cache.get(environment, variable) : other_variable_cache.get(environment, other_variable);
+        if (! value.has_value())
+        {
+            return zeus::unexpected(eval::Error::UndefinedVariable);
+        }
+        return std::move(value.value());
+    }
+    case FusedShape::VariableMin:
+    case FusedShape::VariableMax:
+    {
+        const auto is_min = shape == FusedShape::VariableMin;
+        const auto fn = environment->get(is_min ? min_name : max_name);
+        if (! fn.has_value())
+        {
+            return zeus::unexpected(eval::Error::UndefinedVariable);
+        }
+        const auto* fn_value = std::get_if<eval::Value::fn_t>(&fn.value().value);
+        if (fn_value == nullptr)
+        {
+            return zeus::unexpected(eval::Error::TypeMismatch);
+        }
+        if (fn_value->target_type() != (is_min ? env::min : env::max).target_type())
+        {
+            // another function by that name, only the builtin is known to pick one of its arguments
+            return original.evaluate(environment);
+        }
+
+        auto lhs = variable_cache.get(environment, variable);
+        if (! lhs.has_value())
+        {
+            return zeus::unexpected(eval::Error::UndefinedVariable);
+        }
+        auto rhs = other_variable_cache.get(environment, other_variable);
+        if (! rhs.has_value())
+        {
+            return zeus::unexpected(eval::Error::UndefinedVariable);
+        }
+        // like the builtins, the first argument wins ties
+        const auto replaces = is_min ? rhs.value() < lhs.value() : rhs.value() > lhs.value();
+        if (! replaces.has_value())
+        {
+            return zeus::unexpected(eval::Error::TypeMismatch);
+        }
+        return replaces.value() ? std::move(rhs.value()) : std::move(lhs.value());
+    }
+    }
+    return original.evaluate(environment);
+}
+
+[[nodiscard]] bool FusedExpr::deepEq(const Expr& other) const noexcept
+{
+    if (const auto* other_fused_expr = other.kind() == ExprKind::Fused ? static_cast<const FusedExpr*>(&other) : nullptr)
+    {
+        return original.deepEq(other_fused_expr->original);
+    }
+    return false;
+}
+
+} // namespace CuraFormulaeEngine::ast
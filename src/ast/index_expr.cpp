@@ -37,28 +37,13 @@ namespace CuraFormulaeEngine::ast
     return array_value[index_value];
 }
 
-[[nodiscard]] std::unordered_set<std::string> IndexExpr::freeVariables() const noexcept
-{
-    auto array_vars = array.freeVariables();
-    auto index_vars = index.freeVariables();
-    array_vars.insert(index_vars.begin(), index_vars.end());
-    return array_vars;
-}
-
 [[nodiscard]] bool IndexExpr::deepEq(const Expr& other) const noexcept
 {
-    if (const auto other_index_expr = dynamic_cast<const IndexExpr*>(&other))
+    if (const auto other_index_expr = other.kind() == ExprKind::Index ? static_cast<const IndexExpr*>(&other) : nullptr)
     {
         return array.deepEq(other_index_expr->array) && index.deepEq(other_index_expr->index);
     }
     return false;
 }
 
-void IndexExpr::visitAll(std::function<void(const Expr&)> visitor) const noexcept
-{
-    visitor(*this);
-    array.visitAll(visitor);
-    index.visitAll(visitor);
-}
-
 } // namespace CuraFormulaeEngine::ast
@@ -0,0 +1,39 @@
+#include "cura-formulae-engine/ast/let_expr.h"
+#include "cura-formulae-engine/ast/ast.h"
+
+#include <fmt/format.h>
+#include <zeus/expected.hpp>
+
+#include <string>
+
+namespace CuraFormulaeEngine::ast
+{
+
+[[nodiscard]] std::string LetExpr::toString() const noexcept
+{
+    return fmt::format("(let {} = {} in {})", name, value.toString(), body.toString());
+}
+
+[[nodiscard]] eval::Result LetExpr::evaluate(const env::Environment* environment) const noexcept
+{
+    const auto value_result = value.evaluate(environment);
+    if (! value_result.has_value())
+    {
+        return zeus::unexpected(value_result.error());
+    }
+
+    env::LocalEnvironment local_environment{ environment };
+    local_environment.set(name, value_result.value());
+    return body.evaluate(&local_environment);
+}
+
+[[nodiscard]] bool LetExpr::deepEq(const Expr& other) const noexcept
+{
+    if (const auto* other_let_expr = other.kind() == ExprKind::Let ? static_cast<const LetExpr*>(&other) : nullptr)
+    {
+        return name == other_let_expr->name && value.deepEq(other_let_expr->value) && body.deepEq(other_let_expr->body);
+    }
+    return false;
+}
+
+} // namespace CuraFormulaeEngine::ast
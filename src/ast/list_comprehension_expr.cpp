@@ -9,6 +9,7 @@
 #include <range/v3/view/transform.hpp>
 #include <range/v3/view/zip.hpp>
 
+#include <algorithm>
 #include <optional>
 #include <unordered_set>
 #include <variant>
@@ -38,7 +39,26 @@ namespace CuraFormulaeEngine::ast
     return fmt::format("({} {})", iterator.toString(), loops_str);
 }
 
-std::optional<eval::Error> ListComprehensionExpr::handle_loop(const size_t loop_index, env::LocalEnvironment& local_environment, std::vector<eval::Value>& results) const
+std::vector<std::optional<std::size_t>> ListComprehensionExpr::iterableDependencies() const
+{
+    std::vector<std::optional<std::size_t>> dependencies(loops.size());
+    for (std::size_t loop = 1; loop < loops.size(); ++loop)
+    {
+        const auto& symbols = loops[loop].iterable.freeSymbols();
+        for (std::size_t outer = loop; outer-- > 0;)
+        {
+            const auto& keys = loops[outer].iterator_key.freeSymbols();
+            if (std::any_of(keys.begin(), keys.end(), [&symbols](const auto key) { return symbols.contains(key); }))
+            {
+                dependencies[loop] = outer;
+                break;
+            }
+        }
+    }
+    return dependencies;
+}
+
+std::optional<eval::Error> ListComprehensionExpr::handle_loop(const size_t loop_index, env::LocalEnvironment& local_environment, loop_state& state, std::vector<eval::Value>& results) const
 {
     if (loop_index >= loops.size())
     {
@@ -47,18 +67,29 @@ std::optional<eval::Error> ListComprehensionExpr::handle_loop(const size_t loop_
     }
 
     const auto& loop = loops[loop_index];
-    const auto iterable_result = try_get<std::vector<eval::Value>>(loop.iterable.evaluate(&local_environment));
-    if (! iterable_result.has_value())
+    auto& iterable = state.iterables[loop_index];
+    if (! iterable.has_value())
     {
-        return iterable_result.error();
+        auto iterable_result = try_get<std::vector<eval::Value>>(loop.iterable.evaluate(&local_environment));
+        if (! iterable_result.has_value())
+        {
+            return iterable_result.error();
+        }
+        iterable = std::move(iterable_result.value());
     }
-    const auto iterable_value = iterable_result.value();
 
-    for (const auto& element : iterable_value)
+    for (const auto& element : iterable.value())
     {
-        for (const auto& key : loop.iterator_key.freeVariables())
+        for (const auto key : loop.iterator_key.freeSymbols())
+        {
+            local_environment.set(symbolName(key), element);
+        }
+        for (auto inner = loop_index + 1; inner < loops.size(); ++inner)
         {
-            local_environment.set(key, element);
+            if (state.dependencies[inner] == loop_index)
+            {
+                state.iterables[inner].reset();
+            }
         }
 
         auto exit_loop = false;
@@ -94,7 +125,7 @@ std::optional<eval::Error> ListComprehensionExpr::handle_loop(const size_t loop_
         }
         else
         {
-            const auto loop_err = handle_loop(loop_index + 1, local_environment, results);
+            const auto loop_err = handle_loop(loop_index + 1, local_environment, state, results);
             if (loop_err.has_value())
             {
                 return loop_err.value();
@@ -108,8 +139,9 @@ std::optional<eval::Error> ListComprehensionExpr::handle_loop(const size_t loop_
 [[nodiscard]] eval::Result ListComprehensionExpr::evaluate(const env::Environment* environment) const noexcept
 {
     env::LocalEnvironment local_environment { environment };
+    loop_state state{ iterableDependencies(), std::vector<std::optional<std::vector<eval::Value>>>(loops.size()) };
     std::vector<eval::Value> results;
-    const auto loop_err = handle_loop(0, local_environment, results);
+    const auto loop_err = handle_loop(0, local_environment, state, results);
     if (loop_err.has_value())
     {
         return zeus::unexpected(loop_err.value());
@@ -117,42 +149,9 @@ std::optional<eval::Error> ListComprehensionExpr::handle_loop(const size_t loop_
     return eval::Value{ results };
 }
 
-[[nodiscard]] std::unordered_set<std::string> ListComprehensionExpr::freeVariables() const noexcept
-{
-    std::unordered_set<std::string> free_variables = {};
-    std::unordered_set<std::string> local_variables = {};
-    for (const auto& loop : loops)
-    {
-        for (const auto& key : loop.iterable.freeVariables())
-        {
-            if (local_variables.contains(key))
-            {
-                continue;
-            }
-            free_variables.insert(key);
-        }
-        for (const auto& condition : loop.conditions)
-        {
-            for (const auto& key : condition.freeVariables())
-            {
-                if (local_variables.contains(key))
-                {
-                    continue;
-                }
-                free_variables.insert(key);
-            }
-        }
-        for (const auto& key : loop.iterator_key.freeVariables())
-        {
-            local_variables.insert(key);
-        }
-    }
-    return free_variables;
-}
-
 [[nodiscard]] bool ListComprehensionExpr::deepEq(const Expr& other) const noexcept
 {
-    if (const auto other_list_comprehension = dynamic_cast<const ListComprehensionExpr*>(&other))
+    if (const auto other_list_comprehension = other.kind() == ExprKind::ListComprehension ? static_cast<const ListComprehensionExpr*>(&other) : nullptr)
     {
         if (loops.size() != other_list_comprehension->loops.size())
         {
@@ -187,21 +186,4 @@ std::optional<eval::Error> ListComprehensionExpr::handle_loop(const size_t loop_
     return false;
 }
 
-void ListComprehensionExpr::visitAll(std::function<void(const Expr&)> visitor) const noexcept
-{
-    visitor(*this);
-
-    iterator.visitAll(visitor);
-
-    for (const auto& loop : loops)
-    {
-        loop.iterator_key.visitAll(visitor);
-        loop.iterable.visitAll(visitor);
-        for (const auto& condition : loop.conditions)
-        {
-            condition.visitAll(visitor);
-        }
-    }
-}
-
 } // namespace CuraFormulaeEngine::ast
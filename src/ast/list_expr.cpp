@@ -41,20 +41,9 @@ namespace CuraFormulaeEngine::ast
     return std::move(results);
 }
 
-[[nodiscard]] std::unordered_set<std::string> ListExpr::freeVariables() const noexcept
-{
-    std::unordered_set<std::string> result;
-    for (const auto& element : elements)
-    {
-        const auto element_vars = element.freeVariables();
-        result.insert(element_vars.begin(), element_vars.end());
-    }
-    return result;
-}
-
 [[nodiscard]] bool ListExpr::deepEq(const Expr& other) const noexcept
 {
-    if (auto other_list_expr = dynamic_cast<const ListExpr*>(&other))
+    if (auto other_list_expr = other.kind() == ExprKind::List ? static_cast<const ListExpr*>(&other) : nullptr)
     {
         if (elements.size() != other_list_expr->elements.size())
         {
@@ -73,14 +62,4 @@ namespace CuraFormulaeEngine::ast
     return false;
 }
 
-void ListExpr::visitAll(std::function<void(const Expr&)> visitor) const noexcept
-{
-    visitor(*this);
-
-    for (const auto& element : elements)
-    {
-        element.visitAll(visitor);
-    }
-}
-
 } // namespace CuraFormulaeEngine::ast
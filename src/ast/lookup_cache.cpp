@@ -0,0 +1,136 @@
+#include "cura-formulae-engine/ast/lookup_cache.h"
+
+#include "cura-formulae-engine/ast/ast.h"
+#include "cura-formulae-engine/eval.h"
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <typeinfo>
+
+namespace CuraFormulaeEngine::ast
+{
+
+namespace
+{
+
+std::atomic<bool> statistics_enabled{ false };
+std::atomic<std::uint64_t> hits{ 0 };
+std::atomic<std::uint64_t> misses{ 0 };
+std::atomic<std::uint64_t> uncached{ 0 };
+
+void count(std::atomic<std::uint64_t>& counter) noexcept
+{
+    if (statistics_enabled.load(std::memory_order_relaxed))
+    {
+        counter.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief The generations of an environment, if it has them.
+ *
+ * Formulas are mostly evaluated against an `EnvironmentMap` or a `LocalEnvironment`, which are told apart by their
+ * type without the cost of a `dynamic_cast`.
+ */
+const env::GenerationalEnvironment* generational(const env::Environment* environment) noexcept
+{
+    const auto& type = typeid(*environment);
+    if (type == typeid(env::EnvironmentMap))
+    {
+        return static_cast<const env::EnvironmentMap*>(environment);
+    }
+    if (type == typeid(env::LocalEnvironment))
+    {
+        return nullptr;
+    }
+    return dynamic_cast<const env::GenerationalEnvironment*>(environment);
+}
+
+} // namespace
+
+std::optional<eval::Value> LookupCache::get(const env::Environment* environment, const std::string& key) const noexcept
+{
+    const auto* generational_environment = generational(environment);
+    if (generational_environment == nullptr)
+    {
+        count(uncached);
+        return environment->get(key);
+    }
+    const auto generation = generational_environment->generation();
+    if (const auto* value = cached(environment, generation); value != nullptr)
+    {
+        count(hits);
+        return *value;
+    }
+
+    count(misses);
+    const auto* value = generational_environment->find(key);
+    if (value == nullptr)
+    {
+        // an undefined variable is an error, not worth caching
+        return std::nullopt;
+    }
+    store(environment, generation, value);
+    return *value;
+}
+
+void LookupCache::clear() noexcept
+{
+    store(nullptr, 0, nullptr);
+}
+
+const eval::Value* LookupCache::cached(const env::Environment* environment, std::uint64_t generation) const noexcept
+{
+    const auto sequence = sequence_.load(std::memory_order_acquire);
+    if (sequence % 2 != 0)
+    {
+        return nullptr;
+    }
+    const auto* cached_environment = environment_.load(std::memory_order_relaxed);
+    const auto cached_generation = generation_.load(std::memory_order_relaxed);
+    const auto* cached_value = value_.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence_.load(std::memory_order_relaxed) != sequence)
+    {
+        return nullptr;
+    }
+    return cached_environment == environment && cached_generation == generation ? cached_value : nullptr;
+}
+
+void LookupCache::store(const env::Environment* environment, std::uint64_t generation, const eval::Value* value) const noexcept
+{
+    auto sequence = sequence_.load(std::memory_order_relaxed);
+    if (sequence % 2 != 0 || ! sequence_.compare_exchange_strong(sequence, sequence + 1, std::memory_order_acquire, std::memory_order_relaxed))
+    {
+        // another thread is updating the cache, its entry is as good as this one
+        return;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    environment_.store(environment, std::memory_order_relaxed);
+    generation_.store(generation, std::memory_order_relaxed);
+    value_.store(value, std::memory_order_relaxed);
+    sequence_.store(sequence + 2, std::memory_order_release);
+}
+
+void setLookupStatisticsEnabled(bool enabled) noexcept
+{
+    statistics_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+LookupStatistics lookupStatistics() noexcept
+{
+    return LookupStatistics{ .hits = hits.load(std::memory_order_relaxed),
+                             .misses = misses.load(std::memory_order_relaxed),
+                             .uncached = uncached.load(std::memory_order_relaxed) };
+}
+
+void resetLookupStatistics() noexcept
+{
+    hits.store(0, std::memory_order_relaxed);
+    misses.store(0, std::memory_order_relaxed);
+    uncached.store(0, std::memory_order_relaxed);
+}
+
+} // namespace CuraFormulaeEngine::ast
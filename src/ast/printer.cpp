@@ -0,0 +1,421 @@
+#include "cura-formulae-engine/ast/printer.h"
+
+#include "cura-formulae-engine/ast/binary_expr/binary_expr.h"
+#include "cura-formulae-engine/ast/comp_chain_expr.h"
+#include "cura-formulae-engine/ast/condition_expr.h"
+#include "cura-formulae-engine/ast/expr_ptr.h"
+#include "cura-formulae-engine/ast/flat_expr.h"
+#include "cura-formulae-engine/ast/fn_application_expr.h"
+#include "cura-formulae-engine/ast/fused_expr.h"
+#include "cura-formulae-engine/ast/index_expr.h"
+#include "cura-formulae-engine/ast/let_expr.h"
+#include "cura-formulae-engine/ast/list_comprehension_expr.h"
+#include "cura-formulae-engine/ast/list_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/bool_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/float_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/int_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/string_expr.h"
+#include "cura-formulae-engine/ast/slice_expr.h"
+#include "cura-formulae-engine/ast/tuple_expr.h"
+#include "cura-formulae-engine/ast/unary_expr/unary_expr.h"
+#include "cura-formulae-engine/ast/variable_expr.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace CuraFormulaeEngine::ast
+{
+
+namespace
+{
+
+/**
+ * @brief How tightly an expression binds, from the grammar: a child binding less tightly than its position requires
+ * is put in parentheses.
+ */
+enum Precedence
+{
+    ConditionPrecedence,
+    OrPrecedence,
+    AndPrecedence,
+    NotPrecedence,
+    ComparisonPrecedence,
+    SumPrecedence,
+    ProductPrecedence,
+    PrefixPrecedence,
+    PowerPrecedence,
+    AtomPrecedence
+};
+
+const Expr& unwrap(const Expr& expr) noexcept
+{
+    // a fused node prints as the subexpression it evaluates
+    const auto* node = &expr;
+    while (node->kind() == ExprKind::Ptr || node->kind() == ExprKind::Fused)
+    {
+        node = node->kind() == ExprKind::Ptr ? static_cast<const ExprPtr*>(node)->ptr.get() : static_cast<const FusedExpr*>(node)->original.ptr.get();
+    }
+    return *node;
+}
+
+Precedence precedence(const Expr& node) noexcept
+{
+    switch (node.kind())
+    {
+    case ExprKind::Neg:
+        return PrefixPrecedence;
+    case ExprKind::Not:
+        return NotPrecedence;
+    case ExprKind::Add:
+    case ExprKind::Sub:
+        return SumPrecedence;
+    case ExprKind::Mul:
+    case ExprKind::Div:
+    case ExprKind::Mod:
+        return ProductPrecedence;
+    case ExprKind::Pow:
+        return PowerPrecedence;
+    case ExprKind::And:
+        return AndPrecedence;
+    case ExprKind::Or:
+        return OrPrecedence;
+    case ExprKind::ComparisonChain:
+        return ComparisonPrecedence;
+    case ExprKind::Condition:
+        return ConditionPrecedence;
+    default:
+        return AtomPrecedence;
+    }
+}
+
+std::string_view comparisonOperator(ComparisonOperators comparison_operator) noexcept
+{
+    switch (comparison_operator)
+    {
+    case Equals:
+        return " == ";
+    case NotEquals:
+        return " != ";
+    case LessThan:
+        return " < ";
+    case GreaterThan:
+        return " > ";
+    case LessThenEqual:
+        return " <= ";
+    case GreaterThenEqual:
+        return " >= ";
+    case NotMember:
+        return " not in ";
+    case Member:
+        return " in ";
+    }
+    return " ? ";
+}
+
+class Printer
+{
+public:
+    Printer(std::string& buffer, PrintStyle style) noexcept
+        : buffer_(buffer)
+        , style_(style)
+    {
+    }
+
+    /**
+     * @brief Prints `expr` in a position where expressions binding at least as tightly as `position` need no
+     * parentheses.
+     */
+    void print(const Expr& expr, Precedence position)
+    {
+        const auto& node = unwrap(expr);
+        const auto node_precedence = precedence(node);
+        const auto parenthesize = node_precedence < position || (style_ == PrintStyle::Full && node.kind() >= ExprKind::Neg && node_precedence < AtomPrecedence);
+        if (parenthesize)
+        {
+            buffer_ += '(';
+        }
+        printNode(node);
+        if (parenthesize)
+        {
+            buffer_ += ')';
+        }
+    }
+
+private:
+    void printNode(const Expr& node)
+    {
+        switch (node.kind())
+        {
+        case ExprKind::Bool:
+            buffer_ += static_cast<const BoolExpr&>(node).value ? "True" : "False";
+            return;
+        case ExprKind::Float:
+        {
+            // the grammar has no negative literals, a sign is written like a negation in parentheses
+            const auto value = static_cast<const FloatExpr&>(node).value;
+            const auto negative = std::signbit(value);
+            if (negative)
+            {
+                buffer_ += '(';
+            }
+            if (std::isnan(value) || std::isinf(value))
+            {
+                // infinities and NaN have no literal, they are written as the constants of the standard environment
+                buffer_ += negative ? "-" : "";
+                buffer_ += std::isnan(value) ? "math.nan" : "math.inf";
+            }
+            else
+            {
+                // the grammar has no exponents, so floats are written in fixed notation with digits that round-trip
+                std::array<char, 400> digits;
+                const auto end = std::to_chars(digits.data(), digits.data() + digits.size(), value, std::chars_format::fixed).ptr;
+                buffer_.append(digits.data(), end);
+                // whole numbers are written like integers, which would parse as one
+                if (std::find(digits.data(), end, '.') == end)
+                {
+                    buffer_ += ".0";
+                }
+            }
+            if (negative)
+            {
+                buffer_ += ')';
+            }
+            return;
+        }
+        case ExprKind::Int:
+        {
+            const auto value = static_cast<const IntExpr&>(node).value;
+            if (value < 0)
+            {
+                fmt::format_to(std::back_inserter(buffer_), "({})", value);
+                return;
+            }
+            fmt::format_to(std::back_inserter(buffer_), "{}", value);
+            return;
+        }
+        case ExprKind::None:
+            buffer_ += "None";
+            return;
+        case ExprKind::String:
+        {
+            // strings have no escapes, a string holding double quotes is written in single ones
+            const auto& value = static_cast<const StringExpr&>(node).value;
+            const auto quote = value.find('"') == std::string::npos ? '"' : '\'';
+            buffer_ += quote;
+            buffer_ += value;
+            buffer_ += quote;
+            return;
+        }
+        case ExprKind::Variable:
+            buffer_ += static_cast<const VariableExpr&>(node).name;
+            return;
+        case ExprKind::Neg:
+            buffer_ += '-';
+            print(static_cast<const UnaryExpr&>(node).operand, PowerPrecedence);
+            return;
+        case ExprKind::Not:
+            buffer_ += "not ";
+            print(static_cast<const UnaryExpr&>(node).operand, ComparisonPrecedence);
+            return;
+        case ExprKind::Add:
+        case ExprKind::Sub:
+        case ExprKind::Mul:
+        case ExprKind::Div:
+        case ExprKind::Mod:
+        case ExprKind::And:
+        case ExprKind::Or:
+        {
+            // left associative, a right operand of the same precedence needs parentheses
+            const auto& binary_expr = static_cast<const BinaryExpr&>(node);
+            const auto node_precedence = precedence(node);
+            print(binary_expr.lhs, node_precedence);
+            buffer_ += ' ';
+            buffer_ += binary_expr.getOpIdentifier();
+            buffer_ += ' ';
+            print(binary_expr.rhs, static_cast<Precedence>(node_precedence + 1));
+            return;
+        }
+        case ExprKind::Pow:
+        {
+            // right associative, and the left operand is an atom
+            const auto& binary_expr = static_cast<const BinaryExpr&>(node);
+            print(binary_expr.lhs, AtomPrecedence);
+            buffer_ += " ** ";
+            print(binary_expr.rhs, PowerPrecedence);
+            return;
+        }
+        case ExprKind::ComparisonChain:
+        {
+            const auto& comparison_chain_expr = static_cast<const ComparisonChainExpr&>(node);
+            print(comparison_chain_expr.expressions[0], SumPrecedence);
+            for (std::size_t i = 0; i < comparison_chain_expr.operators.size(); ++i)
+            {
+                buffer_ += comparisonOperator(comparison_chain_expr.operators[i]);
+                print(comparison_chain_expr.expressions[i + 1], SumPrecedence);
+            }
+            return;
+        }
+        case ExprKind::Condition:
+        {
+            const auto& condition_expr = static_cast<const ConditionExpr&>(node);
+            print(condition_expr.then_expr, OrPrecedence);
+            buffer_ += " if ";
+            print(condition_expr.condition, OrPrecedence);
+            buffer_ += " else ";
+            print(condition_expr.else_expr, ConditionPrecedence);
+            return;
+        }
+        case ExprKind::FnApplication:
+        {
+            const auto& fn_application_expr = static_cast<const FnApplicationExpr&>(node);
+            printCallee(fn_application_expr.fn);
+            buffer_ += '(';
+            printSequence(fn_application_expr.args);
+            buffer_ += ')';
+            return;
+        }
+        case ExprKind::Index:
+        {
+            const auto& index_expr = static_cast<const IndexExpr&>(node);
+            printCallee(index_expr.array);
+            buffer_ += '[';
+            print(index_expr.index, ConditionPrecedence);
+            buffer_ += ']';
+            return;
+        }
+        case ExprKind::Slice:
+        {
+            const auto& slice_expr = static_cast<const SliceExpr&>(node);
+            printCallee(slice_expr.array);
+            buffer_ += '[';
+            if (slice_expr.start_index.has_value())
+            {
+                print(slice_expr.start_index.value(), ConditionPrecedence);
+            }
+            buffer_ += ':';
+            if (slice_expr.end_index.has_value())
+            {
+                print(slice_expr.end_index.value(), ConditionPrecedence);
+            }
+            if (slice_expr.step_size.has_value())
+            {
+                buffer_ += ':';
+                print(slice_expr.step_size.value(), ConditionPrecedence);
+            }
+            buffer_ += ']';
+            return;
+        }
+        case ExprKind::List:
+            buffer_ += '[';
+            printSequence(static_cast<const ListExpr&>(node).elements);
+            buffer_ += ']';
+            return;
+        case ExprKind::Tuple:
+        {
+            const auto& elements = static_cast<const TupleExpr&>(node).elements;
+            buffer_ += '(';
+            printSequence(elements);
+            if (elements.size() == 1)
+            {
+                buffer_ += ',';
+            }
+            buffer_ += ')';
+            return;
+        }
+        case ExprKind::ListComprehension:
+        {
+            const auto& list_comprehension_expr = static_cast<const ListComprehensionExpr&>(node);
+            buffer_ += '[';
+            print(list_comprehension_expr.iterator, OrPrecedence);
+            for (const auto& loop : list_comprehension_expr.loops)
+            {
+                buffer_ += " for ";
+                print(loop.iterator_key, AtomPrecedence);
+                buffer_ += " in ";
+                print(loop.iterable, OrPrecedence);
+                for (const auto& condition : loop.conditions)
+                {
+                    buffer_ += " if ";
+                    print(condition, OrPrecedence);
+                }
+            }
+            buffer_ += ']';
+            return;
+        }
+        case ExprKind::Let:
+        {
+            const auto& let_expr = static_cast<const LetExpr&>(node);
+            buffer_ += "(let ";
+            buffer_ += let_expr.name;
+            buffer_ += " = ";
+            print(let_expr.value, ConditionPrecedence);
+            buffer_ += " in ";
+            print(let_expr.body, ConditionPrecedence);
+            buffer_ += ')';
+            return;
+        }
+        case ExprKind::Flat:
+            print(static_cast<const FlatExpr&>(node).toExpr(), ConditionPrecedence);
+            return;
+        case ExprKind::Fused:
+        case ExprKind::Ptr:
+            break;
+        }
+    }
+
+    /**
+     * @brief Prints what is called or indexed; anything but a variable needs parentheses.
+     */
+    void printCallee(const ExprPtr& callee)
+    {
+        if (unwrap(callee).kind() == ExprKind::Variable)
+        {
+            printNode(unwrap(callee));
+            return;
+        }
+        buffer_ += '(';
+        print(callee, ConditionPrecedence);
+        buffer_ += ')';
+    }
+
+    void printSequence(const std::vector<ExprPtr>& elements)
+    {
+        for (std::size_t i = 0; i < elements.size(); ++i)
+        {
+            if (i > 0)
+            {
+                buffer_ += ", ";
+            }
+            print(elements[i], ConditionPrecedence);
+        }
+    }
+
+    std::string& buffer_;
+    PrintStyle style_;
+};
+
+} // namespace
+
+void printTo(std::string& buffer, const Expr& expr, PrintStyle style)
+{
+    Printer{ buffer, style }.print(expr, ConditionPrecedence);
+}
+
+std::string print(const Expr& expr, PrintStyle style)
+{
+    std::string buffer;
+    printTo(buffer, expr, style);
+    return buffer;
+}
+
+} // namespace CuraFormulaeEngine::ast
@@ -27,12 +27,12 @@ namespace CuraFormulaeEngine::ast
     std::int64_t step_size_value = int64_t(1);
     if (step_size.has_value())
     {
-        const auto end_index_result = try_get<std::int64_t>(step_size.value().evaluate(environment));
-        if (! end_index_result.has_value())
+        const auto step_size_result = try_get<std::int64_t>(step_size.value().evaluate(environment));
+        if (! step_size_result.has_value())
         {
-            return zeus::unexpected(end_index_result.error());
+            return zeus::unexpected(step_size_result.error());
         }
-        step_size_value = end_index_result.value();
+        step_size_value = step_size_result.value();
 
         if (step_size_value == int64_t(0))
         {
@@ -45,9 +45,8 @@ namespace CuraFormulaeEngine::ast
     {
         return zeus::unexpected(array_result.error());
     }
-    const auto& array_value = array_result.value();
 
-    std::int64_t start_index_absolute_value = step_size_value > 0 ? 0 : int64_t(array_value.size()) - 1;
+    std::optional<std::int64_t> start_index_value;
     if (start_index.has_value())
     {
         const auto start_index_result = try_get<std::int64_t>(start_index.value().evaluate(environment));
@@ -55,39 +54,56 @@ namespace CuraFormulaeEngine::ast
         {
             return zeus::unexpected(start_index_result.error());
         }
-        const auto start_index_value = start_index_result.value();
+        start_index_value = start_index_result.value();
+    }
 
-        if (start_index_value < int64_t(0))
+    std::optional<std::int64_t> end_index_value;
+    if (end_index.has_value())
+    {
+        const auto end_index_result = try_get<std::int64_t>(end_index.value().evaluate(environment));
+        if (! end_index_result.has_value())
         {
-            start_index_absolute_value = int64_t(array_value.size()) - -start_index_value - int64_t(1);
+            return zeus::unexpected(end_index_result.error());
+        }
+        end_index_value = end_index_result.value();
+    }
+
+    return slice(array_result.value(), start_index_value, end_index_value, step_size_value);
+}
+
+[[nodiscard]] eval::Value SliceExpr::slice(
+    const std::vector<eval::Value>& array_value,
+    std::optional<std::int64_t> start_index_value,
+    std::optional<std::int64_t> end_index_value,
+    std::int64_t step_size_value) noexcept
+{
+    std::int64_t start_index_absolute_value = step_size_value > 0 ? 0 : int64_t(array_value.size()) - 1;
+    if (start_index_value.has_value())
+    {
+        if (start_index_value.value() < int64_t(0))
+        {
+            start_index_absolute_value = int64_t(array_value.size()) - -start_index_value.value() - int64_t(1);
             start_index_absolute_value = std::max(start_index_absolute_value, int64_t(0));
         }
         else
         {
-            start_index_absolute_value = start_index_value;
+            start_index_absolute_value = start_index_value.value();
             start_index_absolute_value = std::min(start_index_absolute_value, static_cast<std::int64_t>(array_value.size()) - int64_t(1));
         }
         start_index_absolute_value = std::min(start_index_absolute_value, static_cast<std::int64_t>(array_value.size()) - int64_t(1));
     }
 
     std::int64_t end_index_absolute_value = step_size_value > int64_t(0) ? static_cast<std::int64_t>(array_value.size()) - int64_t(1) : int64_t(0);
-    if (end_index.has_value())
+    if (end_index_value.has_value())
     {
-        const auto end_index_result = try_get<std::int64_t>(end_index.value().evaluate(environment));
-        if (! end_index_result.has_value())
-        {
-            return zeus::unexpected(end_index_result.error());
-        }
-        const auto end_index_value = end_index_result.value();
-
-        if (end_index_value < int64_t(0))
+        if (end_index_value.value() < int64_t(0))
         {
-            end_index_absolute_value = int64_t(array_value.size()) - -end_index_value - int64_t(1);
+            end_index_absolute_value = int64_t(array_value.size()) - -end_index_value.value() - int64_t(1);
             end_index_absolute_value = std::max(end_index_absolute_value, int64_t(0));
         }
         else
         {
-            end_index_absolute_value = end_index_value;
+            end_index_absolute_value = end_index_value.value();
             end_index_absolute_value = std::min(end_index_absolute_value, static_cast<std::int64_t>(array_value.size()) - int64_t(1));
         }
     }
@@ -112,30 +128,9 @@ namespace CuraFormulaeEngine::ast
     return result;
 }
 
-[[nodiscard]] std::unordered_set<std::string> SliceExpr::freeVariables() const noexcept
-{
-    auto free_vars = array.freeVariables();
-    if (start_index.has_value())
-    {
-        const auto start_index_vars = start_index.value().freeVariables();
-        free_vars.insert(start_index_vars.begin(), start_index_vars.end());
-    }
-    if (end_index.has_value())
-    {
-        const auto end_index_vars = end_index.value().freeVariables();
-        free_vars.insert(end_index_vars.begin(), end_index_vars.end());
-    }
-    if (step_size.has_value())
-    {
-        const auto step_size_vars = step_size.value().freeVariables();
-        free_vars.insert(step_size_vars.begin(), step_size_vars.end());
-    }
-    return free_vars;
-}
-
 [[nodiscard]] bool SliceExpr::deepEq(const Expr& other) const noexcept
 {
-    if (const auto other_slice_expr = dynamic_cast<const SliceExpr*>(&other))
+    if (const auto other_slice_expr = other.kind() == ExprKind::Slice ? static_cast<const SliceExpr*>(&other) : nullptr)
     {
         return array.deepEq(other_slice_expr->array) && start_index.has_value() == other_slice_expr->start_index.has_value()
                && (! start_index.has_value() || start_index.value().deepEq(other_slice_expr->start_index.value()))
@@ -145,23 +140,4 @@ namespace CuraFormulaeEngine::ast
     return false;
 }
 
-void SliceExpr::visitAll(std::function<void(const Expr&)> visitor) const noexcept
-{
-    visitor(*this);
-
-    array.visitAll(visitor);
-    if (start_index.has_value())
-    {
-        start_index.value().visitAll(visitor);
-    }
-    if (end_index.has_value())
-    {
-        end_index.value().visitAll(visitor);
-    }
-    if (step_size.has_value())
-    {
-        step_size.value().visitAll(visitor);
-    }
-}
-
 } // namespace CuraFormulaeEngine::ast
@@ -0,0 +1,122 @@
+#include "cura-formulae-engine/ast/symbol.h"
+
+#include <algorithm>
+#include <deque>
+#include <iterator>
+#include <optional>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace CuraFormulaeEngine::ast
+{
+
+namespace
+{
+
+struct SymbolTable
+{
+    std::shared_mutex mutex;
+
+    // a deque never moves its elements, so the views in `symbols` stay valid
+    std::deque<std::string> names;
+    std::unordered_map<std::string_view, symbol_t> symbols;
+};
+
+SymbolTable& symbolTable()
+{
+    static SymbolTable table;
+    return table;
+}
+
+std::optional<symbol_t> find(SymbolTable& table, std::string_view name)
+{
+    std::shared_lock lock{ table.mutex };
+    const auto symbol = table.symbols.find(name);
+    if (symbol == table.symbols.end())
+    {
+        return std::nullopt;
+    }
+    return symbol->second;
+}
+
+} // namespace
+
+symbol_t intern(std::string_view name)
+{
+    auto& table = symbolTable();
+    if (const auto symbol = find(table, name); symbol.has_value())
+    {
+        return symbol.value();
+    }
+
+    std::unique_lock lock{ table.mutex };
+    if (const auto symbol = table.symbols.find(name); symbol != table.symbols.end())
+    {
+        return symbol->second;
+    }
+    const auto symbol = static_cast<symbol_t>(table.names.size());
+    const auto& stored = table.names.emplace_back(name);
+    table.symbols.emplace(stored, symbol);
+    return symbol;
+}
+
+const std::string& symbolName(symbol_t symbol) noexcept
+{
+    auto& table = symbolTable();
+    std::shared_lock lock{ table.mutex };
+    return table.names[symbol];
+}
+
+bool SymbolSet::contains(symbol_t symbol) const noexcept
+{
+    return std::ranges::binary_search(symbols_, symbol);
+}
+
+bool SymbolSet::contains(std::string_view name) const noexcept
+{
+    const auto symbol = find(symbolTable(), name);
+    return symbol.has_value() && contains(symbol.value());
+}
+
+void SymbolSet::merge(const SymbolSet& other)
+{
+    if (other.symbols_.empty())
+    {
+        return;
+    }
+    if (symbols_.empty())
+    {
+        symbols_ = other.symbols_;
+        return;
+    }
+    std::vector<symbol_t> merged;
+    merged.reserve(symbols_.size() + other.symbols_.size());
+    std::ranges::set_union(symbols_, other.symbols_, std::back_inserter(merged));
+    symbols_ = std::move(merged);
+}
+
+void SymbolSet::erase(const SymbolSet& other)
+{
+    if (symbols_.empty() || other.symbols_.empty())
+    {
+        return;
+    }
+    std::vector<symbol_t> remaining;
+    remaining.reserve(symbols_.size());
+    std::ranges::set_difference(symbols_, other.symbols_, std::back_inserter(remaining));
+    symbols_ = std::move(remaining);
+}
+
+std::unordered_set<std::string> SymbolSet::names() const
+{
+    std::unordered_set<std::string> names;
+    names.reserve(symbols_.size());
+    for (const auto symbol : symbols_)
+    {
+        names.insert(symbolName(symbol));
+    }
+    return names;
+}
+
+} // namespace CuraFormulaeEngine::ast
@@ -41,20 +41,9 @@ namespace CuraFormulaeEngine::ast
     return std::move(results);
 }
 
-[[nodiscard]] std::unordered_set<std::string> TupleExpr::freeVariables() const noexcept
-{
-    std::unordered_set<std::string> result;
-    for (const auto& element : elements)
-    {
-        auto element_vars = element.freeVariables();
-        result.insert(element_vars.begin(), element_vars.end());
-    }
-    return result;
-}
-
 [[nodiscard]] bool TupleExpr::deepEq(const Expr& other) const noexcept
 {
-    if (const auto* other_tuple_expr = dynamic_cast<const TupleExpr*>(&other))
+    if (const auto* other_tuple_expr = other.kind() == ExprKind::Tuple ? static_cast<const TupleExpr*>(&other) : nullptr)
     {
         if (elements.size() != other_tuple_expr->elements.size())
         {
@@ -72,14 +61,4 @@ namespace CuraFormulaeEngine::ast
     return false;
 }
 
-void TupleExpr::visitAll(std::function<void(const Expr&)> visitor) const noexcept
-{
-    visitor(*this);
-
-    for (const auto& element : elements)
-    {
-        element.visitAll(visitor);
-    }
-}
-
 } // namespace CuraFormulaeEngine::ast
@@ -25,14 +25,9 @@ namespace CuraFormulaeEngine::ast
     return evaluate(operand_value);
 }
 
-[[nodiscard]] std::unordered_set<std::string> UnaryExpr::freeVariables() const noexcept
-{
-    return operand.freeVariables();
-}
-
 [[nodiscard]] bool UnaryExpr::deepEq(const Expr& other) const noexcept
 {
-    if (typeid(*this) != typeid(other))
+    if (kind() != other.kind())
     {
         return false;
     }
@@ -40,10 +35,4 @@ namespace CuraFormulaeEngine::ast
     return operand.deepEq(other_UnaryExpr.operand);
 }
 
-void UnaryExpr::visitAll(std::function<void(const Expr&)> visitor) const noexcept
-{
-    visitor(*this);
-    operand.visitAll(visitor);
-}
-
 } // namespace CuraFormulaeEngine::ast
@@ -5,6 +5,7 @@
 #include <zeus/expected.hpp>
 
 #include <string>
+#include <utility>
 #include <unordered_set>
 
 namespace CuraFormulaeEngine::ast
@@ -17,30 +18,20 @@ std::string VariableExpr::toString() const noexcept
 
 eval::Result VariableExpr::evaluate(const env::Environment* environment) const noexcept
 {
-    if (const auto value = environment->get(name); value.has_value())
+    if (auto value = lookup_cache.get(environment, name); value.has_value())
     {
-        return value.value();
+        return std::move(value.value());
     }
     return zeus::unexpected(eval::Error::UndefinedVariable);
 }
 
-std::unordered_set<std::string> VariableExpr::freeVariables() const noexcept
-{
-    return { name };
-}
-
 bool VariableExpr::deepEq(const Expr& other) const noexcept
 {
-    if (const auto* other_variable = dynamic_cast<const VariableExpr*>(&other))
+    if (const auto* other_variable = other.kind() == ExprKind::Variable ? static_cast<const VariableExpr*>(&other) : nullptr)
     {
         return name == other_variable->name;
     }
     return false;
 }
 
-void VariableExpr::visitAll(std::function<void(const Expr&)> visitor) const noexcept
-{
-    visitor(*this);
-}
-
 } // namespace CuraFormulaeEngine::ast
@@ -0,0 +1,26 @@
+#include "cura-formulae-engine/ast/visitor.h"
+
+#include "cura-formulae-engine/ast/flat_expr.h"
+
+#include <functional>
+
+namespace CuraFormulaeEngine::ast
+{
+
+void Expr::visitAll(const std::function<void(const Expr&)>& visitor) const
+{
+    visit(
+        *this,
+        [&visitor](const Expr& node)
+        {
+            if (node.kind() == ExprKind::Flat)
+            {
+                // a flattened formula has no child expressions, visit the equivalent tree instead
+                static_cast<const FlatExpr&>(node).toExpr().visitAll(visitor);
+                return;
+            }
+            visitor(node);
+        });
+}
+
+} // namespace CuraFormulaeEngine::ast
@@ -0,0 +1,110 @@
+#include "cura-formulae-engine/env/concurrent_environment.h"
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+namespace CuraFormulaeEngine::env
+{
+
+ConcurrentEnvironment::ConcurrentEnvironment()
+    : ConcurrentEnvironment(EnvironmentMap{})
+{
+}
+
+ConcurrentEnvironment::ConcurrentEnvironment(EnvironmentMap environment)
+    : current_(std::make_shared<const State>(State{ std::move(environment), 0 }))
+{
+}
+
+ConcurrentEnvironment::state_t ConcurrentEnvironment::state() const noexcept
+{
+#if defined(__cpp_lib_atomic_shared_ptr)
+    return current_.load(std::memory_order_acquire);
+#else
+    return std::atomic_load_explicit(&current_, std::memory_order_acquire);
+#endif
+}
+
+ConcurrentEnvironment::snapshot_t ConcurrentEnvironment::snapshot() const noexcept
+{
+    auto current = state();
+    // shares ownership of the whole state, but only exposes the environment
+    return snapshot_t{ current, &current->environment };
+}
+
+ConcurrentEnvironment::VersionedSnapshot ConcurrentEnvironment::versionedSnapshot() const noexcept
+{
+    auto current = state();
+    const auto version = current->version;
+    const auto* environment = &current->environment;
+    return VersionedSnapshot{ snapshot_t{ std::move(current), environment }, version };
+}
+
+std::uint64_t ConcurrentEnvironment::version() const noexcept
+{
+    return state()->version;
+}
+
+std::optional<eval::Value> ConcurrentEnvironment::get(const std::string& key) const noexcept
+{
+    return snapshot()->get(key);
+}
+
+bool ConcurrentEnvironment::has(const std::string& key) const noexcept
+{
+    return snapshot()->has(key);
+}
+
+std::unordered_map<std::string, eval::Value> ConcurrentEnvironment::getAll() const noexcept
+{
+    return snapshot()->getAll();
+}
+
+void ConcurrentEnvironment::set(const std::string& key, const eval::Value& value)
+{
+    update([&key, &value](EnvironmentMap& environment) { environment.set(key, value); });
+}
+
+bool ConcurrentEnvironment::erase(const std::string& key)
+{
+    const std::lock_guard<std::mutex> lock(writer_mutex_);
+    const auto current = snapshot();
+    if (! current->has(key))
+    {
+        return false;
+    }
+    auto next = current->clone();
+    next.erase(key);
+    publish(std::move(next));
+    return true;
+}
+
+std::unordered_set<std::string> ConcurrentEnvironment::apply(const EnvironmentBatch& batch)
+{
+    const std::lock_guard<std::mutex> lock(writer_mutex_);
+    auto next = snapshot()->clone();
+    auto changed = next.apply(batch);
+    if (! changed.empty())
+    {
+        publish(std::move(next));
+    }
+    return changed;
+}
+
+void ConcurrentEnvironment::publish(EnvironmentMap next)
+{
+    // writers are serialized, so no other writer can publish between reading the version and storing the next one
+    auto state = std::make_shared<const State>(State{ std::move(next), this->state()->version + 1 });
+#if defined(__cpp_lib_atomic_shared_ptr)
+    current_.store(std::move(state), std::memory_order_release);
+#else
+    std::atomic_store_explicit(&current_, std::move(state), std::memory_order_release);
+#endif
+}
+
+} // namespace CuraFormulaeEngine::env
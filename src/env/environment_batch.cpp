@@ -0,0 +1,45 @@
+#include "cura-formulae-engine/env/environment_batch.h"
+
+#include <cstddef>
+#include <optional>
+#include <string>
+
+namespace CuraFormulaeEngine::env
+{
+
+void EnvironmentBatch::reserve(std::size_t count)
+{
+    operations_.reserve(count);
+}
+
+void EnvironmentBatch::set(const std::string& key, const eval::Value& value)
+{
+    operations_.insert_or_assign(key, value);
+}
+
+void EnvironmentBatch::erase(const std::string& key)
+{
+    operations_.insert_or_assign(key, std::nullopt);
+}
+
+void EnvironmentBatch::clear() noexcept
+{
+    operations_.clear();
+}
+
+std::size_t EnvironmentBatch::size() const noexcept
+{
+    return operations_.size();
+}
+
+bool EnvironmentBatch::empty() const noexcept
+{
+    return operations_.empty();
+}
+
+const EnvironmentBatch::operations_t& EnvironmentBatch::operations() const noexcept
+{
+    return operations_;
+}
+
+} // namespace CuraFormulaeEngine::env
@@ -0,0 +1,316 @@
+#include "cura-formulae-engine/env/extruder_environment_family.h"
+
+#include <zeus/expected.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+namespace CuraFormulaeEngine::env
+{
+
+constexpr auto extruder_value_key = "extruderValue";
+constexpr auto extruder_values_key = "extruderValues";
+
+ExtruderEnvironmentFamily::ExtruderEnvironmentFamily(std::size_t extruder_count, const Environment* base_environment)
+    : extruder_count_(extruder_count)
+    , base_environment_(base_environment)
+{
+    views_.reserve(extruder_count_ + 1);
+    views_.emplace_back(this, std::nullopt);
+    for (std::size_t extruder = 0; extruder < extruder_count_; ++extruder)
+    {
+        views_.emplace_back(this, extruder);
+    }
+
+    extruder_value_fn_ = [this](const std::vector<eval::Value>& args) -> eval::Result
+    {
+        if (args.size() != 2)
+        {
+            return zeus::unexpected(eval::Error::InvalidNumberOfArguments);
+        }
+        if (! std::holds_alternative<std::int64_t>(args[0].value) || ! std::holds_alternative<std::string>(args[1].value))
+        {
+            return zeus::unexpected(eval::Error::TypeMismatch);
+        }
+
+        // an extruder number of -1 refers to the global stack
+        const auto extruder_nr = std::get<std::int64_t>(args[0].value);
+        if (extruder_nr < -1 || extruder_nr >= static_cast<std::int64_t>(extruder_count_))
+        {
+            return zeus::unexpected(eval::Error::IndexOutOfBounds);
+        }
+
+        const auto& key = std::get<std::string>(args[1].value);
+        const auto value = extruder_nr == -1 ? lookup(std::nullopt, key) : lookup(static_cast<std::size_t>(extruder_nr), key);
+        if (! value.has_value())
+        {
+            return zeus::unexpected(eval::Error::UndefinedVariable);
+        }
+        return value.value();
+    };
+
+    extruder_values_fn_ = [this](const std::vector<eval::Value>& args) -> eval::Result
+    {
+        if (args.size() != 1)
+        {
+            return zeus::unexpected(eval::Error::InvalidNumberOfArguments);
+        }
+        if (! std::holds_alternative<std::string>(args[0].value))
+        {
+            return zeus::unexpected(eval::Error::TypeMismatch);
+        }
+
+        auto values = extruderValues(std::get<std::string>(args[0].value));
+        if (! values.has_value())
+        {
+            return zeus::unexpected(eval::Error::UndefinedVariable);
+        }
+        return eval::Value(std::move(values.value()));
+    };
+}
+
+std::size_t ExtruderEnvironmentFamily::extruderCount() const noexcept
+{
+    return extruder_count_;
+}
+
+std::optional<ExtruderEnvironmentFamily::slot_t> ExtruderEnvironmentFamily::slot(const std::string& key) const noexcept
+{
+    if (const auto slot = slots_.find(key); slot != slots_.end())
+    {
+        return slot->second;
+    }
+    return std::nullopt;
+}
+
+void ExtruderEnvironmentFamily::setGlobal(const std::string& key, const eval::Value& value)
+{
+    const auto slot = internSlot(key);
+    cells_[slot * stride()] = value;
+}
+
+void ExtruderEnvironmentFamily::setExtruder(std::size_t extruder, const std::string& key, const eval::Value& value)
+{
+    if (extruder >= extruder_count_)
+    {
+        throw std::out_of_range("extruder index out of range");
+    }
+    const auto slot = internSlot(key);
+    cells_[slot * stride() + 1 + extruder] = value;
+}
+
+bool ExtruderEnvironmentFamily::eraseExtruder(std::size_t extruder, const std::string& key) noexcept
+{
+    const auto slot = this->slot(key);
+    if (! slot.has_value() || extruder >= extruder_count_)
+    {
+        return false;
+    }
+
+    auto& cell = cells_[slot.value() * stride() + 1 + extruder];
+    if (! cell.has_value())
+    {
+        return false;
+    }
+    cell.reset();
+    return true;
+}
+
+std::optional<eval::Value> ExtruderEnvironmentFamily::globalValue(const std::string& key) const noexcept
+{
+    return lookup(std::nullopt, key);
+}
+
+std::optional<eval::Value> ExtruderEnvironmentFamily::extruderValue(std::size_t extruder, const std::string& key) const noexcept
+{
+    if (extruder >= extruder_count_)
+    {
+        return std::nullopt;
+    }
+    return lookup(extruder, key);
+}
+
+const eval::Value* ExtruderEnvironmentFamily::extruderValue(std::size_t extruder, slot_t slot) const noexcept
+{
+    if (extruder >= extruder_count_ || slot >= keys_.size())
+    {
+        return nullptr;
+    }
+    return resolve(extruder, slot);
+}
+
+std::optional<std::vector<eval::Value>> ExtruderEnvironmentFamily::extruderValues(const std::string& key) const
+{
+    const auto slot = this->slot(key);
+    if (slot.has_value() && cells_[slot.value() * stride()].has_value())
+    {
+        return extruderValues(slot.value());
+    }
+
+    // without a global value, extruders that do not override the key fall back to the base environment
+    const auto fallback = base_environment_ ? base_environment_->get(key) : std::nullopt;
+    if (! fallback.has_value())
+    {
+        if (! slot.has_value())
+        {
+            return std::nullopt;
+        }
+        return extruderValues(slot.value());
+    }
+
+    std::vector<eval::Value> values;
+    values.reserve(extruder_count_);
+    for (std::size_t extruder = 0; extruder < extruder_count_; ++extruder)
+    {
+        const auto* value = slot.has_value() ? resolve(extruder, slot.value()) : nullptr;
+        values.push_back(value ? *value : fallback.value());
+    }
+    return values;
+}
+
+std::optional<std::vector<eval::Value>> ExtruderEnvironmentFamily::extruderValues(slot_t slot) const
+{
+    if (slot >= keys_.size())
+    {
+        return std::nullopt;
+    }
+
+    std::vector<eval::Value> values;
+    values.reserve(extruder_count_);
+    for (std::size_t extruder = 0; extruder < extruder_count_; ++extruder)
+    {
+        // like extruderValue, an extruder without an override or a global value has no value
+        const auto* value = resolve(extruder, slot);
+        if (value == nullptr)
+        {
+            return std::nullopt;
+        }
+        values.push_back(*value);
+    }
+    return values;
+}
+
+const Environment& ExtruderEnvironmentFamily::global() const noexcept
+{
+    return views_.front();
+}
+
+const Environment& ExtruderEnvironmentFamily::extruder(std::size_t extruder) const
+{
+    return views_.at(extruder + 1);
+}
+
+const eval::Value::fn_t& ExtruderEnvironmentFamily::extruderValueFunction() const noexcept
+{
+    return extruder_value_fn_;
+}
+
+const eval::Value::fn_t& ExtruderEnvironmentFamily::extruderValuesFunction() const noexcept
+{
+    return extruder_values_fn_;
+}
+
+std::size_t ExtruderEnvironmentFamily::stride() const noexcept
+{
+    return extruder_count_ + 1;
+}
+
+ExtruderEnvironmentFamily::slot_t ExtruderEnvironmentFamily::internSlot(const std::string& key)
+{
+    const auto [slot, inserted] = slots_.try_emplace(key, keys_.size());
+    if (inserted)
+    {
+        keys_.push_back(key);
+        cells_.resize(cells_.size() + stride());
+    }
+    return slot->second;
+}
+
+const eval::Value* ExtruderEnvironmentFamily::resolve(std::optional<std::size_t> extruder, slot_t slot) const noexcept
+{
+    const auto row = slot * stride();
+    if (extruder.has_value())
+    {
+        if (const auto& cell = cells_[row + 1 + extruder.value()]; cell.has_value())
+        {
+            return &cell.value();
+        }
+    }
+    if (const auto& cell = cells_[row]; cell.has_value())
+    {
+        return &cell.value();
+    }
+    return nullptr;
+}
+
+std::optional<eval::Value> ExtruderEnvironmentFamily::lookup(std::optional<std::size_t> extruder, const std::string& key) const noexcept
+{
+    if (const auto slot = this->slot(key); slot.has_value())
+    {
+        if (const auto* value = resolve(extruder, slot.value()))
+        {
+            return *value;
+        }
+    }
+    return base_environment_ ? base_environment_->get(key) : std::nullopt;
+}
+
+ExtruderEnvironmentFamily::View::View(const ExtruderEnvironmentFamily* family, std::optional<std::size_t> extruder)
+    : family_(family)
+    , extruder_(extruder)
+{
+}
+
+std::optional<eval::Value> ExtruderEnvironmentFamily::View::get(const std::string& key) const noexcept
+{
+    if (auto value = family_->lookup(extruder_, key); value.has_value())
+    {
+        return value;
+    }
+    if (key == extruder_value_key)
+    {
+        return eval::Value(family_->extruder_value_fn_);
+    }
+    if (key == extruder_values_key)
+    {
+        return eval::Value(family_->extruder_values_fn_);
+    }
+    return std::nullopt;
+}
+
+bool ExtruderEnvironmentFamily::View::has(const std::string& key) const noexcept
+{
+    if (const auto slot = family_->slot(key); slot.has_value() && family_->resolve(extruder_, slot.value()))
+    {
+        return true;
+    }
+    return key == extruder_value_key || key == extruder_values_key || (family_->base_environment_ && family_->base_environment_->has(key));
+}
+
+std::unordered_map<std::string, eval::Value> ExtruderEnvironmentFamily::View::getAll() const noexcept
+{
+    std::unordered_map<std::string, eval::Value> all;
+    if (family_->base_environment_)
+    {
+        all = family_->base_environment_->getAll();
+    }
+    all.try_emplace(extruder_value_key, family_->extruder_value_fn_);
+    all.try_emplace(extruder_values_key, family_->extruder_values_fn_);
+
+    for (std::size_t slot = 0; slot < family_->keys_.size(); ++slot)
+    {
+        if (const auto* value = family_->resolve(extruder_, slot))
+        {
+            all.insert_or_assign(family_->keys_[slot], *value);
+        }
+    }
+    return all;
+}
+
+} // namespace CuraFormulaeEngine::env
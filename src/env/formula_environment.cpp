@@ -0,0 +1,200 @@
+#include "cura-formulae-engine/env/formula_environment.h"
+
+#include <zeus/expected.hpp>
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace CuraFormulaeEngine::env
+{
+
+FormulaEnvironment::FormulaEnvironment(const Environment* base_environment)
+    : base_environment_(base_environment)
+{
+}
+
+std::optional<eval::Value> FormulaEnvironment::get(const std::string& key) const noexcept
+{
+    if (! formulas_.contains(key))
+    {
+        return base_environment_ ? base_environment_->get(key) : std::nullopt;
+    }
+
+    const auto result = evaluate(key);
+    if (! result.has_value())
+    {
+        return std::nullopt;
+    }
+    return result.value();
+}
+
+bool FormulaEnvironment::has(const std::string& key) const noexcept
+{
+    return formulas_.contains(key) || (base_environment_ && base_environment_->has(key));
+}
+
+std::unordered_map<std::string, eval::Value> FormulaEnvironment::getAll() const noexcept
+{
+    std::unordered_map<std::string, eval::Value> all;
+    if (base_environment_)
+    {
+        all = base_environment_->getAll();
+    }
+
+    for (const auto& [key, formula] : formulas_)
+    {
+        if (const auto result = evaluate(key); result.has_value())
+        {
+            all.insert_or_assign(key, result.value());
+        }
+        else
+        {
+            all.erase(key);
+        }
+    }
+    return all;
+}
+
+eval::Result FormulaEnvironment::evaluate(const std::string& key) const noexcept
+{
+    if (const auto evaluated = evaluated_.find(key); evaluated != evaluated_.end())
+    {
+        // a formula reading one that already failed reports its error, whichever was evaluated first
+        if (! evaluated->second.has_value() && ! in_progress_.empty() && ! nested_error_.has_value())
+        {
+            nested_error_ = evaluated->second.error();
+        }
+        return evaluated->second;
+    }
+
+    const auto formula = formulas_.find(key);
+    if (formula == formulas_.end())
+    {
+        if (const auto value = base_environment_ ? base_environment_->get(key) : std::nullopt; value.has_value())
+        {
+            return value.value();
+        }
+        return zeus::unexpected(eval::Error::UndefinedVariable);
+    }
+
+    if (in_progress_.contains(key))
+    {
+        nested_error_ = eval::Error::CyclicDependency;
+        return zeus::unexpected(eval::Error::CyclicDependency);
+    }
+
+    const auto is_outermost = in_progress_.empty();
+    if (is_outermost)
+    {
+        nested_error_.reset();
+    }
+
+    in_progress_.insert(key);
+    auto result = formula->second.evaluate(this);
+    in_progress_.erase(key);
+
+    if (! result.has_value())
+    {
+        // A failing lookup of another formula surfaces as an undefined variable in the formula reading it, report
+        // the error of the formula that actually failed instead.
+        if (nested_error_.has_value())
+        {
+            result = zeus::unexpected(nested_error_.value());
+        }
+        else
+        {
+            nested_error_ = result.error();
+        }
+    }
+
+    evaluated_.insert_or_assign(key, result);
+    if (is_outermost)
+    {
+        nested_error_.reset();
+    }
+    return result;
+}
+
+void FormulaEnvironment::setFormula(const std::string& key, ast::ExprPtr formula)
+{
+    eraseFormula(key);
+
+    for (const auto dependency : formula.freeSymbols())
+    {
+        dependents_[ast::symbolName(dependency)].insert(key);
+    }
+    formulas_.insert_or_assign(key, std::move(formula));
+    invalidate(key);
+}
+
+bool FormulaEnvironment::eraseFormula(const std::string& key)
+{
+    const auto formula = formulas_.find(key);
+    if (formula == formulas_.end())
+    {
+        return false;
+    }
+
+    for (const auto dependency : formula->second.freeSymbols())
+    {
+        if (const auto dependents = dependents_.find(ast::symbolName(dependency)); dependents != dependents_.end())
+        {
+            dependents->second.erase(key);
+            if (dependents->second.empty())
+            {
+                dependents_.erase(dependents);
+            }
+        }
+    }
+    formulas_.erase(formula);
+    invalidate(key);
+    return true;
+}
+
+bool FormulaEnvironment::hasFormula(const std::string& key) const noexcept
+{
+    return formulas_.contains(key);
+}
+
+void FormulaEnvironment::invalidate(const std::string& key)
+{
+    invalidate(std::unordered_set<std::string>{ key });
+}
+
+void FormulaEnvironment::invalidate(const std::unordered_set<std::string>& keys)
+{
+    std::unordered_set<std::string> visited{ keys };
+    std::vector<std::string> pending{ keys.begin(), keys.end() };
+    while (! pending.empty())
+    {
+        const auto current = std::move(pending.back());
+        pending.pop_back();
+        evaluated_.erase(current);
+
+        if (const auto dependents = dependents_.find(current); dependents != dependents_.end())
+        {
+            for (const auto& dependent : dependents->second)
+            {
+                if (visited.insert(dependent).second)
+                {
+                    pending.push_back(dependent);
+                }
+            }
+        }
+    }
+}
+
+void FormulaEnvironment::invalidateAll() noexcept
+{
+    evaluated_.clear();
+}
+
+bool FormulaEnvironment::isEvaluated(const std::string& key) const noexcept
+{
+    return evaluated_.contains(key);
+}
+
+} // namespace CuraFormulaeEngine::env
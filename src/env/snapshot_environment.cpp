@@ -0,0 +1,510 @@
+#include "cura-formulae-engine/env/snapshot_environment.h"
+
+#include "cura-formulae-engine/file.h"
+
+#include <zeus/expected.hpp>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace CuraFormulaeEngine::env
+{
+
+namespace
+{
+
+constexpr std::array<char, 8> snapshot_magic{ 'C', 'F', 'E', 'S', 'N', 'A', 'P', '\0' };
+constexpr std::uint32_t snapshot_format_version = 1;
+
+/*
+ * header: magic[8], u32 format version, u32 reserved, u64 key count, u64 file size
+ * index:  key count entries of u64 key offset, u32 key length, u32 value length, u64 value offset; sorted by key
+ * data:   key bytes and encoded values, all offsets are relative to the start of the file
+ */
+constexpr std::size_t header_size = 32;
+constexpr std::size_t index_entry_size = 24;
+
+enum class Tag : std::uint8_t
+{
+    None,
+    Bool,
+    Float,
+    Int,
+    String,
+    List
+};
+
+template<typename T>
+void append(std::string& buffer, const T& value)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+void store(std::string& buffer, std::size_t offset, const T& value)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    std::memcpy(buffer.data() + offset, &value, sizeof(T));
+}
+
+template<typename T>
+T load(const std::byte* data) noexcept
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+bool encodeValue(std::string& buffer, const eval::Value& value, std::size_t depth = 0)
+{
+    return std::visit(
+        [&buffer, depth]<typename T>(const T& alternative) -> bool
+        {
+            if constexpr (std::is_same_v<T, std::nullptr_t>)
+            {
+                append(buffer, Tag::None);
+            }
+            else if constexpr (std::is_same_v<T, bool>)
+            {
+                append(buffer, Tag::Bool);
+                append(buffer, static_cast<std::uint8_t>(alternative));
+            }
+            else if constexpr (std::is_same_v<T, double>)
+            {
+                append(buffer, Tag::Float);
+                append(buffer, alternative);
+            }
+            else if constexpr (std::is_same_v<T, std::int64_t>)
+            {
+                append(buffer, Tag::Int);
+                append(buffer, alternative);
+            }
+            else if constexpr (std::is_same_v<T, std::string>)
+            {
+                append(buffer, Tag::String);
+                append(buffer, static_cast<std::uint64_t>(alternative.size()));
+                buffer.append(alternative);
+            }
+            else if constexpr (std::is_same_v<T, std::vector<eval::Value>>)
+            {
+                if (depth >= max_snapshot_nesting)
+                {
+                    return false;
+                }
+                append(buffer, Tag::List);
+                append(buffer, static_cast<std::uint64_t>(alternative.size()));
+                return std::ranges::all_of(alternative, [&buffer, depth](const eval::Value& element) { return encodeValue(buffer, element, depth + 1); });
+            }
+            else
+            {
+                return false;
+            }
+            return true;
+        },
+        value.value);
+}
+
+/**
+ * @brief Bounds checked decoding of a single encoded value.
+ */
+class ValueReader
+{
+public:
+    ValueReader(const std::byte* begin, const std::byte* end) noexcept
+        : cursor_(begin)
+        , end_(end)
+    {
+    }
+
+    [[nodiscard]] std::optional<eval::Value> read(std::size_t depth = 0) noexcept
+    {
+        const auto tag = take<Tag>();
+        if (! tag.has_value())
+        {
+            return std::nullopt;
+        }
+
+        switch (tag.value())
+        {
+        case Tag::None:
+            return eval::Value(nullptr);
+        case Tag::Bool:
+            if (const auto value = take<std::uint8_t>(); value.has_value())
+            {
+                return eval::Value(value.value() != 0);
+            }
+            return std::nullopt;
+        case Tag::Float:
+            if (const auto value = take<double>(); value.has_value())
+            {
+                return eval::Value(value.value());
+            }
+            return std::nullopt;
+        case Tag::Int:
+            if (const auto value = take<std::int64_t>(); value.has_value())
+            {
+                return eval::Value(value.value());
+            }
+            return std::nullopt;
+        case Tag::String:
+        {
+            const auto length = take<std::uint64_t>();
+            if (! length.has_value() || length.value() > remaining())
+            {
+                return std::nullopt;
+            }
+            std::string value(reinterpret_cast<const char*>(cursor_), length.value());
+            cursor_ += length.value();
+            return eval::Value(value);
+        }
+        case Tag::List:
+        {
+            // every element takes at least one byte, which bounds the count of a corrupt file
+            const auto count = take<std::uint64_t>();
+            if (depth >= max_snapshot_nesting || ! count.has_value() || count.value() > remaining())
+            {
+                return std::nullopt;
+            }
+            std::vector<eval::Value> values;
+            values.reserve(count.value());
+            for (std::uint64_t i = 0; i < count.value(); ++i)
+            {
+                auto element = read(depth + 1);
+                if (! element.has_value())
+                {
+                    return std::nullopt;
+                }
+                values.push_back(std::move(element.value()));
+            }
+            return eval::Value(values);
+        }
+        }
+        return std::nullopt;
+    }
+
+private:
+    [[nodiscard]] std::size_t remaining() const noexcept
+    {
+        return static_cast<std::size_t>(end_ - cursor_);
+    }
+
+    template<typename T>
+    [[nodiscard]] std::optional<T> take() noexcept
+    {
+        if (remaining() < sizeof(T))
+        {
+            return std::nullopt;
+        }
+        const auto value = load<T>(cursor_);
+        cursor_ += sizeof(T);
+        return value;
+    }
+
+    const std::byte* cursor_;
+    const std::byte* end_;
+};
+
+} // namespace
+
+zeus::expected<std::string, SnapshotError> encodeSnapshot(const Environment& environment)
+{
+    const auto all = environment.getAll();
+    std::vector<std::pair<std::string_view, const eval::Value*>> entries;
+    entries.reserve(all.size());
+    for (const auto& [key, value] : all)
+    {
+        entries.emplace_back(key, &value);
+    }
+    std::ranges::sort(entries, {}, &std::pair<std::string_view, const eval::Value*>::first);
+
+    std::string buffer;
+    buffer.append(snapshot_magic.data(), snapshot_magic.size());
+    append(buffer, snapshot_format_version);
+    append(buffer, std::uint32_t{ 0 });
+    append(buffer, static_cast<std::uint64_t>(entries.size()));
+    append(buffer, std::uint64_t{ 0 });
+    buffer.resize(header_size + entries.size() * index_entry_size);
+
+    for (std::size_t index = 0; index < entries.size(); ++index)
+    {
+        const auto& [key, value] = entries[index];
+        const auto entry = header_size + index * index_entry_size;
+
+        const auto key_offset = buffer.size();
+        buffer.append(key);
+
+        const auto value_offset = buffer.size();
+        if (! encodeValue(buffer, *value))
+        {
+            return zeus::unexpected(SnapshotError::UnsupportedValue);
+        }
+        if (key.size() > std::numeric_limits<std::uint32_t>::max() || buffer.size() - value_offset > std::numeric_limits<std::uint32_t>::max())
+        {
+            return zeus::unexpected(SnapshotError::TooLarge);
+        }
+
+        store(buffer, entry, static_cast<std::uint64_t>(key_offset));
+        store(buffer, entry + 8, static_cast<std::uint32_t>(key.size()));
+        store(buffer, entry + 12, static_cast<std::uint32_t>(buffer.size() - value_offset));
+        store(buffer, entry + 16, static_cast<std::uint64_t>(value_offset));
+    }
+
+    store(buffer, 24, static_cast<std::uint64_t>(buffer.size()));
+    return buffer;
+}
+
+zeus::expected<void, SnapshotError> writeSnapshot(const Environment& environment, const std::filesystem::path& path)
+{
+    const auto encoded = encodeSnapshot(environment);
+    if (! encoded.has_value())
+    {
+        return zeus::unexpected(encoded.error());
+    }
+
+    // the file may be mapped by readers, it is replaced rather than rewritten
+    if (! replaceFile(path, encoded.value()))
+    {
+        return zeus::unexpected(SnapshotError::IoError);
+    }
+    return {};
+}
+
+zeus::expected<SnapshotEnvironment, SnapshotError> SnapshotEnvironment::open(const std::filesystem::path& path)
+{
+    SnapshotEnvironment snapshot;
+
+#ifdef _WIN32
+    const auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return zeus::unexpected(SnapshotError::IoError);
+    }
+    LARGE_INTEGER file_size;
+    if (! GetFileSizeEx(file, &file_size) || file_size.QuadPart < static_cast<LONGLONG>(header_size))
+    {
+        CloseHandle(file);
+        return zeus::unexpected(file_size.QuadPart < static_cast<LONGLONG>(header_size) ? SnapshotError::InvalidFormat : SnapshotError::IoError);
+    }
+    snapshot.mapping_handle_ = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (snapshot.mapping_handle_ == nullptr)
+    {
+        return zeus::unexpected(SnapshotError::IoError);
+    }
+    const auto* view = MapViewOfFile(snapshot.mapping_handle_, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr)
+    {
+        return zeus::unexpected(SnapshotError::IoError);
+    }
+    snapshot.data_ = static_cast<const std::byte*>(view);
+    snapshot.size_ = static_cast<std::size_t>(file_size.QuadPart);
+#else
+    const auto file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0)
+    {
+        return zeus::unexpected(SnapshotError::IoError);
+    }
+    struct stat file_stat
+    {
+    };
+    if (fstat(file, &file_stat) != 0)
+    {
+        ::close(file);
+        return zeus::unexpected(SnapshotError::IoError);
+    }
+    if (file_stat.st_size < static_cast<off_t>(header_size))
+    {
+        ::close(file);
+        return zeus::unexpected(SnapshotError::InvalidFormat);
+    }
+    auto* mapping = mmap(nullptr, static_cast<std::size_t>(file_stat.st_size), PROT_READ, MAP_SHARED, file, 0);
+    ::close(file);
+    if (mapping == MAP_FAILED)
+    {
+        return zeus::unexpected(SnapshotError::IoError);
+    }
+    snapshot.data_ = static_cast<const std::byte*>(mapping);
+    snapshot.size_ = static_cast<std::size_t>(file_stat.st_size);
+#endif
+
+    if (std::memcmp(snapshot.data_, snapshot_magic.data(), snapshot_magic.size()) != 0 || load<std::uint32_t>(snapshot.data_ + 8) != snapshot_format_version
+        || load<std::uint64_t>(snapshot.data_ + 24) != snapshot.size_)
+    {
+        return zeus::unexpected(SnapshotError::InvalidFormat);
+    }
+
+    const auto key_count = load<std::uint64_t>(snapshot.data_ + 16);
+    if (key_count > (snapshot.size_ - header_size) / index_entry_size)
+    {
+        return zeus::unexpected(SnapshotError::InvalidFormat);
+    }
+    snapshot.key_count_ = static_cast<std::size_t>(key_count);
+
+    for (std::size_t index = 0; index < snapshot.key_count_; ++index)
+    {
+        const auto* entry = snapshot.data_ + header_size + index * index_entry_size;
+        const auto key_offset = load<std::uint64_t>(entry);
+        const auto key_length = load<std::uint32_t>(entry + 8);
+        const auto value_length = load<std::uint32_t>(entry + 12);
+        const auto value_offset = load<std::uint64_t>(entry + 16);
+        if (key_offset > snapshot.size_ || key_length > snapshot.size_ - key_offset || value_offset > snapshot.size_ || value_length > snapshot.size_ - value_offset)
+        {
+            return zeus::unexpected(SnapshotError::InvalidFormat);
+        }
+    }
+
+    return snapshot;
+}
+
+SnapshotEnvironment::SnapshotEnvironment(SnapshotEnvironment&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr))
+    , size_(std::exchange(other.size_, 0))
+    , key_count_(std::exchange(other.key_count_, 0))
+#ifdef _WIN32
+    , mapping_handle_(std::exchange(other.mapping_handle_, nullptr))
+#endif
+{
+}
+
+SnapshotEnvironment& SnapshotEnvironment::operator=(SnapshotEnvironment&& other) noexcept
+{
+    if (this != &other)
+    {
+        unmap();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        key_count_ = std::exchange(other.key_count_, 0);
+#ifdef _WIN32
+        mapping_handle_ = std::exchange(other.mapping_handle_, nullptr);
+#endif
+    }
+    return *this;
+}
+
+SnapshotEnvironment::~SnapshotEnvironment()
+{
+    unmap();
+}
+
+std::optional<eval::Value> SnapshotEnvironment::get(const std::string& key) const noexcept
+{
+    if (const auto index = find(key); index.has_value())
+    {
+        return valueAt(index.value());
+    }
+    return std::nullopt;
+}
+
+bool SnapshotEnvironment::has(const std::string& key) const noexcept
+{
+    return find(key).has_value();
+}
+
+std::unordered_map<std::string, eval::Value> SnapshotEnvironment::getAll() const noexcept
+{
+    std::unordered_map<std::string, eval::Value> all;
+    all.reserve(key_count_);
+    for (std::size_t index = 0; index < key_count_; ++index)
+    {
+        if (auto value = valueAt(index); value.has_value())
+        {
+            all.emplace(keyAt(index), std::move(value.value()));
+        }
+    }
+    return all;
+}
+
+std::size_t SnapshotEnvironment::size() const noexcept
+{
+    return key_count_;
+}
+
+std::string_view SnapshotEnvironment::keyAt(std::size_t index) const noexcept
+{
+    const auto* entry = data_ + header_size + index * index_entry_size;
+    return { reinterpret_cast<const char*>(data_ + load<std::uint64_t>(entry)), load<std::uint32_t>(entry + 8) };
+}
+
+std::optional<std::size_t> SnapshotEnvironment::find(std::string_view key) const noexcept
+{
+    std::size_t low = 0;
+    std::size_t high = key_count_;
+    while (low < high)
+    {
+        const auto middle = low + (high - low) / 2;
+        const auto comparison = keyAt(middle).compare(key);
+        if (comparison == 0)
+        {
+            return middle;
+        }
+        if (comparison < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<eval::Value> SnapshotEnvironment::valueAt(std::size_t index) const noexcept
+{
+    const auto* entry = data_ + header_size + index * index_entry_size;
+    const auto* value = data_ + load<std::uint64_t>(entry + 16);
+    return ValueReader(value, value + load<std::uint32_t>(entry + 12)).read();
+}
+
+void SnapshotEnvironment::unmap() noexcept
+{
+#ifdef _WIN32
+    if (data_ != nullptr)
+    {
+        UnmapViewOfFile(data_);
+    }
+    if (mapping_handle_ != nullptr)
+    {
+        CloseHandle(mapping_handle_);
+    }
+    mapping_handle_ = nullptr;
+#else
+    if (data_ != nullptr)
+    {
+        munmap(const_cast<std::byte*>(data_), size_);
+    }
+#endif
+    data_ = nullptr;
+    size_ = 0;
+    key_count_ = 0;
+}
+
+} // namespace CuraFormulaeEngine::env
@@ -340,22 +340,15 @@ zeus::expected<bool, CuraFormulaeEngine::eval::Error> operator>(const CuraFormul
     return zeus::unexpected(CuraFormulaeEngine::eval::Error::TypeMismatch);
 }
 
-zeus::expected<bool, CuraFormulaeEngine::eval::Error> operator&&(const CuraFormulaeEngine::eval::Value& lhs, const CuraFormulaeEngine::eval::Value& rhs) noexcept
+// like Python, `and` and `or` give the operand that decides the result
+CuraFormulaeEngine::eval::Value operator&&(const CuraFormulaeEngine::eval::Value& lhs, const CuraFormulaeEngine::eval::Value& rhs) noexcept
 {
-    if (std::holds_alternative<bool>(lhs.value) && std::holds_alternative<bool>(rhs.value))
-    {
-        return std::get<bool>(lhs.value) && std::get<bool>(rhs.value);
-    }
-    return zeus::unexpected(CuraFormulaeEngine::eval::Error::TypeMismatch);
+    return lhs.isTruthy() ? rhs : lhs;
 }
 
-zeus::expected<bool, CuraFormulaeEngine::eval::Error> operator||(const CuraFormulaeEngine::eval::Value& lhs, const CuraFormulaeEngine::eval::Value& rhs) noexcept
+CuraFormulaeEngine::eval::Value operator||(const CuraFormulaeEngine::eval::Value& lhs, const CuraFormulaeEngine::eval::Value& rhs) noexcept
 {
-    if (std::holds_alternative<bool>(lhs.value) && std::holds_alternative<bool>(rhs.value))
-    {
-        return std::get<bool>(lhs.value) || std::get<bool>(rhs.value);
-    }
-    return zeus::unexpected(CuraFormulaeEngine::eval::Error::TypeMismatch);
+    return lhs.isTruthy() ? lhs : rhs;
 }
 
 CuraFormulaeEngine::eval::Result operator+(const CuraFormulaeEngine::eval::Value& lhs, const CuraFormulaeEngine::eval::Value& rhs) noexcept
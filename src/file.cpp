@@ -0,0 +1,65 @@
+#include "cura-formulae-engine/file.h"
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <fmt/format.h>
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <random>
+#include <system_error>
+
+namespace CuraFormulaeEngine
+{
+
+namespace
+{
+
+std::filesystem::path temporaryPathFor(const std::filesystem::path& path)
+{
+#ifdef _WIN32
+    const auto pid = _getpid();
+#else
+    const auto pid = getpid();
+#endif
+    // the pid tells processes apart, the counter calls within one, the random part processes in other pid namespaces
+    static std::atomic<std::uint64_t> counter{ 0 };
+    thread_local std::mt19937_64 random{ std::random_device{}() };
+    auto temporary_path = path;
+    temporary_path += fmt::format(".{}.{}.{:x}.tmp", pid, counter.fetch_add(1, std::memory_order_relaxed), random());
+    return temporary_path;
+}
+
+} // namespace
+
+bool replaceFile(const std::filesystem::path& path, std::span<const char> contents)
+{
+    const auto temporary_path = temporaryPathFor(path);
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+        file.flush();
+        if (! file)
+        {
+            std::error_code ignored;
+            std::filesystem::remove(temporary_path, ignored);
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary_path, path, error);
+    if (error)
+    {
+        std::filesystem::remove(temporary_path, error);
+        return false;
+    }
+    return true;
+}
+
+} // namespace CuraFormulaeEngine
@@ -0,0 +1,325 @@
+#include "cura-formulae-engine/opt/canonicalize.h"
+
+#include "cura-formulae-engine/ast/binary_expr/add_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/and_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/binary_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/mul_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/or_expr.h"
+#include "cura-formulae-engine/ast/comp_chain_expr.h"
+#include "cura-formulae-engine/ast/flat_expr.h"
+#include "cura-formulae-engine/ast/printer.h"
+#include "cura-formulae-engine/ast/visitor.h"
+#include "cura-formulae-engine/env/env.h"
+#include "cura-formulae-engine/opt/type_inference.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace CuraFormulaeEngine::opt
+{
+
+namespace
+{
+
+using ast::ExprKind;
+
+constexpr ValueTypes numbers{ ValueType::Int, ValueType::Float };
+constexpr ValueTypes integers{ ValueType::Int };
+
+/**
+ * @brief Whether values of the types are all of `expected`; a node without types always fails, it has none.
+ */
+bool only(ValueTypes types, ValueTypes expected) noexcept
+{
+    return ! types.empty() && types.isSubsetOf(expected);
+}
+
+/**
+ * @brief Orders operands by their string, with literals last, so `x > 0` rather than `0 < x` is canonical.
+ */
+struct OperandKey
+{
+    bool literal;
+    std::string string;
+
+    explicit OperandKey(const ast::ExprPtr& expr)
+        : literal(expr.ptr->kind() <= ExprKind::String)
+        , string(expr.toString())
+    {
+    }
+
+    friend bool operator<(const OperandKey& lhs, const OperandKey& rhs) noexcept
+    {
+        return lhs.literal != rhs.literal ? rhs.literal : lhs.string < rhs.string;
+    }
+};
+
+ast::ExprPtr makeBinary(ExprKind kind, ast::ExprPtr lhs, ast::ExprPtr rhs)
+{
+    switch (kind)
+    {
+    case ExprKind::Add:
+        return ast::make_expr_ptr<ast::AddExpr>(std::move(lhs), std::move(rhs));
+    case ExprKind::Mul:
+        return ast::make_expr_ptr<ast::MulExpr>(std::move(lhs), std::move(rhs));
+    case ExprKind::And:
+        return ast::make_expr_ptr<ast::AndExpr>(std::move(lhs), std::move(rhs));
+    default:
+        return ast::make_expr_ptr<ast::OrExpr>(std::move(lhs), std::move(rhs));
+    }
+}
+
+std::optional<ast::ComparisonOperators> flipped(ast::ComparisonOperators comparison_operator) noexcept
+{
+    switch (comparison_operator)
+    {
+    case ast::Equals:
+    case ast::NotEquals:
+        return comparison_operator;
+    case ast::LessThan:
+        return ast::GreaterThan;
+    case ast::GreaterThan:
+        return ast::LessThan;
+    case ast::LessThenEqual:
+        return ast::GreaterThenEqual;
+    case ast::GreaterThenEqual:
+        return ast::LessThenEqual;
+    default:
+        return std::nullopt;
+    }
+}
+
+class Canonicalizer
+{
+public:
+    Canonicalizer(const TypeSchema& schema, TypeAnnotations annotations, std::size_t* canonicalized)
+        : schema_(schema)
+        , annotations_(std::move(annotations))
+        , canonicalized_(canonicalized)
+    {
+    }
+
+    void leave(ast::ExprPtr& node)
+    {
+        // children are already canonical
+        auto rewritten = false;
+        switch (node.ptr->kind())
+        {
+        case ExprKind::Add:
+        case ExprKind::Mul:
+            rewritten = canonicalizeArithmetic(node);
+            break;
+        case ExprKind::And:
+        case ExprKind::Or:
+            rewritten = nestToTheLeft(node);
+            break;
+        case ExprKind::ComparisonChain:
+            rewritten = canonicalizeComparison(node);
+            break;
+        default:
+            break;
+        }
+        if (rewritten && canonicalized_ != nullptr)
+        {
+            ++*canonicalized_;
+        }
+    }
+
+private:
+    ValueTypes typesOf(const ast::ExprPtr& expr) const
+    {
+        return annotations_.typesOf(*expr.ptr);
+    }
+
+    /**
+     * @brief Whether evaluating an operand never fails, so evaluating it after another operand cannot change which
+     * error is reported.
+     */
+    bool cannotFail(const ast::ExprPtr& expr) const
+    {
+        return annotations_.cannotFail(
+            *expr.ptr,
+            [this](const std::string& name) { return schema_.has(name) || env::std_env.get(name).has_value(); });
+    }
+
+    /**
+     * @brief Replaces a node by a new one of the same type, so the nodes above it are refreshed.
+     */
+    void replace(ast::ExprPtr& node, ast::ExprPtr replacement)
+    {
+        annotations_.types.insert_or_assign(replacement.ptr.get(), typesOf(node));
+        node = std::move(replacement);
+    }
+
+    bool canonicalizeArithmetic(ast::ExprPtr& node)
+    {
+        auto& binary_expr = static_cast<ast::BinaryExpr&>(*node.ptr);
+        const auto lhs_types = typesOf(binary_expr.lhs);
+        const auto rhs_types = typesOf(binary_expr.rhs);
+        if (only(lhs_types, integers) && only(rhs_types, integers))
+        {
+            return sortChain(node);
+        }
+        if (! only(lhs_types, numbers) || ! only(rhs_types, numbers) || ! (OperandKey{ binary_expr.rhs } < OperandKey{ binary_expr.lhs }))
+        {
+            return false;
+        }
+        if (! cannotFail(binary_expr.lhs) && ! cannotFail(binary_expr.rhs))
+        {
+            return false;
+        }
+        replace(node, makeBinary(node.ptr->kind(), std::move(binary_expr.rhs), std::move(binary_expr.lhs)));
+        return true;
+    }
+
+    /**
+     * @brief Collects the operands of the operators of the same kind below `expr`, in order; `nested_right` is set if
+     * one of those operators is the right operand of another.
+     */
+    void collectChain(ast::ExprPtr& expr, ExprKind kind, bool only_integers, std::vector<ast::ExprPtr*>& operands, bool& nested_right) const
+    {
+        const auto& binary_expr = static_cast<const ast::BinaryExpr&>(*expr.ptr);
+        const auto inChain = [this, kind, only_integers](const ast::ExprPtr& operand)
+        {
+            if (operand.ptr->kind() != kind)
+            {
+                return false;
+            }
+            const auto& operand_expr = static_cast<const ast::BinaryExpr&>(*operand.ptr);
+            return ! only_integers || (only(typesOf(operand_expr.lhs), integers) && only(typesOf(operand_expr.rhs), integers));
+        };
+
+        auto& lhs = static_cast<ast::BinaryExpr&>(*expr.ptr).lhs;
+        auto& rhs = static_cast<ast::BinaryExpr&>(*expr.ptr).rhs;
+        if (inChain(binary_expr.lhs))
+        {
+            collectChain(lhs, kind, only_integers, operands, nested_right);
+        }
+        else
+        {
+            operands.push_back(&lhs);
+        }
+        if (inChain(binary_expr.rhs))
+        {
+            nested_right = true;
+            collectChain(rhs, kind, only_integers, operands, nested_right);
+        }
+        else
+        {
+            operands.push_back(&rhs);
+        }
+    }
+
+    /**
+     * @brief Rebuilds a chain from its operands, nested to the left.
+     */
+    void rebuildChain(ast::ExprPtr& node, const std::vector<ast::ExprPtr*>& operands)
+    {
+        const auto kind = node.ptr->kind();
+        const auto types = typesOf(node);
+        auto chain = std::move(*operands[0]);
+        for (std::size_t i = 1; i < operands.size(); ++i)
+        {
+            chain = makeBinary(kind, std::move(chain), std::move(*operands[i]));
+            annotations_.types.insert_or_assign(chain.ptr.get(), types);
+        }
+        node = std::move(chain);
+    }
+
+    bool sortChain(ast::ExprPtr& node)
+    {
+        std::vector<ast::ExprPtr*> operands;
+        auto nested_right = false;
+        collectChain(node, node.ptr->kind(), true, operands, nested_right);
+
+        std::vector<std::pair<OperandKey, ast::ExprPtr*>> keyed;
+        for (auto* operand : operands)
+        {
+            keyed.emplace_back(OperandKey{ *operand }, operand);
+        }
+        const auto by_key = [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; };
+        // the first operand that fails decides the error, so operands that may fail keep their order
+        const auto sortable = std::ranges::count_if(operands, [this](const ast::ExprPtr* operand) { return ! cannotFail(*operand); }) <= 1;
+        if (! nested_right && (! sortable || std::is_sorted(keyed.begin(), keyed.end(), by_key)))
+        {
+            return false;
+        }
+        if (sortable)
+        {
+            std::stable_sort(keyed.begin(), keyed.end(), by_key);
+            for (std::size_t i = 0; i < keyed.size(); ++i)
+            {
+                operands[i] = keyed[i].second;
+            }
+        }
+        rebuildChain(node, operands);
+        return true;
+    }
+
+    bool nestToTheLeft(ast::ExprPtr& node)
+    {
+        std::vector<ast::ExprPtr*> operands;
+        auto nested_right = false;
+        collectChain(node, node.ptr->kind(), false, operands, nested_right);
+        if (! nested_right)
+        {
+            return false;
+        }
+        rebuildChain(node, operands);
+        return true;
+    }
+
+    bool canonicalizeComparison(ast::ExprPtr& node)
+    {
+        auto& comparison_chain_expr = static_cast<ast::ComparisonChainExpr&>(*node.ptr);
+        if (comparison_chain_expr.operators.size() != 1)
+        {
+            return false;
+        }
+        const auto comparison_operator = flipped(comparison_chain_expr.operators[0]);
+        auto& lhs = comparison_chain_expr.expressions[0];
+        auto& rhs = comparison_chain_expr.expressions[1];
+        if (! comparison_operator.has_value() || ! (OperandKey{ rhs } < OperandKey{ lhs }) || (! cannotFail(lhs) && ! cannotFail(rhs)))
+        {
+            return false;
+        }
+        // `>=` compares strings, `<=` does not
+        const auto may_be_strings = typesOf(lhs).contains(ValueType::String) && typesOf(rhs).contains(ValueType::String);
+        if (may_be_strings && (comparison_operator == ast::LessThenEqual || comparison_operator == ast::GreaterThenEqual))
+        {
+            return false;
+        }
+
+        std::vector<ast::ExprPtr> expressions;
+        expressions.push_back(std::move(rhs));
+        expressions.push_back(std::move(lhs));
+        replace(node, ast::make_expr_ptr<ast::ComparisonChainExpr>(std::move(expressions), std::vector<ast::ComparisonOperators>{ comparison_operator.value() }));
+        return true;
+    }
+
+    const TypeSchema& schema_;
+    TypeAnnotations annotations_;
+    std::size_t* canonicalized_;
+};
+
+} // namespace
+
+ast::ExprPtr canonicalize(ast::ExprPtr expr, const TypeSchema& schema, std::size_t* canonicalized)
+{
+    // shared nodes would be copied by the rewrite, after the annotations were keyed by them
+    ast::unshare(expr);
+    ast::rewrite(expr, Canonicalizer{ schema, inferTypes(expr, schema), canonicalized });
+    return expr;
+}
+
+std::string canonicalString(const ast::Expr& expr, const TypeSchema& schema)
+{
+    // rebuilding the tree from a flat copy leaves the original untouched
+    return ast::print(canonicalize(ast::FlatExpr::flatten(expr).toExpr(), schema), ast::PrintStyle::Full);
+}
+
+} // namespace CuraFormulaeEngine::opt
@@ -0,0 +1,679 @@
+#include "cura-formulae-engine/opt/common_subexpressions.h"
+
+#include "cura-formulae-engine/ast/binary_expr/binary_expr.h"
+#include "cura-formulae-engine/ast/comp_chain_expr.h"
+#include "cura-formulae-engine/ast/condition_expr.h"
+#include "cura-formulae-engine/ast/dispatch.h"
+#include "cura-formulae-engine/ast/fn_application_expr.h"
+#include "cura-formulae-engine/ast/let_expr.h"
+#include "cura-formulae-engine/ast/list_comprehension_expr.h"
+#include "cura-formulae-engine/ast/list_expr.h"
+#include "cura-formulae-engine/ast/slice_expr.h"
+#include "cura-formulae-engine/ast/symbol.h"
+#include "cura-formulae-engine/ast/variable_expr.h"
+#include "cura-formulae-engine/ast/visitor.h"
+#include "cura-formulae-engine/env/env.h"
+#include "cura-formulae-engine/eval.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace CuraFormulaeEngine::opt
+{
+
+namespace
+{
+
+using ast::ExprKind;
+
+/**
+ * @brief Smaller subexpressions without calls are cheaper to evaluate twice than to bind to a temporary.
+ */
+constexpr std::size_t min_shared_nodes = 4;
+
+/**
+ * @brief A subexpression, with the slots of all nodes from the root of the formula down to it.
+ */
+struct Occurrence
+{
+    std::vector<ast::ExprPtr*> path;
+    std::size_t nodes{ 0 };
+    bool worth_sharing{ false };
+
+    [[nodiscard]] const ast::Expr& expr() const noexcept
+    {
+        return *path.back()->ptr;
+    }
+};
+
+/**
+ * @brief How evaluating a node reaches one of its children.
+ */
+struct Edge
+{
+    /**
+     * @brief Whether the child may not be evaluated when the node is.
+     */
+    bool conditional{ false };
+
+    /**
+     * @brief The symbols the node binds for the child.
+     */
+    ast::SymbolSet bound;
+};
+
+/**
+ * @brief Where a child of a list comprehension is, in the order the parts are first evaluated.
+ */
+struct Part
+{
+    enum Kind
+    {
+        Iterable,
+        Condition,
+        Iterator,
+    };
+
+    Kind kind{ Iterator };
+    std::size_t loop{ 0 };
+    std::size_t condition{ 0 };
+
+    /**
+     * @brief The number of loops whose variables the part sees.
+     */
+    [[nodiscard]] std::size_t visibleLoops() const noexcept
+    {
+        return kind == Iterable ? loop : loop + 1;
+    }
+
+    [[nodiscard]] bool operator<(const Part& other) const noexcept
+    {
+        if (loop != other.loop)
+        {
+            return loop < other.loop;
+        }
+        if (kind != other.kind)
+        {
+            return kind < other.kind;
+        }
+        return condition < other.condition;
+    }
+
+    [[nodiscard]] bool operator==(const Part& other) const noexcept = default;
+};
+
+Part partOf(const ast::ListComprehensionExpr& list_comprehension_expr, const ast::ExprPtr* child)
+{
+    const auto& loops = list_comprehension_expr.loops;
+    for (std::size_t loop = 0; loop < loops.size(); ++loop)
+    {
+        if (child == &loops[loop].iterable)
+        {
+            return Part{ .kind = Part::Iterable, .loop = loop };
+        }
+        for (std::size_t condition = 0; condition < loops[loop].conditions.size(); ++condition)
+        {
+            if (child == &loops[loop].conditions[condition])
+            {
+                return Part{ .kind = Part::Condition, .loop = loop, .condition = condition };
+            }
+        }
+    }
+    // the iterator is evaluated after the conditions of the last loop
+    return Part{ .kind = Part::Iterator, .loop = loops.size() - 1, .condition = loops.back().conditions.size() };
+}
+
+Edge edgeTo(const ast::Expr& node, const ast::ExprPtr* child)
+{
+    Edge edge;
+    switch (node.kind())
+    {
+    case ExprKind::And:
+    case ExprKind::Or:
+        edge.conditional = child == &static_cast<const ast::BinaryExpr&>(node).rhs;
+        break;
+    case ExprKind::Condition:
+        edge.conditional = child != &static_cast<const ast::ConditionExpr&>(node).condition;
+        break;
+    case ExprKind::ComparisonChain:
+    {
+        // the chain ends at the first comparison that is false
+        const auto& expressions = static_cast<const ast::ComparisonChainExpr&>(node).expressions;
+        edge.conditional = child != &expressions[0] && child != &expressions[1];
+        break;
+    }
+    case ExprKind::ListComprehension:
+    {
+        const auto& list_comprehension_expr = static_cast<const ast::ListComprehensionExpr&>(node);
+        const auto part = partOf(list_comprehension_expr, child);
+        edge.conditional = part.kind != Part::Iterable || part.loop > 0;
+        for (std::size_t loop = 0; loop < part.visibleLoops(); ++loop)
+        {
+            edge.bound.merge(list_comprehension_expr.loops[loop].iterator_key.freeSymbols());
+        }
+        break;
+    }
+    case ExprKind::Let:
+        if (const auto& let_expr = static_cast<const ast::LetExpr&>(node); child == &let_expr.body)
+        {
+            edge.bound = ast::SymbolSet{ ast::intern(let_expr.name) };
+        }
+        break;
+    default:
+        break;
+    }
+    return edge;
+}
+
+/**
+ * @brief Whether evaluating an expression never fails, assuming the names of `env::std_env` are not shadowed; false
+ * when that is not known.
+ */
+bool cannotFail(const ast::ExprPtr& expr)
+{
+    const auto& node = *expr.ptr;
+    if (node.kind() <= ExprKind::String)
+    {
+        return true;
+    }
+    switch (node.kind())
+    {
+    case ExprKind::Variable:
+        return env::std_env.has(static_cast<const ast::VariableExpr&>(node).name);
+    case ExprKind::And:
+    case ExprKind::Or:
+    case ExprKind::Condition:
+    case ExprKind::List:
+    case ExprKind::Tuple:
+    {
+        auto children_cannot_fail = true;
+        ast::forEachChild(node, [&children_cannot_fail](const ast::ExprPtr& child) { children_cannot_fail = children_cannot_fail && cannotFail(child); });
+        return children_cannot_fail;
+    }
+    default:
+        return false;
+    }
+}
+
+bool isBuiltinFunction(const ast::ExprPtr& expr)
+{
+    if (expr.ptr->kind() != ExprKind::Variable)
+    {
+        return false;
+    }
+    const auto value = env::std_env.get(static_cast<const ast::VariableExpr&>(*expr.ptr).name);
+    return value.has_value() && std::holds_alternative<eval::Value::fn_t>(value->value);
+}
+
+/**
+ * @brief Whether nothing a node evaluates before one of its children can fail, so an error of the child is the first
+ * error the node reports.
+ */
+bool nothingFailsBefore(const ast::Expr& node, const ast::ExprPtr* child)
+{
+    switch (node.kind())
+    {
+    case ExprKind::Condition:
+    {
+        const auto& condition = static_cast<const ast::ConditionExpr&>(node).condition;
+        return child == &condition || cannotFail(condition);
+    }
+    case ExprKind::FnApplication:
+    {
+        const auto& fn_application_expr = static_cast<const ast::FnApplicationExpr&>(node);
+        if (child == &fn_application_expr.fn)
+        {
+            return true;
+        }
+        if (! isBuiltinFunction(fn_application_expr.fn))
+        {
+            return false;
+        }
+        for (const auto& arg : fn_application_expr.args)
+        {
+            if (child == &arg)
+            {
+                return true;
+            }
+            if (! cannotFail(arg))
+            {
+                return false;
+            }
+        }
+        return false;
+    }
+    case ExprKind::Slice:
+    {
+        // the step is evaluated first, and every part is checked for its type
+        const auto& slice_expr = static_cast<const ast::SliceExpr&>(node);
+        return child == (slice_expr.step_size.has_value() ? &slice_expr.step_size.value() : &slice_expr.array);
+    }
+    case ExprKind::ListComprehension:
+        return child == &static_cast<const ast::ListComprehensionExpr&>(node).loops.front().iterable;
+    default:
+    {
+        // the other nodes evaluate their children in the order they are visited
+        auto reached = false;
+        auto before_cannot_fail = true;
+        ast::forEachChild(
+            node,
+            [child, &reached, &before_cannot_fail](const ast::ExprPtr& sibling)
+            {
+                reached |= &sibling == child;
+                before_cannot_fail = before_cannot_fail && (reached || cannotFail(sibling));
+            });
+        return before_cannot_fail;
+    }
+    }
+}
+
+bool intersects(const ast::SymbolSet& lhs, const ast::SymbolSet& rhs) noexcept
+{
+    return std::ranges::any_of(lhs, [&rhs](const auto symbol) { return rhs.contains(symbol); });
+}
+
+class Eliminator
+{
+public:
+    explicit Eliminator(ast::ExprPtr& root)
+        : root_(root)
+    {
+        ast::visit(
+            *root_.ptr,
+            [this](const ast::Expr& node)
+            {
+                if (node.kind() == ExprKind::Variable)
+                {
+                    used_names_.insert(static_cast<const ast::VariableExpr&>(node).name);
+                }
+                else if (node.kind() == ExprKind::Let)
+                {
+                    used_names_.insert(static_cast<const ast::LetExpr&>(node).name);
+                }
+            });
+    }
+
+    /**
+     * @brief Shares the largest subexpression that occurs more than once and can be shared.
+     *
+     * @return false if there is none.
+     */
+    bool eliminateOne()
+    {
+        occurrences_.clear();
+        std::vector<ast::ExprPtr*> path;
+        collect(root_, path);
+
+        for (const auto& group : groups())
+        {
+            for (const auto& scope : scopes(group))
+            {
+                if (scope.size() > 1 && (bindInLet(scope) || bindInLoop(scope)))
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+private:
+    using Group = std::vector<const Occurrence*>;
+
+    /**
+     * @brief Records every subexpression below a slot, except the iterator keys of list comprehensions.
+     *
+     * @return The number of nodes in the slot and whether any of them is a call or a list comprehension.
+     */
+    std::pair<std::size_t, bool> collect(ast::ExprPtr& slot, std::vector<ast::ExprPtr*>& path)
+    {
+        path.push_back(&slot);
+        auto& node = *slot.ptr;
+        std::size_t nodes = 1;
+        auto calls = node.kind() == ExprKind::FnApplication || node.kind() == ExprKind::ListComprehension;
+        const auto add_child = [this, &path, &nodes, &calls](ast::ExprPtr& child)
+        {
+            const auto [child_nodes, child_calls] = collect(child, path);
+            nodes += child_nodes;
+            calls |= child_calls;
+        };
+
+        if (node.kind() == ExprKind::ListComprehension)
+        {
+            auto& list_comprehension_expr = static_cast<ast::ListComprehensionExpr&>(node);
+            add_child(list_comprehension_expr.iterator);
+            for (auto& loop : list_comprehension_expr.loops)
+            {
+                add_child(loop.iterable);
+                for (auto& condition : loop.conditions)
+                {
+                    add_child(condition);
+                }
+            }
+        }
+        else
+        {
+            ast::forEachChild(node, add_child);
+        }
+
+        if (node.kind() > ExprKind::Variable && node.kind() != ExprKind::Flat)
+        {
+            occurrences_.push_back(Occurrence{ .path = path, .nodes = nodes, .worth_sharing = calls || nodes >= min_shared_nodes });
+        }
+        path.pop_back();
+        return { nodes, calls };
+    }
+
+    /**
+     * @brief The structurally identical occurrences worth sharing, largest first.
+     */
+    std::vector<Group> groups() const
+    {
+        std::vector<Group> groups;
+        std::unordered_map<std::size_t, std::vector<std::size_t>> groups_by_hash;
+        for (const auto& occurrence : occurrences_)
+        {
+            if (! occurrence.worth_sharing)
+            {
+                continue;
+            }
+            auto& candidates = groups_by_hash[occurrence.expr().structuralHash()];
+            const auto group = std::ranges::find_if(candidates, [&](const auto index) { return ast::equal(groups[index].front()->expr(), occurrence.expr()); });
+            if (group == candidates.end())
+            {
+                candidates.push_back(groups.size());
+                groups.push_back({ &occurrence });
+            }
+            else
+            {
+                groups[*group].push_back(&occurrence);
+            }
+        }
+        std::erase_if(groups, [](const auto& group) { return group.size() < 2; });
+        std::ranges::stable_sort(groups, [](const auto& lhs, const auto& rhs) { return lhs.front()->nodes > rhs.front()->nodes; });
+        return groups;
+    }
+
+    /**
+     * @brief Splits a group by the innermost node binding one of its free variables; only occurrences below the same
+     * binding can refer to the same variables.
+     */
+    static std::vector<Group> scopes(const Group& group)
+    {
+        const auto& symbols = group.front()->expr().freeSymbols();
+        std::vector<std::pair<const ast::ExprPtr*, Group>> scopes;
+        for (const auto* occurrence : group)
+        {
+            const ast::ExprPtr* binding = nullptr;
+            for (std::size_t i = 0; i + 1 < occurrence->path.size(); ++i)
+            {
+                if (intersects(edgeTo(*occurrence->path[i]->ptr, occurrence->path[i + 1]).bound, symbols))
+                {
+                    binding = occurrence->path[i];
+                }
+            }
+            const auto scope = std::ranges::find(scopes, binding, [](const auto& entry) { return entry.first; });
+            if (scope == scopes.end())
+            {
+                scopes.emplace_back(binding, Group{ occurrence });
+            }
+            else
+            {
+                scope->second.push_back(occurrence);
+            }
+        }
+
+        std::vector<Group> result;
+        for (auto& [binding, scope] : scopes)
+        {
+            result.push_back(std::move(scope));
+        }
+        return result;
+    }
+
+    /**
+     * @brief The number of slots all paths of a group start with; the last of them holds the lowest common ancestor.
+     */
+    static std::size_t commonPathLength(const Group& group) noexcept
+    {
+        auto length = group.front()->path.size();
+        for (const auto* occurrence : group)
+        {
+            const auto mismatch = std::ranges::mismatch(group.front()->path, occurrence->path);
+            length = std::min(length, static_cast<std::size_t>(mismatch.in1 - group.front()->path.begin()));
+        }
+        return length;
+    }
+
+    /**
+     * @brief Binds the occurrences to a temporary in a let expression around their lowest common ancestor.
+     */
+    bool bindInLet(const Group& group)
+    {
+        const auto common = commonPathLength(group);
+        const auto& symbols = group.front()->expr().freeSymbols();
+        const auto cannot_fail = cannotFail(*group.front()->path.back());
+        auto evaluated = false;
+        for (const auto* occurrence : group)
+        {
+            auto unconditional = true;
+            auto first = true;
+            for (auto i = common - 1; i + 1 < occurrence->path.size(); ++i)
+            {
+                const auto edge = edgeTo(*occurrence->path[i]->ptr, occurrence->path[i + 1]);
+                if (intersects(edge.bound, symbols))
+                {
+                    return false;
+                }
+                unconditional &= ! edge.conditional;
+                first = first && nothingFailsBefore(*occurrence->path[i]->ptr, occurrence->path[i + 1]);
+            }
+            // the let expression evaluates the subexpression before anything else below it, an error of an earlier
+            // sibling would be replaced by the error of the subexpression
+            evaluated |= unconditional && (cannot_fail || first);
+        }
+        if (! evaluated)
+        {
+            return false;
+        }
+
+        auto& site = *group.front()->path[common - 1];
+        const auto name = freshName();
+        auto value = replaceOccurrences(group, name, common - 1);
+        site = ast::make_expr_ptr<ast::LetExpr>(name, std::move(value), std::move(site));
+        refreshPath(group.front()->path, common - 1);
+        return true;
+    }
+
+    /**
+     * @brief Binds occurrences that read the loop variables of the list comprehension that is their lowest common
+     * ancestor to the variable of an extra loop over a single element list.
+     */
+    bool bindInLoop(const Group& group)
+    {
+        const auto common = commonPathLength(group);
+        auto& site = *group.front()->path[common - 1];
+        if (site.ptr->kind() != ExprKind::ListComprehension)
+        {
+            return false;
+        }
+        auto& list_comprehension_expr = static_cast<ast::ListComprehensionExpr&>(*site.ptr);
+        const auto& symbols = group.front()->expr().freeSymbols();
+
+        // the loop binding each free variable, which must be the same for all occurrences
+        const auto binders = [&list_comprehension_expr, &symbols](const Part& part)
+        {
+            std::vector<std::optional<std::size_t>> result;
+            for (const auto symbol : symbols)
+            {
+                auto& binder = result.emplace_back();
+                for (std::size_t loop = 0; loop < part.visibleLoops(); ++loop)
+                {
+                    if (list_comprehension_expr.loops[loop].iterator_key.freeSymbols().contains(symbol))
+                    {
+                        binder = loop;
+                    }
+                }
+            }
+            return result;
+        };
+
+        const auto cannot_fail = cannotFail(*group.front()->path.back());
+        std::optional<Part> first;
+        auto first_evaluated = false;
+        std::optional<std::vector<std::optional<std::size_t>>> first_binders;
+        for (const auto* occurrence : group)
+        {
+            const auto part = partOf(list_comprehension_expr, occurrence->path[common]);
+            auto unconditional = true;
+            auto leading = true;
+            for (auto i = common; i + 1 < occurrence->path.size(); ++i)
+            {
+                const auto edge = edgeTo(*occurrence->path[i]->ptr, occurrence->path[i + 1]);
+                if (intersects(edge.bound, symbols))
+                {
+                    return false;
+                }
+                unconditional &= ! edge.conditional;
+                leading = leading && nothingFailsBefore(*occurrence->path[i]->ptr, occurrence->path[i + 1]);
+            }
+            // the extra loop evaluates the subexpression before the part it is in
+            unconditional &= cannot_fail || leading;
+
+            const auto part_binders = binders(part);
+            if (! first_binders.has_value())
+            {
+                first_binders = part_binders;
+            }
+            else if (first_binders.value() != part_binders)
+            {
+                return false;
+            }
+
+            if (! first.has_value() || part < first.value())
+            {
+                first = part;
+                first_evaluated = unconditional;
+            }
+            else if (part == first.value())
+            {
+                first_evaluated |= unconditional;
+            }
+        }
+
+        // the extra loop goes right before the first part that evaluates the subexpression, which must not be the
+        // first iterable: there is no loop before it
+        if (! first_evaluated || (first->kind == Part::Iterable && first->loop == 0))
+        {
+            return false;
+        }
+        const auto loop = first->kind == Part::Iterable ? first->loop - 1 : first->loop;
+        const auto moved_conditions = first->kind == Part::Condition ? first->condition : list_comprehension_expr.loops[loop].conditions.size();
+
+        const auto name = freshName();
+        auto value = replaceOccurrences(group, name, common);
+
+        // moving the conditions invalidates the paths below the list comprehension
+        auto& conditions = list_comprehension_expr.loops[loop].conditions;
+        std::vector<ast::ExprPtr> conditions_after(std::make_move_iterator(conditions.begin() + moved_conditions), std::make_move_iterator(conditions.end()));
+        conditions.erase(conditions.begin() + moved_conditions, conditions.end());
+        std::vector<ast::ExprPtr> elements;
+        elements.push_back(std::move(value));
+        list_comprehension_expr.loops.emplace(
+            list_comprehension_expr.loops.begin() + loop + 1,
+            ast::make_expr_ptr<ast::VariableExpr>(name),
+            ast::make_expr_ptr<ast::ListExpr>(std::move(elements)),
+            std::move(conditions_after));
+        refreshPath(group.front()->path, common);
+        return true;
+    }
+
+    /**
+     * @brief Replaces the occurrences by a variable and refreshes the nodes above them, up to depth `top`.
+     *
+     * @return The subexpression that was replaced.
+     */
+    static ast::ExprPtr replaceOccurrences(const Group& group, const std::string& name, std::size_t top)
+    {
+        auto value = group.front()->path.back()->share();
+        std::vector<std::pair<std::size_t, ast::ExprPtr*>> ancestors;
+        for (const auto* occurrence : group)
+        {
+            *occurrence->path.back() = ast::make_expr_ptr<ast::VariableExpr>(name);
+            for (auto i = top; i + 1 < occurrence->path.size(); ++i)
+            {
+                ancestors.emplace_back(i, occurrence->path[i]);
+            }
+        }
+
+        // children before their parents
+        std::ranges::sort(ancestors, std::greater{});
+        const auto [last, end] = std::ranges::unique(ancestors);
+        ancestors.erase(last, end);
+        for (const auto& [depth, ancestor] : ancestors)
+        {
+            ancestor->ptr->refreshAttributes();
+        }
+        return value;
+    }
+
+    /**
+     * @brief Refreshes the first `depth` nodes on a path, bottom up.
+     */
+    static void refreshPath(const std::vector<ast::ExprPtr*>& path, std::size_t depth)
+    {
+        for (auto i = depth; i-- > 0;)
+        {
+            path[i]->ptr->refreshAttributes();
+        }
+    }
+
+    std::string freshName()
+    {
+        while (used_names_.contains("$" + std::to_string(next_name_)))
+        {
+            ++next_name_;
+        }
+        auto name = "$" + std::to_string(next_name_++);
+        used_names_.insert(name);
+        return name;
+    }
+
+    ast::ExprPtr& root_;
+
+    /**
+     * @brief The names read or bound anywhere in the formula, which temporaries must not shadow.
+     */
+    std::unordered_set<std::string> used_names_;
+    std::size_t next_name_{ 0 };
+
+    std::vector<Occurrence> occurrences_;
+};
+
+} // namespace
+
+ast::ExprPtr eliminateCommonSubexpressions(ast::ExprPtr expr, std::size_t* eliminated)
+{
+    // the occurrences are changed in place, not through a rewrite
+    ast::unshare(expr);
+    Eliminator eliminator{ expr };
+    while (eliminator.eliminateOne())
+    {
+        if (eliminated != nullptr)
+        {
+            ++*eliminated;
+        }
+    }
+    return expr;
+}
+
+} // namespace CuraFormulaeEngine::opt
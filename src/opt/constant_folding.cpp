@@ -0,0 +1,208 @@
+#include "cura-formulae-engine/opt/constant_folding.h"
+
+#include "cura-formulae-engine/ast/binary_expr/binary_expr.h"
+#include "cura-formulae-engine/ast/condition_expr.h"
+#include "cura-formulae-engine/ast/let_expr.h"
+#include "cura-formulae-engine/ast/list_comprehension_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/bool_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/float_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/int_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/none_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/string_expr.h"
+#include "cura-formulae-engine/ast/symbol.h"
+#include "cura-formulae-engine/ast/visitor.h"
+
+#include <cmath>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <variant>
+
+namespace CuraFormulaeEngine::opt
+{
+
+std::optional<ast::ExprPtr> makeLiteral(const eval::Value& value)
+{
+    return std::visit(
+        []<typename T>(const T& alternative) -> std::optional<ast::ExprPtr>
+        {
+            if constexpr (std::is_same_v<T, bool>)
+            {
+                return ast::make_expr_ptr<ast::BoolExpr>(alternative);
+            }
+            else if constexpr (std::is_same_v<T, double>)
+            {
+                if (! std::isfinite(alternative))
+                {
+                    return std::nullopt;
+                }
+                return ast::make_expr_ptr<ast::FloatExpr>(alternative);
+            }
+            else if constexpr (std::is_same_v<T, std::int64_t>)
+            {
+                return ast::make_expr_ptr<ast::IntExpr>(alternative);
+            }
+            else if constexpr (std::is_same_v<T, std::string>)
+            {
+                return ast::make_expr_ptr<ast::StringExpr>(alternative);
+            }
+            else if constexpr (std::is_same_v<T, std::nullptr_t>)
+            {
+                return ast::make_expr_ptr<ast::NoneExpr>();
+            }
+            else
+            {
+                return std::nullopt;
+            }
+        },
+        value.value);
+}
+
+namespace
+{
+
+bool isLiteral(const ast::Expr& expr) noexcept
+{
+    return expr.kind() <= ast::ExprKind::String;
+}
+
+/**
+ * @brief Whether a builtin may throw for some arguments (e.g. `float('abc')`) instead of returning an error.
+ *
+ * Evaluation is noexcept, so folding such a call would abort even where the original formula never makes it.
+ */
+bool mayThrow(std::string_view name) noexcept
+{
+    return name == "float" || name == "int" || name == "str";
+}
+
+class ConstantFolder
+{
+public:
+    ConstantFolder(const env::Environment& constants, std::size_t* folded)
+        : constants_(constants)
+        , folded_(folded)
+    {
+    }
+
+    void enter(const ast::ExprPtr& node)
+    {
+        bindVariables(*node.ptr, 1);
+    }
+
+    void leave(ast::ExprPtr& node)
+    {
+        bindVariables(*node.ptr, -1);
+        if (isLiteral(*node.ptr))
+        {
+            return;
+        }
+        if (isConstant(*node.ptr))
+        {
+            const auto result = node.evaluate(&constants_);
+            if (! result.has_value())
+            {
+                return;
+            }
+            if (auto literal = makeLiteral(result.value()); literal.has_value())
+            {
+                replace(node, std::move(literal.value()));
+            }
+        }
+        else if (node.ptr->kind() == ast::ExprKind::Condition)
+        {
+            // the condition is folded already, so if it is constant only one branch can be taken
+            auto& condition_expr = static_cast<ast::ConditionExpr&>(*node.ptr);
+            if (isLiteral(*condition_expr.condition.ptr))
+            {
+                const auto truthy = condition_expr.condition.evaluate(&constants_).value().isTruthy();
+                replace(node, std::move(truthy ? condition_expr.then_expr : condition_expr.else_expr));
+            }
+        }
+        else if (node.ptr->kind() == ast::ExprKind::And || node.ptr->kind() == ast::ExprKind::Or)
+        {
+            // likewise a constant left operand either gives the result or passes on to the right one
+            auto& binary_expr = static_cast<ast::BinaryExpr&>(*node.ptr);
+            if (isLiteral(*binary_expr.lhs.ptr))
+            {
+                const auto truthy = binary_expr.lhs.evaluate(&constants_).value().isTruthy();
+                replace(node, std::move(truthy == (node.ptr->kind() == ast::ExprKind::And) ? binary_expr.rhs : binary_expr.lhs));
+            }
+        }
+    }
+
+private:
+    void bindVariables(const ast::Expr& expr, int delta)
+    {
+        if (expr.kind() == ast::ExprKind::ListComprehension)
+        {
+            for (const auto& loop : static_cast<const ast::ListComprehensionExpr&>(expr).loops)
+            {
+                for (const auto symbol : loop.iterator_key.freeSymbols())
+                {
+                    bound_[symbol] += delta;
+                }
+            }
+        }
+        else if (expr.kind() == ast::ExprKind::Let)
+        {
+            bound_[ast::intern(static_cast<const ast::LetExpr&>(expr).name)] += delta;
+        }
+    }
+
+    void replace(ast::ExprPtr& node, ast::ExprPtr replacement)
+    {
+        node = std::move(replacement);
+        if (folded_ != nullptr)
+        {
+            ++*folded_;
+        }
+    }
+
+    bool isConstant(const ast::Expr& expr)
+    {
+        for (const auto symbol : expr.freeSymbols())
+        {
+            if (const auto bound = bound_.find(symbol); bound != bound_.end() && bound->second > 0)
+            {
+                return false;
+            }
+            auto known = known_.find(symbol);
+            if (known == known_.end())
+            {
+                const auto& name = ast::symbolName(symbol);
+                known = known_.emplace(symbol, constants_.has(name) && ! mayThrow(name)).first;
+            }
+            if (! known->second)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const env::Environment& constants_;
+    std::size_t* folded_;
+
+    /**
+     * @brief Whether a symbol is defined in the constants and safe to evaluate, looked up once per symbol.
+     */
+    std::unordered_map<ast::symbol_t, bool> known_;
+
+    /**
+     * @brief How many enclosing list comprehensions and let expressions bind a symbol; bound symbols shadow the
+     * constants.
+     */
+    std::unordered_map<ast::symbol_t, int> bound_;
+};
+
+} // namespace
+
+ast::ExprPtr foldConstants(ast::ExprPtr expr, const env::Environment& constants, std::size_t* folded)
+{
+    ast::rewrite(expr, ConstantFolder{ constants, folded });
+    return expr;
+}
+
+} // namespace CuraFormulaeEngine::opt
@@ -0,0 +1,403 @@
+#include "cura-formulae-engine/opt/cost_model.h"
+
+#include "cura-formulae-engine/ast/binary_expr/binary_expr.h"
+#include "cura-formulae-engine/ast/comp_chain_expr.h"
+#include "cura-formulae-engine/ast/condition_expr.h"
+#include "cura-formulae-engine/ast/dispatch.h"
+#include "cura-formulae-engine/ast/flat_expr.h"
+#include "cura-formulae-engine/ast/fn_application_expr.h"
+#include "cura-formulae-engine/ast/fused_expr.h"
+#include "cura-formulae-engine/ast/index_expr.h"
+#include "cura-formulae-engine/ast/let_expr.h"
+#include "cura-formulae-engine/ast/list_comprehension_expr.h"
+#include "cura-formulae-engine/ast/list_expr.h"
+#include "cura-formulae-engine/ast/slice_expr.h"
+#include "cura-formulae-engine/ast/tuple_expr.h"
+#include "cura-formulae-engine/ast/unary_expr/unary_expr.h"
+#include "cura-formulae-engine/ast/variable_expr.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace CuraFormulaeEngine::opt
+{
+
+namespace
+{
+
+using ast::ExprKind;
+
+const ast::Expr& unwrap(const ast::Expr& expr) noexcept
+{
+    const auto* node = &expr;
+    while (node->kind() == ExprKind::Ptr)
+    {
+        node = static_cast<const ast::ExprPtr*>(node)->ptr.get();
+    }
+    return *node;
+}
+
+class CostEstimator
+{
+public:
+    CostEstimator(const CostModel& model, CostEstimate& estimate)
+        : model_(model)
+        , estimate_(estimate)
+    {
+    }
+
+    /**
+     * @brief Estimates the cost of evaluating a node once, and records it with the number of evaluations.
+     */
+    double estimate(const ast::Expr& expr, double evaluations)
+    {
+        const auto& node = unwrap(expr);
+        const auto cost = model_.kind_costs[static_cast<std::size_t>(node.kind())] + childrenCost(node, evaluations);
+        auto& node_cost = estimate_.nodes[&node];
+        node_cost.cost = cost;
+        // nodes shared within the formula are evaluated once for every parent
+        node_cost.evaluations += evaluations;
+        return cost;
+    }
+
+private:
+    /**
+     * @brief The cost of the children of a node, `count` times per evaluation of the node.
+     */
+    double child(const ast::ExprPtr& expr, double count, double evaluations)
+    {
+        return count * estimate(expr, evaluations * count);
+    }
+
+    double childrenCost(const ast::Expr& node, double evaluations)
+    {
+        const auto branch = model_.branch_probability;
+        switch (node.kind())
+        {
+        case ExprKind::Neg:
+        case ExprKind::Not:
+            return child(static_cast<const ast::UnaryExpr&>(node).operand, 1.0, evaluations);
+        case ExprKind::Add:
+        case ExprKind::Sub:
+        case ExprKind::Mul:
+        case ExprKind::Div:
+        case ExprKind::Mod:
+        case ExprKind::Pow:
+        {
+            const auto& binary_expr = static_cast<const ast::BinaryExpr&>(node);
+            return child(binary_expr.lhs, 1.0, evaluations) + child(binary_expr.rhs, 1.0, evaluations);
+        }
+        case ExprKind::And:
+        case ExprKind::Or:
+        {
+            const auto& binary_expr = static_cast<const ast::BinaryExpr&>(node);
+            return child(binary_expr.lhs, 1.0, evaluations) + child(binary_expr.rhs, branch, evaluations);
+        }
+        case ExprKind::ComparisonChain:
+            return comparisonCost(static_cast<const ast::ComparisonChainExpr&>(node), evaluations);
+        case ExprKind::Condition:
+        {
+            const auto& condition_expr = static_cast<const ast::ConditionExpr&>(node);
+            return child(condition_expr.condition, 1.0, evaluations) + child(condition_expr.then_expr, branch, evaluations)
+                 + child(condition_expr.else_expr, 1.0 - branch, evaluations);
+        }
+        case ExprKind::FnApplication:
+            return callCost(static_cast<const ast::FnApplicationExpr&>(node), evaluations);
+        case ExprKind::Index:
+        {
+            const auto& index_expr = static_cast<const ast::IndexExpr&>(node);
+            return child(index_expr.array, 1.0, evaluations) + child(index_expr.index, 1.0, evaluations);
+        }
+        case ExprKind::Slice:
+        {
+            // the elements of the slice are copied
+            const auto& slice_expr = static_cast<const ast::SliceExpr&>(node);
+            auto cost = model_.per_element * listSize(slice_expr.array);
+            ast::forEachChild(node, [this, &cost, evaluations](const ast::ExprPtr& part) { cost += child(part, 1.0, evaluations); });
+            return cost;
+        }
+        case ExprKind::List:
+        case ExprKind::Tuple:
+        {
+            double cost = 0.0;
+            ast::forEachChild(node, [this, &cost, evaluations](const ast::ExprPtr& element) { cost += model_.per_element + child(element, 1.0, evaluations); });
+            return cost;
+        }
+        case ExprKind::ListComprehension:
+            return comprehensionCost(static_cast<const ast::ListComprehensionExpr&>(node), evaluations);
+        case ExprKind::Let:
+        {
+            const auto& let_expr = static_cast<const ast::LetExpr&>(node);
+            return child(let_expr.value, 1.0, evaluations) + child(let_expr.body, 1.0, evaluations);
+        }
+        case ExprKind::Fused:
+            return fusedCost(static_cast<const ast::FusedExpr&>(node), evaluations);
+        case ExprKind::Flat:
+        {
+            // the nodes of the rebuilt tree do not outlive the estimate, so only the total is kept
+            CostEstimate tree_estimate;
+            CostEstimator tree_estimator{ model_, tree_estimate };
+            return tree_estimator.estimate(static_cast<const ast::FlatExpr&>(node).toExpr(), 1.0);
+        }
+        default:
+            return 0.0;
+        }
+    }
+
+    /**
+     * @brief The variables of a fused shape are looked up without evaluating its nodes, which are not recorded.
+     */
+    double fusedCost(const ast::FusedExpr& fused_expr, double evaluations)
+    {
+        const auto lookup = model_.kind_costs[static_cast<std::size_t>(ExprKind::Variable)];
+        if (! fused_expr.shape.has_value())
+        {
+            return child(fused_expr.original, 1.0, evaluations);
+        }
+        switch (fused_expr.shape.value())
+        {
+        case ast::FusedShape::VariableSelection:
+            return lookup + child(fused_expr.condition.value(), 1.0, evaluations);
+        case ast::FusedShape::VariableMin:
+        case ast::FusedShape::VariableMax:
+            // the function is looked up too, to check it is the builtin
+            return 3.0 * lookup;
+        default:
+            return lookup;
+        }
+    }
+
+    double comparisonCost(const ast::ComparisonChainExpr& chain, double evaluations)
+    {
+        // later comparisons only run if the earlier ones hold
+        auto cost = child(chain.expressions[0], 1.0, evaluations);
+        for (std::size_t i = 0; i < chain.operators.size(); ++i)
+        {
+            const auto count = i == 0 ? 1.0 : model_.branch_probability;
+            const auto& rhs = chain.expressions[i + 1];
+            if (i < chain.constant_sets.size() && chain.constant_sets[i] != nullptr)
+            {
+                // hashed, the list is not evaluated
+                estimate(rhs, 0.0);
+                continue;
+            }
+            cost += child(rhs, count, evaluations);
+            if (i > 0)
+            {
+                cost += count * model_.kind_costs[static_cast<std::size_t>(ExprKind::ComparisonChain)];
+            }
+            if (chain.operators[i] == ast::Member || chain.operators[i] == ast::NotMember)
+            {
+                cost += count * model_.per_element * listSize(rhs);
+            }
+        }
+        return cost;
+    }
+
+    double callCost(const ast::FnApplicationExpr& call, double evaluations)
+    {
+        auto cost = child(call.fn, 1.0, evaluations);
+        for (const auto& arg : call.args)
+        {
+            cost += child(arg, 1.0, evaluations);
+        }
+
+        const auto& fn = unwrap(call.fn);
+        const auto fn_cost = fn.kind() == ExprKind::Variable ? model_.fn_costs.find(static_cast<const ast::VariableExpr&>(fn).name) : model_.fn_costs.end();
+        const auto& [base, per_element] = fn_cost == model_.fn_costs.end() ? model_.unknown_fn : fn_cost->second;
+        // a single argument is the list to go over, e.g. max(xs), otherwise the arguments are, e.g. max(a, b)
+        const auto elements = call.args.size() == 1 ? listSize(call.args[0]) : static_cast<double>(call.args.size());
+        return cost + base + per_element * elements;
+    }
+
+    double comprehensionCost(const ast::ListComprehensionExpr& comprehension, double evaluations)
+    {
+        const auto dependencies = comprehension.iterableDependencies();
+        std::vector<double> sizes;
+        for (const auto& loop : comprehension.loops)
+        {
+            sizes.push_back(listSize(loop.iterable));
+        }
+
+        double cost = 0.0;
+        // how often the body of the loops so far runs
+        double runs = 1.0;
+        for (std::size_t loop = 0; loop < comprehension.loops.size(); ++loop)
+        {
+            const auto& current = comprehension.loops[loop];
+            auto iterable_runs = 1.0;
+            if (dependencies[loop].has_value())
+            {
+                for (std::size_t outer = 0; outer <= dependencies[loop].value(); ++outer)
+                {
+                    iterable_runs *= sizes[outer];
+                }
+            }
+            cost += child(current.iterable, iterable_runs, evaluations);
+
+            runs *= sizes[loop];
+            cost += runs * model_.per_element;
+            for (const auto& condition : current.conditions)
+            {
+                cost += child(condition, runs, evaluations);
+            }
+        }
+        return cost + child(comprehension.iterator, runs, evaluations);
+    }
+
+    /**
+     * @brief The expected number of elements of a list.
+     */
+    double listSize(const ast::Expr& expr) const
+    {
+        const auto& node = unwrap(expr);
+        const auto named = [this](const std::string& name)
+        {
+            const auto size = model_.list_sizes.find(name);
+            return size == model_.list_sizes.end() ? model_.default_list_size : size->second;
+        };
+        switch (node.kind())
+        {
+        case ExprKind::List:
+            return static_cast<double>(static_cast<const ast::ListExpr&>(node).elements.size());
+        case ExprKind::Tuple:
+            return static_cast<double>(static_cast<const ast::TupleExpr&>(node).elements.size());
+        case ExprKind::Variable:
+            return named(static_cast<const ast::VariableExpr&>(node).name);
+        case ExprKind::FnApplication:
+        {
+            const auto& fn = unwrap(static_cast<const ast::FnApplicationExpr&>(node).fn);
+            return fn.kind() == ExprKind::Variable ? named(static_cast<const ast::VariableExpr&>(fn).name) : model_.default_list_size;
+        }
+        case ExprKind::Slice:
+            return listSize(static_cast<const ast::SliceExpr&>(node).array);
+        case ExprKind::ListComprehension:
+        {
+            double size = 1.0;
+            for (const auto& loop : static_cast<const ast::ListComprehensionExpr&>(node).loops)
+            {
+                size *= listSize(loop.iterable);
+            }
+            return size;
+        }
+        default:
+            return model_.default_list_size;
+        }
+    }
+
+    const CostModel& model_;
+    CostEstimate& estimate_;
+};
+
+} // namespace
+
+const CostModel& CostModel::defaults()
+{
+    static const CostModel model = []()
+    {
+        // measured with `formula_cost --calibrate`, see apps/formula_cost; lets, fused nodes, map and Cura's functions
+        // are not among its probes and keep estimates relative to the measured weights
+        CostModel result;
+        const auto set = [&result](ExprKind kind, double cost) { result.kind_costs[static_cast<std::size_t>(kind)] = cost; };
+        for (const auto literal : { ExprKind::Bool, ExprKind::Float, ExprKind::Int, ExprKind::None, ExprKind::String })
+        {
+            set(literal, 0.1);
+        }
+        set(ExprKind::Variable, 1.0);
+        set(ExprKind::Neg, 0.2);
+        set(ExprKind::Not, 0.1);
+        set(ExprKind::Add, 0.3);
+        set(ExprKind::Sub, 0.3);
+        set(ExprKind::Mul, 0.3);
+        set(ExprKind::Div, 0.4);
+        set(ExprKind::Mod, 0.3);
+        set(ExprKind::Pow, 0.4);
+        set(ExprKind::And, 0.3);
+        set(ExprKind::Or, 0.3);
+        set(ExprKind::ComparisonChain, 0.5);
+        set(ExprKind::Condition, 0.1);
+        set(ExprKind::FnApplication, 0.3);
+        set(ExprKind::Index, 0.2);
+        set(ExprKind::Slice, 2.2);
+        set(ExprKind::List, 0.5);
+        set(ExprKind::Tuple, 0.5);
+        set(ExprKind::ListComprehension, 1.6);
+        set(ExprKind::Let, 2.0);
+        set(ExprKind::Fused, 0.2);
+        result.per_element = 0.3;
+
+        result.fn_costs = {
+            { "abs", { 0.3, 0.0 } },
+            { "all", { 0.7, 0.1 } },
+            { "any", { 0.7, 0.1 } },
+            { "float", { 0.5, 0.0 } },
+            { "int", { 1.3, 0.0 } },
+            { "len", { 0.5, 0.0 } },
+            { "map", { 1.0, 5.0 } },
+            { "math.atan", { 0.4, 0.0 } },
+            { "math.ceil", { 0.4, 0.0 } },
+            { "math.cos", { 0.4, 0.0 } },
+            { "math.degrees", { 0.4, 0.0 } },
+            { "math.floor", { 0.4, 0.0 } },
+            { "math.log", { 0.4, 0.0 } },
+            { "math.radians", { 0.4, 0.0 } },
+            { "math.sin", { 0.4, 0.0 } },
+            { "math.sqrt", { 0.4, 0.0 } },
+            { "math.tan", { 0.4, 0.0 } },
+            { "max", { 0.7, 0.1 } },
+            { "min", { 0.7, 0.1 } },
+            { "round", { 0.5, 0.0 } },
+            { "str", { 2.4, 0.0 } },
+            { "sum", { 0.8, 0.2 } },
+            // Cura's functions look settings up in the stacks of the extruders
+            { "extruderValue", { 20.0, 0.0 } },
+            { "extruderValues", { 10.0, 10.0 } },
+            { "resolveOrValue", { 20.0, 0.0 } },
+        };
+        result.unknown_fn = { 10.0, 0.0 };
+
+        result.list_sizes = { { "extruderValues", 2.0 } };
+        result.default_list_size = 4.0;
+        result.branch_probability = 0.5;
+        return result;
+    }();
+    return model;
+}
+
+CostEstimate estimateCost(const ast::Expr& expr, const CostModel& model)
+{
+    CostEstimate estimate;
+    CostEstimator estimator{ model, estimate };
+    estimate.total = estimator.estimate(expr, 1.0);
+    return estimate;
+}
+
+const ast::Expr& dominantSubtree(const ast::Expr& expr, const CostEstimate& estimate, double share)
+{
+    const auto threshold = share * estimate.total;
+    const auto* node = &unwrap(expr);
+    while (true)
+    {
+        const ast::Expr* heaviest = nullptr;
+        auto heaviest_total = 0.0;
+        ast::forEachChild(
+            *node,
+            [&estimate, &heaviest, &heaviest_total](const ast::ExprPtr& child)
+            {
+                const auto& child_node = unwrap(child);
+                if (const auto cost = estimate.nodes.find(&child_node); cost != estimate.nodes.end() && cost->second.total() > heaviest_total)
+                {
+                    heaviest = &child_node;
+                    heaviest_total = cost->second.total();
+                }
+            });
+        if (heaviest == nullptr || heaviest_total < threshold)
+        {
+            return *node;
+        }
+        node = heaviest;
+    }
+}
+
+} // namespace CuraFormulaeEngine::opt
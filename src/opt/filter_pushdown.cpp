@@ -0,0 +1,185 @@
+#include "cura-formulae-engine/opt/filter_pushdown.h"
+
+#include "cura-formulae-engine/ast/dispatch.h"
+#include "cura-formulae-engine/ast/let_expr.h"
+#include "cura-formulae-engine/ast/list_comprehension_expr.h"
+#include "cura-formulae-engine/ast/symbol.h"
+#include "cura-formulae-engine/ast/variable_expr.h"
+#include "cura-formulae-engine/ast/visitor.h"
+#include "cura-formulae-engine/env/env.h"
+#include "cura-formulae-engine/opt/type_inference.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace CuraFormulaeEngine::opt
+{
+
+namespace
+{
+
+using ast::ExprKind;
+
+class FilterPusher
+{
+public:
+    FilterPusher(const TypeSchema& schema, TypeAnnotations annotations, std::size_t* moved)
+        : schema_(schema)
+        , annotations_(std::move(annotations))
+        , moved_(moved)
+    {
+    }
+
+    void enter(const ast::ExprPtr& node)
+    {
+        bindVariables(*node.ptr, 1);
+    }
+
+    void leave(ast::ExprPtr& node)
+    {
+        // the loop variables of the comprehension are still bound, they are defined in its conditions
+        if (node.ptr->kind() == ExprKind::ListComprehension)
+        {
+            pushDown(node);
+        }
+        bindVariables(*node.ptr, -1);
+    }
+
+private:
+    void bindVariables(const ast::Expr& expr, int delta)
+    {
+        if (expr.kind() == ExprKind::ListComprehension)
+        {
+            for (const auto& loop : static_cast<const ast::ListComprehensionExpr&>(expr).loops)
+            {
+                for (const auto symbol : loop.iterator_key.freeSymbols())
+                {
+                    bound_[symbol] += delta;
+                }
+            }
+        }
+        else if (expr.kind() == ExprKind::Let)
+        {
+            bound_[ast::intern(static_cast<const ast::LetExpr&>(expr).name)] += delta;
+        }
+    }
+
+    bool isDefined(const std::string& name) const
+    {
+        if (const auto bound = bound_.find(ast::intern(name)); bound != bound_.end() && bound->second > 0)
+        {
+            return true;
+        }
+        return schema_.has(name) || env::std_env.get(name).has_value();
+    }
+
+    ValueTypes typesOf(const ast::ExprPtr& expr) const
+    {
+        return annotations_.typesOf(*expr.ptr);
+    }
+
+    /**
+     * @brief Whether evaluating an expression never fails; false when that is not known.
+     */
+    bool cannotFail(const ast::ExprPtr& expr) const
+    {
+        return annotations_.cannotFail(expr, [this](const std::string& name) { return isDefined(name); });
+    }
+
+    /**
+     * @brief Whether the parts of the loops that a condition of loop `loop` moved to loop `target` would be checked
+     * before cannot fail: the loops in between and the conditions of `loop` before it.
+     */
+    bool canMoveAhead(const ast::ListComprehensionExpr& comprehension, std::size_t target, std::size_t loop, std::size_t condition) const
+    {
+        for (auto inner = target + 1; inner <= loop; ++inner)
+        {
+            const auto& iterable = comprehension.loops[inner].iterable;
+            if (! cannotFail(iterable) || ! typesOf(iterable).isSubsetOf({ ValueType::List }))
+            {
+                return false;
+            }
+            const auto& conditions = comprehension.loops[inner].conditions;
+            const auto skipped = inner == loop ? condition : conditions.size();
+            if (! std::all_of(conditions.begin(), conditions.begin() + static_cast<std::ptrdiff_t>(skipped), [this](const ast::ExprPtr& skipped_condition) { return cannotFail(skipped_condition); }))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void pushDown(ast::ExprPtr& node)
+    {
+        auto& comprehension = static_cast<ast::ListComprehensionExpr&>(*node.ptr);
+        auto changed = false;
+        for (std::size_t loop = 1; loop < comprehension.loops.size(); ++loop)
+        {
+            auto& conditions = comprehension.loops[loop].conditions;
+            for (std::size_t condition = 0; condition < conditions.size();)
+            {
+                const auto target = targetLoop(comprehension, loop, conditions[condition]);
+                if (target == loop || ! cannotFail(conditions[condition]) || ! canMoveAhead(comprehension, target, loop, condition))
+                {
+                    ++condition;
+                    continue;
+                }
+                comprehension.loops[target].conditions.push_back(std::move(conditions[condition]));
+                conditions.erase(conditions.begin() + static_cast<std::ptrdiff_t>(condition));
+                changed = true;
+                if (moved_ != nullptr)
+                {
+                    ++*moved_;
+                }
+            }
+        }
+
+        if (changed)
+        {
+            // a new node, so the attributes of the nodes above it are refreshed
+            node = ast::make_expr_ptr<ast::ListComprehensionExpr>(std::move(comprehension.iterator), std::move(comprehension.loops));
+        }
+    }
+
+    /**
+     * @brief The innermost loop up to `loop` binding a variable a condition reads, or the first loop.
+     */
+    static std::size_t targetLoop(const ast::ListComprehensionExpr& comprehension, std::size_t loop, const ast::ExprPtr& condition)
+    {
+        const auto& symbols = condition.freeSymbols();
+        for (auto outer = loop + 1; outer-- > 0;)
+        {
+            const auto& keys = comprehension.loops[outer].iterator_key.freeSymbols();
+            if (std::any_of(keys.begin(), keys.end(), [&symbols](const auto key) { return symbols.contains(key); }))
+            {
+                return outer;
+            }
+        }
+        return 0;
+    }
+
+    const TypeSchema& schema_;
+    TypeAnnotations annotations_;
+    std::size_t* moved_;
+
+    /**
+     * @brief How many enclosing list comprehensions and let expressions bind a symbol.
+     */
+    std::unordered_map<ast::symbol_t, int> bound_;
+};
+
+} // namespace
+
+ast::ExprPtr pushDownFilters(ast::ExprPtr expr, const TypeSchema& schema, std::size_t* moved)
+{
+    // conditions are only moved between loops, so the annotated nodes stay valid once shared nodes are copied
+    ast::unshare(expr);
+    ast::rewrite(expr, FilterPusher{ schema, inferTypes(expr, schema), moved });
+    return expr;
+}
+
+} // namespace CuraFormulaeEngine::opt
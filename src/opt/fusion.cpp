@@ -0,0 +1,97 @@
+#include "cura-formulae-engine/opt/fusion.h"
+
+#include "cura-formulae-engine/ast/condition_expr.h"
+#include "cura-formulae-engine/ast/visitor.h"
+
+#include <array>
+#include <cstddef>
+#include <utility>
+
+namespace CuraFormulaeEngine::opt
+{
+
+namespace
+{
+
+using ast::ExprKind;
+
+class Fuser
+{
+public:
+    explicit Fuser(std::size_t* fused)
+        : fused_(fused)
+    {
+    }
+
+    ast::VisitAction enter(const ast::ExprPtr& node) const
+    {
+        // a fused subexpression is not fused again
+        return node.ptr->kind() == ExprKind::Fused ? ast::VisitAction::SkipChildren : ast::VisitAction::Continue;
+    }
+
+    void leave(ast::ExprPtr& node) const
+    {
+        if (! ast::matchFusedShape(*node.ptr).has_value())
+        {
+            return;
+        }
+        node = ast::make_expr_ptr<ast::FusedExpr>(std::move(node));
+        if (fused_ != nullptr)
+        {
+            ++*fused_;
+        }
+    }
+
+private:
+    std::size_t* fused_;
+};
+
+std::size_t countNodes(const ast::Expr& expr)
+{
+    std::size_t nodes = 0;
+    expr.visitAll([&nodes](const ast::Expr& node) { nodes += node.kind() != ExprKind::Fused; });
+    return nodes;
+}
+
+} // namespace
+
+ast::ExprPtr fuseShapes(ast::ExprPtr expr, std::size_t* fused)
+{
+    ast::rewrite(expr, Fuser{ fused });
+    return expr;
+}
+
+void ShapeStatistics::add(const ast::Expr& formula)
+{
+    ++formulas;
+    std::array<bool, ast::fused_shape_count> found{};
+    formula.visitAll(
+        [this, &found](const ast::Expr& node)
+        {
+            if (node.kind() == ExprKind::Fused)
+            {
+                // counted as the subexpression it wraps
+                return;
+            }
+            ++nodes;
+            const auto shape = ast::matchFusedShape(node);
+            if (! shape.has_value())
+            {
+                return;
+            }
+            const auto index = static_cast<std::size_t>(shape.value());
+            ++occurrences[index];
+            found[index] = true;
+            fused_nodes[index] += countNodes(node);
+            if (shape == ast::FusedShape::VariableSelection)
+            {
+                fused_nodes[index] -= countNodes(static_cast<const ast::ConditionExpr&>(node).condition);
+            }
+        });
+    for (std::size_t index = 0; index < ast::fused_shape_count; ++index)
+    {
+        formulas_with[index] += found[index];
+    }
+}
+
+} // namespace CuraFormulaeEngine::opt
@@ -0,0 +1,18 @@
+#include "cura-formulae-engine/opt/partial_evaluation.h"
+
+#include "cura-formulae-engine/opt/constant_folding.h"
+
+#include <utility>
+
+namespace CuraFormulaeEngine::opt
+{
+
+PartialEvaluation partiallyEvaluate(ast::ExprPtr expr, const env::Environment& frozen)
+{
+    // a frozen variable is a constant subexpression, so folding also substitutes the reads
+    auto residual = foldConstants(std::move(expr), frozen);
+    auto free_variables = residual.freeVariables();
+    return PartialEvaluation{ std::move(residual), std::move(free_variables) };
+}
+
+} // namespace CuraFormulaeEngine::opt
@@ -0,0 +1,379 @@
+#include "cura-formulae-engine/opt/simplify.h"
+
+#include "cura-formulae-engine/ast/binary_expr/binary_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/mul_expr.h"
+#include "cura-formulae-engine/ast/condition_expr.h"
+#include "cura-formulae-engine/ast/fn_application_expr.h"
+#include "cura-formulae-engine/ast/let_expr.h"
+#include "cura-formulae-engine/ast/list_comprehension_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/bool_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/float_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/int_expr.h"
+#include "cura-formulae-engine/ast/symbol.h"
+#include "cura-formulae-engine/ast/unary_expr/neg_expr.h"
+#include "cura-formulae-engine/ast/unary_expr/unary_expr.h"
+#include "cura-formulae-engine/ast/variable_expr.h"
+#include "cura-formulae-engine/ast/visitor.h"
+#include "cura-formulae-engine/opt/type_inference.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace CuraFormulaeEngine::opt
+{
+
+namespace
+{
+
+using ast::ExprKind;
+
+constexpr ValueTypes numbers{ ValueType::Int, ValueType::Float };
+
+bool isInt(const ast::ExprPtr& expr, std::int64_t value) noexcept
+{
+    return expr.ptr->kind() == ExprKind::Int && static_cast<const ast::IntExpr&>(*expr.ptr).value == value;
+}
+
+bool isFloat(const ast::ExprPtr& expr, double value) noexcept
+{
+    return expr.ptr->kind() == ExprKind::Float && static_cast<const ast::FloatExpr&>(*expr.ptr).value == value;
+}
+
+bool isBool(const ast::ExprPtr& expr, bool value) noexcept
+{
+    return expr.ptr->kind() == ExprKind::Bool && static_cast<const ast::BoolExpr&>(*expr.ptr).value == value;
+}
+
+/**
+ * @brief The reciprocal of a literal power of two, which multiplies exactly like dividing by the literal.
+ */
+std::optional<double> exactReciprocal(const ast::ExprPtr& expr) noexcept
+{
+    double divisor = 0.0;
+    if (expr.ptr->kind() == ExprKind::Int)
+    {
+        const auto value = static_cast<const ast::IntExpr&>(*expr.ptr).value;
+        // larger integers may round to a power of two
+        if (value > (std::int64_t{ 1 } << 53) || value < -(std::int64_t{ 1 } << 53))
+        {
+            return std::nullopt;
+        }
+        divisor = static_cast<double>(value);
+    }
+    else if (expr.ptr->kind() == ExprKind::Float)
+    {
+        divisor = static_cast<const ast::FloatExpr&>(*expr.ptr).value;
+    }
+    else
+    {
+        return std::nullopt;
+    }
+
+    int exponent = 0;
+    if (std::abs(std::frexp(divisor, &exponent)) != 0.5)
+    {
+        return std::nullopt;
+    }
+    const auto reciprocal = 1.0 / divisor;
+    if (! std::isnormal(reciprocal))
+    {
+        return std::nullopt;
+    }
+    return reciprocal;
+}
+
+class Simplifier
+{
+public:
+    Simplifier(const TypeSchema& schema, std::size_t* simplified)
+        : schema_(schema)
+        , simplified_(simplified)
+    {
+    }
+
+    void enter(const ast::ExprPtr& node)
+    {
+        bindVariables(*node.ptr, 1);
+    }
+
+    void leave(ast::ExprPtr& node)
+    {
+        bindVariables(*node.ptr, -1);
+        // children are already simplified, but a rewrite may enable another one on the same node
+        while (simplifyNode(node))
+        {
+            if (simplified_ != nullptr)
+            {
+                ++*simplified_;
+            }
+        }
+    }
+
+private:
+    void bindVariables(const ast::Expr& expr, int delta)
+    {
+        if (expr.kind() == ExprKind::ListComprehension)
+        {
+            for (const auto& loop : static_cast<const ast::ListComprehensionExpr&>(expr).loops)
+            {
+                for (const auto symbol : loop.iterator_key.freeSymbols())
+                {
+                    bound_[symbol] += delta;
+                }
+            }
+        }
+        else if (expr.kind() == ExprKind::Let)
+        {
+            bound_[ast::intern(static_cast<const ast::LetExpr&>(expr).name)] += delta;
+        }
+    }
+
+    bool isBound(const std::string& name) const
+    {
+        const auto bound = bound_.find(ast::intern(name));
+        return bound != bound_.end() && bound->second > 0;
+    }
+
+    bool isOf(const ast::ExprPtr& expr, ValueTypes allowed) const
+    {
+        // the types of loop variables are not known
+        for (const auto symbol : expr.freeSymbols())
+        {
+            if (const auto bound = bound_.find(symbol); bound != bound_.end() && bound->second > 0)
+            {
+                return false;
+            }
+        }
+        return expressionTypes(expr, schema_).isSubsetOf(allowed);
+    }
+
+    bool simplifyNode(ast::ExprPtr& node)
+    {
+        switch (node.ptr->kind())
+        {
+        case ExprKind::Neg:
+        case ExprKind::Not:
+            return simplifyUnary(node);
+        case ExprKind::Add:
+        case ExprKind::Sub:
+        case ExprKind::Mul:
+        case ExprKind::Div:
+        case ExprKind::Pow:
+        case ExprKind::And:
+        case ExprKind::Or:
+            return simplifyBinary(node);
+        case ExprKind::Condition:
+            return simplifyCondition(node);
+        case ExprKind::FnApplication:
+            return simplifyFnApplication(node);
+        default:
+            return false;
+        }
+    }
+
+    bool simplifyUnary(ast::ExprPtr& node)
+    {
+        auto& operand = static_cast<ast::UnaryExpr&>(*node.ptr).operand;
+        if (operand.ptr->kind() != node.ptr->kind())
+        {
+            return false;
+        }
+        auto& inner_operand = static_cast<ast::UnaryExpr&>(*operand.ptr).operand;
+        const auto allowed = node.ptr->kind() == ExprKind::Neg ? numbers : ValueTypes{ ValueType::Bool };
+        if (! isOf(inner_operand, allowed))
+        {
+            return false;
+        }
+        node = ast::ExprPtr{ std::move(inner_operand) };
+        return true;
+    }
+
+    bool simplifyBinary(ast::ExprPtr& node)
+    {
+        auto& binary_expr = static_cast<ast::BinaryExpr&>(*node.ptr);
+        auto& lhs = binary_expr.lhs;
+        auto& rhs = binary_expr.rhs;
+        const auto replace = [&node](ast::ExprPtr& replacement)
+        {
+            node = ast::ExprPtr{ std::move(replacement) };
+            return true;
+        };
+
+        switch (node.ptr->kind())
+        {
+        case ExprKind::Add:
+            // x + 0.0 is 0.0 for x == -0.0, so only integers
+            if (isInt(rhs, 0) && isOf(lhs, { ValueType::Int }))
+            {
+                return replace(lhs);
+            }
+            if (isInt(lhs, 0) && isOf(rhs, { ValueType::Int }))
+            {
+                return replace(rhs);
+            }
+            return false;
+        case ExprKind::Sub:
+            if ((isInt(rhs, 0) && isOf(lhs, numbers)) || (isFloat(rhs, 0.0) && isOf(lhs, { ValueType::Float })))
+            {
+                return replace(lhs);
+            }
+            if (isInt(lhs, 0) && isOf(rhs, { ValueType::Int }))
+            {
+                node = ast::make_expr_ptr<ast::NegExpr>(std::move(rhs));
+                return true;
+            }
+            return false;
+        case ExprKind::Mul:
+        {
+            const ValueTypes repeatable{ ValueType::Int, ValueType::Float, ValueType::String, ValueType::List };
+            if ((isInt(rhs, 1) && isOf(lhs, repeatable)) || (isFloat(rhs, 1.0) && isOf(lhs, { ValueType::Float })))
+            {
+                return replace(lhs);
+            }
+            if ((isInt(lhs, 1) && isOf(rhs, repeatable)) || (isFloat(lhs, 1.0) && isOf(rhs, { ValueType::Float })))
+            {
+                return replace(rhs);
+            }
+            return false;
+        }
+        case ExprKind::Div:
+        {
+            if ((isInt(rhs, 1) || isFloat(rhs, 1.0)) && isOf(lhs, { ValueType::Float }))
+            {
+                return replace(lhs);
+            }
+            if (const auto reciprocal = exactReciprocal(rhs); reciprocal.has_value() && isOf(lhs, numbers))
+            {
+                node = ast::make_expr_ptr<ast::MulExpr>(std::move(lhs), ast::make_expr_ptr<ast::FloatExpr>(reciprocal.value()));
+                return true;
+            }
+            return false;
+        }
+        case ExprKind::Pow:
+            // integer powers are computed through double, which rounds beyond 2^53 where the operand itself does not
+            if (isInt(rhs, 1) && isOf(lhs, { ValueType::Float }))
+            {
+                return replace(lhs);
+            }
+            if (isInt(rhs, 2) && lhs.ptr->kind() == ExprKind::Variable && isOf(lhs, { ValueType::Float }))
+            {
+                auto square = ast::make_expr_ptr<ast::VariableExpr>(static_cast<const ast::VariableExpr&>(*lhs.ptr).name);
+                node = ast::make_expr_ptr<ast::MulExpr>(std::move(lhs), std::move(square));
+                return true;
+            }
+            return false;
+        case ExprKind::And:
+        case ExprKind::Or:
+        {
+            // a literal on the left decides the result or passes it on to the right operand
+            const auto is_and = node.ptr->kind() == ExprKind::And;
+            if (lhs.ptr->kind() <= ExprKind::String)
+            {
+                const auto truthy = lhs.evaluate(nullptr).value().isTruthy();
+                return replace(truthy == is_and ? rhs : lhs);
+            }
+            // `b and True` gives `b` if it is false and True otherwise, which is `b` only for booleans
+            if (isBool(rhs, is_and) && isOf(lhs, { ValueType::Bool }))
+            {
+                return replace(lhs);
+            }
+            return false;
+        }
+        default:
+            return false;
+        }
+    }
+
+    bool simplifyCondition(ast::ExprPtr& node)
+    {
+        auto& condition_expr = static_cast<ast::ConditionExpr&>(*node.ptr);
+        auto& condition = condition_expr.condition;
+        if (condition.ptr->kind() <= ExprKind::String)
+        {
+            // a literal condition evaluates without failing, so the other branch can go
+            const auto truthy = condition.evaluate(nullptr).value().isTruthy();
+            node = ast::ExprPtr{ std::move(truthy ? condition_expr.then_expr : condition_expr.else_expr) };
+            return true;
+        }
+        if (condition.ptr->kind() == ExprKind::Not)
+        {
+            // `not` fails for None and functions, where the truthiness of a condition does not
+            auto& negated = static_cast<ast::UnaryExpr&>(*condition.ptr).operand;
+            if (! isOf(negated, { ValueType::Bool, ValueType::Int, ValueType::Float, ValueType::String, ValueType::List }))
+            {
+                return false;
+            }
+            node = ast::make_expr_ptr<ast::ConditionExpr>(std::move(condition_expr.else_expr), std::move(negated), std::move(condition_expr.then_expr));
+            return true;
+        }
+        return false;
+    }
+
+    bool isBuiltinCall(const ast::Expr& expr, const std::string& name) const
+    {
+        if (expr.kind() != ExprKind::FnApplication)
+        {
+            return false;
+        }
+        const auto& fn = static_cast<const ast::FnApplicationExpr&>(expr).fn;
+        return fn.ptr->kind() == ExprKind::Variable && static_cast<const ast::VariableExpr&>(*fn.ptr).name == name && ! isBound(name);
+    }
+
+    bool simplifyFnApplication(ast::ExprPtr& node)
+    {
+        auto& fn_application_expr = static_cast<ast::FnApplicationExpr&>(*node.ptr);
+        // a single argument is a list to take the minimum of, so only calls with several arguments nest
+        if (fn_application_expr.args.size() < 2)
+        {
+            return false;
+        }
+        for (const auto* name : { "min", "max" })
+        {
+            // the builtins fold from the left with a strict comparison, so only a nested call in front is the same fold;
+            // elsewhere a NaN it skipped, or the tie it resolved, would be compared to the arguments before it instead
+            auto& first = fn_application_expr.args.front();
+            if (! isBuiltinCall(fn_application_expr, name) || ! isBuiltinCall(*first.ptr, name)
+                || static_cast<const ast::FnApplicationExpr&>(*first.ptr).args.size() < 2)
+            {
+                continue;
+            }
+            std::vector<ast::ExprPtr> args;
+            for (auto& inner_arg : static_cast<ast::FnApplicationExpr&>(*first.ptr).args)
+            {
+                args.push_back(std::move(inner_arg));
+            }
+            for (auto arg = std::next(fn_application_expr.args.begin()); arg != fn_application_expr.args.end(); ++arg)
+            {
+                args.push_back(std::move(*arg));
+            }
+            node = ast::make_expr_ptr<ast::FnApplicationExpr>(std::move(fn_application_expr.fn), std::move(args));
+            return true;
+        }
+        return false;
+    }
+
+    const TypeSchema& schema_;
+    std::size_t* simplified_;
+
+    /**
+     * @brief How many enclosing list comprehensions and let expressions bind a symbol; bound symbols are not in the
+     * schema.
+     */
+    std::unordered_map<ast::symbol_t, int> bound_;
+};
+
+} // namespace
+
+ast::ExprPtr simplify(ast::ExprPtr expr, const TypeSchema& schema, std::size_t* simplified)
+{
+    ast::rewrite(expr, Simplifier{ schema, simplified });
+    return expr;
+}
+
+} // namespace CuraFormulaeEngine::opt
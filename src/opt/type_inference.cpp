@@ -0,0 +1,630 @@
+#include "cura-formulae-engine/opt/type_inference.h"
+
+#include "cura-formulae-engine/ast/binary_expr/binary_expr.h"
+#include "cura-formulae-engine/ast/comp_chain_expr.h"
+#include "cura-formulae-engine/ast/condition_expr.h"
+#include "cura-formulae-engine/ast/dispatch.h"
+#include "cura-formulae-engine/ast/expr_ptr.h"
+#include "cura-formulae-engine/ast/fn_application_expr.h"
+#include "cura-formulae-engine/ast/fused_expr.h"
+#include "cura-formulae-engine/ast/index_expr.h"
+#include "cura-formulae-engine/ast/let_expr.h"
+#include "cura-formulae-engine/ast/list_comprehension_expr.h"
+#include "cura-formulae-engine/ast/list_expr.h"
+#include "cura-formulae-engine/ast/slice_expr.h"
+#include "cura-formulae-engine/ast/symbol.h"
+#include "cura-formulae-engine/ast/tuple_expr.h"
+#include "cura-formulae-engine/ast/unary_expr/unary_expr.h"
+#include "cura-formulae-engine/ast/variable_expr.h"
+#include "cura-formulae-engine/env/env.h"
+
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <string>
+
+namespace CuraFormulaeEngine::opt
+{
+
+namespace
+{
+
+using ast::ExprKind;
+
+constexpr ValueTypes numeric{ ValueType::Bool, ValueType::Int, ValueType::Float };
+
+/**
+ * @brief The union of `fn` applied to each type in `types`.
+ */
+template<typename Fn>
+ValueTypes collect(ValueTypes types, Fn&& fn)
+{
+    ValueTypes result;
+    types.forEach([&result, &fn](ValueType type) { result |= fn(type); });
+    return result;
+}
+
+ValueTypes arithmeticTypes(ExprKind op, ValueType lhs, ValueType rhs) noexcept
+{
+    // bools count as integers in + and -, but not in * and /
+    const auto is_integer = [](ValueType type) { return type == ValueType::Bool || type == ValueType::Int; };
+    const auto is_numeric = [](ValueType type) { return numeric.contains(type); };
+    const auto is_number = [](ValueType type) { return type == ValueType::Int || type == ValueType::Float; };
+
+    switch (op)
+    {
+    case ExprKind::Add:
+        if ((lhs == ValueType::String || lhs == ValueType::List) && rhs == lhs)
+        {
+            return { lhs };
+        }
+        [[fallthrough]];
+    case ExprKind::Sub:
+        if (is_integer(lhs) && is_integer(rhs))
+        {
+            return { ValueType::Int };
+        }
+        return is_numeric(lhs) && is_numeric(rhs) ? ValueTypes{ ValueType::Float } : ValueTypes{};
+    case ExprKind::Mul:
+        if (lhs == ValueType::Int && rhs == ValueType::Int)
+        {
+            return { ValueType::Int };
+        }
+        if (is_numeric(lhs) && is_numeric(rhs) && ! (is_integer(lhs) && is_integer(rhs) && lhs != rhs))
+        {
+            return { ValueType::Float };
+        }
+        if (lhs == ValueType::Int && (rhs == ValueType::String || rhs == ValueType::List))
+        {
+            return { rhs };
+        }
+        if (rhs == ValueType::Int && (lhs == ValueType::String || lhs == ValueType::List))
+        {
+            return { lhs };
+        }
+        return {};
+    case ExprKind::Div:
+        return is_number(lhs) && is_number(rhs) ? ValueTypes{ ValueType::Float } : ValueTypes{};
+    case ExprKind::Mod:
+        return is_number(lhs) && lhs == rhs ? ValueTypes{ lhs } : ValueTypes{};
+    case ExprKind::Pow:
+        if (lhs == ValueType::Int && rhs == ValueType::Int)
+        {
+            return { ValueType::Int };
+        }
+        return is_number(lhs) && is_number(rhs) ? ValueTypes{ ValueType::Float } : ValueTypes{};
+    default:
+        return {};
+    }
+}
+
+bool comparable(ast::ComparisonOperators op, ValueTypes lhs, ValueTypes rhs) noexcept
+{
+    const auto both_numeric = ! (lhs & numeric).empty() && ! (rhs & numeric).empty();
+    const auto both_strings = lhs.contains(ValueType::String) && rhs.contains(ValueType::String);
+    switch (op)
+    {
+    case ast::Equals:
+    case ast::NotEquals:
+        return true;
+    case ast::LessThenEqual:
+        return both_numeric;
+    case ast::LessThan:
+    case ast::GreaterThan:
+    case ast::GreaterThenEqual:
+        return both_numeric || both_strings;
+    case ast::Member:
+    case ast::NotMember:
+        return rhs.contains(ValueType::List);
+    }
+    return false;
+}
+
+/**
+ * @brief A signature for builtins taking a single argument, giving the result for each type of the argument.
+ */
+template<typename Fn>
+FnSignature unarySignature(Fn result)
+{
+    return [result](const std::vector<ValueTypes>& args) { return args.size() == 1 ? collect(args[0], result) : ValueTypes{}; };
+}
+
+/**
+ * @brief A signature for builtins taking a single argument of the given types.
+ */
+FnSignature unarySignature(ValueTypes accepted, ValueTypes result)
+{
+    return [accepted, result](const std::vector<ValueTypes>& args)
+    { return args.size() == 1 && ! (args[0] & accepted).empty() ? result : ValueTypes{}; };
+}
+
+FnSignature extremeSignature()
+{
+    return [](const std::vector<ValueTypes>& args) -> ValueTypes
+    {
+        if (args.empty())
+        {
+            return {};
+        }
+        if (args.size() == 1)
+        {
+            // the elements of a list, or the argument itself
+            return args[0].contains(ValueType::List) ? ValueTypes::any() : args[0];
+        }
+        const ValueTypes comparable_types{ ValueType::Bool, ValueType::Int, ValueType::Float, ValueType::String };
+        ValueTypes result;
+        for (const auto& arg : args)
+        {
+            if ((arg & comparable_types).empty())
+            {
+                return {};
+            }
+            result |= arg & comparable_types;
+        }
+        return result;
+    };
+}
+
+class Inferrer
+{
+public:
+    Inferrer(const TypeSchema& schema, const FnSignatures& signatures, TypeAnnotations* annotations)
+        : schema_(schema)
+        , signatures_(signatures)
+        , annotations_(annotations)
+    {
+    }
+
+    ValueTypes infer(const ast::Expr& expr)
+    {
+        const auto* node = &expr;
+        while (node->kind() == ExprKind::Ptr)
+        {
+            node = static_cast<const ast::ExprPtr*>(node)->ptr.get();
+        }
+
+        auto operands_succeed = true;
+        auto types = inferNode(*node, operands_succeed);
+        if (! operands_succeed)
+        {
+            types = {};
+        }
+        if (annotations_ != nullptr)
+        {
+            // a node shared between formulas may be visited more than once
+            annotations_->types[node] |= types;
+            if (types.empty() && operands_succeed)
+            {
+                annotations_->mismatches.push_back(node);
+            }
+        }
+        return types;
+    }
+
+private:
+    ValueTypes inferNode(const ast::Expr& expr, bool& operands_succeed)
+    {
+        // infers an operand that is always evaluated, so the node fails if it does
+        const auto operand = [this, &operands_succeed](const ast::Expr& operand_expr)
+        {
+            const auto types = infer(operand_expr);
+            operands_succeed &= ! types.empty();
+            return types;
+        };
+
+        switch (expr.kind())
+        {
+        case ExprKind::Bool:
+            return { ValueType::Bool };
+        case ExprKind::Float:
+            return { ValueType::Float };
+        case ExprKind::Int:
+            return { ValueType::Int };
+        case ExprKind::None:
+            return { ValueType::None };
+        case ExprKind::String:
+            return { ValueType::String };
+        case ExprKind::Variable:
+            return variableTypes(static_cast<const ast::VariableExpr&>(expr).name);
+        case ExprKind::Neg:
+            return collect(
+                operand(static_cast<const ast::UnaryExpr&>(expr).operand),
+                [](ValueType type) -> ValueTypes
+                {
+                    if (type == ValueType::Bool || type == ValueType::Int)
+                    {
+                        return { ValueType::Int };
+                    }
+                    return type == ValueType::Float ? ValueTypes{ ValueType::Float } : ValueTypes{};
+                });
+        case ExprKind::Not:
+        {
+            const ValueTypes negatable{ ValueType::Bool, ValueType::Int, ValueType::Float, ValueType::String, ValueType::List };
+            const auto types = operand(static_cast<const ast::UnaryExpr&>(expr).operand);
+            return (types & negatable).empty() ? ValueTypes{} : ValueTypes{ ValueType::Bool };
+        }
+        case ExprKind::And:
+        case ExprKind::Or:
+        {
+            // gives the left operand if it decides the result, and only evaluates the right one otherwise
+            const ValueTypes can_be_truthy{ ValueType::Bool, ValueType::Float, ValueType::Int, ValueType::String, ValueType::List };
+            const ValueTypes can_be_falsy = ValueTypes::any();
+            const auto& binary_expr = static_cast<const ast::BinaryExpr&>(expr);
+            const auto lhs = operand(binary_expr.lhs);
+            const auto rhs = infer(binary_expr.rhs);
+            const auto deciding = expr.kind() == ExprKind::And ? can_be_falsy : can_be_truthy;
+            const auto passing = expr.kind() == ExprKind::And ? can_be_truthy : can_be_falsy;
+            return (lhs & deciding) | ((lhs & passing).empty() ? ValueTypes{} : rhs);
+        }
+        case ExprKind::Add:
+        case ExprKind::Sub:
+        case ExprKind::Mul:
+        case ExprKind::Div:
+        case ExprKind::Mod:
+        case ExprKind::Pow:
+        {
+            const auto& binary_expr = static_cast<const ast::BinaryExpr&>(expr);
+            const auto lhs = operand(binary_expr.lhs);
+            const auto rhs = operand(binary_expr.rhs);
+            return opt::arithmeticTypes(expr.kind(), lhs, rhs);
+        }
+        case ExprKind::ComparisonChain:
+        {
+            // only the first comparison is always made, the chain ends at the first one that is false
+            const auto& chain_expr = static_cast<const ast::ComparisonChainExpr&>(expr);
+            const auto first = operand(chain_expr.expressions[0]);
+            const auto second = operand(chain_expr.expressions[1]);
+            for (std::size_t i = 2; i < chain_expr.expressions.size(); ++i)
+            {
+                infer(chain_expr.expressions[i]);
+            }
+            return comparable(chain_expr.operators[0], first, second) ? ValueTypes{ ValueType::Bool } : ValueTypes{};
+        }
+        case ExprKind::Condition:
+        {
+            // a condition only fails if both branches do, which are not its operands
+            const auto& condition_expr = static_cast<const ast::ConditionExpr&>(expr);
+            operand(condition_expr.condition);
+            const auto types = infer(condition_expr.then_expr) | infer(condition_expr.else_expr);
+            operands_succeed &= ! types.empty();
+            return types;
+        }
+        case ExprKind::FnApplication:
+            return fnApplicationTypes(static_cast<const ast::FnApplicationExpr&>(expr), operand);
+        case ExprKind::Index:
+        {
+            const auto& index_expr = static_cast<const ast::IndexExpr&>(expr);
+            const auto array = operand(index_expr.array);
+            const auto index = operand(index_expr.index);
+            return array.contains(ValueType::List) && index.contains(ValueType::Int) ? ValueTypes::any() : ValueTypes{};
+        }
+        case ExprKind::Slice:
+        {
+            const auto& slice_expr = static_cast<const ast::SliceExpr&>(expr);
+            auto valid = operand(slice_expr.array).contains(ValueType::List);
+            for (const auto& part : { &slice_expr.start_index, &slice_expr.end_index, &slice_expr.step_size })
+            {
+                if (part->has_value())
+                {
+                    valid &= operand(part->value()).contains(ValueType::Int);
+                }
+            }
+            return valid ? ValueTypes{ ValueType::List } : ValueTypes{};
+        }
+        case ExprKind::List:
+            for (const auto& element : static_cast<const ast::ListExpr&>(expr).elements)
+            {
+                operand(element);
+            }
+            return { ValueType::List };
+        case ExprKind::Tuple:
+            for (const auto& element : static_cast<const ast::TupleExpr&>(expr).elements)
+            {
+                operand(element);
+            }
+            return { ValueType::List };
+        case ExprKind::ListComprehension:
+            return listComprehensionTypes(static_cast<const ast::ListComprehensionExpr&>(expr), operand);
+        case ExprKind::Let:
+        {
+            const auto& let_expr = static_cast<const ast::LetExpr&>(expr);
+            bound_[let_expr.name].push_back(operand(let_expr.value));
+            const auto types = operand(let_expr.body);
+            bound_[let_expr.name].pop_back();
+            return types;
+        }
+        case ExprKind::Fused:
+            return operand(static_cast<const ast::FusedExpr&>(expr).original);
+        case ExprKind::Ptr:
+        case ExprKind::Flat:
+            return ValueTypes::any();
+        }
+        return ValueTypes::any();
+    }
+
+    ValueTypes variableTypes(const std::string& name) const
+    {
+        if (isBound(name))
+        {
+            return bound_.at(name).back();
+        }
+        if (schema_.has(name))
+        {
+            return schema_.get(name);
+        }
+        if (signatures_.contains(name))
+        {
+            return { ValueType::Fn };
+        }
+        if (const auto value = env::std_env.get(name); value.has_value())
+        {
+            return ValueTypes::of(value.value());
+        }
+        return ValueTypes::any();
+    }
+
+    bool isBound(const std::string& name) const
+    {
+        const auto bound = bound_.find(name);
+        return bound != bound_.end() && ! bound->second.empty();
+    }
+
+    template<typename Operand>
+    ValueTypes fnApplicationTypes(const ast::FnApplicationExpr& fn_application_expr, Operand& operand)
+    {
+        const auto fn = operand(fn_application_expr.fn);
+        std::vector<ValueTypes> args;
+        for (const auto& arg : fn_application_expr.args)
+        {
+            args.push_back(operand(arg));
+        }
+        if (! fn.contains(ValueType::Fn))
+        {
+            return {};
+        }
+
+        if (fn_application_expr.fn.ptr->kind() == ExprKind::Variable)
+        {
+            const auto& name = static_cast<const ast::VariableExpr&>(*fn_application_expr.fn.ptr).name;
+            if (const auto signature = signatures_.find(name); signature != signatures_.end() && ! isBound(name))
+            {
+                return signature->second(args);
+            }
+        }
+        return ValueTypes::any();
+    }
+
+    template<typename Operand>
+    ValueTypes listComprehensionTypes(const ast::ListComprehensionExpr& list_comprehension_expr, Operand& operand)
+    {
+        // only the first iterable is always evaluated, the rest of the loops may not run
+        auto iterable_is_list = true;
+        std::vector<std::string> bound_names;
+        for (const auto& loop : list_comprehension_expr.loops)
+        {
+            const auto iterable = bound_names.empty() ? operand(loop.iterable) : infer(loop.iterable);
+            if (bound_names.empty())
+            {
+                iterable_is_list = iterable.contains(ValueType::List);
+            }
+            for (const auto symbol : loop.iterator_key.freeSymbols())
+            {
+                bound_names.push_back(ast::symbolName(symbol));
+                bound_[bound_names.back()].push_back(ValueTypes::any());
+            }
+            infer(loop.iterator_key);
+            for (const auto& condition : loop.conditions)
+            {
+                infer(condition);
+            }
+        }
+        infer(list_comprehension_expr.iterator);
+        for (const auto& name : bound_names)
+        {
+            bound_[name].pop_back();
+        }
+        return iterable_is_list ? ValueTypes{ ValueType::List } : ValueTypes{};
+    }
+
+    const TypeSchema& schema_;
+    const FnSignatures& signatures_;
+    TypeAnnotations* annotations_;
+
+    /**
+     * @brief The types of the names bound by enclosing list comprehensions and let expressions, innermost last; loop
+     * variables may have any type.
+     */
+    std::unordered_map<std::string, std::vector<ValueTypes>> bound_;
+};
+
+} // namespace
+
+const FnSignatures& builtinSignatures()
+{
+    static const FnSignatures signatures = []()
+    {
+        const ValueTypes numbers{ ValueType::Int, ValueType::Float };
+        const ValueTypes list{ ValueType::List };
+        const ValueTypes floats{ ValueType::Float };
+        const ValueTypes integers{ ValueType::Int };
+
+        FnSignatures result;
+        result.emplace(
+            "abs",
+            unarySignature([](ValueType type) { return type == ValueType::Float ? ValueTypes{ ValueType::Float } : type == ValueType::Bool || type == ValueType::Int ? ValueTypes{ ValueType::Int } : ValueTypes{}; }));
+        result.emplace("all", unarySignature(list, { ValueType::Bool }));
+        result.emplace("any", unarySignature(list, { ValueType::Bool }));
+        // float() of an int gives the int back
+        result.emplace(
+            "float",
+            unarySignature(
+                [](ValueType type) { return type == ValueType::Int ? ValueTypes{ ValueType::Int } : type == ValueType::Float || type == ValueType::String || type == ValueType::Bool ? ValueTypes{ ValueType::Float } : ValueTypes{}; }));
+        result.emplace(
+            "int",
+            [integers](const std::vector<ValueTypes>& args) -> ValueTypes
+            {
+                if (args.size() == 2)
+                {
+                    return args[0].contains(ValueType::String) && args[1].contains(ValueType::Int) ? integers : ValueTypes{};
+                }
+                const ValueTypes convertible{ ValueType::Bool, ValueType::Int, ValueType::Float, ValueType::String };
+                return args.size() == 1 && ! (args[0] & convertible).empty() ? integers : ValueTypes{};
+            });
+        result.emplace("len", unarySignature(list, integers));
+        result.emplace(
+            "map",
+            [list](const std::vector<ValueTypes>& args)
+            { return args.size() == 2 && args[0].contains(ValueType::Fn) && args[1].contains(ValueType::List) ? list : ValueTypes{}; });
+        result.emplace("math.atan", unarySignature(numbers, floats));
+        result.emplace("math.ceil", unarySignature(numeric, floats));
+        result.emplace("math.cos", unarySignature(numbers, floats));
+        result.emplace("math.degrees", unarySignature([](ValueType type) { return arithmeticTypes(ExprKind::Mul, type, ValueType::Float); }));
+        result.emplace("math.floor", unarySignature(numeric, floats));
+        result.emplace(
+            "math.log",
+            [floats](const std::vector<ValueTypes>& args)
+            { return (args.size() == 1 || args.size() == 2) && ! (args[0] & numeric).empty() ? floats : ValueTypes{}; });
+        result.emplace("math.radians", unarySignature([](ValueType type) { return arithmeticTypes(ExprKind::Mul, type, ValueType::Float); }));
+        result.emplace("math.sin", unarySignature(numeric, floats));
+        result.emplace("math.sqrt", unarySignature(numeric, floats));
+        result.emplace("math.tan", unarySignature(numeric, floats));
+        result.emplace("max", extremeSignature());
+        result.emplace("min", extremeSignature());
+        result.emplace(
+            "round",
+            [numbers, integers](const std::vector<ValueTypes>& args) -> ValueTypes
+            {
+                // a positive number of digits gives a float
+                if (args.empty() || args.size() > 2 || (args[0] & numbers).empty())
+                {
+                    return {};
+                }
+                if (args.size() == 2)
+                {
+                    return args[1].contains(ValueType::Int) ? ValueTypes{ ValueType::Int, ValueType::Float } : ValueTypes{};
+                }
+                return integers;
+            });
+        result.emplace("str", unarySignature({ ValueType::Bool, ValueType::Int, ValueType::Float, ValueType::String }, { ValueType::String }));
+        result.emplace("sum", unarySignature(list, numbers));
+        return result;
+    }();
+    return signatures;
+}
+
+ValueTypes arithmeticTypes(ast::ExprKind op, ValueTypes lhs, ValueTypes rhs) noexcept
+{
+    return collect(lhs, [op, rhs](ValueType lhs_type) { return collect(rhs, [op, lhs_type](ValueType rhs_type) { return arithmeticTypes(op, lhs_type, rhs_type); }); });
+}
+
+ValueTypes TypeAnnotations::typesOf(const ast::Expr& expr) const
+{
+    const auto* node = &expr;
+    while (node->kind() == ExprKind::Ptr)
+    {
+        node = static_cast<const ast::ExprPtr*>(node)->ptr.get();
+    }
+    const auto node_types = types.find(node);
+    return node_types == types.end() ? ValueTypes::any() : node_types->second;
+}
+
+bool TypeAnnotations::cannotFail(const ast::Expr& expr, const std::function<bool(const std::string&)>& is_defined) const
+{
+    constexpr ValueTypes numbers{ ValueType::Int, ValueType::Float };
+    const auto* node = &expr;
+    while (node->kind() == ExprKind::Ptr)
+    {
+        node = static_cast<const ast::ExprPtr*>(node)->ptr.get();
+    }
+    if (node->kind() <= ExprKind::String)
+    {
+        return true;
+    }
+    switch (node->kind())
+    {
+    case ExprKind::Variable:
+        return is_defined(static_cast<const ast::VariableExpr&>(*node).name);
+    case ExprKind::Neg:
+    {
+        const auto& operand = static_cast<const ast::UnaryExpr&>(*node).operand;
+        return cannotFail(operand, is_defined) && typesOf(operand).isSubsetOf(numbers);
+    }
+    case ExprKind::Not:
+    {
+        const auto& operand = static_cast<const ast::UnaryExpr&>(*node).operand;
+        return cannotFail(operand, is_defined) && (typesOf(operand) & ValueTypes{ ValueType::Fn, ValueType::None }).empty();
+    }
+    case ExprKind::Add:
+    case ExprKind::Sub:
+    case ExprKind::Mul:
+    {
+        const auto& binary_expr = static_cast<const ast::BinaryExpr&>(*node);
+        return cannotFail(binary_expr.lhs, is_defined) && cannotFail(binary_expr.rhs, is_defined) && typesOf(binary_expr.lhs).isSubsetOf(numbers)
+            && typesOf(binary_expr.rhs).isSubsetOf(numbers);
+    }
+    case ExprKind::ComparisonChain:
+    {
+        const auto& chain = static_cast<const ast::ComparisonChainExpr&>(*node);
+        for (const auto& operand : chain.expressions)
+        {
+            if (! cannotFail(operand, is_defined))
+            {
+                return false;
+            }
+        }
+        for (std::size_t i = 0; i < chain.operators.size(); ++i)
+        {
+            const auto lhs = typesOf(chain.expressions[i]);
+            const auto rhs = typesOf(chain.expressions[i + 1]);
+            switch (chain.operators[i])
+            {
+            case ast::Equals:
+            case ast::NotEquals:
+                break;
+            case ast::Member:
+            case ast::NotMember:
+                if (! rhs.isSubsetOf({ ValueType::List }))
+                {
+                    return false;
+                }
+                break;
+            default:
+                if (! lhs.isSubsetOf(numbers) || ! rhs.isSubsetOf(numbers))
+                {
+                    return false;
+                }
+                break;
+            }
+        }
+        return true;
+    }
+    case ExprKind::And:
+    case ExprKind::Or:
+    case ExprKind::Condition:
+    case ExprKind::List:
+    case ExprKind::Tuple:
+    {
+        auto children_cannot_fail = true;
+        ast::forEachChild(
+            *node,
+            [this, &is_defined, &children_cannot_fail](const ast::ExprPtr& child) { children_cannot_fail = children_cannot_fail && cannotFail(child, is_defined); });
+        return children_cannot_fail;
+    }
+    default:
+        return false;
+    }
+}
+
+TypeAnnotations inferTypes(const ast::Expr& expr, const TypeSchema& schema, const FnSignatures& signatures)
+{
+    TypeAnnotations annotations;
+    Inferrer{ schema, signatures, &annotations }.infer(expr);
+    return annotations;
+}
+
+ValueTypes expressionTypes(const ast::Expr& expr, const TypeSchema& schema, const FnSignatures& signatures)
+{
+    return Inferrer{ schema, signatures, nullptr }.infer(expr);
+}
+
+} // namespace CuraFormulaeEngine::opt
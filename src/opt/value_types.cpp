@@ -0,0 +1,58 @@
+#include "cura-formulae-engine/opt/value_types.h"
+
+#include <array>
+#include <string_view>
+
+namespace CuraFormulaeEngine::opt
+{
+
+ValueTypes ValueTypes::of(const eval::Value& value) noexcept
+{
+    return ValueTypes{ static_cast<ValueType>(value.value.index()) };
+}
+
+std::string ValueTypes::toString() const
+{
+    static constexpr std::array<std::string_view, 7> names{ "bool", "float", "int", "str", "list", "function", "None" };
+    std::string result;
+    for (std::size_t type = 0; type < names.size(); ++type)
+    {
+        if (contains(static_cast<ValueType>(type)))
+        {
+            if (! result.empty())
+            {
+                result += " | ";
+            }
+            result += names[type];
+        }
+    }
+    return result;
+}
+
+TypeSchema TypeSchema::fromEnvironment(const env::Environment& environment)
+{
+    TypeSchema schema;
+    for (const auto& [name, value] : environment.getAll())
+    {
+        schema.set(name, ValueTypes::of(value));
+    }
+    return schema;
+}
+
+void TypeSchema::set(const std::string& name, ValueTypes types)
+{
+    types_.insert_or_assign(name, types);
+}
+
+bool TypeSchema::has(const std::string& name) const
+{
+    return types_.contains(name);
+}
+
+ValueTypes TypeSchema::get(const std::string& name) const
+{
+    const auto types = types_.find(name);
+    return types == types_.end() ? ValueTypes::any() : types->second;
+}
+
+} // namespace CuraFormulaeEngine::opt
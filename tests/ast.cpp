@@ -0,0 +1,859 @@
+#include "cura-formulae-engine/ast/binary_expr/add_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/and_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/div_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/mod_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/mul_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/or_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/pow_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/sub_expr.h"
+#include "cura-formulae-engine/ast/comp_chain_expr.h"
+#include "cura-formulae-engine/ast/condition_expr.h"
+#include "cura-formulae-engine/ast/dispatch.h"
+#include "cura-formulae-engine/ast/expr_corpus.h"
+#include "cura-formulae-engine/ast/flat_expr.h"
+#include "cura-formulae-engine/ast/formula_cache.h"
+#include "cura-formulae-engine/ast/fn_application_expr.h"
+#include "cura-formulae-engine/ast/index_expr.h"
+#include "cura-formulae-engine/ast/let_expr.h"
+#include "cura-formulae-engine/ast/list_comprehension_expr.h"
+#include "cura-formulae-engine/ast/list_expr.h"
+#include "cura-formulae-engine/ast/printer.h"
+#include "cura-formulae-engine/ast/primary_expr/bool_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/float_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/int_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/none_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/string_expr.h"
+#include "cura-formulae-engine/ast/slice_expr.h"
+#include "cura-formulae-engine/ast/static_evaluate.h"
+#include "cura-formulae-engine/ast/tuple_expr.h"
+#include "cura-formulae-engine/ast/unary_expr/neg_expr.h"
+#include "cura-formulae-engine/ast/unary_expr/not_expr.h"
+#include "cura-formulae-engine/ast/variable_expr.h"
+#include "cura-formulae-engine/ast/visitor.h"
+#include "cura-formulae-engine/env/env.h"
+#include "cura-formulae-engine/env/layered_environment.h"
+#include "cura-formulae-engine/eval.h"
+
+#include "fixtures.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <unordered_set>
+#include <variant>
+#include <vector>
+
+using namespace CuraFormulaeEngine::ast;
+using namespace CuraFormulaeEngine::test;
+
+namespace
+{
+
+std::size_t count_nodes(const Expr& expr)
+{
+    std::size_t count = 0;
+    expr.visitAll(
+        [&count](const Expr& node)
+        {
+            if (node.kind() != ExprKind::Ptr)
+            {
+                ++count;
+            }
+        });
+    return count;
+}
+
+/**
+ * Float literals that are easy to get wrong: signed zeros, values only written with an exponent, a subnormal, and the
+ * non-finite ones.
+ */
+std::vector<double> edge_case_floats()
+{
+    return { 0.0, -0.0, 1e300, 0.00001, 1e-310, std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(), std::numeric_limits<double>::quiet_NaN() };
+}
+
+bool same_bits(const CuraFormulaeEngine::eval::Value& value, double expected)
+{
+    const auto* actual = std::get_if<double>(&value.value);
+    return actual != nullptr && std::bit_cast<std::uint64_t>(*actual) == std::bit_cast<std::uint64_t>(expected);
+}
+
+std::size_t count_children(const Expr& expr)
+{
+    std::size_t count = 1;
+    forEachChild(expr, [&count](const ExprPtr& child) { count += count_children(child); });
+    return count;
+}
+
+} // namespace
+
+TEST_CASE("flat expressions evaluate like their trees", "[ast, flat]")
+{
+    const auto environment = sample_environment();
+    for (const auto& formula : sample_formulas())
+    {
+        const auto flat = FlatExpr::flatten(formula);
+        INFO(formula.toString());
+        REQUIRE(same_result(flat.evaluate(&environment), formula.evaluate(&environment)));
+        REQUIRE(flat.freeVariables() == formula.freeVariables());
+        REQUIRE(flat.toString() == formula.toString());
+        REQUIRE(flat.nodes().size() == count_nodes(formula));
+        REQUIRE(count_nodes(flat) == count_nodes(formula));
+    }
+}
+
+TEST_CASE("flat expressions compare equal to their trees", "[ast, flat]")
+{
+    const auto formulas = sample_formulas();
+    const auto others = sample_formulas();
+    for (std::size_t i = 0; i < formulas.size(); ++i)
+    {
+        const auto flat = make_expr_ptr<FlatExpr>(FlatExpr::flatten(formulas[i]));
+        for (std::size_t j = 0; j < others.size(); ++j)
+        {
+            INFO(formulas[i].toString() << " vs " << others[j].toString());
+            REQUIRE(flat.deepEq(others[j]) == (i == j));
+            REQUIRE(others[j].deepEq(flat) == (i == j));
+            REQUIRE(FlatExpr::flatten(formulas[i]).deepEq(FlatExpr::flatten(others[j])) == (i == j));
+        }
+        REQUIRE(FlatExpr::flatten(formulas[i]).toExpr().deepEq(formulas[i]));
+    }
+}
+
+TEST_CASE("flat expressions store children before their parents", "[ast, flat]")
+{
+    const auto flat = FlatExpr::flatten(var("a") * integer(2) + var("a"));
+    REQUIRE(flat.root() == flat.nodes().size() - 1);
+    for (FlatExpr::index_t node = 0; node < flat.nodes().size(); ++node)
+    {
+        for (const auto child : flat.children(node))
+        {
+            REQUIRE(child < node);
+        }
+    }
+}
+
+TEST_CASE("flat expressions keep float literals, errors and untaken branches of their trees", "[ast, flat]")
+{
+    for (const auto value : edge_case_floats())
+    {
+        INFO(value);
+        const auto flat = FlatExpr::flatten(number(value));
+        REQUIRE(same_bits(flat.evaluate(&CuraFormulaeEngine::env::std_env).value(), value));
+        REQUIRE(flat.toExpr().deepEq(number(value)));
+        REQUIRE(flat.structuralHash() == number(value).structuralHash());
+    }
+    REQUIRE(! FlatExpr::flatten(number(0.0)).deepEq(FlatExpr::flatten(number(-0.0))));
+    REQUIRE(! FlatExpr::flatten(number(-0.0)).deepEq(number(0.0)));
+
+    CuraFormulaeEngine::env::LocalEnvironment environment{ &CuraFormulaeEngine::env::std_env };
+    environment.set("c", true);
+    environment.set("x", -0.0);
+
+    // the first failing operand gives the error
+    REQUIRE(FlatExpr::flatten(integer(1) / integer(0) + var("undefined")).evaluate(&environment).error() == CuraFormulaeEngine::eval::Error::DivisionByZero);
+    REQUIRE(FlatExpr::flatten(var("undefined") + integer(1) / integer(0)).evaluate(&environment).error() == CuraFormulaeEngine::eval::Error::UndefinedVariable);
+
+    // float('abc') would throw, it must not be evaluated where the tree does not evaluate it
+    REQUIRE(same_bits(FlatExpr::flatten(make_expr_ptr<ConditionExpr>(var("x"), var("c"), var("float")(string("abc")))).evaluate(&environment).value(), -0.0));
+    REQUIRE(! FlatExpr::flatten(make_expr_ptr<BoolExpr>(false) && var("float")(string("abc"))).evaluate(&environment).value().isTruthy());
+    REQUIRE(FlatExpr::flatten(var("c") || var("int")(string("x"))).evaluate(&environment).value().isTruthy());
+}
+
+TEST_CASE("comparison chains compare adjacent operands", "[ast, comparison]")
+{
+    const auto environment = sample_environment();
+    // 3 <= 2 must fail even though 1 <= 2 holds
+    const auto formula = chain(exprs(integer(1), integer(3), integer(2)), { LessThenEqual, LessThenEqual });
+    REQUIRE(formula.evaluate(&environment).value().deepEq(CuraFormulaeEngine::eval::Value(false)));
+}
+
+TEST_CASE("membership in lists of literals matches a scan of the list", "[ast, comparison]")
+{
+    using CuraFormulaeEngine::eval::Value;
+    const auto lists = []()
+    {
+        return exprs(
+            make_list_expr(integer(1), string("a"), number(2.5)),
+            make_list_expr(make_expr_ptr<BoolExpr>(true)),
+            make_list_expr(number(0.0), -integer(3)),
+            make_list_expr(make_expr_ptr<NoneExpr>(), string("")),
+            make_expr_ptr<TupleExpr>(exprs(string("grid"), string("lines"))),
+            make_list_expr());
+    };
+    const std::vector<Value> operands{ Value{ true },          Value{ false },        Value{ int64_t(0) }, Value{ int64_t(1) }, Value{ int64_t(-3) },
+                                       Value{ 1.0 },           Value{ -0.0 },         Value{ 2.5 },        Value{ -3.0 },       Value{ std::string("a") },
+                                       Value{ std::string("grid") }, Value{ nullptr }, Value{ std::vector<Value>{} } };
+
+    for (const auto& list : lists())
+    {
+        const auto list_value = list.evaluate(nullptr).value();
+        for (const auto& operand : operands)
+        {
+            for (const auto comparison_operator : { Member, NotMember })
+            {
+                CuraFormulaeEngine::env::LocalEnvironment environment{ &CuraFormulaeEngine::env::std_env };
+                environment.set("x", operand);
+                const auto formula = chain(exprs(var("x"), list.share()), { comparison_operator });
+                REQUIRE(static_cast<const ComparisonChainExpr&>(*formula.ptr).constant_sets[0] != nullptr);
+                const auto expected = compare(comparison_operator, operand, list_value).value();
+                INFO(formula.toString() << " with x = " << operand.toString());
+                REQUIRE(formula.evaluate(&environment).value().deepEq(expected));
+                REQUIRE(FlatExpr::flatten(formula).evaluate(&environment).value().deepEq(expected));
+            }
+        }
+    }
+
+    // lists with variables are evaluated and scanned
+    const auto variable_list = chain(exprs(integer(1), make_list_expr(var("x"))), { Member });
+    REQUIRE(static_cast<const ComparisonChainExpr&>(*variable_list.ptr).constant_sets[0] == nullptr);
+    // the list is still the left operand of the next comparison
+    const auto chained = chain(exprs(integer(1), make_list_expr(integer(1)), make_list_expr(integer(1))), { Member, Equals });
+    REQUIRE(chained.evaluate(nullptr).value().deepEq(Value{ true }));
+    REQUIRE(FlatExpr::flatten(chained).evaluate(nullptr).value().deepEq(Value{ true }));
+}
+
+TEST_CASE("and and or only evaluate the right operand when it decides the result", "[ast, boolean]")
+{
+    using CuraFormulaeEngine::eval::Value;
+    std::size_t calls = 0;
+    auto environment = sample_environment();
+    environment.set(
+        "extruderValue",
+        Value::fn_t{ [&calls](const std::vector<Value>&) -> CuraFormulaeEngine::eval::Result
+                     {
+                         ++calls;
+                         return Value{ std::string("pla") };
+                     } });
+    const auto call = []() { return var("extruderValue")(integer(0)); };
+
+    // like Python, the result is the operand that decides it
+    std::vector<std::tuple<ExprPtr, Value, std::size_t>> cases;
+    cases.emplace_back(make_expr_ptr<BoolExpr>(false) && call(), Value{ false }, 0);
+    cases.emplace_back(integer(0) && call(), Value{ int64_t(0) }, 0);
+    cases.emplace_back(make_list_expr() && var("undefined"), Value{ std::vector<Value>{} }, 0);
+    cases.emplace_back(var("support_enable") && call(), Value{ std::string("pla") }, 1);
+    cases.emplace_back(var("line_width") || call(), Value{ 0.4 }, 0);
+    cases.emplace_back(string("x") || var("undefined"), Value{ std::string("x") }, 0);
+    cases.emplace_back(string("") || call(), Value{ std::string("pla") }, 1);
+    cases.emplace_back(make_expr_ptr<NoneExpr>() || integer(2), Value{ int64_t(2) }, 0);
+
+    for (const auto& [formula, expected, expected_calls] : cases)
+    {
+        INFO(formula.toString());
+        calls = 0;
+        REQUIRE(formula.evaluate(&environment).value().deepEq(expected));
+        REQUIRE(evaluate(formula, &environment).value().deepEq(expected));
+        REQUIRE(FlatExpr::flatten(formula).evaluate(&environment).value().deepEq(expected));
+        REQUIRE(calls == 3 * expected_calls);
+    }
+}
+
+TEST_CASE("list comprehensions only evaluate an iterable again when a loop it reads advances", "[ast, list comprehension]")
+{
+    using CuraFormulaeEngine::eval::Value;
+    std::size_t calls = 0;
+    auto environment = sample_environment();
+    environment.set(
+        "extruderValues",
+        Value::fn_t{ [&calls](const std::vector<Value>& args) -> CuraFormulaeEngine::eval::Result
+                     {
+                         ++calls;
+                         return Value{ std::vector<Value>{ args.empty() ? Value{ int64_t(0) } : args[0] } };
+                     } });
+    const auto loops = [](auto... parts)
+    {
+        std::vector<ListComprehensionExpr::loop> result;
+        (result.emplace_back(std::move(parts.first), std::move(parts.second), std::vector<ExprPtr>{}), ...);
+        return result;
+    };
+    const auto loop = [](const std::string& key, ExprPtr iterable) { return std::make_pair(var(key), std::move(iterable)); };
+
+    std::vector<std::tuple<ExprPtr, std::size_t, std::size_t>> cases;
+    // reads no loop variables
+    cases.emplace_back(make_expr_ptr<ListComprehensionExpr>(var("y"), loops(loop("x", var("extruders")), loop("y", var("extruderValues")()))), 1, 3);
+    // reads the outer loop variable, but not the one in between
+    cases.emplace_back(
+        make_expr_ptr<ListComprehensionExpr>(
+            var("z"),
+            loops(loop("x", var("extruders")), loop("y", var("extruders")), loop("z", var("extruderValues")(var("x"))))),
+        3,
+        9);
+    // never evaluated when the outer loop is empty
+    cases.emplace_back(make_expr_ptr<ListComprehensionExpr>(var("y"), loops(loop("x", make_list_expr()), loop("y", var("extruderValues")()))), 0, 0);
+
+    for (const auto& [formula, expected_calls, expected_size] : cases)
+    {
+        INFO(formula.toString());
+        calls = 0;
+        const auto result = formula.evaluate(&environment);
+        REQUIRE(std::get<std::vector<Value>>(result.value().value).size() == expected_size);
+        REQUIRE(calls == expected_calls);
+        calls = 0;
+        REQUIRE(same_result(FlatExpr::flatten(formula).evaluate(&environment), result));
+        REQUIRE(calls == expected_calls);
+    }
+}
+
+TEST_CASE("expressions are dispatched on their kind", "[ast, dispatch]")
+{
+    const auto environment = sample_environment();
+    const auto formulas = sample_formulas();
+    const auto others = sample_formulas();
+    for (std::size_t i = 0; i < formulas.size(); ++i)
+    {
+        INFO(formulas[i].toString());
+        REQUIRE(formulas[i].kind() == ExprKind::Ptr);
+        REQUIRE(same_result(evaluate(formulas[i], &environment), formulas[i].ptr->evaluate(&environment)));
+        REQUIRE(dispatch(formulas[i], [](const auto& node) { return node.kind(); }) == formulas[i].ptr->kind());
+        for (std::size_t j = 0; j < others.size(); ++j)
+        {
+            REQUIRE(equal(formulas[i], *others[j].ptr) == (i == j));
+        }
+
+        REQUIRE(count_children(formulas[i]) == count_nodes(formulas[i]));
+    }
+}
+
+TEST_CASE("dispatched equality compares float literals by their bits", "[ast, dispatch]")
+{
+    for (const auto value : edge_case_floats())
+    {
+        INFO(value);
+        REQUIRE(equal(number(value), number(value)));
+        REQUIRE(same_bits(evaluate(number(value), &CuraFormulaeEngine::env::std_env).value(), value));
+    }
+    REQUIRE(! equal(number(0.0), number(-0.0)));
+    REQUIRE(! equal(number(0.0) + var("x"), number(-0.0) + var("x")));
+    REQUIRE(! equal(number(std::numeric_limits<double>::quiet_NaN()), number(-std::numeric_limits<double>::quiet_NaN())));
+    REQUIRE(! equal(integer(0), number(0.0)));
+    REQUIRE(! equal(integer(1), make_expr_ptr<BoolExpr>(true)));
+    REQUIRE(! equal(string(""), make_expr_ptr<NoneExpr>()));
+
+    // dispatching gives the errors of the virtual calls, and does not evaluate branches they skip
+    CuraFormulaeEngine::env::LocalEnvironment environment{ &CuraFormulaeEngine::env::std_env };
+    environment.set("c", false);
+    REQUIRE(evaluate(var("undefined") * (integer(1) / integer(0)), &environment).error() == CuraFormulaeEngine::eval::Error::UndefinedVariable);
+    REQUIRE(evaluate(-string("x"), &environment).error() == CuraFormulaeEngine::eval::Error::TypeMismatch);
+    REQUIRE(evaluate(make_expr_ptr<ConditionExpr>(var("str")(make_expr_ptr<NoneExpr>()), var("c"), integer(2)), &environment).value().deepEq(CuraFormulaeEngine::eval::Value(int64_t(2))));
+}
+
+TEST_CASE("statically dispatched evaluation matches the virtual path", "[ast, dispatch]")
+{
+    const auto local = sample_environment();
+    const CuraFormulaeEngine::env::EnvironmentMap flattened{ local.getAll() };
+    const auto& settings = local.local_environment_;
+    const CuraFormulaeEngine::env::LayeredEnvironment layered{ settings, CuraFormulaeEngine::env::std_env };
+    const CuraFormulaeEngine::env::EnvironmentMap overrides{ { { "line_width", CuraFormulaeEngine::eval::Value{ 0.5 } } } };
+    const CuraFormulaeEngine::env::LayeredEnvironment stacked{ overrides, layered };
+    REQUIRE(stacked.get("line_width").value().deepEq(CuraFormulaeEngine::eval::Value{ 0.5 }));
+    REQUIRE(stacked.get("layer_height").value().deepEq(CuraFormulaeEngine::eval::Value{ 0.2 }));
+    REQUIRE(stacked.getAll().size() == flattened.getAll().size());
+
+    for (const auto& formula : sample_formulas())
+    {
+        INFO(formula.toString());
+        const auto expected = formula.evaluate(&local);
+        REQUIRE(same_result(evaluate(formula, local), expected));
+        REQUIRE(same_result(evaluate(formula, flattened), expected));
+        REQUIRE(same_result(evaluate(formula, layered), expected));
+        REQUIRE(same_result(evaluate(formula, stacked), formula.evaluate(&stacked)));
+    }
+}
+
+TEST_CASE("statically dispatched evaluation keeps the edge cases of the virtual path", "[ast, dispatch]")
+{
+    using CuraFormulaeEngine::eval::Value;
+    const CuraFormulaeEngine::env::EnvironmentMap settings{ { { "zero", Value{ -0.0 } }, { "nan", Value{ std::numeric_limits<double>::quiet_NaN() } }, { "c", Value{ false } } } };
+    const CuraFormulaeEngine::env::LayeredEnvironment layered{ settings, CuraFormulaeEngine::env::std_env };
+    // an override of another type shadows the value below it
+    const CuraFormulaeEngine::env::EnvironmentMap overrides{ { { "zero", Value{ std::string("0") } } } };
+    const CuraFormulaeEngine::env::LayeredEnvironment stacked{ overrides, layered };
+
+    REQUIRE(same_bits(evaluate(var("zero"), layered).value(), -0.0));
+    REQUIRE(same_bits(evaluate(-var("zero"), layered).value(), 0.0));
+    REQUIRE(same_bits(evaluate(var("zero") * integer(1), layered).value(), -0.0));
+    REQUIRE(std::get<std::string>(evaluate(var("zero") + string("1"), stacked).value().value) == "01");
+
+    // NaN compares unequal to everything, itself included
+    REQUIRE(! evaluate(chain(exprs(var("nan"), var("nan")), { Equals }), layered).value().isTruthy());
+    REQUIRE(evaluate(chain(exprs(var("nan"), var("nan")), { NotEquals }), layered).value().isTruthy());
+    REQUIRE(! evaluate(chain(exprs(var("nan"), integer(1)), { LessThan }), layered).value().isTruthy());
+
+    // the first failing operand gives the error, and branches that are not taken are not evaluated
+    REQUIRE(evaluate(var("undefined") + integer(1) / integer(0), layered).error() == CuraFormulaeEngine::eval::Error::UndefinedVariable);
+    REQUIRE(evaluate(integer(1) / integer(0) + var("undefined"), layered).error() == CuraFormulaeEngine::eval::Error::DivisionByZero);
+    REQUIRE(evaluate(var("zero") - integer(1), stacked).error() == CuraFormulaeEngine::eval::Error::TypeMismatch);
+    REQUIRE(evaluate(make_expr_ptr<ConditionExpr>(var("float")(string("abc")), var("c"), integer(2)), layered).value().deepEq(Value(int64_t(2))));
+    REQUIRE(! evaluate(var("c") && var("int")(string("x")), layered).value().isTruthy());
+}
+
+TEST_CASE("children can be replaced through forEachChild", "[ast, dispatch]")
+{
+    auto formula = var("a") * integer(2) + var("b");
+    forEachChild(
+        *formula.ptr,
+        [](ExprPtr& child)
+        {
+            if (child.ptr->kind() == ExprKind::Variable)
+            {
+                child = integer(1);
+            }
+        });
+    REQUIRE(formula.freeVariables() == std::unordered_set<std::string>{ "a", "b" });
+    formula.ptr->refreshAttributes();
+    REQUIRE(formula.deepEq(var("a") * integer(2) + integer(1)));
+    REQUIRE(formula.freeVariables() == std::unordered_set<std::string>{ "a" });
+}
+
+TEST_CASE("free variables are computed when a node is constructed", "[ast, free variables]")
+{
+    const auto formula = var("line_width") * integer(2) + var("layer_height") / var("line_width");
+    const auto& free_symbols = formula.freeSymbols();
+    REQUIRE(free_symbols.size() == 2);
+    REQUIRE(free_symbols.contains(intern("line_width")));
+    REQUIRE(free_symbols.contains("layer_height"));
+    REQUIRE_FALSE(free_symbols.contains("infill_sparse_density"));
+    REQUIRE(std::ranges::is_sorted(free_symbols.symbols()));
+    // the same set every time, not a rebuilt one
+    REQUIRE(&formula.freeSymbols() == &free_symbols);
+    REQUIRE(symbolName(intern("line_width")) == "line_width");
+}
+
+TEST_CASE("free variables of list comprehensions exclude the loop variables", "[ast, free variables]")
+{
+    std::vector<ListComprehensionExpr::loop> loops;
+    loops.emplace_back(var("x"), var("extruders"), exprs(var("x") > var("minimum")));
+    loops.emplace_back(var("y"), make_list_expr(var("x"), var("y")), std::vector<ExprPtr>{});
+    const auto formula = make_expr_ptr<ListComprehensionExpr>(var("x") * var("y") + var("line_width"), std::move(loops));
+    // the iterable of the second loop reads the y of the enclosing scope
+    REQUIRE(formula.freeVariables() == std::unordered_set<std::string>{ "extruders", "minimum", "y", "line_width" });
+}
+
+TEST_CASE("visitors see nodes before and after their children", "[ast, visitor]")
+{
+    struct Recorder
+    {
+        std::vector<ExprKind> entered;
+        std::vector<ExprKind> left;
+
+        void enter(const Expr& node)
+        {
+            entered.push_back(node.kind());
+        }
+
+        void leave(const Expr& node)
+        {
+            left.push_back(node.kind());
+        }
+    };
+
+    Recorder recorder;
+    REQUIRE(visit(var("a") * integer(2) + var("b"), recorder));
+    REQUIRE(recorder.entered == std::vector{ ExprKind::Add, ExprKind::Mul, ExprKind::Variable, ExprKind::Int, ExprKind::Variable });
+    REQUIRE(recorder.left == std::vector{ ExprKind::Variable, ExprKind::Int, ExprKind::Mul, ExprKind::Variable, ExprKind::Add });
+}
+
+TEST_CASE("visitors can skip subtrees and stop early", "[ast, visitor]")
+{
+    const auto formula = var("a") * integer(2) + var("b");
+
+    std::vector<ExprKind> entered;
+    REQUIRE(visit(
+        formula,
+        [&entered](const Expr& node)
+        {
+            entered.push_back(node.kind());
+            return node.kind() == ExprKind::Mul ? VisitAction::SkipChildren : VisitAction::Continue;
+        }));
+    REQUIRE(entered == std::vector{ ExprKind::Add, ExprKind::Mul, ExprKind::Variable });
+
+    std::size_t visited = 0;
+    REQUIRE_FALSE(visit(
+        formula,
+        [&visited](const Expr& node)
+        {
+            ++visited;
+            return node.kind() == ExprKind::Variable ? VisitAction::Stop : VisitAction::Continue;
+        }));
+    REQUIRE(visited == 3);
+}
+
+TEST_CASE("rewriting visitors replace nodes and refresh free variables", "[ast, visitor]")
+{
+    struct InlineVariable
+    {
+        std::size_t replaced{ 0 };
+
+        void leave(ExprPtr& node)
+        {
+            if (node.ptr->kind() == ExprKind::Variable && static_cast<const VariableExpr&>(*node.ptr).name == "a")
+            {
+                node = integer(3);
+                ++replaced;
+            }
+        }
+    };
+
+    auto formula = var("max")(var("a") * integer(2), var("b") - var("a"));
+    InlineVariable inline_variable;
+    REQUIRE(rewrite(formula, inline_variable));
+    REQUIRE(inline_variable.replaced == 2);
+    REQUIRE(formula.deepEq(var("max")(integer(3) * integer(2), var("b") - integer(3))));
+    REQUIRE(formula.freeVariables() == std::unordered_set<std::string>{ "max", "b" });
+}
+
+TEST_CASE("equal expressions have equal structural hashes", "[ast, hash]")
+{
+    const auto formulas = sample_formulas();
+    const auto others = sample_formulas();
+    for (std::size_t i = 0; i < formulas.size(); ++i)
+    {
+        INFO(formulas[i].toString());
+        REQUIRE(formulas[i].structuralHash() == others[i].structuralHash());
+        REQUIRE(FlatExpr::flatten(formulas[i]).structuralHash() == formulas[i].structuralHash());
+        for (std::size_t j = i + 1; j < others.size(); ++j)
+        {
+            REQUIRE(formulas[i].structuralHash() != others[j].structuralHash());
+        }
+    }
+    REQUIRE(number(0.0).structuralHash() != number(-0.0).structuralHash());
+    REQUIRE(! number(0.0).deepEq(number(-0.0)));
+    REQUIRE(integer(1).structuralHash() != number(1.0).structuralHash());
+    REQUIRE((var("a") - var("b")).structuralHash() != (var("b") - var("a")).structuralHash());
+}
+
+TEST_CASE("a corpus shares identical subexpressions between formulas", "[ast, hash]")
+{
+    ExprCorpus corpus;
+    const auto first = corpus.add(var("machine_nozzle_size") * number(0.8) + integer(1));
+    const auto second = corpus.add(var("machine_nozzle_size") * number(0.8) - var("machine_nozzle_size"));
+
+    const auto& first_sum = static_cast<const BinaryExpr&>(*first.ptr);
+    const auto& second_difference = static_cast<const BinaryExpr&>(*second.ptr);
+    REQUIRE(first_sum.lhs.ptr == second_difference.lhs.ptr);
+    REQUIRE(static_cast<const BinaryExpr&>(*first_sum.lhs.ptr).lhs.ptr == second_difference.rhs.ptr);
+
+    // machine_nozzle_size, 0.8, *, 1, +, -
+    REQUIRE(corpus.size() == 6);
+    REQUIRE(corpus.sharedCount() == 4);
+
+    REQUIRE(first.deepEq(var("machine_nozzle_size") * number(0.8) + integer(1)));
+    REQUIRE(second.freeVariables() == std::unordered_set<std::string>{ "machine_nozzle_size" });
+
+    const auto environment = sample_environment();
+    for (auto& formula : sample_formulas())
+    {
+        const auto expected = formula.evaluate(&environment);
+        const auto shared = corpus.add(std::move(formula));
+        REQUIRE(same_result(shared.evaluate(&environment), expected));
+        REQUIRE(corpus.add(shared.share()).ptr == shared.ptr);
+    }
+}
+
+TEST_CASE("a corpus keeps floats that compare equal but print differently apart", "[ast, hash]")
+{
+    ExprCorpus corpus;
+    const auto positive = corpus.add(number(0.0) + var("x"));
+    const auto negative = corpus.add(number(-0.0) + var("x"));
+    REQUIRE(print(positive) == "0.0 + x");
+    REQUIRE(print(negative) == "(-0.0) + x");
+    // 0.0, x, +, -0.0, +
+    REQUIRE(corpus.size() == 5);
+
+    CuraFormulaeEngine::env::LocalEnvironment environment{ &CuraFormulaeEngine::env::std_env };
+    environment.set("x", -0.0);
+    const auto str_of = [&environment](const ExprPtr& formula) { return std::get<std::string>(var("str")(formula.share()).evaluate(&environment).value().value); };
+    REQUIRE(str_of(positive) == "0.000000");
+    REQUIRE(str_of(negative) == "-0.000000");
+}
+
+TEST_CASE("rewriting a formula of a corpus leaves the formulas sharing its nodes alone", "[ast, hash]")
+{
+    struct ReplaceVariables
+    {
+        void leave(ExprPtr& node)
+        {
+            if (node.ptr->kind() == ExprKind::Variable)
+            {
+                node = integer(0);
+            }
+        }
+    };
+
+    // a visitor that changes the nodes it is given instead of replacing them
+    struct RenameVariables
+    {
+        void leave(ExprPtr& node)
+        {
+            if (node.ptr->kind() == ExprKind::Variable)
+            {
+                static_cast<VariableExpr&>(*node.ptr).name = "renamed";
+            }
+        }
+    };
+
+    ExprCorpus corpus;
+    auto first = corpus.add(var("line_width") * number(0.8) + integer(1));
+    const auto second = corpus.add(var("line_width") * number(0.8) - integer(1));
+    const auto third = corpus.add(var("line_width") * number(0.8) - integer(1));
+
+    rewrite(first, ReplaceVariables{});
+    REQUIRE(print(first) == "0 * 0.8 + 1");
+    REQUIRE(print(second) == "line_width * 0.8 - 1");
+
+    auto renamed = second.share();
+    rewrite(renamed, RenameVariables{});
+    REQUIRE(print(renamed) == "renamed * 0.8 - 1");
+    REQUIRE(print(second) == "line_width * 0.8 - 1");
+    REQUIRE(second.ptr == third.ptr);
+    REQUIRE(corpus.add(var("line_width") * number(0.8) - integer(1)).ptr == second.ptr);
+
+    auto unshared = second.share();
+    unshare(unshared);
+    REQUIRE(unshared.ptr != second.ptr);
+    REQUIRE(static_cast<const BinaryExpr&>(*unshared.ptr).lhs.ptr != static_cast<const BinaryExpr&>(*second.ptr).lhs.ptr);
+    REQUIRE(unshared.deepEq(second));
+}
+
+TEST_CASE("formula caches load the formulas they were built from", "[ast, formula cache]")
+{
+    const auto environment = sample_environment();
+    auto formulas = sample_formulas();
+    formulas.push_back(make_expr_ptr<LetExpr>("$0", var("line_width") * integer(2), var("$0") + var("$0")));
+
+    FormulaCacheBuilder builder;
+    for (const auto& formula : formulas)
+    {
+        builder.add(formula.toString(), formula);
+    }
+    REQUIRE(builder.size() == formulas.size());
+
+    const auto cache = FormulaCache::decode(builder.encode().value());
+    REQUIRE(cache.has_value());
+    REQUIRE(cache.value().size() == formulas.size());
+    for (const auto& formula : formulas)
+    {
+        INFO(formula.toString());
+        const auto loaded = cache.value().find(formula.toString());
+        REQUIRE(loaded.has_value());
+        REQUIRE(loaded.value().deepEq(formula));
+        REQUIRE(loaded.value().structuralHash() == formula.structuralHash());
+        REQUIRE(loaded.value().freeSymbols() == formula.freeSymbols());
+        REQUIRE(same_result(loaded.value().evaluate(&environment), formula.evaluate(&environment)));
+    }
+
+    // a changed text is a different formula
+    REQUIRE(! cache.value().find(formulas[0].toString() + " ").has_value());
+    REQUIRE(! cache.value().find("").has_value());
+    REQUIRE(formulaTextHash("line_width * 2") == formulaTextHash(std::string("line_width * 2")));
+    REQUIRE(formulaTextHash("line_width * 2") != formulaTextHash("line_width * 3"));
+}
+
+TEST_CASE("formula caches keep edge case literals and failing formulas", "[ast, formula cache]")
+{
+    std::vector<ExprPtr> formulas;
+    for (const auto value : edge_case_floats())
+    {
+        formulas.push_back(number(value));
+    }
+    formulas.push_back(integer(std::numeric_limits<std::int64_t>::min()));
+    formulas.push_back(integer(std::numeric_limits<std::int64_t>::max()));
+    formulas.push_back(string(""));
+    formulas.push_back(string(std::string("a\0b\"'", 5)));
+    formulas.push_back(integer(1) / integer(0) + var("undefined"));
+    formulas.push_back(make_expr_ptr<ConditionExpr>(var("x"), var("c"), var("float")(string("abc"))));
+
+    FormulaCacheBuilder builder;
+    for (std::size_t i = 0; i < formulas.size(); ++i)
+    {
+        builder.add(std::to_string(i), formulas[i]);
+    }
+    const auto cache = FormulaCache::decode(builder.encode().value());
+    REQUIRE(cache.has_value());
+
+    CuraFormulaeEngine::env::LocalEnvironment environment{ &CuraFormulaeEngine::env::std_env };
+    environment.set("x", 1.5);
+    environment.set("c", true);
+    const auto floats = edge_case_floats();
+    for (std::size_t i = 0; i < formulas.size(); ++i)
+    {
+        INFO(formulas[i].toString());
+        const auto loaded = cache.value().find(std::to_string(i));
+        REQUIRE(loaded.has_value());
+        REQUIRE(loaded.value().deepEq(formulas[i]));
+        REQUIRE(same_result(loaded.value().evaluate(&environment), formulas[i].evaluate(&environment)));
+        if (i < floats.size())
+        {
+            REQUIRE(same_bits(loaded.value().evaluate(&environment).value(), floats[i]));
+        }
+    }
+    REQUIRE(cache.value().find(std::to_string(formulas.size() - 2)).value().evaluate(&environment).error() == CuraFormulaeEngine::eval::Error::DivisionByZero);
+}
+
+TEST_CASE("formula caches reject corrupt and incompatible data", "[ast, formula cache]")
+{
+    FormulaCacheBuilder builder;
+    builder.add("formula", sample_formulas()[13]);
+    const auto encoded = builder.encode().value();
+
+    auto magic = encoded;
+    magic[0] = 'X';
+    REQUIRE(FormulaCache::decode(magic).error() == FormulaCacheError::InvalidFormat);
+    REQUIRE(FormulaCache::decode(encoded.substr(0, encoded.size() - 1)).error() == FormulaCacheError::InvalidFormat);
+    auto version = encoded;
+    version[8] = static_cast<char>(version[8] + 1);
+    REQUIRE(FormulaCache::decode(version).error() == FormulaCacheError::IncompatibleVersion);
+
+    // corrupting any byte of the formula gives no formula or one that is still well formed
+    const auto environment = sample_environment();
+    const auto formula_offset = encoded.size() - [&encoded]()
+    {
+        std::string formula;
+        FlatExpr::flatten(sample_formulas()[13]).encode(formula);
+        return formula.size();
+    }();
+    for (auto offset = formula_offset; offset < encoded.size(); ++offset)
+    {
+        auto corrupt = encoded;
+        corrupt[offset] = static_cast<char>(corrupt[offset] ^ 0x5a);
+        const auto loaded = FormulaCache::decode(corrupt).value().find("formula");
+        if (loaded.has_value())
+        {
+            static_cast<void>(loaded.value().evaluate(&environment));
+            static_cast<void>(loaded.value().toString());
+        }
+    }
+    REQUIRE(! FlatExpr::decode(std::span<const std::byte>{}).has_value());
+}
+
+TEST_CASE("formula caches are replaced when written again", "[ast, formula cache]")
+{
+    const auto path = std::filesystem::temp_directory_path() / "cura-formulae-engine-formula-cache-test.cfec";
+    FormulaCacheBuilder first;
+    first.add("first", sample_formulas()[0]);
+    REQUIRE(first.write(path).has_value());
+    const auto old_cache = FormulaCache::open(path);
+    REQUIRE(old_cache.has_value());
+
+    FormulaCacheBuilder second;
+    second.add("second", sample_formulas()[1]);
+    REQUIRE(second.write(path).has_value());
+
+    const auto new_cache = FormulaCache::open(path);
+    REQUIRE(new_cache.has_value());
+    REQUIRE(new_cache.value().find("second").has_value());
+    REQUIRE(! new_cache.value().find("first").has_value());
+    REQUIRE(old_cache.value().find("first").value().deepEq(sample_formulas()[0]));
+
+    // writers racing on the same file each write their own temporary file, one of them is published whole
+    std::array<bool, 4> written{};
+    std::vector<std::thread> writers;
+    for (std::size_t i = 0; i < written.size(); ++i)
+    {
+        writers.emplace_back([&path, &first, &second, &written, i] { written[i] = (i % 2 == 0 ? first : second).write(path).has_value(); });
+    }
+    for (auto& writer : writers)
+    {
+        writer.join();
+    }
+    REQUIRE(std::all_of(written.begin(), written.end(), [](bool success) { return success; }));
+    const auto raced_cache = FormulaCache::open(path);
+    REQUIRE(raced_cache.has_value());
+    REQUIRE(raced_cache.value().find("first").has_value() != raced_cache.value().find("second").has_value());
+
+    for (const auto& entry : std::filesystem::directory_iterator(path.parent_path()))
+    {
+        const auto name = entry.path().filename().string();
+        REQUIRE(! (name.starts_with(path.filename().string()) && name.ends_with(".tmp")));
+    }
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("printing writes formulas with the parentheses their precedence needs", "[ast, printer]")
+{
+    const std::vector<std::string> expected{
+        "line_width * 2 + 0.5",
+        "-layer_height / 3 - infill_sparse_density % 7",
+        "layer_height ** 2",
+        "not (support_enable and True) or False",
+        "1 < wall_line_count <= 4 >= 10",
+        "adhesion_type in [\"brim\", \"skirt\"]",
+        "adhesion_type not in [\"raft\"]",
+        "line_width if support_enable else None",
+        "max(line_width, layer_height, 1)",
+        "extruders[1]",
+        "extruders[(-2)::(-1)]",
+        "extruders[:1]",
+        "(line_width, \"x\")",
+        "[x * y + line_width for x in extruders if x > 0 for y in [x, 10]]",
+        "undefined + 1",
+        "1 / 0",
+    };
+    const auto formulas = sample_formulas();
+    REQUIRE(formulas.size() == expected.size());
+    for (std::size_t i = 0; i < formulas.size(); ++i)
+    {
+        REQUIRE(print(formulas[i]) == expected[i]);
+        REQUIRE(print(FlatExpr::flatten(formulas[i])) == expected[i]);
+    }
+
+    REQUIRE(print(var("a") - (var("b") - var("c"))) == "a - (b - c)");
+    REQUIRE(print((var("a") - var("b")) - var("c")) == "a - b - c");
+    REQUIRE(print(-make_expr_ptr<PowExpr>(var("x"), integer(2))) == "-x ** 2");
+    REQUIRE(print(make_expr_ptr<PowExpr>(-var("x"), integer(2))) == "(-x) ** 2");
+    REQUIRE(print(make_expr_ptr<PowExpr>(integer(2), integer(-1))) == "2 ** (-1)");
+    REQUIRE(print(make_expr_ptr<PowExpr>(var("a"), make_expr_ptr<PowExpr>(var("b"), var("c")))) == "a ** b ** c");
+    REQUIRE(print(make_expr_ptr<PowExpr>(make_expr_ptr<PowExpr>(var("a"), var("b")), var("c"))) == "(a ** b) ** c");
+    REQUIRE(print(! ! var("a")) == "not (not a)");
+    REQUIRE(print(chain(exprs(chain(exprs(var("a"), var("b")), { LessThan }), var("c")), { Equals })) == "(a < b) == c");
+    REQUIRE(print(make_expr_ptr<ConditionExpr>(var("a"), var("c"), make_expr_ptr<ConditionExpr>(var("b"), var("d"), var("e")))) == "a if c else b if d else e");
+    REQUIRE(print(make_expr_ptr<ConditionExpr>(make_expr_ptr<ConditionExpr>(var("a"), var("b"), var("c")), var("d"), var("e"))) == "(a if b else c) if d else e");
+    REQUIRE(print(number(1.0)) == "1.0");
+    REQUIRE(print(number(-2.0)) == "(-2.0)");
+    REQUIRE(print(make_expr_ptr<PowExpr>(number(-0.0), integer(2))) == "(-0.0) ** 2");
+    REQUIRE(print(integer(-1) - integer(-1)) == "(-1) - (-1)");
+    REQUIRE(print(number(0.00001)) == "0.00001");
+    REQUIRE(print(number(0.1)) == "0.1");
+    // large floats are written with all their integer digits, which read back as the same value
+    const auto large = print(number(1e300));
+    REQUIRE(large.size() == 303);
+    REQUIRE(large.ends_with(".0"));
+    REQUIRE(std::stod(large) == 1e300);
+    REQUIRE(print(number(-1e-7)) == "(-0.0000001)");
+    REQUIRE(print(number(std::numeric_limits<double>::infinity())) == "math.inf");
+    REQUIRE(print(number(-std::numeric_limits<double>::infinity())) == "(-math.inf)");
+    REQUIRE(print(number(std::numeric_limits<double>::quiet_NaN())) == "math.nan");
+    REQUIRE(print(string("say \"hi\"")) == "'say \"hi\"'");
+    REQUIRE(print(make_tuple_expr(var("a"))) == "(a,)");
+    REQUIRE(print(make_expr_ptr<LetExpr>("$0", var("a") + var("b"), var("$0") * var("$0"))) == "(let $0 = a + b in $0 * $0)");
+}
+
+TEST_CASE("printing fully parenthesized puts every operator in parentheses", "[ast, printer]")
+{
+    const auto formulas = sample_formulas();
+    REQUIRE(print(formulas[0], PrintStyle::Full) == "((line_width * 2) + 0.5)");
+    REQUIRE(print(formulas[1], PrintStyle::Full) == "(((-layer_height) / 3) - (infill_sparse_density % 7))");
+    REQUIRE(print(formulas[3], PrintStyle::Full) == "((not (support_enable and True)) or False)");
+    REQUIRE(print(formulas[4], PrintStyle::Full) == "(1 < wall_line_count <= 4 >= 10)");
+    REQUIRE(print(formulas[7], PrintStyle::Full) == "(line_width if support_enable else None)");
+    REQUIRE(print(formulas[10], PrintStyle::Full) == "extruders[(-2)::(-1)]");
+
+    // printing appends to what is in the buffer
+    std::string buffer = "key: ";
+    printTo(buffer, formulas[0]);
+    printTo(buffer, formulas[2], PrintStyle::Full);
+    REQUIRE(buffer == "key: line_width * 2 + 0.5(layer_height ** 2)");
+}
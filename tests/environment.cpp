@@ -0,0 +1,484 @@
+#include "cura-formulae-engine/ast/binary_expr/add_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/div_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/mul_expr.h"
+#include "cura-formulae-engine/ast/fn_application_expr.h"
+#include "cura-formulae-engine/ast/lookup_cache.h"
+#include "cura-formulae-engine/ast/primary_expr/int_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/string_expr.h"
+#include "cura-formulae-engine/ast/variable_expr.h"
+#include "cura-formulae-engine/env/concurrent_environment.h"
+#include "cura-formulae-engine/env/env.h"
+#include "cura-formulae-engine/env/environment_batch.h"
+#include "cura-formulae-engine/env/extruder_environment_family.h"
+#include "cura-formulae-engine/env/formula_environment.h"
+#include "cura-formulae-engine/env/snapshot_environment.h"
+#include "cura-formulae-engine/eval.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <variant>
+#include <vector>
+
+using namespace CuraFormulaeEngine::ast;
+
+TEST_CASE("concurrent environment snapshot is immutable", "[environment, concurrent]")
+{
+    CuraFormulaeEngine::env::ConcurrentEnvironment environment;
+    environment.set("x", int64_t(1));
+
+    const auto snapshot = environment.snapshot();
+    environment.set("x", int64_t(2));
+    environment.set("y", int64_t(3));
+
+    REQUIRE(snapshot->get("x").value().deepEq(CuraFormulaeEngine::eval::Value(int64_t(1))));
+    REQUIRE(! snapshot->has("y"));
+    REQUIRE(environment.get("x").value().deepEq(CuraFormulaeEngine::eval::Value(int64_t(2))));
+    REQUIRE(environment.has("y"));
+    REQUIRE(environment.version() == 3);
+}
+
+TEST_CASE("concurrent environment update publishes a single version", "[environment, concurrent]")
+{
+    CuraFormulaeEngine::env::ConcurrentEnvironment environment;
+    environment.update(
+        [](CuraFormulaeEngine::env::EnvironmentMap& map)
+        {
+            map.set("a", int64_t(1));
+            map.set("b", int64_t(2));
+        });
+
+    REQUIRE(environment.version() == 1);
+    REQUIRE(environment.getAll().size() == 2);
+    REQUIRE(environment.erase("a"));
+    REQUIRE(! environment.erase("a"));
+    REQUIRE(environment.version() == 2);
+}
+
+TEST_CASE("concurrent environment readers observe consistent versions", "[environment, concurrent]")
+{
+    CuraFormulaeEngine::env::ConcurrentEnvironment environment;
+    environment.update(
+        [](CuraFormulaeEngine::env::EnvironmentMap& map)
+        {
+            map.set("a", int64_t(0));
+            map.set("b", int64_t(0));
+        });
+
+    // the writer keeps a + b == 0, readers must never observe a torn update
+    const auto expr = make_expr_ptr<VariableExpr>(std::string("a")) + make_expr_ptr<VariableExpr>(std::string("b"));
+    std::atomic<bool> torn{ false };
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i)
+    {
+        readers.emplace_back(
+            [&]
+            {
+                for (int j = 0; j < 1000; ++j)
+                {
+                    const auto snapshot = environment.snapshot();
+                    const auto result = expr.evaluate(snapshot.get());
+                    if (! result.has_value() || ! result.value().deepEq(CuraFormulaeEngine::eval::Value(int64_t(0))))
+                    {
+                        torn = true;
+                    }
+
+                    // version n + 1 is the one that set a to n
+                    const auto versioned = environment.versionedSnapshot();
+                    const auto a = versioned.environment->get("a");
+                    if (! a.has_value() || ! a.value().deepEq(CuraFormulaeEngine::eval::Value(static_cast<int64_t>(versioned.version) - 1)))
+                    {
+                        torn = true;
+                    }
+                }
+            });
+    }
+    for (int64_t i = 1; i <= 200; ++i)
+    {
+        environment.update(
+            [i](CuraFormulaeEngine::env::EnvironmentMap& map)
+            {
+                map.set("a", i);
+                map.set("b", -i);
+            });
+    }
+    for (auto& reader : readers)
+    {
+        reader.join();
+    }
+
+    REQUIRE(! torn);
+    REQUIRE(environment.version() == 201);
+}
+
+TEST_CASE("formula environment evaluates lazily", "[environment, formula]")
+{
+    CuraFormulaeEngine::env::LocalEnvironment base{ &CuraFormulaeEngine::env::std_env };
+    base.set("x", int64_t(2));
+
+    CuraFormulaeEngine::env::FormulaEnvironment environment{ &base };
+    environment.setFormula("a", make_expr_ptr<VariableExpr>(std::string("b")) * make_expr_ptr<IntExpr>(3));
+    environment.setFormula("b", make_expr_ptr<VariableExpr>(std::string("x")) + make_expr_ptr<IntExpr>(1));
+    environment.setFormula("unused", make_expr_ptr<VariableExpr>(std::string("x")) + make_expr_ptr<IntExpr>(5));
+
+    const auto a = environment.evaluate("a");
+    REQUIRE(a.has_value());
+    REQUIRE(a.value().deepEq(CuraFormulaeEngine::eval::Value(int64_t(9))));
+    REQUIRE(environment.isEvaluated("b"));
+    REQUIRE(! environment.isEvaluated("unused"));
+
+    base.set("x", int64_t(4));
+    environment.invalidate("x");
+    REQUIRE(! environment.isEvaluated("a"));
+    REQUIRE(! environment.isEvaluated("b"));
+    REQUIRE(environment.get("a").value().deepEq(CuraFormulaeEngine::eval::Value(int64_t(15))));
+}
+
+TEST_CASE("formula environment reports cycles", "[environment, formula]")
+{
+    CuraFormulaeEngine::env::FormulaEnvironment environment{ &CuraFormulaeEngine::env::std_env };
+    environment.setFormula("a", make_expr_ptr<VariableExpr>(std::string("b")) + make_expr_ptr<IntExpr>(1));
+    environment.setFormula("b", make_expr_ptr<VariableExpr>(std::string("a")) + make_expr_ptr<IntExpr>(1));
+    environment.setFormula("c", make_expr_ptr<VariableExpr>(std::string("a")) * make_expr_ptr<IntExpr>(2));
+
+    const auto c = environment.evaluate("c");
+    REQUIRE(! c.has_value());
+    REQUIRE(c.error() == CuraFormulaeEngine::eval::Error::CyclicDependency);
+    REQUIRE(environment.evaluate("b").error() == CuraFormulaeEngine::eval::Error::CyclicDependency);
+    REQUIRE(! environment.get("a").has_value());
+}
+
+TEST_CASE("formula environment reports the innermost error", "[environment, formula]")
+{
+    CuraFormulaeEngine::env::FormulaEnvironment environment{ &CuraFormulaeEngine::env::std_env };
+    environment.setFormula("a", make_expr_ptr<VariableExpr>(std::string("b")) + make_expr_ptr<IntExpr>(1));
+    environment.setFormula("b", make_expr_ptr<IntExpr>(1) / make_expr_ptr<IntExpr>(0));
+
+    REQUIRE(environment.evaluate("a").error() == CuraFormulaeEngine::eval::Error::DivisionByZero);
+    REQUIRE(environment.evaluate("missing").error() == CuraFormulaeEngine::eval::Error::UndefinedVariable);
+
+    // the same error when the failing formula was evaluated, and memoized, first
+    environment.invalidate("b");
+    REQUIRE(environment.evaluate("b").error() == CuraFormulaeEngine::eval::Error::DivisionByZero);
+    REQUIRE(environment.evaluate("a").error() == CuraFormulaeEngine::eval::Error::DivisionByZero);
+    REQUIRE(environment.evaluate("a").error() == CuraFormulaeEngine::eval::Error::DivisionByZero);
+}
+
+TEST_CASE("extruder environment family layers extruders over the global stack", "[environment, extruder]")
+{
+    CuraFormulaeEngine::env::ExtruderEnvironmentFamily family{ 3, &CuraFormulaeEngine::env::std_env };
+    family.setGlobal("line_width", 0.4);
+    family.setExtruder(1, "line_width", 0.6);
+    family.setExtruder(2, "material", std::string("PLA"));
+
+    REQUIRE(family.extruderValue(0, "line_width").value().deepEq(CuraFormulaeEngine::eval::Value(0.4)));
+    REQUIRE(family.extruderValue(1, "line_width").value().deepEq(CuraFormulaeEngine::eval::Value(0.6)));
+    REQUIRE(! family.extruderValue(0, "material").has_value());
+    REQUIRE(family.extruder(2).has("material"));
+    REQUIRE(! family.global().has("material"));
+    REQUIRE(family.extruder(0).has("max"));
+
+    const auto line_widths = family.extruderValues("line_width");
+    REQUIRE(line_widths.has_value());
+    REQUIRE(CuraFormulaeEngine::eval::Value(line_widths.value()).deepEq(CuraFormulaeEngine::eval::Value(std::vector<CuraFormulaeEngine::eval::Value>{ 0.4, 0.6, 0.4 })));
+    REQUIRE(! family.extruderValues("missing").has_value());
+
+    REQUIRE(family.eraseExtruder(1, "line_width"));
+    REQUIRE(! family.eraseExtruder(1, "line_width"));
+    const auto slot = family.slot("line_width");
+    REQUIRE(slot.has_value());
+    REQUIRE(family.extruderValue(1, slot.value())->deepEq(CuraFormulaeEngine::eval::Value(0.4)));
+    REQUIRE(family.extruderValues(slot.value()).has_value());
+
+    // material is only set in extruder 2, the other extruders have no value for it
+    const auto material = family.slot("material");
+    REQUIRE(material.has_value());
+    REQUIRE(family.extruderValue(0, material.value()) == nullptr);
+    REQUIRE(! family.extruderValues(material.value()).has_value());
+    REQUIRE(! family.extruderValues(material.value() + 1).has_value());
+    REQUIRE(family.extruderValue(0, material.value() + 1) == nullptr);
+}
+
+TEST_CASE("extruder environment family resolves cross-extruder functions", "[environment, extruder]")
+{
+    CuraFormulaeEngine::env::ExtruderEnvironmentFamily family{ 2, &CuraFormulaeEngine::env::std_env };
+    family.setGlobal("speed", int64_t(50));
+    family.setExtruder(1, "speed", int64_t(30));
+
+    const auto extruder_value = make_expr_ptr<VariableExpr>(std::string("extruderValue"))(make_expr_ptr<IntExpr>(1), make_expr_ptr<StringExpr>(std::string("speed")));
+    REQUIRE(extruder_value.evaluate(&family.extruder(0)).value().deepEq(CuraFormulaeEngine::eval::Value(int64_t(30))));
+
+    const auto global_value = make_expr_ptr<VariableExpr>(std::string("extruderValue"))(make_expr_ptr<IntExpr>(-1), make_expr_ptr<StringExpr>(std::string("speed")));
+    REQUIRE(global_value.evaluate(&family.extruder(1)).value().deepEq(CuraFormulaeEngine::eval::Value(int64_t(50))));
+
+    const auto out_of_range = make_expr_ptr<VariableExpr>(std::string("extruderValue"))(make_expr_ptr<IntExpr>(2), make_expr_ptr<StringExpr>(std::string("speed")));
+    REQUIRE(out_of_range.evaluate(&family.global()).error() == CuraFormulaeEngine::eval::Error::IndexOutOfBounds);
+
+    const auto max_speed = make_expr_ptr<VariableExpr>(std::string("max"))(make_expr_ptr<VariableExpr>(std::string("extruderValues"))(make_expr_ptr<StringExpr>(std::string("speed"))));
+    REQUIRE(max_speed.evaluate(&family.global()).value().deepEq(CuraFormulaeEngine::eval::Value(int64_t(50))));
+}
+
+TEST_CASE("snapshot environment round trips through a mapped file", "[environment, snapshot]")
+{
+    CuraFormulaeEngine::env::EnvironmentMap defaults;
+    defaults.set("layer_height", 0.2);
+    defaults.set("wall_line_count", int64_t(3));
+    defaults.set("support_enable", false);
+    defaults.set("material_type", std::string("PLA"));
+    defaults.set("machine_head_polygon", std::vector<CuraFormulaeEngine::eval::Value>{ int64_t(-20), std::vector<CuraFormulaeEngine::eval::Value>{ 1.5, std::string("x") } });
+    defaults.set("adhesion_extruder_nr", nullptr);
+
+    const auto path = std::filesystem::temp_directory_path() / "cura-formulae-engine-snapshot-test.cfes";
+    REQUIRE(CuraFormulaeEngine::env::writeSnapshot(defaults, path).has_value());
+
+    {
+        const auto snapshot = CuraFormulaeEngine::env::SnapshotEnvironment::open(path);
+        REQUIRE(snapshot.has_value());
+        REQUIRE(snapshot.value().size() == 6);
+        for (const auto& [key, value] : defaults.getAll())
+        {
+            REQUIRE(snapshot.value().has(key));
+            REQUIRE(snapshot.value().get(key).value().deepEq(value));
+        }
+        REQUIRE(! snapshot.value().has("missing"));
+        REQUIRE(snapshot.value().getAll().size() == 6);
+
+        const auto expr = make_expr_ptr<VariableExpr>(std::string("wall_line_count")) * make_expr_ptr<IntExpr>(2);
+        REQUIRE(expr.evaluate(&snapshot.value()).value().deepEq(CuraFormulaeEngine::eval::Value(int64_t(6))));
+
+        // writing a new snapshot replaces the file, the mapped one keeps its values
+        defaults.set("wall_line_count", int64_t(4));
+        REQUIRE(CuraFormulaeEngine::env::writeSnapshot(defaults, path).has_value());
+        REQUIRE(snapshot.value().get("wall_line_count").value().deepEq(CuraFormulaeEngine::eval::Value(int64_t(3))));
+        REQUIRE(CuraFormulaeEngine::env::SnapshotEnvironment::open(path).value().get("wall_line_count").value().deepEq(CuraFormulaeEngine::eval::Value(int64_t(4))));
+    }
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("snapshot environment rejects functions and invalid files", "[environment, snapshot]")
+{
+    REQUIRE(CuraFormulaeEngine::env::encodeSnapshot(CuraFormulaeEngine::env::std_env).error() == CuraFormulaeEngine::env::SnapshotError::UnsupportedValue);
+
+    auto encoded = CuraFormulaeEngine::env::encodeSnapshot(CuraFormulaeEngine::env::EnvironmentMap{}).value();
+    encoded[0] = 'X';
+    const auto path = std::filesystem::temp_directory_path() / "cura-formulae-engine-invalid-snapshot-test.cfes";
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << encoded;
+    }
+    REQUIRE(CuraFormulaeEngine::env::SnapshotEnvironment::open(path).error() == CuraFormulaeEngine::env::SnapshotError::InvalidFormat);
+    std::filesystem::remove(path);
+    REQUIRE(CuraFormulaeEngine::env::SnapshotEnvironment::open(path).error() == CuraFormulaeEngine::env::SnapshotError::IoError);
+
+    CuraFormulaeEngine::eval::Value nested{ nullptr };
+    for (std::size_t depth = 0; depth <= CuraFormulaeEngine::env::max_snapshot_nesting; ++depth)
+    {
+        nested = CuraFormulaeEngine::eval::Value{ std::vector<CuraFormulaeEngine::eval::Value>{ nested } };
+    }
+    CuraFormulaeEngine::env::EnvironmentMap too_deep;
+    too_deep.set("a", nested);
+    REQUIRE(CuraFormulaeEngine::env::encodeSnapshot(too_deep).error() == CuraFormulaeEngine::env::SnapshotError::UnsupportedValue);
+}
+
+TEST_CASE("snapshot environment rejects values nested too deeply", "[environment, snapshot]")
+{
+    // a string whose bytes are nested one element lists, then turned into such a list by patching its tag and length
+    const auto crafted = [](std::size_t depth)
+    {
+        std::string lists;
+        for (std::size_t i = 0; i < depth; ++i)
+        {
+            const std::uint64_t one = 1;
+            lists.push_back(char{ 5 });
+            lists.append(reinterpret_cast<const char*>(&one), sizeof(one));
+        }
+        lists.push_back(char{ 0 });
+
+        CuraFormulaeEngine::env::EnvironmentMap environment;
+        environment.set("a", lists);
+        auto encoded = CuraFormulaeEngine::env::encodeSnapshot(environment).value();
+        // header, one index entry and the key "a" precede the value
+        const std::size_t value_offset = 32 + 24 + 1;
+        const std::uint64_t one = 1;
+        encoded[value_offset] = char{ 5 };
+        std::memcpy(encoded.data() + value_offset + 1, &one, sizeof(one));
+        return encoded;
+    };
+
+    const auto path = std::filesystem::temp_directory_path() / "cura-formulae-engine-nested-snapshot-test.cfes";
+    for (const auto& [depth, readable] : { std::pair{ std::size_t{ 8 }, true }, std::pair{ std::size_t{ 100000 }, false } })
+    {
+        {
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            file << crafted(depth);
+        }
+        const auto snapshot = CuraFormulaeEngine::env::SnapshotEnvironment::open(path);
+        REQUIRE(snapshot.has_value());
+        REQUIRE(snapshot.value().has("a"));
+        REQUIRE(snapshot.value().get("a").has_value() == readable);
+    }
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("environment batch reports the changed keys", "[environment, batch]")
+{
+    CuraFormulaeEngine::env::EnvironmentMap environment;
+    environment.set("a", int64_t(1));
+    environment.set("b", int64_t(2));
+
+    CuraFormulaeEngine::env::EnvironmentBatch batch;
+    batch.reserve(4);
+    batch.set("a", int64_t(1));
+    batch.set("b", int64_t(5));
+    batch.set("c", int64_t(3));
+    batch.erase("c");
+    batch.erase("missing");
+    batch.set("d", int64_t(4));
+    REQUIRE(batch.size() == 5);
+
+    const auto changed = environment.apply(batch);
+    REQUIRE(changed == std::unordered_set<std::string>{ "b", "d" });
+    REQUIRE(environment.get("b").value().deepEq(CuraFormulaeEngine::eval::Value(int64_t(5))));
+    REQUIRE(! environment.has("c"));
+
+    CuraFormulaeEngine::env::ConcurrentEnvironment concurrent{ environment.clone() };
+    REQUIRE(concurrent.apply(batch).empty());
+    REQUIRE(concurrent.version() == 0);
+    batch.erase("a");
+    REQUIRE(concurrent.apply(batch) == std::unordered_set<std::string>{ "a" });
+    REQUIRE(concurrent.version() == 1);
+}
+
+TEST_CASE("environment batch stores functions and signed zeros", "[environment, batch]")
+{
+    using CuraFormulaeEngine::eval::Value;
+    CuraFormulaeEngine::env::EnvironmentMap environment;
+    environment.set("fn", Value::fn_t{ [](const std::vector<Value>&) -> CuraFormulaeEngine::eval::Result { return Value(int64_t(1)); } });
+    environment.set("zero", 0.0);
+    environment.set("one", int64_t(1));
+    const auto generation = environment.generation();
+
+    CuraFormulaeEngine::env::EnvironmentBatch batch;
+    batch.set("fn", Value::fn_t{ [](const std::vector<Value>&) -> CuraFormulaeEngine::eval::Result { return Value(int64_t(2)); } });
+    batch.set("zero", -0.0);
+    batch.set("one", true);
+    REQUIRE(environment.apply(batch) == std::unordered_set<std::string>{ "fn", "zero", "one" });
+    REQUIRE(environment.generation() != generation);
+
+    const auto fn = environment.get("fn");
+    REQUIRE(std::get<Value::fn_t>(fn.value().value)({}).value().deepEq(Value(int64_t(2))));
+    REQUIRE(std::signbit(std::get<double>(environment.get("zero").value().value)));
+    REQUIRE(std::holds_alternative<bool>(environment.get("one").value().value));
+}
+
+TEST_CASE("environment batch invalidates formulas once", "[environment, batch]")
+{
+    CuraFormulaeEngine::env::LocalEnvironment base{ &CuraFormulaeEngine::env::std_env };
+    base.set("x", int64_t(1));
+    base.set("y", int64_t(2));
+
+    CuraFormulaeEngine::env::FormulaEnvironment environment{ &base };
+    environment.setFormula("sum", make_expr_ptr<VariableExpr>(std::string("x")) + make_expr_ptr<VariableExpr>(std::string("y")));
+    REQUIRE(environment.get("sum").value().deepEq(CuraFormulaeEngine::eval::Value(int64_t(3))));
+
+    CuraFormulaeEngine::env::EnvironmentBatch batch;
+    batch.set("x", int64_t(10));
+    batch.set("y", int64_t(20));
+    environment.invalidate(base.local_environment_.apply(batch));
+    REQUIRE(environment.get("sum").value().deepEq(CuraFormulaeEngine::eval::Value(int64_t(30))));
+}
+
+TEST_CASE("environment map generations change with every edit", "[environment, generation]")
+{
+    CuraFormulaeEngine::env::EnvironmentMap environment;
+    environment.set("a", int64_t(1));
+    const auto generation = environment.generation();
+    REQUIRE(generation != 0);
+    const auto* value = environment.find("a");
+    REQUIRE(value != nullptr);
+    REQUIRE(environment.find("missing") == nullptr);
+
+    environment.reserve(1024);
+    REQUIRE(environment.generation() == generation);
+    REQUIRE(environment.find("a") == value);
+    REQUIRE(! environment.erase("missing"));
+    REQUIRE(environment.generation() == generation);
+
+    const auto copy = environment.clone();
+    REQUIRE(copy.generation() != generation);
+    environment.set("b", int64_t(2));
+    REQUIRE(environment.generation() != generation);
+
+    // only environments storing their values have generations, they are not part of every environment
+    const CuraFormulaeEngine::env::LocalEnvironment local{ &environment };
+    const CuraFormulaeEngine::env::Environment* environments[] = { &environment, &local };
+    REQUIRE(dynamic_cast<const CuraFormulaeEngine::env::GenerationalEnvironment*>(environments[0]) == &environment);
+    REQUIRE(dynamic_cast<const CuraFormulaeEngine::env::GenerationalEnvironment*>(environments[1]) == nullptr);
+}
+
+TEST_CASE("variable lookups are cached until the environment changes", "[environment, generation]")
+{
+    CuraFormulaeEngine::env::EnvironmentMap environment;
+    environment.set("a", int64_t(1));
+    environment.set("b", int64_t(2));
+    const auto expr = make_expr_ptr<VariableExpr>(std::string("a")) + make_expr_ptr<VariableExpr>(std::string("b"));
+
+    setLookupStatisticsEnabled(true);
+    resetLookupStatistics();
+    for (int i = 0; i < 10; ++i)
+    {
+        REQUIRE(expr.evaluate(&environment).value().deepEq(CuraFormulaeEngine::eval::Value(int64_t(3))));
+    }
+    REQUIRE(lookupStatistics().misses == 2);
+    REQUIRE(lookupStatistics().hits == 18);
+
+    environment.set("a", int64_t(10));
+    REQUIRE(expr.evaluate(&environment).value().deepEq(CuraFormulaeEngine::eval::Value(int64_t(12))));
+    REQUIRE(lookupStatistics().misses == 4);
+
+    const auto other = environment.clone();
+    REQUIRE(expr.evaluate(&other).value().deepEq(CuraFormulaeEngine::eval::Value(int64_t(12))));
+    REQUIRE(lookupStatistics().misses == 6);
+
+    environment.erase("a");
+    REQUIRE(expr.evaluate(&environment).error() == CuraFormulaeEngine::eval::Error::UndefinedVariable);
+
+    CuraFormulaeEngine::env::LocalEnvironment local{ &other };
+    REQUIRE(expr.evaluate(&local).value().deepEq(CuraFormulaeEngine::eval::Value(int64_t(12))));
+    REQUIRE(lookupStatistics().uncached == 2);
+
+    // environments defined outside the library only implement the lookups of `Environment`
+    struct ForwardingEnvironment final : CuraFormulaeEngine::env::Environment
+    {
+        const Environment* target{ nullptr };
+
+        std::optional<CuraFormulaeEngine::eval::Value> get(const std::string& key) const override
+        {
+            return target->get(key);
+        }
+        bool has(const std::string& key) const override
+        {
+            return target->has(key);
+        }
+        std::unordered_map<std::string, CuraFormulaeEngine::eval::Value> getAll() const override
+        {
+            return target->getAll();
+        }
+    };
+    ForwardingEnvironment forwarding;
+    forwarding.target = &other;
+    REQUIRE(expr.evaluate(&forwarding).value().deepEq(CuraFormulaeEngine::eval::Value(int64_t(12))));
+    REQUIRE(lookupStatistics().uncached == 4);
+    REQUIRE(lookupStatistics().hitRate() > 0.5);
+    setLookupStatisticsEnabled(false);
+}
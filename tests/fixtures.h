@@ -0,0 +1,176 @@
+#pragma once
+
+#include "cura-formulae-engine/ast/binary_expr/add_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/and_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/div_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/mod_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/mul_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/or_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/pow_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/sub_expr.h"
+#include "cura-formulae-engine/ast/comp_chain_expr.h"
+#include "cura-formulae-engine/ast/condition_expr.h"
+#include "cura-formulae-engine/ast/expr_ptr.h"
+#include "cura-formulae-engine/ast/fn_application_expr.h"
+#include "cura-formulae-engine/ast/index_expr.h"
+#include "cura-formulae-engine/ast/list_comprehension_expr.h"
+#include "cura-formulae-engine/ast/list_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/bool_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/float_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/int_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/none_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/string_expr.h"
+#include "cura-formulae-engine/ast/slice_expr.h"
+#include "cura-formulae-engine/ast/tuple_expr.h"
+#include "cura-formulae-engine/ast/unary_expr/neg_expr.h"
+#include "cura-formulae-engine/ast/unary_expr/not_expr.h"
+#include "cura-formulae-engine/ast/variable_expr.h"
+#include "cura-formulae-engine/env/env.h"
+#include "cura-formulae-engine/eval.h"
+
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// expression builders and sample formulas shared by the test files
+namespace CuraFormulaeEngine::test
+{
+
+using namespace CuraFormulaeEngine::ast;
+
+inline ExprPtr var(const std::string& name)
+{
+    return make_expr_ptr<VariableExpr>(name);
+}
+
+inline ExprPtr integer(std::int64_t value)
+{
+    return make_expr_ptr<IntExpr>(value);
+}
+
+inline ExprPtr number(double value)
+{
+    return make_expr_ptr<FloatExpr>(value);
+}
+
+inline ExprPtr string(const std::string& value)
+{
+    return make_expr_ptr<StringExpr>(value);
+}
+
+inline ExprPtr chain(std::vector<ExprPtr> expressions, std::vector<ComparisonOperators> operators)
+{
+    return make_expr_ptr<ComparisonChainExpr>(std::move(expressions), std::move(operators));
+}
+
+template<typename... Ts>
+std::vector<ExprPtr> exprs(Ts... expressions)
+{
+    std::vector<ExprPtr> result;
+    (result.push_back(std::move(expressions)), ...);
+    return result;
+}
+
+/**
+ * Formulas covering every node type, shaped after the formulas in Cura's machine definitions.
+ */
+inline std::vector<ExprPtr> sample_formulas()
+{
+    std::vector<ExprPtr> formulas;
+    formulas.push_back(var("line_width") * integer(2) + number(0.5));
+    formulas.push_back(-var("layer_height") / integer(3) - var("infill_sparse_density") % integer(7));
+    formulas.push_back(make_expr_ptr<PowExpr>(var("layer_height"), integer(2)));
+    formulas.push_back(! (var("support_enable") && make_expr_ptr<BoolExpr>(true)) || make_expr_ptr<BoolExpr>(false));
+    formulas.push_back(chain(exprs(integer(1), var("wall_line_count"), integer(4), integer(10)), { LessThan, LessThenEqual, GreaterThenEqual }));
+    formulas.push_back(chain(exprs(var("adhesion_type"), make_list_expr(string("brim"), string("skirt"))), { Member }));
+    formulas.push_back(chain(exprs(var("adhesion_type"), make_list_expr(string("raft"))), { NotMember }));
+    formulas.push_back(make_expr_ptr<ConditionExpr>(var("line_width"), var("support_enable"), make_expr_ptr<NoneExpr>()));
+    formulas.push_back(var("max")(var("line_width"), var("layer_height"), integer(1)));
+    formulas.push_back(var("extruders")[integer(1)]);
+    formulas.push_back(make_expr_ptr<SliceExpr>(var("extruders"), std::optional<ExprPtr>{ integer(-2) }, std::optional<ExprPtr>{}, std::optional<ExprPtr>{ integer(-1) }));
+    formulas.push_back(make_expr_ptr<SliceExpr>(var("extruders"), std::optional<ExprPtr>{}, std::optional<ExprPtr>{ integer(1) }, std::optional<ExprPtr>{}));
+    formulas.push_back(make_tuple_expr(var("line_width"), string("x")));
+
+    std::vector<ListComprehensionExpr::loop> loops;
+    loops.emplace_back(var("x"), var("extruders"), exprs(var("x") > integer(0)));
+    loops.emplace_back(var("y"), make_list_expr(var("x"), integer(10)), std::vector<ExprPtr>{});
+    formulas.push_back(make_expr_ptr<ListComprehensionExpr>(var("x") * var("y") + var("line_width"), std::move(loops)));
+
+    formulas.push_back(var("undefined") + integer(1));
+    formulas.push_back(integer(1) / integer(0));
+    return formulas;
+}
+
+inline CuraFormulaeEngine::env::LocalEnvironment sample_environment()
+{
+    CuraFormulaeEngine::env::LocalEnvironment environment{ &CuraFormulaeEngine::env::std_env };
+    environment.set("line_width", 0.4);
+    environment.set("layer_height", 0.2);
+    environment.set("infill_sparse_density", int64_t(20));
+    environment.set("wall_line_count", int64_t(3));
+    environment.set("support_enable", true);
+    environment.set("adhesion_type", std::string("brim"));
+    environment.set("extruders", std::vector<CuraFormulaeEngine::eval::Value>{ int64_t(0), int64_t(1), int64_t(2) });
+    return environment;
+}
+
+/**
+ * Formulas mixing constant and variable parts, shaped after the formulas in Cura's machine definitions.
+ */
+inline std::vector<ExprPtr> folding_formulas()
+{
+    std::vector<ExprPtr> formulas;
+    formulas.push_back(var("math.pi") / integer(180) * var("support_angle"));
+    formulas.push_back(var("line_width") * (integer(2) + integer(3)) - -integer(1));
+    formulas.push_back(var("max")(integer(1), var("round")(number(2.6))) + var("wall_line_count"));
+    formulas.push_back(make_expr_ptr<ConditionExpr>(var("line_width"), chain(exprs(integer(1), integer(2)), { LessThan }), var("layer_height")));
+    formulas.push_back(chain(exprs(var("adhesion_type"), make_list_expr(string("brim"), string("skirt"))), { Member }));
+    formulas.push_back(var("extruders")[integer(3) - integer(2)]);
+    formulas.push_back(var("len")(make_list_expr(integer(1), integer(2))) * var("layer_height"));
+
+    std::vector<ListComprehensionExpr::loop> loops;
+    loops.emplace_back(var("x"), var("extruders"), exprs(var("x") > integer(2) - integer(2)));
+    formulas.push_back(make_expr_ptr<ListComprehensionExpr>(var("x") * (integer(2) * integer(5)), std::move(loops)));
+
+    formulas.push_back(var("line_width") + integer(1) / integer(0));
+    formulas.push_back(var("undefined") + integer(1) * integer(2));
+    return formulas;
+}
+
+inline CuraFormulaeEngine::env::LocalEnvironment folding_environment()
+{
+    CuraFormulaeEngine::env::LocalEnvironment environment{ &CuraFormulaeEngine::env::std_env };
+    environment.set("line_width", 0.4);
+    environment.set("layer_height", 0.2);
+    environment.set("support_angle", 50.0);
+    environment.set("wall_line_count", int64_t(3));
+    environment.set("adhesion_type", std::string("brim"));
+    environment.set("extruders", std::vector<CuraFormulaeEngine::eval::Value>{ int64_t(0), int64_t(1), int64_t(2) });
+    return environment;
+}
+
+inline bool same_result(const CuraFormulaeEngine::eval::Result& lhs, const CuraFormulaeEngine::eval::Result& rhs)
+{
+    if (lhs.has_value() != rhs.has_value())
+    {
+        return false;
+    }
+    if (! lhs.has_value())
+    {
+        return lhs.error() == rhs.error();
+    }
+    // NaN is not equal to itself, but is the same result
+    const auto* lhs_float = std::get_if<double>(&lhs.value().value);
+    const auto* rhs_float = std::get_if<double>(&rhs.value().value);
+    if (lhs_float != nullptr && rhs_float != nullptr && std::isnan(*lhs_float) && std::isnan(*rhs_float))
+    {
+        return true;
+    }
+    return lhs.value().deepEq(rhs.value());
+}
+
+} // namespace CuraFormulaeEngine::test
@@ -0,0 +1,883 @@
+#include "cura-formulae-engine/ast/binary_expr/add_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/and_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/div_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/mul_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/or_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/pow_expr.h"
+#include "cura-formulae-engine/ast/binary_expr/sub_expr.h"
+#include "cura-formulae-engine/ast/comp_chain_expr.h"
+#include "cura-formulae-engine/ast/condition_expr.h"
+#include "cura-formulae-engine/ast/dispatch.h"
+#include "cura-formulae-engine/ast/expr_corpus.h"
+#include "cura-formulae-engine/ast/flat_expr.h"
+#include "cura-formulae-engine/ast/fn_application_expr.h"
+#include "cura-formulae-engine/ast/fused_expr.h"
+#include "cura-formulae-engine/ast/index_expr.h"
+#include "cura-formulae-engine/ast/let_expr.h"
+#include "cura-formulae-engine/ast/list_comprehension_expr.h"
+#include "cura-formulae-engine/ast/list_expr.h"
+#include "cura-formulae-engine/ast/printer.h"
+#include "cura-formulae-engine/ast/primary_expr/bool_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/float_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/int_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/none_expr.h"
+#include "cura-formulae-engine/ast/primary_expr/string_expr.h"
+#include "cura-formulae-engine/ast/tuple_expr.h"
+#include "cura-formulae-engine/ast/unary_expr/neg_expr.h"
+#include "cura-formulae-engine/ast/unary_expr/not_expr.h"
+#include "cura-formulae-engine/ast/variable_expr.h"
+#include "cura-formulae-engine/ast/visitor.h"
+#include "cura-formulae-engine/env/env.h"
+#include "cura-formulae-engine/eval.h"
+#include "cura-formulae-engine/opt/canonicalize.h"
+#include "cura-formulae-engine/opt/common_subexpressions.h"
+#include "cura-formulae-engine/opt/constant_folding.h"
+#include "cura-formulae-engine/opt/cost_model.h"
+#include "cura-formulae-engine/opt/filter_pushdown.h"
+#include "cura-formulae-engine/opt/fusion.h"
+#include "cura-formulae-engine/opt/partial_evaluation.h"
+#include "cura-formulae-engine/opt/simplify.h"
+#include "cura-formulae-engine/opt/type_inference.h"
+#include "cura-formulae-engine/opt/value_types.h"
+
+#include "fixtures.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <zeus/expected.hpp>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <unordered_set>
+#include <variant>
+#include <vector>
+
+using namespace CuraFormulaeEngine::ast;
+using namespace CuraFormulaeEngine::test;
+using namespace CuraFormulaeEngine::opt;
+
+namespace
+{
+
+ExprPtr comprehension(ExprPtr iterator, ExprPtr key, ExprPtr iterable)
+{
+    std::vector<ListComprehensionExpr::loop> loops;
+    loops.emplace_back(std::move(key), std::move(iterable), std::vector<ExprPtr>{});
+    return make_expr_ptr<ListComprehensionExpr>(std::move(iterator), std::move(loops));
+}
+
+TypeSchema simplification_schema()
+{
+    TypeSchema schema;
+    schema.set("f", { ValueType::Float });
+    schema.set("g", { ValueType::Float });
+    schema.set("n", { ValueType::Int });
+    schema.set("m", { ValueType::Int });
+    schema.set("b", { ValueType::Bool });
+    schema.set("s", { ValueType::String });
+    schema.set("l", { ValueType::List });
+    schema.set("flags", { ValueType::List });
+    return schema;
+}
+
+/**
+ * Environments holding values of the types in the simplification schema, including the corner cases of the rewrites.
+ */
+std::vector<CuraFormulaeEngine::env::LocalEnvironment> simplification_environments()
+{
+    using CuraFormulaeEngine::eval::Value;
+    std::vector<CuraFormulaeEngine::env::LocalEnvironment> environments;
+    const auto add = [&environments](double f, double g, std::int64_t n, std::int64_t m, bool b, const std::string& s, std::vector<Value> l)
+    {
+        auto& environment = environments.emplace_back(&CuraFormulaeEngine::env::std_env);
+        environment.set("f", f);
+        environment.set("g", g);
+        environment.set("n", n);
+        environment.set("m", m);
+        environment.set("b", b);
+        environment.set("s", s);
+        environment.set("l", l);
+        environment.set("flags", std::vector<Value>{ true, false });
+    };
+    add(2.5, -0.0, 7, -3, true, "brim", { int64_t(1), int64_t(2) });
+    add(-0.0, 1e300, 0, 1000000, false, "", { int64_t(4), int64_t(-4) });
+    add(-3.75, std::numeric_limits<double>::infinity(), -5, 0, true, "skirt", { 0.5 });
+    add(1e-310, 3.0, 3, 3, false, "raft", { std::string("a") });
+    // squares beyond 2^53 round when computed through double
+    add(1.0, std::numeric_limits<double>::quiet_NaN(), 94906267, -94906267, true, "brim", { int64_t(3) });
+    return environments;
+}
+
+/**
+ * Pairs of a formula and what it simplifies to under the simplification schema.
+ */
+std::vector<std::pair<ExprPtr, ExprPtr>> simplification_cases()
+{
+    std::vector<std::pair<ExprPtr, ExprPtr>> cases;
+    const auto add = [&cases](ExprPtr formula, ExprPtr simplified) { cases.emplace_back(std::move(formula), std::move(simplified)); };
+
+    add(var("n") + integer(0), var("n"));
+    add(integer(0) + var("n"), var("n"));
+    add(var("f") + integer(0), var("f") + integer(0));
+    add(var("f") - integer(0), var("f"));
+    add(var("n") - integer(0), var("n"));
+    add(var("f") - number(0.0), var("f"));
+    add(var("n") - number(0.0), var("n") - number(0.0));
+    add(integer(0) - var("n"), -var("n"));
+    add(var("s") * integer(1), var("s"));
+    add(integer(1) * var("l"), var("l"));
+    add(var("f") * number(1.0), var("f"));
+    add(var("n") * number(1.0), var("n") * number(1.0));
+    add(var("b") * integer(1), var("b") * integer(1));
+    add(var("f") / integer(1), var("f"));
+    add(var("n") / integer(1), var("n") * number(1.0));
+    add(var("n") / integer(2), var("n") * number(0.5));
+    add(var("f") / number(0.25), var("f") * number(4.0));
+    add(var("f") / integer(-8), var("f") * number(-0.125));
+    add(var("f") / integer(3), var("f") / integer(3));
+    add(var("n") / integer(0), var("n") / integer(0));
+    add(var("b") / integer(2), var("b") / integer(2));
+    add(make_expr_ptr<PowExpr>(var("f"), integer(1)), var("f"));
+    add(make_expr_ptr<PowExpr>(var("n"), integer(1)), make_expr_ptr<PowExpr>(var("n"), integer(1)));
+    add(make_expr_ptr<PowExpr>(var("n"), integer(2)), make_expr_ptr<PowExpr>(var("n"), integer(2)));
+    add(make_expr_ptr<PowExpr>(var("f"), integer(2)), var("f") * var("f"));
+    add(make_expr_ptr<PowExpr>(var("f"), number(2.0)), make_expr_ptr<PowExpr>(var("f"), number(2.0)));
+    add(make_expr_ptr<PowExpr>(var("b"), integer(2)), make_expr_ptr<PowExpr>(var("b"), integer(2)));
+    add(make_expr_ptr<PowExpr>(var("f") + var("g"), integer(2)), make_expr_ptr<PowExpr>(var("f") + var("g"), integer(2)));
+    add(- -var("f"), var("f"));
+    add(- -var("b"), - -var("b"));
+    add(! ! var("b"), var("b"));
+    add(! ! var("n"), ! ! var("n"));
+    add(! ! ! ! chain(exprs(var("n"), var("m")), { LessThan }), chain(exprs(var("n"), var("m")), { LessThan }));
+    add(make_expr_ptr<BoolExpr>(true) && var("b"), var("b"));
+    add(var("b") && make_expr_ptr<BoolExpr>(true), var("b"));
+    add(make_expr_ptr<BoolExpr>(false) || (var("n") < var("m")), var("n") < var("m"));
+    add(make_expr_ptr<BoolExpr>(true) && var("n"), var("n"));
+    add(make_expr_ptr<BoolExpr>(false) && var("undefined"), make_expr_ptr<BoolExpr>(false));
+    add(integer(0) || var("s"), var("s"));
+    add(string("x") || var("undefined"), string("x"));
+    add(var("n") && make_expr_ptr<BoolExpr>(true), var("n") && make_expr_ptr<BoolExpr>(true));
+    add(var("b") || make_expr_ptr<BoolExpr>(false), var("b"));
+    add(make_expr_ptr<ConditionExpr>(var("f"), make_expr_ptr<BoolExpr>(true), var("s")), var("f"));
+    add(make_expr_ptr<ConditionExpr>(var("f"), integer(0), var("n")), var("n"));
+    add(make_expr_ptr<ConditionExpr>(var("f"), ! var("n"), var("g")), make_expr_ptr<ConditionExpr>(var("g"), var("n"), var("f")));
+    add(make_expr_ptr<ConditionExpr>(var("f"), ! var("undefined"), var("g")), make_expr_ptr<ConditionExpr>(var("f"), ! var("undefined"), var("g")));
+    add(var("min")(var("min")(var("f"), var("n")), var("m")), var("min")(var("f"), var("n"), var("m")));
+    add(var("max")(var("max")(var("max")(var("f"), var("n")), var("m")), var("max")(var("g"), var("b"))), var("max")(var("f"), var("n"), var("m"), var("max")(var("g"), var("b"))));
+    // min(1, min(nan, m)) is 1, min(1, nan, m) would be m
+    add(var("min")(var("f"), var("min")(var("g"), var("m"))), var("min")(var("f"), var("min")(var("g"), var("m"))));
+    add(var("min")(var("min")(var("l")), var("n")), var("min")(var("min")(var("l")), var("n")));
+    add(var("max")(var("min")(var("f"), var("n")), var("m")), var("max")(var("min")(var("f"), var("n")), var("m")));
+    add(var("n") * (var("f") / integer(1)) + integer(0) * var("m"), var("n") * var("f") + integer(0) * var("m"));
+
+    // loop variables shadow the schema
+    add(comprehension(var("f") * number(1.0), var("f"), var("flags")), comprehension(var("f") * number(1.0), var("f"), var("flags")));
+    add(comprehension(var("n") + integer(0), var("x"), var("l")), comprehension(var("n"), var("x"), var("l")));
+    add(comprehension(var("min")(var("min")(var("n"), var("m")), integer(1)), var("min"), var("flags")),
+        comprehension(var("min")(var("min")(var("n"), var("m")), integer(1)), var("min"), var("flags")));
+    return cases;
+}
+
+/**
+ * An environment with functions that count how often they are called, like Cura's extruderValue(s).
+ */
+CuraFormulaeEngine::env::LocalEnvironment counting_environment(std::size_t& calls)
+{
+    using CuraFormulaeEngine::eval::Value;
+    CuraFormulaeEngine::env::LocalEnvironment environment{ &CuraFormulaeEngine::env::std_env };
+    environment.set(
+        "extruderValues",
+        Value::fn_t{ [&calls](const std::vector<Value>& args) -> CuraFormulaeEngine::eval::Result
+                     {
+                         ++calls;
+                         if (args.size() != 1 || ! std::holds_alternative<std::string>(args[0].value))
+                         {
+                             return zeus::unexpected(CuraFormulaeEngine::eval::Error::TypeMismatch);
+                         }
+                         return Value{ std::vector<Value>{ 0.4, 0.6 } };
+                     } });
+    environment.set(
+        "extruderValue",
+        Value::fn_t{ [&calls](const std::vector<Value>& args) -> CuraFormulaeEngine::eval::Result
+                     {
+                         ++calls;
+                         if (args.size() != 1 || ! std::holds_alternative<std::int64_t>(args[0].value))
+                         {
+                             return zeus::unexpected(CuraFormulaeEngine::eval::Error::TypeMismatch);
+                         }
+                         return std::get<std::int64_t>(args[0].value) - 1;
+                     } });
+    environment.set("extruders", std::vector<Value>{ int64_t(0), int64_t(1), int64_t(2) });
+    environment.set("empty", std::vector<Value>{});
+    environment.set("x", int64_t(1));
+    environment.set("b", false);
+    return environment;
+}
+
+} // namespace
+
+TEST_CASE("constant folding keeps the result of formulas", "[optimizer, constant folding]")
+{
+    const auto environment = folding_environment();
+    auto formulas = folding_formulas();
+    for (auto& formula : formulas)
+    {
+        INFO(formula.toString());
+        const auto expected = formula.evaluate(&environment);
+        const auto folded = foldConstants(std::move(formula));
+        INFO(folded.toString());
+        REQUIRE(same_result(folded.evaluate(&environment), expected));
+    }
+}
+
+TEST_CASE("constant folding replaces constant subexpressions by literals", "[optimizer, constant folding]")
+{
+    std::size_t folded = 0;
+    const auto formula = foldConstants(var("line_width") * (integer(2) + integer(3)) - var("max")(integer(1), var("round")(number(2.6))), CuraFormulaeEngine::env::std_env, &folded);
+    REQUIRE(formula.deepEq(var("line_width") * integer(5) - integer(3)));
+    REQUIRE(folded == 3);
+    REQUIRE(formula.freeVariables() == std::unordered_set<std::string>{ "line_width" });
+
+    REQUIRE(foldConstants(var("math.pi") / integer(180)).deepEq(number(3.141592653589793 / 180)));
+    REQUIRE(foldConstants(make_list_expr(integer(1), integer(2))).ptr->kind() == ExprKind::List);
+}
+
+TEST_CASE("constant folding keeps subexpressions that fail", "[optimizer, constant folding]")
+{
+    const auto formula = foldConstants(var("line_width") + integer(1) / (integer(2) - integer(2)));
+    REQUIRE(formula.deepEq(var("line_width") + integer(1) / integer(0)));
+
+    // lists and infinities have no literal, but the expressions around them may still fold
+    REQUIRE(foldConstants(var("len")(make_list_expr(integer(1), integer(2)))).deepEq(integer(2)));
+    REQUIRE(foldConstants(var("math.inf")).deepEq(var("math.inf")));
+
+    // loop variables are not constant, even if the constants define a name like them
+    CuraFormulaeEngine::env::LocalEnvironment constants{ &CuraFormulaeEngine::env::std_env };
+    constants.set("x", int64_t(1));
+    std::vector<ListComprehensionExpr::loop> loops;
+    loops.emplace_back(var("x"), var("extruders"), std::vector<ExprPtr>{});
+    const auto comprehension = foldConstants(make_expr_ptr<ListComprehensionExpr>(var("x") + integer(1), std::move(loops)), constants);
+    std::vector<ListComprehensionExpr::loop> expected_loops;
+    expected_loops.emplace_back(var("x"), var("extruders"), std::vector<ExprPtr>{});
+    REQUIRE(comprehension.deepEq(make_expr_ptr<ListComprehensionExpr>(var("x") + integer(1), std::move(expected_loops))));
+}
+
+TEST_CASE("constant folding does not call builtins that may throw", "[optimizer, constant folding]")
+{
+    // these calls throw when evaluated, so they must stay in the branch that is never taken
+    const auto throwing_calls = []
+    {
+        std::vector<ExprPtr> calls;
+        calls.push_back(var("float")(string("abc")));
+        calls.push_back(var("int")(string("x")));
+        calls.push_back(var("int")(string("z"), integer(10)));
+        calls.push_back(var("str")(make_list_expr(integer(1))));
+        calls.push_back(var("str")(make_expr_ptr<NoneExpr>()));
+        return calls;
+    };
+    auto calls = throwing_calls();
+    auto sums = throwing_calls();
+    const auto expected = throwing_calls();
+    for (std::size_t i = 0; i < expected.size(); ++i)
+    {
+        INFO(expected[i].toString());
+        const auto formula = foldConstants(make_expr_ptr<ConditionExpr>(var("x"), var("c"), std::move(calls[i])));
+        REQUIRE(formula.deepEq(make_expr_ptr<ConditionExpr>(var("x"), var("c"), expected[i].share())));
+        REQUIRE(foldConstants(std::move(sums[i]) + integer(1)).deepEq(expected[i].share() + integer(1)));
+    }
+
+    // the arguments still fold
+    REQUIRE(foldConstants(var("str")(integer(1) + integer(2))).deepEq(var("str")(integer(3))));
+}
+
+TEST_CASE("simplification gives the results of the original formulas", "[optimizer, simplify]")
+{
+    const auto schema = simplification_schema();
+    const auto environments = simplification_environments();
+    const auto originals = simplification_cases();
+    auto cases = simplification_cases();
+    for (std::size_t i = 0; i < cases.size(); ++i)
+    {
+        const auto& original = originals[i].first;
+        auto& [formula, expected] = cases[i];
+        INFO(original.toString());
+        const auto simplified = simplify(std::move(formula), schema);
+        INFO(simplified.toString());
+        REQUIRE(simplified.deepEq(expected));
+        for (const auto& environment : environments)
+        {
+            REQUIRE(same_result(simplified.evaluate(&environment), original.evaluate(&environment)));
+        }
+    }
+}
+
+TEST_CASE("simplification counts the rewrites and keeps untyped variables", "[optimizer, simplify]")
+{
+    std::size_t simplified = 0;
+    const auto formula = simplify(! ! (make_expr_ptr<BoolExpr>(true) && var("b")), simplification_schema(), &simplified);
+    REQUIRE(formula.deepEq(var("b")));
+    REQUIRE(simplified == 2);
+
+    REQUIRE(simplify(var("f") * integer(1)).deepEq(var("f") * integer(1)));
+    REQUIRE(simplify(var("f") * integer(1), TypeSchema::fromEnvironment(simplification_environments().front())).deepEq(var("f")));
+}
+
+TEST_CASE("constant folding takes the branch of constant conditions", "[optimizer, constant folding]")
+{
+    const auto formula = foldConstants(make_expr_ptr<ConditionExpr>(var("line_width"), chain(exprs(integer(1), integer(2)), { LessThan }), var("layer_height")) * integer(2));
+    REQUIRE(formula.deepEq(var("line_width") * integer(2)));
+}
+
+TEST_CASE("partial evaluation specializes formulas for frozen values", "[optimizer, partial evaluation]")
+{
+    using CuraFormulaeEngine::eval::Value;
+    CuraFormulaeEngine::env::LocalEnvironment machine{ &CuraFormulaeEngine::env::std_env };
+    machine.set("machine_extruder_count", int64_t(1));
+    machine.set("machine_nozzle_size", 0.4);
+    machine.set("machine_width", 235.0);
+    machine.set("extruders", std::vector<Value>{ int64_t(0) });
+
+    std::vector<ExprPtr> formulas;
+    formulas.push_back(make_expr_ptr<ConditionExpr>(var("line_width") * integer(2), var("machine_extruder_count") > integer(1), var("line_width")) + var("machine_nozzle_size") / integer(2));
+    formulas.push_back(var("max")(var("machine_width") - integer(10), var("brim_width")));
+    formulas.push_back(var("len")(var("extruders")) * var("layer_height"));
+    formulas.push_back(var("extruders") + var("support_extruders"));
+    formulas.push_back(make_expr_ptr<ConditionExpr>(var("machine_nozzle_size") / integer(0), var("machine_width") > integer(100), var("line_width")));
+
+    auto environment = machine;
+    environment.set("line_width", 0.35);
+    environment.set("brim_width", 8.0);
+    environment.set("layer_height", 0.1);
+    environment.set("support_extruders", std::vector<Value>{ int64_t(1) });
+
+    std::vector<PartialEvaluation> specialized;
+    for (auto& formula : formulas)
+    {
+        const auto expected = formula.evaluate(&environment);
+        INFO(formula.toString());
+        specialized.push_back(partiallyEvaluate(std::move(formula), machine));
+        INFO(specialized.back().residual.toString());
+        REQUIRE(same_result(specialized.back().residual.evaluate(&environment), expected));
+    }
+
+    REQUIRE(specialized[0].residual.deepEq(var("line_width") + number(0.2)));
+    REQUIRE(specialized[0].free_variables == std::unordered_set<std::string>{ "line_width" });
+    REQUIRE(specialized[1].residual.deepEq(var("max")(number(225.0), var("brim_width"))));
+    REQUIRE(specialized[1].free_variables == std::unordered_set<std::string>{ "max", "brim_width" });
+    REQUIRE(specialized[2].residual.deepEq(integer(1) * var("layer_height")));
+    REQUIRE(specialized[3].free_variables == std::unordered_set<std::string>{ "extruders", "support_extruders" });
+    REQUIRE(specialized[4].residual.deepEq(number(0.4) / integer(0)));
+    REQUIRE(specialized[4].free_variables.empty());
+}
+
+TEST_CASE("type inference annotates every node", "[optimizer, types]")
+{
+    const auto schema = simplification_schema();
+    const auto formula = make_expr_ptr<ConditionExpr>(var("f") * integer(2), var("b"), var("round")(var("f"))) + var("n");
+    const auto annotations = inferTypes(formula, schema);
+    REQUIRE(annotations.mismatches.empty());
+    REQUIRE(annotations.typesOf(formula) == ValueTypes{ ValueType::Float, ValueType::Int });
+    REQUIRE(annotations.typesOf(formula).toString() == "float | int");
+
+    const auto& condition = static_cast<const ConditionExpr&>(*static_cast<const BinaryExpr&>(*formula.ptr).lhs.ptr);
+    REQUIRE(annotations.typesOf(condition.then_expr) == ValueTypes{ ValueType::Float });
+    REQUIRE(annotations.typesOf(condition.else_expr) == ValueTypes{ ValueType::Int });
+    REQUIRE(annotations.types.size() == 10);
+
+    REQUIRE(expressionTypes(*var("math.pi").ptr) == ValueTypes{ ValueType::Float });
+    REQUIRE(expressionTypes(var("undefined") + integer(1)) == ValueTypes{ ValueType::Int, ValueType::Float });
+    REQUIRE(expressionTypes(var("round")(var("f"), integer(2)), schema) == ValueTypes{ ValueType::Int, ValueType::Float });
+    REQUIRE(expressionTypes(var("l")[integer(0)], schema) == ValueTypes::any());
+    REQUIRE(expressionTypes(comprehension(var("s") - integer(1), var("s"), var("l")), schema) == ValueTypes{ ValueType::List });
+}
+
+TEST_CASE("type inference flags expressions that always fail", "[optimizer, types]")
+{
+    const auto schema = simplification_schema();
+    const auto mismatches = [&schema](const ExprPtr& formula)
+    {
+        std::vector<std::string> result;
+        for (const auto* node : inferTypes(formula, schema).mismatches)
+        {
+            result.push_back(node->toString());
+        }
+        return result;
+    };
+
+    REQUIRE(mismatches(var("s") - integer(1)) == std::vector<std::string>{ "(s - 1)" });
+    REQUIRE(mismatches((var("s") - integer(1)) * var("f")) == std::vector<std::string>{ "(s - 1)" });
+    REQUIRE(mismatches(make_expr_ptr<ConditionExpr>(var("f"), var("b"), var("len")(var("n")))) == std::vector<std::string>{ "(len(n))" });
+    REQUIRE(mismatches(chain(exprs(var("n"), var("s")), { LessThenEqual })) == std::vector<std::string>{ "n <= s" });
+    REQUIRE(mismatches(var("l")[var("f")] + var("b")[integer(0)]).size() == 2);
+    REQUIRE(mismatches(var("max")(var("l"), var("n"))).size() == 1);
+    REQUIRE(mismatches(var("f")(integer(1))).size() == 1);
+
+    // a later comparison of a chain, and the body of a comprehension, need not be evaluated
+    REQUIRE(mismatches(chain(exprs(var("n"), var("m"), var("s")), { LessThan, LessThan })).empty());
+    REQUIRE(mismatches(comprehension(var("s") - integer(1), var("s"), var("l"))).empty());
+    REQUIRE(mismatches(var("min")(var("f"), var("n")) + var("str")(var("b"))).size() == 1);
+    REQUIRE(mismatches(var("n") + var("undefined")).empty());
+}
+
+TEST_CASE("builtin signatures cover the results of the builtins", "[optimizer, types]")
+{
+    using CuraFormulaeEngine::eval::Value;
+    const std::vector<Value> values{ true, int64_t(2), 2.5, std::string("1"), std::vector<Value>{ int64_t(1) }, Value{} };
+    const auto check = [](const std::string& name, const std::vector<Value>& args)
+    {
+        std::vector<ValueTypes> arg_types;
+        for (const auto& arg : args)
+        {
+            arg_types.push_back(ValueTypes::of(arg));
+        }
+        const auto signature_types = builtinSignatures().at(name)(arg_types);
+        const auto result = std::get<Value::fn_t>(CuraFormulaeEngine::env::std_env.get(name).value().value)(args);
+        INFO(name << " " << arg_types.size() << " " << arg_types.front().toString() << " -> " << signature_types.toString());
+        if (result.has_value())
+        {
+            REQUIRE(ValueTypes::of(result.value()).isSubsetOf(signature_types));
+        }
+        else
+        {
+            REQUIRE(result.error() != CuraFormulaeEngine::eval::Error::DivisionByZero);
+        }
+        if (signature_types.empty())
+        {
+            REQUIRE_FALSE(result.has_value());
+        }
+    };
+
+    for (const auto& [name, signature] : builtinSignatures())
+    {
+        for (const auto& arg : values)
+        {
+            // str() of lists and None is not implemented
+            if (name != "str" || (ValueTypes::of(arg) & ValueTypes{ ValueType::List, ValueType::None }).empty())
+            {
+                check(name, { arg });
+            }
+        }
+    }
+    for (const auto* name : { "int", "math.log", "round", "map", "min", "max" })
+    {
+        for (const auto& lhs : values)
+        {
+            for (const auto& rhs : values)
+            {
+                check(name, { lhs, rhs });
+            }
+        }
+    }
+}
+
+TEST_CASE("common subexpression elimination evaluates shared subexpressions once", "[optimizer, common subexpressions]")
+{
+    std::size_t calls = 0;
+    const auto environment = counting_environment(calls);
+    const auto formulas = []()
+    {
+        std::vector<std::pair<ExprPtr, std::size_t>> result;
+        const auto values = []() { return var("extruderValues")(string("speed")); };
+        result.emplace_back(values()[integer(0)] + values()[integer(1)], 1);
+        result.emplace_back(var("len")(values()) + var("sum")(comprehension(var("y"), var("y"), values())), 1);
+        result.emplace_back(var("max")(var("extruderValue")(var("x")) * integer(2), var("extruderValue")(var("x")) + integer(1)) - var("extruderValue")(var("x")), 1);
+
+        std::vector<ListComprehensionExpr::loop> loops;
+        loops.emplace_back(var("x"), var("extruders"), exprs(var("extruderValue")(var("x")) > integer(0)));
+        result.emplace_back(make_expr_ptr<ListComprehensionExpr>(var("extruderValue")(var("x")) * integer(2), std::move(loops)), 1);
+
+        // reads the global x and the loop variable x
+        result.emplace_back(var("extruderValue")(var("x")) + var("sum")(comprehension(var("extruderValue")(var("x")), var("x"), var("extruders"))), 0);
+        // only one branch is evaluated
+        result.emplace_back(make_expr_ptr<ConditionExpr>(values(), var("b"), values()), 0);
+        // the loops may not run, and the call fails when they do
+        const auto failing = []() { return var("extruderValues")(integer(1)); };
+        result.emplace_back(var("len")(comprehension(failing(), var("y"), var("empty"))) + var("len")(comprehension(failing(), var("z"), var("empty"))), 0);
+        // binding the call would report its error instead of the one of the undefined variable
+        result.emplace_back((var("undefined") + failing()[integer(0)]) * failing()[integer(1)], 0);
+        // builtins are defined, nothing before the first call can fail
+        result.emplace_back(var("max")(integer(1), values()[integer(0)]) * values()[integer(1)], 1);
+        // small subexpressions are not worth a temporary
+        result.emplace_back((var("x") + integer(1)) * (var("x") + integer(1)), 0);
+        return result;
+    };
+
+    const auto originals = formulas();
+    auto cases = formulas();
+    for (std::size_t i = 0; i < cases.size(); ++i)
+    {
+        const auto& original = originals[i].first;
+        auto& [formula, expected_eliminated] = cases[i];
+        INFO(original.toString());
+        std::size_t eliminated = 0;
+        const auto shared = eliminateCommonSubexpressions(std::move(formula), &eliminated);
+        INFO(shared.toString());
+        REQUIRE(eliminated == expected_eliminated);
+
+        calls = 0;
+        const auto expected = original.evaluate(&environment);
+        const auto original_calls = calls;
+        calls = 0;
+        REQUIRE(same_result(shared.evaluate(&environment), expected));
+        if (eliminated > 0)
+        {
+            REQUIRE(calls < original_calls);
+        }
+        REQUIRE(same_result(FlatExpr::flatten(shared).evaluate(&environment), expected));
+        REQUIRE(shared.freeVariables() == original.freeVariables());
+    }
+}
+
+TEST_CASE("common subexpression elimination binds temporaries where they are used", "[optimizer, common subexpressions]")
+{
+    const auto values = []() { return var("extruderValues")(string("speed")); };
+    const auto shared = eliminateCommonSubexpressions(values()[integer(0)] + values()[integer(1)]);
+    REQUIRE(shared.deepEq(make_expr_ptr<LetExpr>("$0", values(), var("$0")[integer(0)] + var("$0")[integer(1)])));
+
+    // temporaries do not shadow the names in the formula
+    const auto renamed = eliminateCommonSubexpressions(values()[integer(0)] + values()[integer(1)] + var("$0"));
+    REQUIRE(renamed.deepEq(make_expr_ptr<LetExpr>("$1", values(), var("$1")[integer(0)] + var("$1")[integer(1)]) + var("$0")));
+
+    // the undefined variable is evaluated first, its error must not be replaced by one of the call
+    const auto failing = eliminateCommonSubexpressions(var("$0") + values()[integer(0)] + values()[integer(1)]);
+    REQUIRE(failing.deepEq(var("$0") + values()[integer(0)] + values()[integer(1)]));
+
+    // a subexpression reading a loop variable is bound once per iteration, by an extra loop
+    std::vector<ListComprehensionExpr::loop> loops;
+    loops.emplace_back(var("x"), var("extruders"), exprs(var("extruderValue")(var("x")) > integer(0)));
+    const auto loop = eliminateCommonSubexpressions(make_expr_ptr<ListComprehensionExpr>(var("extruderValue")(var("x")) * integer(2), std::move(loops)));
+    std::vector<ListComprehensionExpr::loop> expected_loops;
+    expected_loops.emplace_back(var("x"), var("extruders"), std::vector<ExprPtr>{});
+    expected_loops.emplace_back(var("$0"), make_list_expr(var("extruderValue")(var("x"))), exprs(var("$0") > integer(0)));
+    REQUIRE(loop.deepEq(make_expr_ptr<ListComprehensionExpr>(var("$0") * integer(2), std::move(expected_loops))));
+}
+
+TEST_CASE("filter pushdown moves conditions to the outermost loop they read", "[optimizer, filter pushdown]")
+{
+    std::size_t calls = 0;
+    const auto environment = counting_environment(calls);
+    const auto schema = TypeSchema::fromEnvironment(environment);
+    const auto pairs = [](std::vector<ExprPtr> outer_conditions, ExprPtr inner_iterable, std::vector<ExprPtr> inner_conditions)
+    {
+        std::vector<ListComprehensionExpr::loop> loops;
+        loops.emplace_back(var("x"), var("extruders"), std::move(outer_conditions));
+        loops.emplace_back(var("y"), std::move(inner_iterable), std::move(inner_conditions));
+        return make_expr_ptr<ListComprehensionExpr>(make_tuple_expr(var("x"), var("y")), std::move(loops));
+    };
+
+    const auto formulas = [&pairs]()
+    {
+        std::vector<std::pair<ExprPtr, std::optional<ExprPtr>>> result;
+        const auto moved = [&result, &pairs](const auto& condition)
+        { result.emplace_back(pairs({}, var("extruders"), exprs(condition())), pairs(exprs(condition()), var("extruders"), {})); };
+        moved([]() { return chain(exprs(var("x"), integer(0)), { NotEquals }); });
+        moved([]() { return var("b"); });
+        moved([]() { return chain(exprs(var("x"), var("extruders")), { Member }); });
+        // reads the inner loop variable
+        result.emplace_back(pairs({}, var("extruders"), exprs(chain(exprs(var("x"), var("y")), { LessThan }))), std::nullopt);
+        // may fail
+        result.emplace_back(pairs({}, var("extruders"), exprs(var("extruderValue")(var("x")))), std::nullopt);
+        result.emplace_back(pairs({}, var("extruders"), exprs(var("undefined"))), std::nullopt);
+        // would be checked before an iterable or a condition that may fail
+        result.emplace_back(pairs({}, var("extruderValues")(string("speed")), exprs(var("b"))), std::nullopt);
+        result.emplace_back(pairs({}, var("extruders"), exprs(var("extruderValue")(var("y")), var("b"))), std::nullopt);
+        return result;
+    };
+
+    const auto originals = formulas();
+    auto cases = formulas();
+    for (std::size_t i = 0; i < cases.size(); ++i)
+    {
+        const auto& original = originals[i].first;
+        auto& [formula, expected] = cases[i];
+        INFO(original.toString());
+        std::size_t moved = 0;
+        const auto pushed = pushDownFilters(std::move(formula), schema, &moved);
+        INFO(pushed.toString());
+        REQUIRE(moved == (expected.has_value() ? 1 : 0));
+        REQUIRE(pushed.deepEq(expected.has_value() ? expected.value() : original));
+        REQUIRE(same_result(pushed.evaluate(&environment), original.evaluate(&environment)));
+        REQUIRE(same_result(FlatExpr::flatten(pushed).evaluate(&environment), original.evaluate(&environment)));
+    }
+
+    // without a schema the variables may be undefined
+    std::size_t moved = 0;
+    const auto unknown = pushDownFilters(pairs({}, var("extruders"), exprs(var("b"))), {}, &moved);
+    REQUIRE(moved == 0);
+    REQUIRE(unknown.deepEq(pairs({}, var("extruders"), exprs(var("b")))));
+}
+
+TEST_CASE("canonicalization makes formulas written differently equal", "[optimizer, canonicalize]")
+{
+    CuraFormulaeEngine::env::LocalEnvironment environment{ &CuraFormulaeEngine::env::std_env };
+    environment.set("f", 0.5);
+    environment.set("g", 1.25);
+    environment.set("h", 3.0);
+    environment.set("n", int64_t(2));
+    environment.set("m", int64_t(5));
+    environment.set("x", int64_t(1));
+    environment.set("a", true);
+    environment.set("b", int64_t(0));
+    environment.set("c", std::string("z"));
+    environment.set("s", std::string("a"));
+    environment.set("t", std::string("b"));
+    const auto schema = TypeSchema::fromEnvironment(environment);
+
+    // each pair means the same, the last element tells whether the canonical forms are equal
+    const auto formulas = []()
+    {
+        std::vector<std::tuple<ExprPtr, ExprPtr, bool>> result;
+        result.emplace_back(var("f") + var("g"), var("g") + var("f"), true);
+        result.emplace_back(var("f") * number(2.0), number(2.0) * var("f"), true);
+        result.emplace_back(var("n") + var("m") + integer(1), integer(1) + (var("m") + var("n")), true);
+        result.emplace_back(var("n") * (var("x") * var("m")), var("m") * var("n") * var("x"), true);
+        result.emplace_back(var("x") > integer(0), integer(0) < var("x"), true);
+        result.emplace_back(var("f") <= var("g"), var("g") >= var("f"), true);
+        result.emplace_back(var("c") == string("z"), string("z") == var("c"), true);
+        result.emplace_back(var("a") && (var("b") && var("c")), (var("a") && var("b")) && var("c"), true);
+        result.emplace_back(var("b") || (var("a") || var("c")), (var("b") || var("a")) || var("c"), true);
+        // strings do not commute, and only >= compares them
+        result.emplace_back(var("s") + var("t"), var("t") + var("s"), false);
+        result.emplace_back(var("s") <= var("t"), var("t") >= var("s"), false);
+        // float additions round differently when reassociated
+        result.emplace_back((var("f") + var("g")) + var("h"), var("f") + (var("g") + var("h")), false);
+        // the order of and and or decides the result
+        result.emplace_back(var("a") && var("b"), var("b") && var("a"), false);
+        // when both operands may fail the first one decides the error
+        result.emplace_back(var("len")(var("u")) + var("len")(var("v")), var("len")(var("v")) + var("len")(var("u")), false);
+        result.emplace_back(var("len")(var("v")) < var("len")(var("u")), var("len")(var("u")) > var("len")(var("v")), false);
+        result.emplace_back(var("len")(var("u")) * var("len")(var("v")) * var("m"), var("m") * var("len")(var("u")) * var("len")(var("v")), false);
+        // an operand that always fails has no types, it is not an integer
+        result.emplace_back((var("s") - integer(1)) + var("n"), var("n") + (var("s") - integer(1)), false);
+        return result;
+    };
+
+    const auto originals = formulas();
+    auto cases = formulas();
+    for (std::size_t i = 0; i < cases.size(); ++i)
+    {
+        auto& [lhs, rhs, equal] = cases[i];
+        const auto& [original_lhs, original_rhs, _] = originals[i];
+        INFO(original_lhs.toString() << " and " << original_rhs.toString());
+        const auto lhs_key = canonicalString(original_lhs, schema);
+        REQUIRE(original_lhs.deepEq(std::get<0>(formulas()[i])));
+        REQUIRE((lhs_key == canonicalString(original_rhs, schema)) == equal);
+
+        const auto canonical_lhs = canonicalize(std::move(lhs), schema);
+        const auto canonical_rhs = canonicalize(std::move(rhs), schema);
+        REQUIRE(print(canonical_lhs, PrintStyle::Full) == lhs_key);
+        REQUIRE(canonical_lhs.deepEq(canonical_rhs) == equal);
+        REQUIRE(same_result(canonical_lhs.evaluate(&environment), original_lhs.evaluate(&environment)));
+        REQUIRE(same_result(canonical_rhs.evaluate(&environment), original_rhs.evaluate(&environment)));
+
+        // canonical forms stay as they are
+        std::size_t canonicalized = 0;
+        const auto again = canonicalize(FlatExpr::flatten(canonical_lhs).toExpr(), schema, &canonicalized);
+        REQUIRE(canonicalized == 0);
+        REQUIRE(again.deepEq(canonical_lhs));
+    }
+
+    // without types only comparisons and boolean chains are rewritten
+    REQUIRE(canonicalString(var("g") + var("f")) == "(g + f)");
+    REQUIRE(canonicalString(integer(0) < var("x")) == "(x > 0)");
+}
+
+TEST_CASE("the cost model weighs nodes by how often they are evaluated", "[optimizer, cost model]")
+{
+    auto model = CostModel::defaults();
+    model.list_sizes["xs"] = 3;
+    model.list_sizes["ys"] = 5;
+
+    // calls going over their list grow with the list
+    const auto speeds = var("sum")(var("extruderValues")(string("speed")));
+    auto more_extruders = model;
+    more_extruders.list_sizes["extruderValues"] = 4;
+    REQUIRE(estimateCost(speeds, more_extruders).total > estimateCost(speeds, model).total);
+
+    // the body of the loops runs for every pair, an iterable only when a loop it reads advances
+    const auto pairs = [](ExprPtr inner_iterable)
+    {
+        std::vector<ListComprehensionExpr::loop> loops;
+        loops.emplace_back(var("x"), var("xs"), std::vector<ExprPtr>{});
+        loops.emplace_back(var("y"), std::move(inner_iterable), std::vector<ExprPtr>{});
+        return make_expr_ptr<ListComprehensionExpr>(var("x") * var("y"), std::move(loops));
+    };
+    const auto invariant = pairs(var("ys"));
+    const auto& invariant_expr = static_cast<const ListComprehensionExpr&>(*invariant.ptr);
+    const auto invariant_estimate = estimateCost(invariant, model);
+    REQUIRE(invariant_estimate.nodes.at(invariant_expr.iterator.ptr.get()).evaluations == 15.0);
+    REQUIRE(invariant_estimate.nodes.at(invariant_expr.loops[0].iterable.ptr.get()).evaluations == 1.0);
+    REQUIRE(invariant_estimate.nodes.at(invariant_expr.loops[1].iterable.ptr.get()).evaluations == 1.0);
+
+    const auto dependent = pairs(var("ys")[var("x")]);
+    const auto& dependent_expr = static_cast<const ListComprehensionExpr&>(*dependent.ptr);
+    const auto dependent_estimate = estimateCost(dependent, model);
+    REQUIRE(dependent_estimate.nodes.at(dependent_expr.loops[1].iterable.ptr.get()).evaluations == 3.0);
+
+    // the expensive part of a formula
+    const auto formula = var("line_width") * integer(2) + var("extruderValue")(integer(0), string("speed_print"));
+    const auto estimate = estimateCost(formula, model);
+    REQUIRE(dominantSubtree(formula, estimate).toString() == var("extruderValue")(integer(0), string("speed_print")).toString());
+    REQUIRE(&dominantSubtree(formula, estimate, 1.0) == formula.ptr.get());
+    double node_totals = 0.0;
+    forEachChild(*formula.ptr, [&estimate, &node_totals](const ExprPtr& child) { node_totals += estimate.nodes.at(child.ptr.get()).total(); });
+    REQUIRE(estimate.total == node_totals + model.kind_costs[static_cast<std::size_t>(ExprKind::Add)]);
+
+    // membership in literals is hashed, in variables it is a scan
+    const auto hashed = chain(exprs(var("x"), make_list_expr(integer(1), integer(2), integer(3))), { Member });
+    const auto scanned = chain(exprs(var("x"), make_list_expr(var("a"), var("b"), var("c"))), { Member });
+    REQUIRE(estimateCost(hashed, model).total < estimateCost(scanned, model).total);
+
+    // flat formulas cost the same as their trees
+    REQUIRE(estimateCost(FlatExpr::flatten(formula), model).total == estimate.total);
+}
+
+TEST_CASE("fused nodes evaluate like the subexpressions they replace", "[optimizer, fusion]")
+{
+    std::vector<ExprPtr> formulas;
+    formulas.push_back(chain(exprs(var("s"), string("brim")), { Equals }));
+    formulas.push_back(chain(exprs(var("n"), integer(3)), { NotEquals }));
+    formulas.push_back(chain(exprs(var("f"), number(2.5)), { LessThan }));
+    formulas.push_back(chain(exprs(var("s"), integer(1)), { GreaterThenEqual }));
+    formulas.push_back(chain(exprs(var("undefined"), string("brim")), { Equals }));
+    formulas.push_back(chain(exprs(var("s"), make_list_expr(string("brim"), string("raft"))), { Member }));
+    formulas.push_back(chain(exprs(var("n"), make_list_expr(integer(7), number(3.0))), { NotMember }));
+    formulas.push_back(var("f") * integer(2));
+    formulas.push_back(number(0.5) * var("n"));
+    formulas.push_back(var("s") * integer(2));
+    formulas.push_back(integer(2) * var("l"));
+    formulas.push_back(make_expr_ptr<ConditionExpr>(var("f"), chain(exprs(var("s"), string("brim")), { Equals }), var("g")));
+    formulas.push_back(make_expr_ptr<ConditionExpr>(var("n"), var("b"), var("undefined")));
+    formulas.push_back(make_expr_ptr<ConditionExpr>(var("f"), var("undefined"), var("g")));
+    formulas.push_back(var("min")(var("f"), var("g")));
+    formulas.push_back(var("max")(var("n"), var("m")));
+    formulas.push_back(var("max")(var("f"), var("n")));
+    formulas.push_back(var("min")(var("s"), var("n")));
+    formulas.push_back(var("min")(var("n"), var("undefined")));
+    formulas.push_back(var("f") * integer(2) + var("max")(var("n"), var("m")));
+
+    const auto environments = simplification_environments();
+    std::size_t fused = 0;
+    for (const auto& formula : formulas)
+    {
+        INFO(formula.toString());
+        const auto fused_formula = fuseShapes(FlatExpr::flatten(formula).toExpr(), &fused);
+        REQUIRE(print(fused_formula) == print(formula));
+        REQUIRE(fused_formula.freeSymbols() == formula.freeSymbols());
+        for (const auto& environment : environments)
+        {
+            REQUIRE(same_result(fused_formula.evaluate(&environment), formula.evaluate(&environment)));
+        }
+    }
+    // the comparison in the condition of a selection is fused too
+    REQUIRE(fused == formulas.size() + 2);
+
+    // only the builtins are known to pick one of their arguments
+    const auto min = fuseShapes(var("min")(var("n"), var("m")));
+    REQUIRE(min.ptr->kind() == ExprKind::Fused);
+    for (const auto& environment : environments)
+    {
+        CuraFormulaeEngine::env::LocalEnvironment shadowing{ &environment };
+        shadowing.set("min", CuraFormulaeEngine::eval::Value::fn_t{ [](const std::vector<CuraFormulaeEngine::eval::Value>& args) -> CuraFormulaeEngine::eval::Result { return int64_t(args.size()); } });
+        REQUIRE(std::get<std::int64_t>(min.evaluate(&shadowing).value().value) == 2);
+        shadowing.set("min", int64_t(1));
+        REQUIRE(min.evaluate(&shadowing).error() == CuraFormulaeEngine::eval::Error::TypeMismatch);
+    }
+}
+
+TEST_CASE("optimizing a formula of a corpus leaves the formulas sharing its nodes alone", "[optimizer, corpus]")
+{
+    // every pass below changes this formula
+    const auto formula = []
+    {
+        return (integer(2) + integer(3)) * var("n") + integer(0) + var("len")(var("l")) * var("len")(var("l")) + var("f") * number(2.0) + var("m") + var("n");
+    };
+    const std::vector<std::function<ExprPtr(ExprPtr)>> passes{
+        [](ExprPtr expr) { return foldConstants(std::move(expr)); },
+        [](ExprPtr expr) { return simplify(std::move(expr), simplification_schema()); },
+        [](ExprPtr expr) { return canonicalize(std::move(expr), simplification_schema()); },
+        [](ExprPtr expr) { return eliminateCommonSubexpressions(std::move(expr)); },
+        [](ExprPtr expr) { return fuseShapes(std::move(expr)); },
+    };
+    for (const auto& pass : passes)
+    {
+        CuraFormulaeEngine::ast::ExprCorpus corpus;
+        const auto first = corpus.add(formula());
+        const auto second = corpus.add(formula());
+        REQUIRE(first.ptr == second.ptr);
+        const auto printed = print(second);
+
+        const auto optimized = pass(first.share());
+        INFO(print(optimized));
+        REQUIRE(! optimized.deepEq(second));
+        REQUIRE(print(first) == printed);
+        REQUIRE(print(second) == printed);
+        REQUIRE(corpus.add(formula()).ptr == second.ptr);
+    }
+}
+
+TEST_CASE("fused nodes follow rewrites of their subexpression", "[optimizer, fusion]")
+{
+    struct ReplaceVariable
+    {
+        std::string name;
+        ExprPtr replacement;
+
+        void leave(ExprPtr& node) const
+        {
+            if (node.ptr->kind() == ExprKind::Variable && static_cast<const VariableExpr&>(*node.ptr).name == name)
+            {
+                node = replacement.share();
+            }
+        }
+    };
+
+    auto scale = fuseShapes(var("f") * integer(2));
+    const auto& fused_expr = static_cast<const FusedExpr&>(*scale.ptr);
+    REQUIRE(fused_expr.shape == FusedShape::VariableScale);
+    rewrite(scale, ReplaceVariable{ "f", var("g") });
+    REQUIRE(fused_expr.shape == FusedShape::VariableScale);
+    REQUIRE(fused_expr.variable == "g");
+    rewrite(scale, ReplaceVariable{ "g", number(1.5) });
+    REQUIRE(! fused_expr.shape.has_value());
+    REQUIRE(std::get<double>(scale.evaluate(&CuraFormulaeEngine::env::std_env).value().value) == 3.0);
+
+    // fusing again leaves fused nodes as they are
+    std::size_t fused = 0;
+    auto selection = fuseShapes(make_expr_ptr<ConditionExpr>(var("f"), chain(exprs(var("s"), string("brim")), { Equals }), var("g")), &fused);
+    REQUIRE(fused == 2);
+    selection = fuseShapes(std::move(selection), &fused);
+    REQUIRE(fused == 2);
+
+    // fused nodes are cheaper than the nodes they evaluate
+    const auto original = var("f") * integer(2) + var("max")(var("n"), var("m"));
+    REQUIRE(estimateCost(fuseShapes(FlatExpr::flatten(original).toExpr())).total < estimateCost(original).total);
+}
+
+TEST_CASE("shape statistics count the shapes fusion replaces", "[optimizer, fusion]")
+{
+    ShapeStatistics statistics;
+    statistics.add(make_expr_ptr<ConditionExpr>(var("f"), chain(exprs(var("s"), string("brim")), { Equals }), var("g")));
+    statistics.add(var("f") * integer(2) + var("n") * integer(3));
+    statistics.add(fuseShapes(var("max")(var("n"), var("m"))));
+    statistics.add(var("min")(var("n"), integer(1)));
+
+    REQUIRE(statistics.formulas == 4);
+    REQUIRE(statistics.nodes == 6 + 7 + 4 + 4);
+    const auto at = [](const auto& counts, FusedShape shape) { return counts[static_cast<std::size_t>(shape)]; };
+    REQUIRE(at(statistics.occurrences, FusedShape::VariableComparison) == 1);
+    REQUIRE(at(statistics.occurrences, FusedShape::VariableSelection) == 1);
+    REQUIRE(at(statistics.fused_nodes, FusedShape::VariableSelection) == 3);
+    REQUIRE(at(statistics.occurrences, FusedShape::VariableScale) == 2);
+    REQUIRE(at(statistics.formulas_with, FusedShape::VariableScale) == 1);
+    REQUIRE(at(statistics.fused_nodes, FusedShape::VariableScale) == 6);
+    REQUIRE(at(statistics.occurrences, FusedShape::VariableMax) == 1);
+    REQUIRE(at(statistics.occurrences, FusedShape::VariableMin) == 0);
+    REQUIRE(at(statistics.occurrences, FusedShape::VariableMembership) == 0);
+}
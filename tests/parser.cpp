@@ -1,8 +1,10 @@
+#include "cura-formulae-engine/ast/printer.h"
 #include "cura-formulae-engine/cura-formulae-engine.h"
 
 #include <catch2/catch_all.hpp>
 #include <catch2/catch_test_macros.hpp>
 #include <cmath>
+#include <limits>
 #include <numbers>
 #include <optional>
 #include <string>
@@ -2279,3 +2281,23 @@ TEST_CASE("Falcon infill", "[parser, fdm_printer.def.json example]")
     REQUIRE(eval.has_value());
     REQUIRE(eval.value().deepEq(expected_eval));
 }
+
+TEST_CASE("printed floats parse back to the same value", "[parser, printer]")
+{
+    const std::vector<double> values{ 0.00001, 0.1, 1e300, 123456789.125, -0.0, -2.5, std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity() };
+    for (const auto value : values)
+    {
+        const auto printed = print(make_expr_ptr<FloatExpr>(value));
+        INFO(printed);
+        const auto message = CuraFormulaeEngine::parser::parse(printed);
+        REQUIRE(message.has_value());
+        const auto eval = message.value().evaluate(&CuraFormulaeEngine::env::std_env);
+        REQUIRE(eval.has_value());
+        REQUIRE(std::get<double>(eval.value().value) == value);
+        REQUIRE(std::signbit(std::get<double>(eval.value().value)) == std::signbit(value));
+    }
+
+    const auto nan = CuraFormulaeEngine::parser::parse(print(make_expr_ptr<FloatExpr>(std::numeric_limits<double>::quiet_NaN())));
+    REQUIRE(nan.has_value());
+    REQUIRE(std::isnan(std::get<double>(nan.value().evaluate(&CuraFormulaeEngine::env::std_env).value().value)));
+}